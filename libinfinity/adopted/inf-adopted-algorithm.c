@@ -60,13 +60,17 @@
 
 /* TODO: Do only cleanup if too much entries in cache? */
 
-/* TODO: If users are not issuing any requests for some time, and we can be
- * sure that we do not need to transform any requests, then remove them from
- * the users array (users_begin, users_end). Readd users as soon as they
- * issue buffer-altering requests. This way we keep the asymptotic complexity
- * dynamically as O(active users^2). */
+/* Users whose request log is empty cannot have issued any request that still
+ * needs to be transformed, so apart from the users array (users_begin,
+ * users_end) we keep the array of active users (active_begin, active_end),
+ * which contains only the users with a non-empty request log. Users are
+ * removed from it when cleanup drops their last request and readded as soon
+ * as they issue another buffer-altering request. This way the cost of
+ * translating requests depends on the number of active users, even for
+ * sessions with many idle users. */
 
 #include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-request-log-private.h>
 #include <libinfinity/inf-signals.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -81,6 +85,10 @@ typedef struct _InfAdoptedAlgorithmPrivate InfAdoptedAlgorithmPrivate;
 struct _InfAdoptedAlgorithmPrivate {
   /* request log policy */
   guint max_total_log_size;
+  guint max_cache_size;
+
+  /* Memory budget for cached requests, shared by all users' logs */
+  InfAdoptedRequestCache* request_cache;
 
   InfAdoptedStateVector* current;
   InfAdoptedStateVector* buffer_modified_time;
@@ -95,7 +103,20 @@ struct _InfAdoptedAlgorithmPrivate {
   InfAdoptedUser** users_begin;
   InfAdoptedUser** users_end;
 
+  /* Users with a non-empty request log. The array has the same capacity as
+   * the users array. */
+  InfAdoptedUser** active_begin;
+  InfAdoptedUser** active_end;
+
   GSList* local_users;
+
+  /* Nesting depth of inf_adopted_algorithm_begin_batch(). While a batch is
+   * running, updating the local user times, the modified flag of the buffer
+   * and the undo/redo state of local users is deferred until the end of the
+   * batch. */
+  guint batch_depth;
+  gboolean batch_state_changed;
+  gboolean batch_undo_redo_changed;
 };
 
 enum {
@@ -105,6 +126,8 @@ enum {
   PROP_USER_TABLE,
   PROP_BUFFER,
   PROP_MAX_TOTAL_LOG_SIZE,
+
+  PROP_MAX_CACHE_SIZE,
   
   /* read/only */
   PROP_CURRENT_STATE,
@@ -129,78 +152,6 @@ static guint algorithm_signals[LAST_SIGNAL];
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedAlgorithm, inf_adopted_algorithm, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfAdoptedAlgorithm))
 
-/* Returns a new state vector v so that both first and second are causally
- * before v and so that there is no other state vector with the same property
- * that is causally before v. */
-/* TODO: Move this to state vector, possibly with a faster O(n)
- * implementation (This is O(n log n), at best) */
-static InfAdoptedStateVector*
-inf_adopted_algorithm_least_common_successor(InfAdoptedAlgorithm* algorithm,
-                                             InfAdoptedStateVector* first,
-                                             InfAdoptedStateVector* second)
-{
-  InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user;
-  InfAdoptedStateVector* result;
-  guint id;
-
-  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  result = inf_adopted_state_vector_new();
-
-  for(user = priv->users_begin; user != priv->users_end; ++ user)
-  {
-    id = inf_user_get_id(INF_USER(*user));
-    inf_adopted_state_vector_set(
-      result,
-      id,
-      MAX(
-        inf_adopted_state_vector_get(first, id),
-        inf_adopted_state_vector_get(second, id)
-      )
-    );
-  }
-
-  g_assert(inf_adopted_state_vector_causally_before(first, result));
-  g_assert(inf_adopted_state_vector_causally_before(second, result));
-  return result;
-}
-
-/* Returns a new state vector v so that v is both causally before first and
- * second and so that there is no other state vector with the same property
- * so that v is causally before that vector. */
-/* TODO: Move this to state vector, possibly with a faster O(n)
- * implementation (This is O(n log n), at best) */
-/* TODO: A version modifying first instead of returning a new result,
- * use in inf_adopted_algorithm_cleanup(). */
-static InfAdoptedStateVector*
-inf_adopted_algorithm_least_common_predecessor(InfAdoptedAlgorithm* algorithm,
-                                               InfAdoptedStateVector* first,
-                                               InfAdoptedStateVector* second)
-{
-  InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedUser** user;
-  InfAdoptedStateVector* result;
-  guint id;
-
-  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
-  result = inf_adopted_state_vector_new();
-
-  for(user = priv->users_begin; user != priv->users_end; ++ user)
-  {
-    id = inf_user_get_id(INF_USER(*user));
-    inf_adopted_state_vector_set(
-      result,
-      id,
-      MIN(
-        inf_adopted_state_vector_get(first, id),
-        inf_adopted_state_vector_get(second, id)
-      )
-    );
-  }
-
-  return result;
-}
-
 /* Checks whether the given request can be undone (or redone if it is an
  * undo request). In general, a user can perform an undo when
  * there is a request to undo in the request log. However, if there are too
@@ -339,6 +290,62 @@ inf_adopted_algorithm_local_user_free(InfAdoptedAlgorithm* algorithm,
   g_slice_free(InfAdoptedAlgorithmLocalUser, local);
 }
 
+static void
+inf_adopted_algorithm_activate_user(InfAdoptedAlgorithm* algorithm,
+                                    InfAdoptedUser* user)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_assert(priv->active_end - priv->active_begin <
+           priv->users_end - priv->users_begin);
+
+  *priv->active_end = user;
+  ++ priv->active_end;
+}
+
+/* Removes the user at position user_it from the active users array. The last
+ * active user is moved to user_it. */
+static void
+inf_adopted_algorithm_deactivate_user(InfAdoptedAlgorithm* algorithm,
+                                      InfAdoptedUser** user_it)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_assert(user_it >= priv->active_begin && user_it < priv->active_end);
+
+  -- priv->active_end;
+  *user_it = *priv->active_end;
+}
+
+static void
+inf_adopted_algorithm_request_log_add_request_cb(InfAdoptedRequestLog* log,
+                                                 InfAdoptedRequest* request,
+                                                 gpointer user_data)
+{
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedAlgorithmPrivate* priv;
+  InfUser* user;
+
+  algorithm = INF_ADOPTED_ALGORITHM(user_data);
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  /* A user is active exactly if its request log is non-empty, so if this is
+   * the only request in the log, then the user was not active before. */
+  if(inf_adopted_request_log_get_end(log) -
+     inf_adopted_request_log_get_begin(log) == 1)
+  {
+    user = inf_user_table_lookup_user_by_id(
+      priv->user_table,
+      inf_adopted_request_log_get_user_id(log)
+    );
+
+    g_assert(INF_ADOPTED_IS_USER(user));
+    inf_adopted_algorithm_activate_user(algorithm, INF_ADOPTED_USER(user));
+  }
+}
+
 static void
 inf_adopted_algorithm_add_user(InfAdoptedAlgorithm* algorithm,
                                InfAdoptedUser* user)
@@ -347,6 +354,7 @@ inf_adopted_algorithm_add_user(InfAdoptedAlgorithm* algorithm,
   InfAdoptedRequestLog* log;
   InfAdoptedStateVector* time;
   guint user_count;
+  guint active_count;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
@@ -364,6 +372,23 @@ inf_adopted_algorithm_add_user(InfAdoptedAlgorithm* algorithm,
     g_realloc(priv->users_begin, sizeof(InfAdoptedUser*) * user_count);
   priv->users_end = priv->users_begin + user_count;
   priv->users_begin[user_count - 1] = user;
+
+  active_count = priv->active_end - priv->active_begin;
+  priv->active_begin =
+    g_realloc(priv->active_begin, sizeof(InfAdoptedUser*) * user_count);
+  priv->active_end = priv->active_begin + active_count;
+
+  if(!inf_adopted_request_log_is_empty(log))
+    inf_adopted_algorithm_activate_user(algorithm, user);
+
+  _inf_adopted_request_log_set_cache(log, priv->request_cache);
+
+  g_signal_connect_after(
+    G_OBJECT(log),
+    "add-request",
+    G_CALLBACK(inf_adopted_algorithm_request_log_add_request_cb),
+    algorithm
+  );
 }
 
 static void
@@ -452,12 +477,14 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
   guint user_id;
   guint first_n;
   guint second_n;
+  guint active_diff;
 
   g_assert(inf_adopted_state_vector_causally_before(first, second));
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+  active_diff = 0;
 
-  for(user_it = priv->users_begin; user_it != priv->users_end; ++ user_it)
+  for(user_it = priv->active_begin; user_it != priv->active_end; ++ user_it)
   {
     user = *user_it;
     user_id = inf_user_get_id(INF_USER(user));
@@ -465,6 +492,7 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
 
     first_n = inf_adopted_state_vector_get(first, user_id);
     second_n = inf_adopted_state_vector_get(second, user_id);
+    active_diff += second_n - first_n;
 
     /* TODO: This algorithm can probably be optimized by moving it into 
      * request log. */
@@ -496,6 +524,13 @@ inf_adopted_algorithm_buffer_states_equivalent(InfAdoptedAlgorithm* algorithm,
       return FALSE;
   }
 
+  /* Inactive users have no requests in their request log, so the two states
+   * can only be equivalent if they agree in all components of inactive
+   * users. Since first is causally before second, this is the case exactly
+   * if the active users account for the whole difference. */
+  if(inf_adopted_state_vector_vdiff(first, second) != active_diff)
+    return FALSE;
+
   return TRUE;
 }
 
@@ -640,10 +675,10 @@ inf_adopted_algorithm_transform_request(InfAdoptedAlgorithm* algorithm,
   concurrency_id = INF_ADOPTED_CONCURRENCY_NONE;
   if(inf_adopted_request_need_concurrency_id(request_at, against_at) == TRUE)
   {
-    lcs = inf_adopted_algorithm_least_common_successor(
-      algorithm,
+    lcs = inf_adopted_state_vector_max(
       inf_adopted_request_get_vector(request),
-      inf_adopted_request_get_vector(against)
+      inf_adopted_request_get_vector(against),
+      NULL
     );
 
     g_assert(inf_adopted_state_vector_causally_before(lcs, at));
@@ -731,7 +766,9 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
     next_req = NULL;
 
     g_assert(inf_adopted_state_vector_causally_before(vector, to) == TRUE);
-    for(user_it = priv->users_begin; user_it != priv->users_end; ++user_it)
+    /* Users with an empty request log have from_n == to_n, so we only need
+     * to look at the active users here. */
+    for(user_it = priv->active_begin; user_it != priv->active_end; ++user_it)
     {
       user = *user_it;
       user_id = inf_user_get_id(INF_USER(user));
@@ -845,6 +882,81 @@ inf_adopted_algorithm_translate_request_forward(InfAdoptedAlgorithm* algorithm,
   return cur_req;
 }
 
+/* Unsets the modified flag of the buffer if the current state is equivalent
+ * (reachable only by folding, i.e. skipping undo/redo pairs) to the known
+ * state when the buffer was not considered modified. */
+static void
+inf_adopted_algorithm_update_buffer_modified(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  gboolean equivalent;
+
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  if(priv->buffer_modified_time != NULL)
+  {
+    equivalent = inf_adopted_algorithm_buffer_states_equivalent(
+      algorithm,
+      priv->buffer_modified_time,
+      priv->current
+    );
+
+    if(equivalent == TRUE)
+    {
+      inf_buffer_set_modified(priv->buffer, FALSE);
+      inf_adopted_state_vector_free(priv->buffer_modified_time);
+      priv->buffer_modified_time =
+        inf_adopted_state_vector_copy(priv->current);
+    }
+    else
+    {
+      /* The buffer does this automatically when applying an operation: */
+      /*inf_buffer_set_modified(priv->buffer, TRUE);*/
+    }
+  }
+  else
+  {
+    /* When the modified flag is set to false, then we create the
+     * buffer_modified_time, so when it is unset, the flag needs to be set.
+     * Otherwise, we didn't get notified correctly. */
+    g_assert(inf_buffer_get_modified(priv->buffer) == TRUE);
+  }
+}
+
+/* Performs the updates that have been deferred while a batch is running. */
+static void
+inf_adopted_algorithm_flush_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  if(priv->batch_state_changed)
+  {
+    priv->batch_state_changed = FALSE;
+    inf_adopted_algorithm_update_local_user_times(algorithm);
+
+    inf_signal_handlers_block_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+
+    inf_adopted_algorithm_update_buffer_modified(algorithm);
+
+    inf_signal_handlers_unblock_by_func(
+      G_OBJECT(priv->buffer),
+      G_CALLBACK(inf_adopted_algorithm_buffer_notify_modified_cb),
+      algorithm
+    );
+  }
+
+  if(priv->batch_undo_redo_changed)
+  {
+    priv->batch_undo_redo_changed = FALSE;
+    inf_adopted_algorithm_update_undo_redo(algorithm);
+  }
+}
+
 static void
 inf_adopted_algorithm_log_request(InfAdoptedAlgorithm* algorithm,
                                   InfAdoptedUser* user,
@@ -855,7 +967,6 @@ inf_adopted_algorithm_log_request(InfAdoptedAlgorithm* algorithm,
 /*  InfAdoptedStateVector* user_vector;
   InfAdoptedStateVector* request_vector;*/
   guint user_id;
-  gboolean equivalent;
 
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
   log = inf_adopted_user_get_request_log(user);
@@ -873,39 +984,16 @@ inf_adopted_algorithm_log_request(InfAdoptedAlgorithm* algorithm,
     inf_adopted_request_log_add_request(log, request);
     /* Update current document state */
     inf_adopted_state_vector_add(priv->current, user_id, 1);
-    /* Update local user times */
-    inf_adopted_algorithm_update_local_user_times(algorithm);
 
-    /* Unset the modified flag of the buffer if the state is equivalent
-     * (reachable only by folding, i.e. skipping undo/redo pairs) to the
-     * known state when the buffer was not considered modified. */
-    if(priv->buffer_modified_time != NULL)
+    if(priv->batch_depth > 0)
     {
-      equivalent = inf_adopted_algorithm_buffer_states_equivalent(
-        algorithm,
-        priv->buffer_modified_time,
-        priv->current
-      );
-
-      if(equivalent == TRUE)
-      {
-        inf_buffer_set_modified(priv->buffer, FALSE);
-        inf_adopted_state_vector_free(priv->buffer_modified_time);
-        priv->buffer_modified_time =
-          inf_adopted_state_vector_copy(priv->current);
-      }
-      else
-      {
-        /* The buffer does this automatically when applying an operation: */
-        /*inf_buffer_set_modified(priv->buffer, TRUE);*/
-      }
+      priv->batch_state_changed = TRUE;
     }
     else
     {
-      /* When the modified flag is set to false, then we create the
-       * buffer_modified_time, so when it is unset, the flag needs to be set.
-       * Otherwise, we didn't get notified correctly. */
-      g_assert(inf_buffer_get_modified(priv->buffer) == TRUE);
+      /* Update local user times */
+      inf_adopted_algorithm_update_local_user_times(algorithm);
+      inf_adopted_algorithm_update_buffer_modified(algorithm);
     }
   }
 }
@@ -1034,6 +1122,8 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   priv->max_total_log_size = 2048;
+  priv->max_cache_size = 4 * 1024 * 1024;
+  priv->request_cache = _inf_adopted_request_cache_new(priv->max_cache_size);
   priv->execute_request = NULL;
 
   priv->current = inf_adopted_state_vector_new();
@@ -1045,8 +1135,14 @@ inf_adopted_algorithm_init(InfAdoptedAlgorithm* algorithm)
    * reference anyway. */
   priv->users_begin = NULL;
   priv->users_end = NULL;
+  priv->active_begin = NULL;
+  priv->active_end = NULL;
 
   priv->local_users = NULL;
+
+  priv->batch_depth = 0;
+  priv->batch_state_changed = FALSE;
+  priv->batch_undo_redo_changed = FALSE;
 }
 
 static void
@@ -1106,6 +1202,7 @@ inf_adopted_algorithm_dispose(GObject* object)
 {
   InfAdoptedAlgorithm* algorithm;
   InfAdoptedAlgorithmPrivate* priv;
+  InfAdoptedUser** user;
   GList* item;
 
   algorithm = INF_ADOPTED_ALGORITHM(object);
@@ -1114,7 +1211,27 @@ inf_adopted_algorithm_dispose(GObject* object)
   while(priv->local_users != NULL)
     inf_adopted_algorithm_local_user_free(algorithm, priv->local_users->data);
 
+  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  {
+    inf_signal_handlers_disconnect_by_func(
+      G_OBJECT(inf_adopted_user_get_request_log(*user)),
+      G_CALLBACK(inf_adopted_algorithm_request_log_add_request_cb),
+      algorithm
+    );
+
+    _inf_adopted_request_log_set_cache(
+      inf_adopted_user_get_request_log(*user),
+      NULL
+    );
+  }
+
   g_free(priv->users_begin);
+  priv->users_begin = NULL;
+  priv->users_end = NULL;
+
+  g_free(priv->active_begin);
+  priv->active_begin = NULL;
+  priv->active_end = NULL;
 
   if(priv->buffer != NULL)
   {
@@ -1168,6 +1285,7 @@ inf_adopted_algorithm_finalize(GObject* object)
   priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
 
   inf_adopted_state_vector_free(priv->current);
+  _inf_adopted_request_cache_free(priv->request_cache);
 
   G_OBJECT_CLASS(inf_adopted_algorithm_parent_class)->finalize(object);
 }
@@ -1228,6 +1346,15 @@ inf_adopted_algorithm_set_property(GObject* object,
     break;
   case PROP_MAX_TOTAL_LOG_SIZE:
     priv->max_total_log_size = g_value_get_uint(value);
+    break;
+  case PROP_MAX_CACHE_SIZE:
+    priv->max_cache_size = g_value_get_uint(value);
+
+    _inf_adopted_request_cache_set_max_size(
+      priv->request_cache,
+      priv->max_cache_size
+    );
+
     break;
   case PROP_CURRENT_STATE:
   case PROP_BUFFER_MODIFIED_STATE:
@@ -1261,6 +1388,9 @@ inf_adopted_algorithm_get_property(GObject* object,
   case PROP_MAX_TOTAL_LOG_SIZE:
     g_value_set_uint(value, priv->max_total_log_size);
     break;
+  case PROP_MAX_CACHE_SIZE:
+    g_value_set_uint(value, priv->max_cache_size);
+    break;
   case PROP_CURRENT_STATE:
     g_value_set_boxed(value, priv->current);
     break;
@@ -1356,6 +1486,22 @@ inf_adopted_algorithm_class_init(InfAdoptedAlgorithmClass* algorithm_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_MAX_CACHE_SIZE,
+    g_param_spec_uint(
+      "max-cache-size",
+      "Maximum cache size",
+      "The approximate number of bytes the request logs of all users "
+      "together may use to cache translated requests, or G_MAXUINT for no "
+      "limit",
+      0,
+      G_MAXUINT,
+      4 * 1024 * 1024,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_install_property(
     object_class,
     PROP_CURRENT_STATE,
@@ -1867,6 +2013,16 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
 
   /* not re-entrant */
   g_return_val_if_fail(priv->execute_request == NULL, FALSE);
+
+  /* The undo/redo state and the vector of local users are not up to date
+   * while a batch is running, but they are required to execute requests of
+   * local users. */
+  if(priv->batch_depth > 0 &&
+     inf_adopted_algorithm_find_local_user(algorithm, user) != NULL)
+  {
+    inf_adopted_algorithm_flush_batch(algorithm);
+  }
+
   priv->execute_request = request;
 
   inf_adopted_request_set_execute_time(request, g_get_real_time());
@@ -2025,7 +2181,10 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
     algorithm
   );
 
-  inf_adopted_algorithm_update_undo_redo(algorithm);
+  if(priv->batch_depth > 0)
+    priv->batch_undo_redo_changed = TRUE;
+  else
+    inf_adopted_algorithm_update_undo_redo(algorithm);
 
   g_signal_emit(
     G_OBJECT(algorithm),
@@ -2044,6 +2203,114 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
   return TRUE;
 }
 
+/**
+ * inf_adopted_algorithm_begin_batch:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Starts a batch of requests. Until the corresponding call to
+ * inf_adopted_algorithm_end_batch(), requests executed with
+ * inf_adopted_algorithm_execute_request() are transformed and applied to the
+ * buffer as usual, and the #InfAdoptedAlgorithm::begin-execute-request and
+ * #InfAdoptedAlgorithm::end-execute-request signals are emitted for each of
+ * them. However, the vector times of local users, the modified flag of the
+ * buffer and the undo/redo state of local users, including the
+ * #InfAdoptedAlgorithm::can-undo-changed and
+ * #InfAdoptedAlgorithm::can-redo-changed signals, are only updated once at
+ * the end of the batch.
+ *
+ * This is useful when executing many remote requests at once, for example
+ * when several requests have been received at the same time, since the
+ * deferred updates need time proportional to the number of local users for
+ * each request. If a request of a local user is executed while a batch is
+ * running, then the deferred updates are performed before executing it.
+ *
+ * Batches can be nested, in which case the updates are performed when the
+ * outermost batch ends.
+ */
+void
+inf_adopted_algorithm_begin_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  ++ priv->batch_depth;
+}
+
+/**
+ * inf_adopted_algorithm_end_batch:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ *
+ * Ends a batch of requests started with inf_adopted_algorithm_begin_batch().
+ * If this ends the outermost batch, then the updates that have been deferred
+ * during the batch are performed.
+ */
+void
+inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm)
+{
+  InfAdoptedAlgorithmPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm));
+  priv = INF_ADOPTED_ALGORITHM_PRIVATE(algorithm);
+
+  g_return_if_fail(priv->batch_depth > 0);
+  g_return_if_fail(priv->execute_request == NULL);
+
+  -- priv->batch_depth;
+  if(priv->batch_depth == 0)
+    inf_adopted_algorithm_flush_batch(algorithm);
+}
+
+/**
+ * inf_adopted_algorithm_execute_requests:
+ * @algorithm: A #InfAdoptedAlgorithm.
+ * @requests: (array length=n_requests): The requests to execute, in order.
+ * @n_requests: The number of elements in @requests.
+ * @error: Location to store error information, if any.
+ *
+ * Executes all requests in @requests, as if by calling
+ * inf_adopted_algorithm_execute_request() with @apply set to %TRUE for each
+ * of them, within a batch as described in
+ * inf_adopted_algorithm_begin_batch().
+ *
+ * If executing one of the requests fails, then the remaining requests are
+ * not executed, and the function returns %FALSE with @error set. The
+ * requests executed before the failing one remain executed.
+ *
+ * Returns: %TRUE if all requests were executed successfully, or %FALSE
+ * on error.
+ */
+gboolean
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       GError** error)
+{
+  guint i;
+  gboolean result;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_ALGORITHM(algorithm), FALSE);
+  g_return_val_if_fail(requests != NULL || n_requests == 0, FALSE);
+  g_return_val_if_fail(error == NULL || *error == NULL, FALSE);
+
+  result = TRUE;
+  inf_adopted_algorithm_begin_batch(algorithm);
+
+  for(i = 0; i < n_requests && result == TRUE; ++i)
+  {
+    result = inf_adopted_algorithm_execute_request(
+      algorithm,
+      requests[i],
+      TRUE,
+      error
+    );
+  }
+
+  inf_adopted_algorithm_end_batch(algorithm);
+  return result;
+}
+
 /**
  * inf_adopted_algorithm_cleanup:
  * @algorithm: A #InfAdoptedAlgorithm.
@@ -2061,7 +2328,6 @@ void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
 {
   InfAdoptedAlgorithmPrivate* priv;
-  InfAdoptedStateVector* temp;
   InfAdoptedStateVector* lcp;
   InfAdoptedUser** user;
   InfAdoptedRequestLog* log;
@@ -2102,23 +2368,25 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
    * are additional conditions. However, in the current case, some requests
    * are just kept a bit longer than necessary, in favor of simplicity. */
 
+  /* Idle users still need to be considered here since they might not have
+   * processed all requests yet. */
   lcp = inf_adopted_state_vector_copy(priv->current);
   for(user = priv->users_begin; user != priv->users_end; ++ user)
   {
     if(inf_user_get_status(INF_USER(*user)) != INF_USER_UNAVAILABLE)
     {
-      temp = inf_adopted_algorithm_least_common_predecessor(
-        algorithm,
+      inf_adopted_state_vector_min(
         lcp,
-        inf_adopted_user_get_vector(*user)
+        inf_adopted_user_get_vector(*user),
+        lcp
       );
-
-      inf_adopted_state_vector_free(lcp);
-      lcp = temp;
     }
   }
 
-  for(user = priv->users_begin; user != priv->users_end; ++ user)
+  /* Users whose request log becomes empty are removed from the active users
+   * array, which moves the last active user to the current position. */
+  user = priv->active_begin;
+  while(user != priv->active_end)
   {
     id = inf_user_get_id(INF_USER(*user));
     log = inf_adopted_user_get_request_log(*user);
@@ -2170,6 +2438,11 @@ inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm)
     }
 
     inf_adopted_request_log_remove_requests(log, n);
+
+    if(inf_adopted_request_log_is_empty(log))
+      inf_adopted_algorithm_deactivate_user(algorithm, user);
+    else
+      ++ user;
   }
 
   inf_adopted_state_vector_free(lcp);
@@ -143,6 +143,18 @@ inf_adopted_algorithm_execute_request(InfAdoptedAlgorithm* algorithm,
                                       gboolean apply,
                                       GError** error);
 
+void
+inf_adopted_algorithm_begin_batch(InfAdoptedAlgorithm* algorithm);
+
+void
+inf_adopted_algorithm_end_batch(InfAdoptedAlgorithm* algorithm);
+
+gboolean
+inf_adopted_algorithm_execute_requests(InfAdoptedAlgorithm* algorithm,
+                                       InfAdoptedRequest** requests,
+                                       guint n_requests,
+                                       GError** error);
+
 void
 inf_adopted_algorithm_cleanup(InfAdoptedAlgorithm* algorithm);
 
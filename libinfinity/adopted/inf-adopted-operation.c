@@ -409,4 +409,33 @@ inf_adopted_operation_revert(InfAdoptedOperation* operation)
   return (*iface->revert)(operation);
 }
 
+/**
+ * inf_adopted_operation_get_memory_size:
+ * @operation: A #InfAdoptedOperation.
+ *
+ * Returns the number of bytes of memory held by @operation, including any
+ * data it references, such as text to be inserted. The value is an estimate
+ * that is used to limit the size of request caches. If the operation does
+ * not implement the #InfAdoptedOperationInterface.get_memory_size virtual
+ * function, the size of the operation's instance structure is returned.
+ *
+ * Returns: The memory used by @operation, in bytes.
+ **/
+gsize
+inf_adopted_operation_get_memory_size(InfAdoptedOperation* operation)
+{
+  InfAdoptedOperationInterface* iface;
+  GTypeQuery query;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(operation), 0);
+
+  iface = INF_ADOPTED_OPERATION_GET_IFACE(operation);
+
+  if(iface->get_memory_size != NULL)
+    return (*iface->get_memory_size)(operation);
+
+  g_type_query(G_TYPE_FROM_INSTANCE(operation), &query);
+  return query.instance_size;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -96,6 +96,11 @@ typedef enum _InfAdoptedOperationFlags {
  * effect of the operation. If @get_flags does never return the
  * %INF_ADOPTED_OPERATION_REVERSIBLE flag set, then this is allowed to be
  * %NULL.
+ * @get_memory_size: Virtual function that returns the number of bytes of
+ * memory held by the operation. This is used to account for requests in the
+ * request log cache. The implementation of this function is optional; if it
+ * is not implemented then only the size of the instance structure is
+ * accounted for.
  *
  * The virtual methods that need to be implemented by an operation to be used
  * with #InfAdoptedAlgorithm.
@@ -130,6 +135,8 @@ struct _InfAdoptedOperationInterface {
                                             GError** error);
 
   InfAdoptedOperation* (*revert)(InfAdoptedOperation* operation);
+
+  gsize (*get_memory_size)(InfAdoptedOperation* operation);
 };
 
 /**
@@ -184,6 +191,9 @@ inf_adopted_operation_is_reversible(InfAdoptedOperation* operation);
 InfAdoptedOperation*
 inf_adopted_operation_revert(InfAdoptedOperation* operation);
 
+gsize
+inf_adopted_operation_get_memory_size(InfAdoptedOperation* operation);
+
 G_END_DECLS
 
 #endif /* __INF_ADOPTED_OPERATION_H__ */
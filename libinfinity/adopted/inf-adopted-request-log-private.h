@@ -0,0 +1,50 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_ADOPTED_REQUEST_LOG_PRIVATE_H__
+#define __INF_ADOPTED_REQUEST_LOG_PRIVATE_H__
+
+#include <libinfinity/adopted/inf-adopted-request-log.h>
+
+/* A memory budget for cached requests that is shared among several request
+ * logs. When the cached requests of all logs together use more than the
+ * maximum size, then the least recently used ones are dropped, regardless
+ * of which log they belong to. */
+typedef struct _InfAdoptedRequestCache InfAdoptedRequestCache;
+
+InfAdoptedRequestCache*
+_inf_adopted_request_cache_new(guint max_size);
+
+void
+_inf_adopted_request_cache_free(InfAdoptedRequestCache* cache);
+
+void
+_inf_adopted_request_cache_set_max_size(InfAdoptedRequestCache* cache,
+                                        guint max_size);
+
+gsize
+_inf_adopted_request_cache_get_size(InfAdoptedRequestCache* cache);
+
+void
+_inf_adopted_request_log_set_cache(InfAdoptedRequestLog* log,
+                                   InfAdoptedRequestCache* cache);
+
+#endif /* __INF_ADOPTED_REQUEST_LOG_PRIVATE_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -37,15 +37,36 @@
  */
 
 #include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/adopted/inf-adopted-request-log-private.h>
 
 #include <string.h> /* For (g_)memmove */
 
-typedef struct _InfAdoptedRequestLogCleanupCacheData
-  InfAdoptedRequestLogCleanupCacheData;
-struct _InfAdoptedRequestLogCleanupCacheData {
-  guint user_id;
-  guint up_to;
-  GSList* requests_to_remove;
+struct _InfAdoptedRequestCache {
+  /* Cached requests of all logs using this cache, with the most recently
+   * used one at the head. */
+  GQueue lru;
+  gsize size;
+  guint max_size;
+};
+
+typedef struct _InfAdoptedRequestLogCacheEntry InfAdoptedRequestLogCacheEntry;
+struct _InfAdoptedRequestLogCacheEntry {
+  /* The log owning the entry, so that it can be removed from its log when
+   * it is evicted from a shared cache. */
+  InfAdoptedRequestLog* log;
+  InfAdoptedRequest* request;
+  /* Memory used by the entry, as accounted for in the cache size */
+  gsize size;
+  /* The request's component of the log's user, i.e. the index of the
+   * request it is a translation of. */
+  guint index;
+
+  /* Other cached requests with the same index */
+  InfAdoptedRequestLogCacheEntry* prev;
+  InfAdoptedRequestLogCacheEntry* next;
+
+  /* Link in the LRU list. data points back to the entry. */
+  GList lru_link;
 };
 
 typedef struct _InfAdoptedRequestLogEntry InfAdoptedRequestLogEntry;
@@ -64,7 +85,18 @@ typedef struct _InfAdoptedRequestLogPrivate InfAdoptedRequestLogPrivate;
 struct _InfAdoptedRequestLogPrivate {
   guint user_id;
   InfAdoptedRequestLogEntry* entries;
-  GTree* cache;
+
+  /* Transformation cache: Maps state vectors to cache entries, and indices
+   * to the first cache entry with that index. The entries are kept in the
+   * LRU list of lru_cache, which is either own_cache or a cache shared with
+   * other logs. cache_size is the memory used by this log's entries. */
+  GHashTable* cache;
+  GHashTable* cache_index;
+  InfAdoptedRequestCache* own_cache;
+  InfAdoptedRequestCache* lru_cache;
+  gsize cache_size;
+  guint64 cache_hits;
+  guint64 cache_misses;
 
   InfAdoptedRequestLogEntry* next_undo;
   InfAdoptedRequestLogEntry* next_redo;
@@ -98,6 +130,7 @@ enum {
 #define INF_ADOPTED_REQUEST_LOG_PRIVATE(obj)     ((InfAdoptedRequestLogPrivate*)(obj)->priv)
 
 static const guint INF_ADOPTED_REQUEST_LOG_INC = 0x80;
+
 static guint request_log_signals[LAST_SIGNAL];
 
 G_DEFINE_TYPE_WITH_CODE(InfAdoptedRequestLog, inf_adopted_request_log, G_TYPE_OBJECT,
@@ -159,64 +192,103 @@ inf_adopted_request_log_verify_related(InfAdoptedRequestLog* log)
  * Transformation cache
  */
 
-static int
-inf_adopted_request_log_cache_key_cmp(gconstpointer a,
-                                      gconstpointer b,
-                                      gpointer user_data)
+static guint
+inf_adopted_request_log_cache_hash(gconstpointer key)
 {
-  InfAdoptedRequestLog* log;
-  InfAdoptedRequestLogPrivate* priv;
-  const InfAdoptedStateVector* key_a;
-  const InfAdoptedStateVector* key_b;
-  guint n_a, n_b;
+  return inf_adopted_state_vector_hash((const InfAdoptedStateVector*)key);
+}
 
-  key_a = (const InfAdoptedStateVector*)a;
-  key_b = (const InfAdoptedStateVector*)b;
+static gboolean
+inf_adopted_request_log_cache_equal(gconstpointer a,
+                                    gconstpointer b)
+{
+  return inf_adopted_state_vector_compare(
+    (const InfAdoptedStateVector*)a,
+    (const InfAdoptedStateVector*)b
+  ) == 0;
+}
 
-  log = (InfAdoptedRequestLog*)user_data;
+/* Removes entry from the cache and frees it. */
+static void
+inf_adopted_request_log_cache_remove(InfAdoptedRequestLog* log,
+                                     InfAdoptedRequestLogCacheEntry* entry)
+{
+  InfAdoptedRequestLogPrivate* priv;
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
 
-  /* Primary, order by component of user ID -- this makes cleanup very
-   * efficient. */
-  n_a = inf_adopted_state_vector_get(key_a, priv->user_id);
-  n_b = inf_adopted_state_vector_get(key_b, priv->user_id);
+  if(entry->prev != NULL)
+  {
+    entry->prev->next = entry->next;
+  }
+  else if(entry->next != NULL)
+  {
+    g_hash_table_insert(
+      priv->cache_index,
+      GUINT_TO_POINTER(entry->index),
+      entry->next
+    );
+  }
+  else
+  {
+    g_hash_table_remove(priv->cache_index, GUINT_TO_POINTER(entry->index));
+  }
 
-  if(n_a < n_b)
-    return -1;
-  if(n_a > n_b)
-    return 1;
+  if(entry->next != NULL)
+    entry->next->prev = entry->prev;
 
-  /* If user ID component is equal, go by other components. */
-  return inf_adopted_state_vector_compare(key_a, key_b);
+  g_hash_table_remove(
+    priv->cache,
+    inf_adopted_request_get_vector(entry->request)
+  );
+
+  g_queue_unlink(&priv->lru_cache->lru, &entry->lru_link);
+  priv->lru_cache->size -= entry->size;
+  priv->cache_size -= entry->size;
+
+  g_object_unref(entry->request);
+  g_slice_free(InfAdoptedRequestLogCacheEntry, entry);
 }
 
-static gboolean
-inf_adopted_request_log_remove_requests_cache_foreach_func(gpointer key,
-                                                           gpointer value,
-                                                           gpointer user_data)
+/* Removes least recently used entries until the cache fits into its
+ * maximum size. The entries can belong to any log using the cache. */
+static void
+inf_adopted_request_cache_shrink(InfAdoptedRequestCache* cache)
 {
-  InfAdoptedStateVector* vector;
-  InfAdoptedRequestLogCleanupCacheData* data;
-
-  vector = (InfAdoptedStateVector*)key;
-  data = (InfAdoptedRequestLogCleanupCacheData*)user_data;
+  InfAdoptedRequestLogCacheEntry* entry;
+  GList* link;
 
-  /* Remove all requests which are a cached translation of one of the requests
-   * that have been removed, i.e. have a user component smaller than up_to. */
-  if(inf_adopted_state_vector_get(vector, data->user_id) < data->up_to)
+  while(cache->size > cache->max_size)
   {
-    data->requests_to_remove =
-      g_slist_prepend(data->requests_to_remove, vector);
-    return FALSE;
+    link = g_queue_peek_tail_link(&cache->lru);
+    g_assert(link != NULL);
+
+    entry = (InfAdoptedRequestLogCacheEntry*)link->data;
+    inf_adopted_request_log_cache_remove(entry->log, entry);
   }
-  else
+}
+
+/* Removes all of log's entries from the cache. Entries of other logs
+ * sharing the same cache are kept. */
+static void
+inf_adopted_request_log_cache_clear(InfAdoptedRequestLog* log)
+{
+  InfAdoptedRequestLogPrivate* priv;
+  GList* entries;
+  GList* item;
+
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+
+  entries = g_hash_table_get_values(priv->cache);
+  for(item = entries; item != NULL; item = item->next)
   {
-    /* Stop traversal. The tree is traversed in sorted order, and the primary
-     * sort criteria of the tree is the vector component of the user. So if
-     * we have reached this point, all other elements in the tree will have
-     * a higher user component and are not scheduled for removal. */
-    return TRUE;
+    inf_adopted_request_log_cache_remove(
+      log,
+      (InfAdoptedRequestLogCacheEntry*)item->data
+    );
   }
+
+  g_list_free(entries);
+  g_assert(priv->cache_size == 0);
 }
 
 /*
@@ -296,7 +368,19 @@ inf_adopted_request_log_init(InfAdoptedRequestLog* log)
 
   priv->alloc = INF_ADOPTED_REQUEST_LOG_INC;
   priv->entries = g_malloc(priv->alloc * sizeof(InfAdoptedRequestLogEntry));
-  priv->cache = NULL;
+
+  priv->cache = g_hash_table_new(
+    inf_adopted_request_log_cache_hash,
+    inf_adopted_request_log_cache_equal
+  );
+
+  priv->cache_index = g_hash_table_new(NULL, NULL);
+  priv->own_cache = _inf_adopted_request_cache_new(G_MAXUINT);
+  priv->lru_cache = priv->own_cache;
+  priv->cache_size = 0;
+  priv->cache_hits = 0;
+  priv->cache_misses = 0;
+
   priv->begin = 0;
   priv->end = 0;
   priv->offset = 0;
@@ -315,11 +399,7 @@ inf_adopted_request_log_dispose(GObject* object)
   log = INF_ADOPTED_REQUEST_LOG(object);
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
 
-  if(priv->cache != NULL)
-  {
-    g_tree_destroy(priv->cache);
-    priv->cache = NULL;
-  }
+  inf_adopted_request_log_cache_clear(log);
 
   for(i = priv->offset; i < priv->offset + (priv->end - priv->begin); ++ i)
     g_object_unref(G_OBJECT(priv->entries[i].request));
@@ -341,6 +421,9 @@ inf_adopted_request_log_finalize(GObject* object)
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
 
   g_free(priv->entries);
+  g_hash_table_destroy(priv->cache);
+  g_hash_table_destroy(priv->cache_index);
+  _inf_adopted_request_cache_free(priv->own_cache);
 
   G_OBJECT_CLASS(inf_adopted_request_log_parent_class)->finalize(object);
 }
@@ -943,9 +1026,9 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
                                         guint up_to)
 {
   InfAdoptedRequestLogPrivate* priv;
-  InfAdoptedRequestLogCleanupCacheData data;
+  InfAdoptedRequestLogCacheEntry* entry;
+  InfAdoptedRequestLogCacheEntry* next;
   guint i;
-  GSList* item;
 
   g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
 
@@ -962,6 +1045,22 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
   for(i = priv->offset; i < priv->offset + (up_to - priv->begin); ++i)
     g_object_unref(G_OBJECT(priv->entries[i].request));
 
+  /* Remove all requests which are a cached translation of one of the
+   * requests that are removed, i.e. have a user component smaller than
+   * up_to. */
+  if(g_hash_table_size(priv->cache_index) > 0)
+  {
+    for(i = priv->begin; i < up_to; ++i)
+    {
+      entry = g_hash_table_lookup(priv->cache_index, GUINT_TO_POINTER(i));
+      for(; entry != NULL; entry = next)
+      {
+        next = entry->next;
+        inf_adopted_request_log_cache_remove(log, entry);
+      }
+    }
+  }
+
   g_object_freeze_notify(G_OBJECT(log));
 
   /* If the next undo/redo request has been removed, there cannot be
@@ -989,23 +1088,6 @@ inf_adopted_request_log_remove_requests(InfAdoptedRequestLog* log,
   priv->begin = up_to;
   g_object_notify(G_OBJECT(log), "begin");
 
-  if(priv->cache != NULL)
-  {
-    data.user_id = priv->user_id;
-    data.up_to = up_to;
-    data.requests_to_remove = NULL;
-
-    g_tree_foreach(
-      priv->cache,
-      inf_adopted_request_log_remove_requests_cache_foreach_func,
-      &data
-    );
-    
-    for(item = data.requests_to_remove; item != NULL; item = item->next)
-      g_tree_remove(priv->cache, (InfAdoptedStateVector*)item->data);
-    g_slist_free(data.requests_to_remove);
-  }
-
   inf_adopted_request_log_verify_related(log);
   g_object_thaw_notify(G_OBJECT(log));
 }
@@ -1322,9 +1404,14 @@ inf_adopted_request_log_lower_related(InfAdoptedRequestLog* log,
  * requests are removed from the log the cache is automatically updated
  * accordingly.
  *
- * The data structure of the cache is optimized for quick lookup of entries
- * by the state vector and cleaning up entries in an efficient manner also
- * when the cache has grown very big.
+ * The cache is a hash table keyed by the state vector of the cached
+ * requests, so lookups take constant time. When the log belongs to an
+ * #InfAdoptedAlgorithm, the memory used by the caches of all the
+ * algorithm's request logs together is bounded by the
+ * #InfAdoptedAlgorithm:max-cache-size property. If adding a request
+ * exceeds that size, then the least recently used requests of any of those
+ * logs are dropped from the cache. The memory used by a request is
+ * estimated with inf_adopted_request_get_memory_size().
  *
  * The request cache is mainly used by #InfAdoptedAlgorithm to efficiently
  * handle big transformations.
@@ -1338,6 +1425,8 @@ inf_adopted_request_log_add_cached_request(InfAdoptedRequestLog* log,
 {
   InfAdoptedRequestLogPrivate* priv;
   InfAdoptedStateVector* vector;
+  InfAdoptedRequestLogCacheEntry* entry;
+  gsize size;
 
   g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
   g_return_if_fail(INF_ADOPTED_IS_REQUEST(request));
@@ -1346,25 +1435,45 @@ inf_adopted_request_log_add_cached_request(InfAdoptedRequestLog* log,
   g_return_if_fail(inf_adopted_request_get_user_id(request) == priv->user_id);
 
   vector = inf_adopted_request_get_vector(request);
+  g_return_if_fail(g_hash_table_lookup(priv->cache, vector) == NULL);
 
-  if(priv->cache == NULL)
-  {
-    priv->cache = g_tree_new_full(
-      inf_adopted_request_log_cache_key_cmp,
-      log,
-      NULL,
-      g_object_unref
-    );
-  }
+  /* Don't bother if the cache cannot hold the entry at all */
+  size = sizeof(InfAdoptedRequestLogCacheEntry) +
+    inf_adopted_request_get_memory_size(request);
+  if(size > priv->lru_cache->max_size)
+    return;
 
-  g_return_if_fail(g_tree_lookup(priv->cache, vector) == NULL);
+  entry = g_slice_new(InfAdoptedRequestLogCacheEntry);
+  entry->log = log;
+  entry->request = request;
+  entry->size = size;
+  entry->index = inf_adopted_request_get_index(request);
+  entry->prev = NULL;
+  entry->next = g_hash_table_lookup(
+    priv->cache_index,
+    GUINT_TO_POINTER(entry->index)
+  );
 
-  g_tree_insert(priv->cache, vector, request);
+  entry->lru_link.data = entry;
+  entry->lru_link.prev = NULL;
+  entry->lru_link.next = NULL;
   g_object_ref(request);
 
-  /* Implement lookup_cached_request */
-  /* Use this implementation in InfAdoptedAlgorithm */
-  /* Make the performance tests */
+  if(entry->next != NULL)
+    entry->next->prev = entry;
+
+  g_hash_table_insert(
+    priv->cache_index,
+    GUINT_TO_POINTER(entry->index),
+    entry
+  );
+
+  g_hash_table_insert(priv->cache, vector, entry);
+  g_queue_push_head_link(&priv->lru_cache->lru, &entry->lru_link);
+  priv->lru_cache->size += size;
+  priv->cache_size += size;
+
+  inf_adopted_request_cache_shrink(priv->lru_cache);
 }
 
 /**
@@ -1386,14 +1495,120 @@ inf_adopted_request_log_lookup_cached_request(InfAdoptedRequestLog* log,
                                               InfAdoptedStateVector* vec)
 {
   InfAdoptedRequestLogPrivate* priv;
+  InfAdoptedRequestLogCacheEntry* entry;
 
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log), NULL);
   g_return_val_if_fail(vec != NULL, NULL);
 
   priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
-  if(priv->cache == NULL) return NULL;
 
-  return INF_ADOPTED_REQUEST(g_tree_lookup(priv->cache, vec));
+  entry = g_hash_table_lookup(priv->cache, vec);
+  if(entry == NULL)
+  {
+    ++ priv->cache_misses;
+    return NULL;
+  }
+
+  ++ priv->cache_hits;
+
+  /* Mark as most recently used */
+  g_queue_unlink(&priv->lru_cache->lru, &entry->lru_link);
+  g_queue_push_head_link(&priv->lru_cache->lru, &entry->lru_link);
+
+  return entry->request;
+}
+
+/**
+ * inf_adopted_request_log_get_cache_statistics:
+ * @log: A #InfAdoptedRequestLog.
+ * @hits: (out) (allow-none): Location to store the number of cache hits,
+ * or %NULL.
+ * @misses: (out) (allow-none): Location to store the number of cache misses,
+ * or %NULL.
+ * @size: (out) (allow-none): Location to store the approximate number of
+ * bytes currently used by the cached requests of @log, or %NULL.
+ *
+ * Returns statistics about the request cache of @log. @hits and @misses count
+ * the calls to inf_adopted_request_log_lookup_cached_request() that did and
+ * did not find a request in the cache, respectively, since @log was created.
+ * If the cache is shared with other request logs, @size only includes the
+ * requests cached for @log.
+ */
+void
+inf_adopted_request_log_get_cache_statistics(InfAdoptedRequestLog* log,
+                                             guint64* hits,
+                                             guint64* misses,
+                                             gsize* size)
+{
+  InfAdoptedRequestLogPrivate* priv;
+
+  g_return_if_fail(INF_ADOPTED_IS_REQUEST_LOG(log));
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+
+  if(hits != NULL) *hits = priv->cache_hits;
+  if(misses != NULL) *misses = priv->cache_misses;
+  if(size != NULL) *size = priv->cache_size;
+}
+
+/*
+ * Shared cache, see inf-adopted-request-log-private.h
+ */
+
+InfAdoptedRequestCache*
+_inf_adopted_request_cache_new(guint max_size)
+{
+  InfAdoptedRequestCache* cache;
+
+  cache = g_slice_new(InfAdoptedRequestCache);
+  g_queue_init(&cache->lru);
+  cache->size = 0;
+  cache->max_size = max_size;
+
+  return cache;
+}
+
+void
+_inf_adopted_request_cache_free(InfAdoptedRequestCache* cache)
+{
+  /* All logs need to stop using the cache before it is freed */
+  g_assert(g_queue_is_empty(&cache->lru));
+  g_assert(cache->size == 0);
+
+  g_slice_free(InfAdoptedRequestCache, cache);
+}
+
+void
+_inf_adopted_request_cache_set_max_size(InfAdoptedRequestCache* cache,
+                                        guint max_size)
+{
+  cache->max_size = max_size;
+  inf_adopted_request_cache_shrink(cache);
+}
+
+gsize
+_inf_adopted_request_cache_get_size(InfAdoptedRequestCache* cache)
+{
+  return cache->size;
+}
+
+/* Makes log keep its cached requests in cache, so that they count against
+ * the cache's memory budget. Pass NULL to make log use its own, unlimited
+ * cache again. Requests cached so far are dropped. */
+void
+_inf_adopted_request_log_set_cache(InfAdoptedRequestLog* log,
+                                   InfAdoptedRequestCache* cache)
+{
+  InfAdoptedRequestLogPrivate* priv;
+  priv = INF_ADOPTED_REQUEST_LOG_PRIVATE(log);
+
+  if(cache == NULL)
+    cache = priv->own_cache;
+
+  if(priv->lru_cache != cache)
+  {
+    inf_adopted_request_log_cache_clear(log);
+    priv->lru_cache = cache;
+  }
 }
 
 /* vim:set et sw=2 ts=2: */
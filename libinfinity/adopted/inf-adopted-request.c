@@ -160,8 +160,10 @@ inf_adopted_request_set_property(GObject* object,
     priv->vector = g_value_dup_boxed(value);
     break;
   case PROP_USER_ID:
+    /* 0 is an invalid ID, but it is what GObject passes when the request
+     * is constructed without properties, as done by
+     * inf_adopted_request_new_common(), which sets the ID afterwards. */
     g_assert(priv->user_id == 0); /* construct only */
-    g_assert(g_value_get_uint(value) != 0); /* 0 is invalid ID */
     priv->user_id = g_value_get_uint(value);
     break;
   case PROP_OPERATION:
@@ -310,6 +312,37 @@ inf_adopted_request_class_init(InfAdoptedRequestClass* request_class)
   );
 }
 
+/* Creates a new request without going through the GObject property
+ * machinery, which is considerably faster for an object that is created
+ * as often as this one. Takes ownership of vector. */
+static InfAdoptedRequest*
+inf_adopted_request_new_common(InfAdoptedRequestType type,
+                               InfAdoptedStateVector* vector,
+                               guint user_id,
+                               InfAdoptedOperation* operation,
+                               gint64 received,
+                               gint64 executed)
+{
+  InfAdoptedRequest* request;
+  InfAdoptedRequestPrivate* priv;
+
+  g_assert(user_id != 0);
+  g_assert( (type == INF_ADOPTED_REQUEST_DO) == (operation != NULL) );
+
+  request = INF_ADOPTED_REQUEST(g_object_new(INF_ADOPTED_TYPE_REQUEST, NULL));
+  priv = INF_ADOPTED_REQUEST_PRIVATE(request);
+
+  priv->type = type;
+  priv->vector = vector;
+  priv->user_id = user_id;
+  if(operation != NULL)
+    priv->operation = g_object_ref(operation);
+  priv->received = received;
+  priv->executed = executed;
+
+  return request;
+}
+
 /**
  * inf_adopted_request_new_do: (constructor)
  * @vector: The vector time at which the request was made.
@@ -327,23 +360,18 @@ inf_adopted_request_new_do(InfAdoptedStateVector* vector,
                            InfAdoptedOperation* operation,
                            gint64 received)
 {
-  GObject* object;
-
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
   g_return_val_if_fail(INF_ADOPTED_IS_OPERATION(operation), NULL);
 
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_DO,
-    "vector", vector,
-    "user-id", user_id,
-    "operation", operation,
-    "received", received,
-    NULL
+  return inf_adopted_request_new_common(
+    INF_ADOPTED_REQUEST_DO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    operation,
+    received,
+    0
   );
-
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -364,21 +392,17 @@ inf_adopted_request_new_undo(InfAdoptedStateVector* vector,
                              guint user_id,
                              gint64 received)
 {
-  GObject* object;
-
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
 
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_UNDO,
-    "vector", vector,
-    "user-id", user_id,
-    "received", received,
-    NULL
+  return inf_adopted_request_new_common(
+    INF_ADOPTED_REQUEST_UNDO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    NULL,
+    received,
+    0
   );
-  
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -399,21 +423,17 @@ inf_adopted_request_new_redo(InfAdoptedStateVector* vector,
                              guint user_id,
                              gint64 received)
 {
-  GObject* object;
-  
   g_return_val_if_fail(vector != NULL, NULL);
   g_return_val_if_fail(user_id != 0, NULL);
-  
-  object = g_object_new(
-    INF_ADOPTED_TYPE_REQUEST,
-    "type", INF_ADOPTED_REQUEST_REDO,
-    "vector", vector,
-    "user-id", user_id,
-    "received", received,
-    NULL
+
+  return inf_adopted_request_new_common(
+    INF_ADOPTED_REQUEST_REDO,
+    inf_adopted_state_vector_copy(vector),
+    user_id,
+    NULL,
+    received,
+    0
   );
-  
-  return INF_ADOPTED_REQUEST(object);
 }
 
 /**
@@ -428,39 +448,18 @@ InfAdoptedRequest*
 inf_adopted_request_copy(InfAdoptedRequest* request)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
-  GObject* object;
-  
+
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
   priv = INF_ADOPTED_REQUEST_PRIVATE(request);
 
-  if(priv->type == INF_ADOPTED_REQUEST_DO)
-  {
-    object = g_object_new(
-      INF_ADOPTED_TYPE_REQUEST,
-      "type", priv->type,
-      "vector", priv->vector,
-      "user-id", priv->user_id,
-      "operation", priv->operation,
-      "received", priv->received,
-      NULL
-    );
-  }
-  else
-  {
-    object = g_object_new(
-      INF_ADOPTED_TYPE_REQUEST,
-      "type", priv->type,
-      "vector", priv->vector,
-      "user-id", priv->user_id,
-      "received", priv->received,
-      NULL
-    );
-  }
-
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(INF_ADOPTED_REQUEST(object));
-  new_priv->executed = priv->executed;
-  return INF_ADOPTED_REQUEST(object);
+  return inf_adopted_request_new_common(
+    priv->type,
+    inf_adopted_state_vector_copy(priv->vector),
+    priv->user_id,
+    priv->operation,
+    priv->received,
+    priv->executed
+  );
 }
 
 /**
@@ -700,7 +699,6 @@ inf_adopted_request_transform(InfAdoptedRequest* request,
   InfAdoptedRequestPrivate* against_priv;
   InfAdoptedRequestPrivate* request_lcs_priv;
   InfAdoptedRequestPrivate* against_lcs_priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedOperation* new_operation;
   InfAdoptedStateVector* new_vector;
   InfAdoptedRequest* new_request;
@@ -794,18 +792,16 @@ inf_adopted_request_transform(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(request_priv->vector);
   inf_adopted_state_vector_add(new_vector, against_priv->user_id, 1);
 
-  new_request = inf_adopted_request_new_do(
+  new_request = inf_adopted_request_new_common(
+    INF_ADOPTED_REQUEST_DO,
     new_vector,
     request_priv->user_id,
     new_operation,
-    request_priv->received
+    request_priv->received,
+    request_priv->executed
   );
 
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = request_priv->executed;
-
   g_object_unref(new_operation);
-  inf_adopted_state_vector_free(new_vector);
   return new_request;
 }
 
@@ -832,7 +828,6 @@ inf_adopted_request_mirror(InfAdoptedRequest* request,
                            guint by)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedOperation* new_operation;
   InfAdoptedStateVector* new_vector;
   InfAdoptedRequest* new_request;
@@ -851,18 +846,16 @@ inf_adopted_request_mirror(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(priv->vector);
   inf_adopted_state_vector_add(new_vector, priv->user_id, by);
 
-  new_request = inf_adopted_request_new_do(
+  new_request = inf_adopted_request_new_common(
+    INF_ADOPTED_REQUEST_DO,
     new_vector,
     priv->user_id,
     new_operation,
-    priv->received
+    priv->received,
+    priv->executed
   );
 
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = priv->executed;
-
   g_object_unref(new_operation);
-  inf_adopted_state_vector_free(new_vector);
   return new_request;
 }
 
@@ -889,9 +882,7 @@ inf_adopted_request_fold(InfAdoptedRequest* request,
                          guint by)
 {
   InfAdoptedRequestPrivate* priv;
-  InfAdoptedRequestPrivate* new_priv;
   InfAdoptedStateVector* new_vector;
-  InfAdoptedRequest* new_request;
 
   g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), NULL);
   g_return_val_if_fail(into != 0, NULL);
@@ -903,39 +894,14 @@ inf_adopted_request_fold(InfAdoptedRequest* request,
   new_vector = inf_adopted_state_vector_copy(priv->vector);
   inf_adopted_state_vector_add(new_vector, into, by);
 
-  if(priv->type == INF_ADOPTED_REQUEST_DO)
-  {
-    new_request = INF_ADOPTED_REQUEST(
-      g_object_new(
-        INF_ADOPTED_TYPE_REQUEST,
-        "type", priv->type,
-        "operation", priv->operation,
-        "vector", new_vector,
-        "user-id", priv->user_id,
-        "received", priv->received,
-        NULL
-      )
-    );
-  }
-  else
-  {
-    new_request = INF_ADOPTED_REQUEST(
-      g_object_new(
-        INF_ADOPTED_TYPE_REQUEST,
-        "type", priv->type,
-        "vector", new_vector,
-        "user-id", priv->user_id,
-        "received", priv->received,
-        NULL
-      )
-    );
-  }
-
-  new_priv = INF_ADOPTED_REQUEST_PRIVATE(new_request);
-  new_priv->executed = priv->executed;
-
-  inf_adopted_state_vector_free(new_vector);
-  return new_request;
+  return inf_adopted_request_new_common(
+    priv->type,
+    new_vector,
+    priv->user_id,
+    priv->operation,
+    priv->received,
+    priv->executed
+  );
 }
 
 /**
@@ -980,4 +946,31 @@ inf_adopted_request_affects_buffer(InfAdoptedRequest* request)
   }
 }
 
+/**
+ * inf_adopted_request_get_memory_size:
+ * @request: A #InfAdoptedRequest.
+ *
+ * Returns an estimate of the number of bytes of memory held by @request,
+ * including its state vector and, for %INF_ADOPTED_REQUEST_DO requests, its
+ * operation as reported by inf_adopted_operation_get_memory_size().
+ *
+ * Returns: The memory used by @request, in bytes.
+ **/
+gsize
+inf_adopted_request_get_memory_size(InfAdoptedRequest* request)
+{
+  InfAdoptedRequestPrivate* priv;
+  gsize size;
+
+  g_return_val_if_fail(INF_ADOPTED_IS_REQUEST(request), 0);
+  priv = INF_ADOPTED_REQUEST_PRIVATE(request);
+
+  size = sizeof(InfAdoptedRequest) + sizeof(InfAdoptedRequestPrivate);
+  size += inf_adopted_state_vector_get_memory_size(priv->vector);
+  if(priv->operation != NULL)
+    size += inf_adopted_operation_get_memory_size(priv->operation);
+
+  return size;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -149,6 +149,9 @@ inf_adopted_request_fold(InfAdoptedRequest* request,
 gboolean
 inf_adopted_request_affects_buffer(InfAdoptedRequest* request);
 
+gsize
+inf_adopted_request_get_memory_size(InfAdoptedRequest* request);
+
 G_END_DECLS
 
 #endif /* __INF_ADOPTED_REQUEST_H__ */
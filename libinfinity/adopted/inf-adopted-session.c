@@ -672,6 +672,11 @@ inf_adopted_session_remove_local_user_cb(InfUserTable* user_table,
   );
   g_assert(local != NULL);
 
+  /* If the user is only no longer local but still available then we can
+   * still send what has been held back for it. */
+  if(inf_user_get_status(user) != INF_USER_UNAVAILABLE)
+    inf_adopted_session_flush_requests(session);
+
   inf_adopted_session_stop_noop_timer(session, local);
   inf_adopted_state_vector_free(local->last_send_vector);
   priv->local_users = g_slist_remove(priv->local_users, local);
@@ -1054,6 +1059,9 @@ inf_adopted_session_to_xml_sync(InfSession* session,
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
   g_assert(priv->algorithm != NULL);
 
+  /* The request logs need to match the buffer content that is synchronized */
+  inf_adopted_session_flush_requests(INF_ADOPTED_SESSION(session));
+
   INF_SESSION_CLASS(inf_adopted_session_parent_class)->to_xml_sync(
     session,
     parent
@@ -1233,11 +1241,20 @@ inf_adopted_session_process_xml_run(InfSession* session,
       return INF_COMMUNICATION_SCOPE_PTP;
     }
 
+    /* Modifications held back for local users need to be executed before
+     * the remote request, since the buffer already contains them. */
+    inf_adopted_session_flush_requests(INF_ADOPTED_SESSION(session));
+
     /* Update the user vector to the state of the request. */
     user_vector = inf_adopted_state_vector_copy(request_vector);
     /* Note that this function takes ownership of user_vector */
     inf_adopted_user_set_vector(INF_ADOPTED_USER(user), user_vector);
 
+    /* Execute the request(s) and the buffered requests that become ready
+     * in one batch, so that the algorithm updates the state of local users
+     * only once. */
+    inf_adopted_algorithm_begin_batch(priv->algorithm);
+
     /* Apply the request more than once if num >= 2 is given. This is mostly
      * used for multiple undos and redos, but is in general allowed for any
      * request. */
@@ -1299,6 +1316,8 @@ inf_adopted_session_process_xml_run(InfSession* session,
       );
     }
 
+    inf_adopted_algorithm_end_batch(priv->algorithm);
+
     /* Cleanup requests that are no longer used after
      * having processed everything */
     inf_adopted_algorithm_cleanup(
@@ -1562,6 +1581,7 @@ inf_adopted_session_class_init(InfAdoptedSessionClass* adopted_session_class)
 
   adopted_session_class->xml_to_request = NULL;
   adopted_session_class->request_to_xml = NULL;
+  adopted_session_class->flush_requests = NULL;
   adopted_session_class->check_request = inf_adopted_session_check_request;
 
   inf_adopted_session_error_quark = g_quark_from_static_string(
@@ -1692,6 +1712,28 @@ inf_adopted_session_broadcast_request(InfAdoptedSession* session,
   inf_adopted_session_broadcast_n_requests(session, request, 1);
 }
 
+/**
+ * inf_adopted_session_flush_requests:
+ * @session: A #InfAdoptedSession.
+ *
+ * Executes and broadcasts all buffer modifications of local users that
+ * @session has held back so far, see #InfAdoptedSessionClass.flush_requests.
+ * The session does this automatically before it executes other requests.
+ * Only code that executes requests on @session's #InfAdoptedAlgorithm
+ * directly needs to call this function before doing so.
+ **/
+void
+inf_adopted_session_flush_requests(InfAdoptedSession* session)
+{
+  InfAdoptedSessionClass* session_class;
+
+  g_return_if_fail(INF_ADOPTED_IS_SESSION(session));
+
+  session_class = INF_ADOPTED_SESSION_GET_CLASS(session);
+  if(session_class->flush_requests != NULL)
+    session_class->flush_requests(session);
+}
+
 /**
  * inf_adopted_session_undo:
  * @session: A #InfAdoptedSession.
@@ -1719,6 +1761,7 @@ inf_adopted_session_undo(InfAdoptedSession* session,
   /* TODO: Check whether we can issue n undo requests before doing anything */
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  inf_adopted_session_flush_requests(session);
 
   first_request = NULL;
   for(i = 0; i < n; ++i)
@@ -1777,6 +1820,7 @@ inf_adopted_session_redo(InfAdoptedSession* session,
   g_return_if_fail(n >= 1);
 
   priv = INF_ADOPTED_SESSION_PRIVATE(session);
+  inf_adopted_session_flush_requests(session);
 
   first_request = NULL;
   for(i = 0; i < n; ++i)
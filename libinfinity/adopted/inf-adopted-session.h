@@ -77,6 +77,11 @@ typedef enum _InfAdoptedSessionError {
  * common info.
  * @check_request: Default signal handler of the
  * InfAdoptedSession::check-request signal.
+ * @flush_requests: Virtual function to execute and broadcast buffer
+ * modifications of local users that the session has held back so far, for
+ * example to merge them with adjacent ones. It is called before any other
+ * request is executed or the session is synchronized, so that the state of
+ * the algorithm matches the buffer content. May be %NULL.
  *
  * Virtual functions and default signal handlers for #InfAdoptedSession.
  */
@@ -104,6 +109,10 @@ struct _InfAdoptedSessionClass {
   gboolean(*check_request)(InfAdoptedSession* session,
                            InfAdoptedRequest* request,
                            InfAdoptedUser* user);
+
+  /* Virtual table, continued */
+
+  void(*flush_requests)(InfAdoptedSession* session);
 };
 
 /**
@@ -130,6 +139,9 @@ void
 inf_adopted_session_broadcast_request(InfAdoptedSession* session,
                                       InfAdoptedRequest* request);
 
+void
+inf_adopted_session_flush_requests(InfAdoptedSession* session);
+
 void
 inf_adopted_session_undo(InfAdoptedSession* session,
                          InfAdoptedUser* user,
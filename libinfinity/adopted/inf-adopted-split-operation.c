@@ -525,6 +525,18 @@ inf_adopted_split_operation_revert(InfAdoptedOperation* operation)
   return INF_ADOPTED_OPERATION(result);
 }
 
+static gsize
+inf_adopted_split_operation_get_memory_size(InfAdoptedOperation* operation)
+{
+  InfAdoptedSplitOperationPrivate* priv;
+  priv = INF_ADOPTED_SPLIT_OPERATION_PRIVATE(operation);
+
+  return sizeof(InfAdoptedSplitOperation) +
+    sizeof(InfAdoptedSplitOperationPrivate) +
+    inf_adopted_operation_get_memory_size(priv->first) +
+    inf_adopted_operation_get_memory_size(priv->second);
+}
+
 static void
 inf_adopted_split_operation_operation_iface_init(
   InfAdoptedOperationInterface* iface)
@@ -537,6 +549,7 @@ inf_adopted_split_operation_operation_iface_init(
   iface->apply = inf_adopted_split_operation_apply;
   iface->apply_transformed = inf_adopted_split_operation_apply_transformed;
   iface->revert = inf_adopted_split_operation_revert;
+  iface->get_memory_size = inf_adopted_split_operation_get_memory_size;
 }
 
 /**
@@ -62,6 +62,12 @@ struct _InfAdoptedStateVector {
   InfAdoptedStateVectorComponent* data;
 };
 
+typedef enum _InfAdoptedStateVectorMergeOp {
+  INF_ADOPTED_STATE_VECTOR_MERGE_MAX,
+  INF_ADOPTED_STATE_VECTOR_MERGE_MIN,
+  INF_ADOPTED_STATE_VECTOR_MERGE_DIFF
+} InfAdoptedStateVectorMergeOp;
+
 static gsize
 inf_adopted_state_vector_find_insert_pos(const InfAdoptedStateVector* vec,
                                          guint id)
@@ -144,6 +150,142 @@ inf_adopted_state_vector_insert(InfAdoptedStateVector* vec,
   return comp;
 }
 
+/* Makes sure that vec can hold at least size components without
+ * reallocation. Existing components are kept. */
+static void
+inf_adopted_state_vector_reserve(InfAdoptedStateVector* vec,
+                                 gsize size)
+{
+  if(vec->max_size < size)
+  {
+    vec->max_size = size;
+    vec->data = g_realloc(vec->data,
+                vec->max_size * sizeof(InfAdoptedStateVectorComponent));
+  }
+}
+
+/* Returns the number of distinct IDs in first and second. */
+static gsize
+inf_adopted_state_vector_union_size(const InfAdoptedStateVector* first,
+                                    const InfAdoptedStateVector* second)
+{
+  gsize first_pos;
+  gsize second_pos;
+  gsize size;
+
+  first_pos = 0;
+  second_pos = 0;
+  size = 0;
+
+  while(first_pos < first->size && second_pos < second->size)
+  {
+    if(first->data[first_pos].id < second->data[second_pos].id)
+    {
+      ++first_pos;
+    }
+    else if(first->data[first_pos].id > second->data[second_pos].id)
+    {
+      ++second_pos;
+    }
+    else
+    {
+      ++first_pos;
+      ++second_pos;
+    }
+
+    ++size;
+  }
+
+  return size + (first->size - first_pos) + (second->size - second_pos);
+}
+
+/* Combines the components of first and second into result, which can be
+ * the same as first or second, or NULL in which case a new vector is
+ * allocated. Both vectors are sorted by ID, so we can walk them in parallel.
+ * We walk them from the back, so that the result can be written into one of
+ * the input vectors without overwriting components that have not yet been
+ * read: at every step there are at least as many components left to be
+ * written as there are left to be read from either input. */
+static InfAdoptedStateVector*
+inf_adopted_state_vector_merge(const InfAdoptedStateVector* first,
+                               const InfAdoptedStateVector* second,
+                               InfAdoptedStateVector* result,
+                               InfAdoptedStateVectorMergeOp op)
+{
+  gsize size;
+  gsize first_pos;
+  gsize second_pos;
+  gsize result_pos;
+  guint id;
+  guint first_n;
+  guint second_n;
+
+  size = inf_adopted_state_vector_union_size(first, second);
+
+  if(result == NULL)
+    result = inf_adopted_state_vector_new();
+  /* Note that this may change first->data or second->data if result is
+   * the same as one of them. */
+  inf_adopted_state_vector_reserve(result, size);
+
+  first_pos = first->size;
+  second_pos = second->size;
+  result_pos = size;
+
+  while(first_pos > 0 || second_pos > 0)
+  {
+    if(second_pos == 0 ||
+       (first_pos > 0 &&
+        first->data[first_pos - 1].id > second->data[second_pos - 1].id))
+    {
+      --first_pos;
+      id = first->data[first_pos].id;
+      first_n = first->data[first_pos].n;
+      second_n = 0;
+    }
+    else if(first_pos == 0 ||
+            first->data[first_pos - 1].id < second->data[second_pos - 1].id)
+    {
+      --second_pos;
+      id = second->data[second_pos].id;
+      first_n = 0;
+      second_n = second->data[second_pos].n;
+    }
+    else
+    {
+      --first_pos;
+      --second_pos;
+      id = first->data[first_pos].id;
+      first_n = first->data[first_pos].n;
+      second_n = second->data[second_pos].n;
+    }
+
+    --result_pos;
+    result->data[result_pos].id = id;
+
+    switch(op)
+    {
+    case INF_ADOPTED_STATE_VECTOR_MERGE_MAX:
+      result->data[result_pos].n = MAX(first_n, second_n);
+      break;
+    case INF_ADOPTED_STATE_VECTOR_MERGE_MIN:
+      result->data[result_pos].n = MIN(first_n, second_n);
+      break;
+    case INF_ADOPTED_STATE_VECTOR_MERGE_DIFF:
+      g_assert(first_n <= second_n);
+      result->data[result_pos].n = second_n - first_n;
+      break;
+    default:
+      g_assert_not_reached();
+      break;
+    }
+  }
+
+  g_assert(result_pos == 0);
+  result->size = size;
+  return result;
+}
+
 /**
  * inf_adopted_state_vector_error_quark:
  *
@@ -431,6 +573,56 @@ inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
   }
 }
 
+/**
+ * inf_adopted_state_vector_hash:
+ * @vec: A #InfAdoptedStateVector.
+ *
+ * Computes a hash value for @vec, so that state vectors can be used as keys
+ * in a #GHashTable, together with inf_adopted_state_vector_compare() to
+ * check for equality. Components with a zero value are ignored, so that two
+ * vectors comparing equal also have the same hash value.
+ *
+ * Returns: A hash value for @vec.
+ **/
+guint
+inf_adopted_state_vector_hash(const InfAdoptedStateVector* vec)
+{
+  gsize pos;
+  guint hash;
+
+  g_return_val_if_fail(vec != NULL, 0);
+
+  hash = 5381;
+  for(pos = 0; pos < vec->size; ++pos)
+  {
+    if(vec->data[pos].n > 0)
+    {
+      hash = (hash * 33) ^ vec->data[pos].id;
+      hash = (hash * 33) ^ vec->data[pos].n;
+    }
+  }
+
+  return hash;
+}
+
+/**
+ * inf_adopted_state_vector_get_memory_size:
+ * @vec: A #InfAdoptedStateVector.
+ *
+ * Returns the number of bytes of memory that is allocated for @vec,
+ * including reserved but currently unused components.
+ *
+ * Returns: The memory used by @vec, in bytes.
+ **/
+gsize
+inf_adopted_state_vector_get_memory_size(const InfAdoptedStateVector* vec)
+{
+  g_return_val_if_fail(vec != NULL, 0);
+
+  return sizeof(InfAdoptedStateVector) +
+    vec->max_size * sizeof(InfAdoptedStateVectorComponent);
+}
+
 /**
  * inf_adopted_state_vector_causally_before:
  * @first: A #InfAdoptedStateVector.
@@ -450,50 +642,33 @@ inf_adopted_state_vector_causally_before(const InfAdoptedStateVector* first,
   gsize first_pos;
   gsize second_pos;
   InfAdoptedStateVectorComponent* first_comp;
-  InfAdoptedStateVectorComponent* second_comp;
+  guint second_n;
 
   g_return_val_if_fail(first != NULL, FALSE);
   g_return_val_if_fail(second != NULL, FALSE);
 
-  first_pos = 0;
   second_pos = 0;
 
-  while(first_pos < first->size)
+  for(first_pos = 0; first_pos < first->size; ++first_pos)
   {
-    first_comp = first->data + first_pos++;
+    first_comp = first->data + first_pos;
 
-    if(second_pos == second->size)
+    while(second_pos < second->size &&
+          second->data[second_pos].id < first_comp->id)
     {
-      /* That component is not contained in second (thus 0) */
-      if(first_comp->n > 0)
-        return FALSE;
+      ++second_pos;
     }
-    else
-    {
-      second_comp = second->data + second_pos;
-      while(second_comp != NULL && first_comp->id > second_comp->id)
-      {
-        ++second_pos;
-        if(second_pos != second->size)
-          second_comp = second->data + second_pos;
-        else
-          second_comp = NULL;
-      }
-
-      if(second_comp == NULL || first_comp->id < second_comp->id)
-      {
-        /* That component is not contained in second (thus 0) */
-        if(first_comp->n > 0)
-          return FALSE;
-        else
-          /* 0 <= 0 */
-          continue;
-      }
 
-      g_assert(first_comp->id == second_comp->id);
-      if(first_comp->n > second_comp->n)
-        return FALSE;
+    /* Components not contained in second are 0 */
+    second_n = 0;
+    if(second_pos < second->size &&
+       second->data[second_pos].id == first_comp->id)
+    {
+      second_n = second->data[second_pos].n;
     }
+
+    if(first_comp->n > second_n)
+      return FALSE;
   }
 
   return TRUE;
@@ -635,25 +810,156 @@ guint
 inf_adopted_state_vector_vdiff(const InfAdoptedStateVector* first,
                                const InfAdoptedStateVector* second)
 {
-  gsize n;
-  guint first_sum;
-  guint second_sum;
+  gsize first_pos;
+  gsize second_pos;
+  guint first_n;
+  guint second_n;
+  guint sum;
 
-  g_return_val_if_fail(
-    inf_adopted_state_vector_causally_before(first, second) == TRUE,
-    0
+  g_return_val_if_fail(first != NULL, 0);
+  g_return_val_if_fail(second != NULL, 0);
+
+  first_pos = 0;
+  second_pos = 0;
+  sum = 0;
+
+  /* Check that first is causally before second while walking both
+   * vectors, instead of in a separate pass. */
+  while(first_pos < first->size || second_pos < second->size)
+  {
+    if(second_pos == second->size ||
+       (first_pos < first->size &&
+        first->data[first_pos].id < second->data[second_pos].id))
+    {
+      first_n = first->data[first_pos++].n;
+      second_n = 0;
+    }
+    else if(first_pos == first->size ||
+            first->data[first_pos].id > second->data[second_pos].id)
+    {
+      first_n = 0;
+      second_n = second->data[second_pos++].n;
+    }
+    else
+    {
+      first_n = first->data[first_pos++].n;
+      second_n = second->data[second_pos++].n;
+    }
+
+    g_return_val_if_fail(first_n <= second_n, 0);
+    sum += second_n - first_n;
+  }
+
+  return sum;
+}
+
+/**
+ * inf_adopted_state_vector_max:
+ * @first: A #InfAdoptedStateVector.
+ * @second: Another #InfAdoptedStateVector.
+ * @result: (allow-none): A #InfAdoptedStateVector to write the result to,
+ * or %NULL.
+ *
+ * Computes the component-wise maximum of @first and @second. This is the
+ * least common successor of the two states, i.e. both @first and @second
+ * are causally before it, and it is causally before any other vector with
+ * that property.
+ *
+ * If @result is not %NULL, then the result is written into @result, which
+ * may be the same as @first or @second. In that case no memory is
+ * allocated, unless @result needs to grow to hold all components. If
+ * @result is %NULL, then a new state vector is returned.
+ *
+ * Returns: (transfer full): @result, or a new #InfAdoptedStateVector if
+ * @result is %NULL.
+ **/
+InfAdoptedStateVector*
+inf_adopted_state_vector_max(const InfAdoptedStateVector* first,
+                             const InfAdoptedStateVector* second,
+                             InfAdoptedStateVector* result)
+{
+  g_return_val_if_fail(first != NULL, NULL);
+  g_return_val_if_fail(second != NULL, NULL);
+
+  return inf_adopted_state_vector_merge(
+    first,
+    second,
+    result,
+    INF_ADOPTED_STATE_VECTOR_MERGE_MAX
+  );
+}
+
+/**
+ * inf_adopted_state_vector_min:
+ * @first: A #InfAdoptedStateVector.
+ * @second: Another #InfAdoptedStateVector.
+ * @result: (allow-none): A #InfAdoptedStateVector to write the result to,
+ * or %NULL.
+ *
+ * Computes the component-wise minimum of @first and @second. This is the
+ * least common predecessor of the two states, i.e. it is causally before
+ * both @first and @second, and any other vector with that property is
+ * causally before it.
+ *
+ * @result is handled in the same way as for inf_adopted_state_vector_max().
+ *
+ * Returns: (transfer full): @result, or a new #InfAdoptedStateVector if
+ * @result is %NULL.
+ **/
+InfAdoptedStateVector*
+inf_adopted_state_vector_min(const InfAdoptedStateVector* first,
+                             const InfAdoptedStateVector* second,
+                             InfAdoptedStateVector* result)
+{
+  g_return_val_if_fail(first != NULL, NULL);
+  g_return_val_if_fail(second != NULL, NULL);
+
+  return inf_adopted_state_vector_merge(
+    first,
+    second,
+    result,
+    INF_ADOPTED_STATE_VECTOR_MERGE_MIN
   );
+}
 
-  first_sum = 0;
-  second_sum = 0;
+/**
+ * inf_adopted_state_vector_diff:
+ * @first: A #InfAdoptedStateVector.
+ * @second: Another #InfAdoptedStateVector.
+ * @result: (allow-none): A #InfAdoptedStateVector to write the result to,
+ * or %NULL.
+ *
+ * Computes the component-wise difference of @second and @first, i.e. how
+ * many operations of each user have been performed in @second but not
+ * in @first. This function can only be called if
+ * inf_adopted_state_vector_causally_before() returns %TRUE. The sum of all
+ * components of the result is what inf_adopted_state_vector_vdiff()
+ * returns.
+ *
+ * @result is handled in the same way as for inf_adopted_state_vector_max().
+ *
+ * Returns: (transfer full): @result, or a new #InfAdoptedStateVector if
+ * @result is %NULL.
+ **/
+InfAdoptedStateVector*
+inf_adopted_state_vector_diff(const InfAdoptedStateVector* first,
+                              const InfAdoptedStateVector* second,
+                              InfAdoptedStateVector* result)
+{
+  g_return_val_if_fail(first != NULL, NULL);
+  g_return_val_if_fail(second != NULL, NULL);
 
-  for(n = 0; n < first->size; ++ n)
-    first_sum += first->data[n].n;
-  for(n = 0; n < second->size; ++ n)
-    second_sum += second->data[n].n;
+  g_return_val_if_fail(
+    inf_adopted_state_vector_causally_before(first, second) == TRUE,
+    NULL
+  );
 
-  g_assert(second_sum >= first_sum);
-  return second_sum - first_sum;
+  return inf_adopted_state_vector_merge(
+    first,
+    second,
+    result,
+    INF_ADOPTED_STATE_VECTOR_MERGE_DIFF
+  );
 }
 
 /**
@@ -101,6 +101,12 @@ int
 inf_adopted_state_vector_compare(const InfAdoptedStateVector* first,
                                  const InfAdoptedStateVector* second);
 
+guint
+inf_adopted_state_vector_hash(const InfAdoptedStateVector* vec);
+
+gsize
+inf_adopted_state_vector_get_memory_size(const InfAdoptedStateVector* vec);
+
 gboolean
 inf_adopted_state_vector_causally_before(const InfAdoptedStateVector* first,
                                          const InfAdoptedStateVector* second);
@@ -115,6 +121,21 @@ guint
 inf_adopted_state_vector_vdiff(const InfAdoptedStateVector* first,
                                const InfAdoptedStateVector* second);
 
+InfAdoptedStateVector*
+inf_adopted_state_vector_max(const InfAdoptedStateVector* first,
+                             const InfAdoptedStateVector* second,
+                             InfAdoptedStateVector* result);
+
+InfAdoptedStateVector*
+inf_adopted_state_vector_min(const InfAdoptedStateVector* first,
+                             const InfAdoptedStateVector* second,
+                             InfAdoptedStateVector* result);
+
+InfAdoptedStateVector*
+inf_adopted_state_vector_diff(const InfAdoptedStateVector* first,
+                              const InfAdoptedStateVector* second,
+                              InfAdoptedStateVector* result);
+
 gchar*
 inf_adopted_state_vector_to_string(const InfAdoptedStateVector* vec);
 
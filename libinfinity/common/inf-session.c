@@ -2435,6 +2435,11 @@ inf_session_set_user_status(InfSession* session,
 
   if(inf_user_get_status(user) != status)
   {
+    /* Change the status before announcing it, so that anything which is
+     * sent on behalf of the user in a signal handler, such as a held back
+     * request, reaches the other sites before the status change. */
+    g_object_set(G_OBJECT(user), "status", status, NULL);
+
     xml = xmlNewNode(NULL, (const xmlChar*)"user-status-change");
     inf_xml_util_set_attribute_uint(xml, "id", inf_user_get_id(user));
 
@@ -2446,8 +2451,6 @@ inf_session_set_user_status(InfSession* session,
 
     if(priv->subscription_group != NULL)
       inf_session_send_to_subscriptions(session, xml);
-
-    g_object_set(G_OBJECT(user), "status", status, NULL);
   }
 }
 
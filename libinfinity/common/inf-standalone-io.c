@@ -30,6 +30,11 @@
  * sockets, scheduling timeouts and inter-thread notifications. The class
  * is fully thread-safe.
  *
+ * On Linux, sockets are watched with epoll, so that the cost of an
+ * iteration does not depend on the total number of watched sockets. On
+ * other Unix systems poll() is used, and WSAWaitForMultipleEvents() on
+ * Windows.
+ *
  * This class can be perfectly used for all functions in libinfinity that
  * require a #InfIo object to wait for events. If, on top of that more
  * functionality is required, or the main loop needs to be integrated with
@@ -42,12 +47,20 @@
 #include <libinfinity/common/inf-standalone-io.h>
 #include <libinfinity/common/inf-io.h>
 
-/* TODO: Modularize the FD handling, then add epoll support */
+#include "config.h"
+
+#if !defined(G_OS_WIN32) && defined(HAVE_EPOLL)
+# define INF_STANDALONE_IO_EPOLL
+#endif
 
 #ifdef G_OS_WIN32
 # include <winsock2.h>
 #else
-# include <poll.h>
+# ifdef INF_STANDALONE_IO_EPOLL
+#  include <sys/epoll.h>
+# else
+#  include <poll.h>
+# endif
 # include <errno.h>
 # include <unistd.h>
 #endif /* !G_OS_WIN32 */
@@ -67,25 +80,40 @@ static const InfStandaloneIoPollTimeout INF_STANDALONE_IO_POLL_INFINITE =
     (Sleep(timeout), WSA_WAIT_TIMEOUT) : \
     (WSAWaitForMultipleEvents(num_events, events, FALSE, timeout, TRUE)))
 #else
+# ifdef INF_STANDALONE_IO_EPOLL
+typedef struct epoll_event InfStandaloneIoNativeEvent;
+# else
 typedef struct pollfd InfStandaloneIoNativeEvent;
+# endif
 typedef int InfStandaloneIoPollTimeout;
 typedef int InfStandaloneIoPollResult;
 static const InfStandaloneIoPollResult INF_STANDALONE_IO_POLL_TIMEOUT = 0;
 static const InfStandaloneIoPollTimeout INF_STANDALONE_IO_POLL_INFINITE = -1;
-#define inf_standalone_io_poll(events, num_events, timeout) \
-  (poll(events, (nfds_t)num_events, timeout))
 #endif
 
-struct _InfIoWatch {
-  /* TODO: Do we actually need this? We can access the event by
-   * priv->events[watchindex+1]. */
-  InfStandaloneIoNativeEvent* event;
+#ifdef INF_STANDALONE_IO_EPOLL
+/* Maximum number of events retrieved by a single epoll_wait() call */
+#define INF_STANDALONE_IO_MAX_EVENTS 64
+#endif
 
+struct _InfIoWatch {
   InfNativeSocket* socket;
   InfIoWatchFunc func;
   gpointer user_data;
   GDestroyNotify notify;
 
+#ifdef INF_STANDALONE_IO_EPOLL
+  /* The socket might already be closed and reset by the time the watch is
+   * removed, so remember the file descriptor it was registered with. */
+  int fd;
+  /* The events the watch is currently interested in */
+  InfIoEvent events;
+#else
+  /* Position of the watch's native event in priv->events. The watch itself
+   * is stored at index-1 in priv->watches. */
+  guint index;
+#endif
+
   /* Protection flags to avoid freeing the watch object when running
    * the callback */
   gboolean executing;
@@ -93,8 +121,11 @@ struct _InfIoWatch {
 };
 
 struct _InfIoTimeout {
-  GTimeVal begin;
-  guint msecs;
+  /* Monotonic time at which the timeout elapses, in microseconds */
+  gint64 expiration;
+  /* Position in the timeout heap */
+  guint index;
+
   InfIoTimeoutFunc func;
   gpointer user_data;
   GDestroyNotify notify;
@@ -108,16 +139,45 @@ struct _InfIoDispatch {
 
 typedef struct _InfStandaloneIoPrivate InfStandaloneIoPrivate;
 struct _InfStandaloneIoPrivate {
-  InfStandaloneIoNativeEvent* events;
   GMutex mutex;
 
+  /* InfNativeSocket* -> InfIoWatch* */
+  GHashTable* watch_table;
+  /* Set of InfIoWatch*, to check watches that are passed in by the user
+   * without dereferencing them, since they might have been freed. */
+  GHashTable* watch_set;
+
+#ifdef INF_STANDALONE_IO_EPOLL
+  int epoll_fd;
+
+  /* Events returned by the last epoll_wait() call. The ones from
+   * ready_index to ready_count have not yet been dispatched. */
+  InfStandaloneIoNativeEvent ready[INF_STANDALONE_IO_MAX_EVENTS];
+  guint ready_index;
+  guint ready_count;
+
+  /* Watches that have been removed while waiting in epoll_wait(). They are
+   * freed as soon as the wait returns. */
+  GSList* disposed_watches;
+#else
+  InfStandaloneIoNativeEvent* events;
+
   guint fd_size;
   guint fd_alloc;
 
   /* this array has fd_size-1 entries and fd_alloc-1 allocations: */
   InfIoWatch** watches;
+#endif
+
+  /* Binary min-heap of timeouts, ordered by expiration time */
+  InfIoTimeout** timeouts;
+  guint n_timeouts;
+  guint timeouts_alloc;
+  /* Set of the InfIoTimeout* in the heap, to check timeouts that are passed
+   * in by the user without dereferencing them, since they might have
+   * elapsed and been freed already. */
+  GHashTable* timeout_set;
 
-  GList* timeouts;
   GList* dispatchs;
 
 #ifndef G_OS_WIN32
@@ -155,172 +215,987 @@ G_DEFINE_TYPE_WITH_CODE(InfStandaloneIo, inf_standalone_io, G_TYPE_OBJECT,
   G_ADD_PRIVATE(InfStandaloneIo)
   G_IMPLEMENT_INTERFACE(INF_TYPE_IO, inf_standalone_io_io_iface_init))
 
-static guint
-inf_standalone_io_timeval_diff(GTimeVal* first,
-                               GTimeVal* second)
+static void
+inf_standalone_io_timeout_set(InfStandaloneIoPrivate* priv,
+                              guint index,
+                              InfIoTimeout* timeout)
+{
+  priv->timeouts[index] = timeout;
+  timeout->index = index;
+}
+
+/* Moves the timeout at index towards the root of the heap until its parent
+ * does not expire later. */
+static void
+inf_standalone_io_timeout_sift_up(InfStandaloneIoPrivate* priv,
+                                  guint index)
 {
-  g_assert(first->tv_sec > second->tv_sec ||
-           (first->tv_sec == second->tv_sec &&
-            first->tv_usec >= second->tv_usec));
+  InfIoTimeout* timeout;
+  guint parent;
+
+  timeout = priv->timeouts[index];
+  while(index > 0)
+  {
+    parent = (index - 1) / 2;
+    if(priv->timeouts[parent]->expiration <= timeout->expiration)
+      break;
 
-  /* Don't risk overflow, don't need to convert to signed int */
-  return (first->tv_sec - second->tv_sec) * 1000 +
-         (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
+    inf_standalone_io_timeout_set(priv, index, priv->timeouts[parent]);
+    index = parent;
+  }
+
+  inf_standalone_io_timeout_set(priv, index, timeout);
 }
 
-/* Run one iteration of the main loop. Call this only with the mutex locked
- * and a local reference added to io. */
+/* Moves the timeout at index towards the leaves of the heap until none of
+ * its children expires earlier. */
 static void
-inf_standalone_io_iteration_impl(InfStandaloneIo* io,
-                                 InfStandaloneIoPollTimeout timeout)
+inf_standalone_io_timeout_sift_down(InfStandaloneIoPrivate* priv,
+                                    guint index)
 {
-  InfStandaloneIoPrivate* priv;
-  InfIoEvent events;
-  InfStandaloneIoPollResult result;
-  guint i;
+  InfIoTimeout* timeout;
+  guint child;
 
-  GList* item;
-  GTimeVal current;
-  InfIoWatch* watch;
-  InfIoTimeout* cur_timeout;
-  InfIoDispatch* dispatch;
-  guint elapsed;
+  timeout = priv->timeouts[index];
+  for(;;)
+  {
+    child = 2 * index + 1;
+    if(child >= priv->n_timeouts)
+      break;
 
-#ifdef G_OS_WIN32
-  gchar* error_message;
-  WSANETWORKEVENTS wsa_events;
-  const InfStandaloneIoEventTableEntry* entry;
-#else
+    if(child + 1 < priv->n_timeouts &&
+       priv->timeouts[child + 1]->expiration <
+       priv->timeouts[child]->expiration)
+    {
+      ++child;
+    }
+
+    if(timeout->expiration <= priv->timeouts[child]->expiration)
+      break;
+
+    inf_standalone_io_timeout_set(priv, index, priv->timeouts[child]);
+    index = child;
+  }
+
+  inf_standalone_io_timeout_set(priv, index, timeout);
+}
+
+static void
+inf_standalone_io_timeout_insert(InfStandaloneIoPrivate* priv,
+                                 InfIoTimeout* timeout)
+{
+  if(priv->n_timeouts == priv->timeouts_alloc)
+  {
+    priv->timeouts_alloc *= 2;
+    priv->timeouts = g_realloc(
+      priv->timeouts,
+      priv->timeouts_alloc * sizeof(InfIoTimeout*)
+    );
+  }
+
+  priv->timeouts[priv->n_timeouts] = timeout;
+  inf_standalone_io_timeout_sift_up(priv, priv->n_timeouts++);
+  g_hash_table_add(priv->timeout_set, timeout);
+}
+
+static void
+inf_standalone_io_timeout_remove(InfStandaloneIoPrivate* priv,
+                                 InfIoTimeout* timeout)
+{
+  guint index;
+
+  g_hash_table_remove(priv->timeout_set, timeout);
+
+  index = timeout->index;
+  --priv->n_timeouts;
+
+  /* Fill the gap with the last timeout in the heap, and restore the heap
+   * property from there. */
+  if(index != priv->n_timeouts)
+  {
+    inf_standalone_io_timeout_set(
+      priv,
+      index,
+      priv->timeouts[priv->n_timeouts]
+    );
+
+    if(index > 0 &&
+       priv->timeouts[index]->expiration <
+       priv->timeouts[(index - 1) / 2]->expiration)
+    {
+      inf_standalone_io_timeout_sift_up(priv, index);
+    }
+    else
+    {
+      inf_standalone_io_timeout_sift_down(priv, index);
+    }
+  }
+}
+
+/*
+ * Event backends. Each backend implements the following functions, all of
+ * which are called with the mutex locked:
+ *
+ * inf_standalone_io_backend_init(): Sets up the backend, including the
+ * wakeup mechanism.
+ *
+ * inf_standalone_io_backend_finalize(): Releases all backend resources. All
+ * watches have been removed already.
+ *
+ * inf_standalone_io_backend_add_watch(): Starts watching the socket of a
+ * newly created watch. Returns FALSE if that is not possible.
+ *
+ * inf_standalone_io_backend_update_watch(): Changes the events a watch is
+ * interested in.
+ *
+ * inf_standalone_io_backend_remove_watch(): Stops watching the socket of a
+ * watch. The watch object itself is freed by the caller.
+ *
+ * inf_standalone_io_backend_wait(): Waits until an event occurs or the
+ * timeout elapses. The mutex is released while waiting. Returns FALSE if
+ * the wait failed or was interrupted.
+ *
+ * inf_standalone_io_backend_next_watch(): Called after a successful wait
+ * that did not time out. Returns the next watch which has events pending,
+ * or NULL if there is none.
+ */
+
+#ifndef G_OS_WIN32
+static void
+inf_standalone_io_read_wakeup(InfStandaloneIo* io,
+                              InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
   ssize_t ret;
   char buf[1];
-#endif
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
-  /* Find number of milliseconds to wait */
-  if(priv->dispatchs != NULL)
+  /* we were not polling for outgoing */
+  g_assert(~events & INF_IO_OUTGOING);
+  if(events & INF_IO_ERROR)
   {
-    /* TODO: Don't even poll */
-    timeout = 0;
+    /* TODO: Read error from FD? */
+    g_warning("Error condition on wakeup pipe");
+    /* TODO: Is there anything we could do here?
+     * Try to re-establish pipe? */
   }
   else
   {
-    g_get_current_time(&current);
-    for(item = priv->timeouts; item != NULL; item = g_list_next(item))
+    ret = read(priv->wakeup_pipe[0], &buf, 1);
+    if(ret == -1)
     {
-      cur_timeout = (InfIoTimeout*)item->data;
-      elapsed = inf_standalone_io_timeval_diff(&current, &cur_timeout->begin);
+      g_warning(
+        "read() on wakeup pipe failed: %s",
+        strerror(errno)
+      );
 
-      if(elapsed >= cur_timeout->msecs)
-      {
-        /* already elapsed */
-        /* TODO: Don't even poll */
-        timeout = 0;
-        /* no need to check other timeouts */
-        break;
-      }
-      else
-      {
-        if(timeout == INF_STANDALONE_IO_POLL_INFINITE ||
-           cur_timeout->msecs - elapsed < (guint)timeout)
-        {
-          timeout = cur_timeout->msecs - elapsed;
-        }
-      }
+      /* TODO: Is there anything we could do here?
+       * Try to re-establish pipe? */
+    }
+    else if(ret == 0)
+    {
+      g_warning("Wakeup pipe received EOF");
+      /* TODO: Is there anything we could do here?
+       * Try to re-establish pipe? */
+    }
+    else
+    {
+      /* this is what we send as wakeup call */
+      g_assert(buf[0] == 'c');
     }
   }
+}
+#endif
 
-  priv->polling = TRUE;
-  g_mutex_unlock(&priv->mutex);
+#if defined(G_OS_WIN32)
+static long
+inf_standalone_io_backend_native_events(InfIoEvent events)
+{
+  long pevents;
 
-  result = inf_standalone_io_poll(priv->events, priv->fd_size, timeout);
+  pevents = 0;
+  if(events & INF_IO_INCOMING)
+    pevents |= (FD_READ | FD_ACCEPT | FD_CLOSE);
+  if(events & INF_IO_OUTGOING)
+    pevents |= (FD_WRITE | FD_CONNECT);
 
-  g_mutex_lock(&priv->mutex);
-  priv->polling = FALSE;
+  return pevents;
+}
 
-#ifdef G_OS_WIN32
-  switch(result)
+static void
+inf_standalone_io_backend_init(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->fd_size = 0;
+  priv->fd_alloc = 4;
+
+  priv->events =
+    g_malloc(sizeof(InfStandaloneIoNativeEvent) * priv->fd_alloc);
+
+  priv->events[0] = WSACreateEvent();
+  if(priv->events[0] == WSA_INVALID_EVENT)
   {
-  case WSA_WAIT_FAILED:
     error_message = g_win32_error_message(WSAGetLastError());
-    g_warning("WSAWaitForMultipleEvents() failed: %s\n", error_message);
+    g_error("Failed to create wakeup event: %s", error_message);
+    g_free(error_message); /* will not be called since g_error abort()s */
+  }
+  else
+  {
+    ++priv->fd_size;
+  }
+
+  priv->watches = g_malloc(sizeof(InfIoWatch*) * (priv->fd_alloc - 1) );
+}
+
+static void
+inf_standalone_io_backend_finalize(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  guint i;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  for(i = 0; i < priv->fd_size; ++ i)
+  {
+    if(WSACloseEvent(priv->events[i]) == FALSE)
+    {
+      error_message = g_win32_error_message(WSAGetLastError());
+      g_warning("WSACloseEvent() failed: %s", error_message);
+      g_free(error_message);
+    }
+  }
+
+  g_free(priv->events);
+  g_free(priv->watches);
+}
+
+static gboolean
+inf_standalone_io_backend_add_watch(InfStandaloneIo* io,
+                                    InfIoWatch* watch,
+                                    InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  /* TODO: If we are currently polling we should not modify the fds array
+   * array but do this after wakeup directly after the poll call. */
+  if(priv->fd_size == priv->fd_alloc)
+  {
+    priv->fd_alloc *= 2;
+
+    priv->events = g_realloc(
+      priv->events,
+      priv->fd_alloc * sizeof(InfStandaloneIoNativeEvent)
+    );
+
+    priv->watches = g_realloc(
+      priv->watches,
+      (priv->fd_alloc - 1) * sizeof(InfIoWatch*)
+    );
+  }
+
+  priv->events[priv->fd_size] = WSACreateEvent();
+  if(priv->events[priv->fd_size] == WSA_INVALID_EVENT)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSACreateEvent() failed: %s", error_message);
     g_free(error_message);
-    return;
-  case WSA_WAIT_IO_COMPLETION:
-    return;
-  default:
-    break;
+    return FALSE;
+  }
+
+  if(WSAEventSelect(*watch->socket, priv->events[priv->fd_size],
+                    inf_standalone_io_backend_native_events(events)) ==
+     SOCKET_ERROR)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSAEventSelect() failed: %s", error_message);
+    g_free(error_message);
+
+    WSACloseEvent(priv->events[priv->fd_size]);
+    return FALSE;
+  }
+
+  watch->index = priv->fd_size;
+  priv->watches[priv->fd_size - 1] = watch;
+  ++priv->fd_size;
+  return TRUE;
+}
+
+static void
+inf_standalone_io_backend_update_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch,
+                                       InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  if(WSAEventSelect(*watch->socket, priv->events[watch->index],
+                    inf_standalone_io_backend_native_events(events)) ==
+     SOCKET_ERROR)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSAEventSelect() failed: %s", error_message);
+    g_free(error_message);
+  }
+}
+
+static void
+inf_standalone_io_backend_remove_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch)
+{
+  InfStandaloneIoPrivate* priv;
+  guint index;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+  index = watch->index;
+
+  if(WSAEventSelect(*watch->socket, priv->events[index], 0) == SOCKET_ERROR)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSAEventSelect() failed: %s", error_message);
+    g_free(error_message);
+  }
+
+  if(WSACloseEvent(priv->events[index]) == FALSE)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSACloseEvent() failed: %s", error_message);
+    g_free(error_message);
+  }
+
+  /* TODO: If we are currently polling we should not modify the fds array
+   * array but do this after wakeup directly after the poll call. */
+
+  /* Remove watch by replacing it by the last event/watch */
+  if(index != priv->fd_size - 1)
+  {
+    priv->events[index] = priv->events[priv->fd_size - 1];
+    priv->watches[index - 1] = priv->watches[priv->fd_size - 2];
+    priv->watches[index - 1]->index = index;
+  }
+
+  --priv->fd_size;
+}
+
+static gboolean
+inf_standalone_io_backend_wait(InfStandaloneIo* io,
+                               InfStandaloneIoPollTimeout timeout,
+                               InfStandaloneIoPollResult* result)
+{
+  InfStandaloneIoPrivate* priv;
+  gchar* error_message;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->polling = TRUE;
+  g_mutex_unlock(&priv->mutex);
+
+  *result = inf_standalone_io_poll(priv->events, priv->fd_size, timeout);
+
+  g_mutex_lock(&priv->mutex);
+  priv->polling = FALSE;
+
+  switch(*result)
+  {
+  case WSA_WAIT_FAILED:
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSAWaitForMultipleEvents() failed: %s\n", error_message);
+    g_free(error_message);
+    return FALSE;
+  case WSA_WAIT_IO_COMPLETION:
+    return FALSE;
+  default:
+    return TRUE;
+  }
+}
+
+static InfIoWatch*
+inf_standalone_io_backend_next_watch(InfStandaloneIo* io,
+                                     InfStandaloneIoPollResult result,
+                                     InfIoEvent* events)
+{
+  InfStandaloneIoPrivate* priv;
+  InfIoWatch* watch;
+  WSANETWORKEVENTS wsa_events;
+  const InfStandaloneIoEventTableEntry* entry;
+  gchar* error_message;
+  guint i;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  if(result < WSA_WAIT_EVENT_0 || result >= WSA_WAIT_EVENT_0 + priv->fd_size)
+    return NULL;
+
+  if(result == WSA_WAIT_EVENT_0)
+  {
+    /* wakeup call */
+    WSAResetEvent(priv->events[0]);
+    return NULL;
+  }
+
+  watch = priv->watches[result - WSA_WAIT_EVENT_0 - 1];
+
+  if(WSAEnumNetworkEvents(*watch->socket, priv->events[watch->index],
+                          &wsa_events) == SOCKET_ERROR)
+  {
+    error_message = g_win32_error_message(WSAGetLastError());
+    g_warning("WSAEnumNetworkEvents failed: %s\n", error_message);
+    g_free(error_message);
+
+    *events = INF_IO_ERROR;
+  }
+  else
+  {
+    *events = 0;
+    for(i = 0; i < G_N_ELEMENTS(inf_standalone_io_event_table); ++ i)
+    {
+      entry = &inf_standalone_io_event_table[i];
+      if(wsa_events.lNetworkEvents & entry->flag_val)
+      {
+        *events |= entry->io_val;
+        if(wsa_events.iErrorCode[entry->flag_bit])
+          *events |= INF_IO_ERROR;
+      }
+    }
+  }
+
+  return watch;
+}
+#elif defined(INF_STANDALONE_IO_EPOLL)
+static uint32_t
+inf_standalone_io_backend_native_events(InfIoEvent events)
+{
+  uint32_t pevents;
+
+  pevents = 0;
+  if(events & INF_IO_INCOMING)
+    pevents |= EPOLLIN;
+  if(events & INF_IO_OUTGOING)
+    pevents |= EPOLLOUT;
+  if(events & INF_IO_ERROR)
+    pevents |= (EPOLLERR | EPOLLHUP | EPOLLPRI);
+
+  return pevents;
+}
+
+static void
+inf_standalone_io_backend_init(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoNativeEvent event;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if(priv->epoll_fd == -1)
+    g_error("Failed to create epoll instance: %s", strerror(errno));
+
+  if(pipe(priv->wakeup_pipe) == -1)
+    g_error("Failed to create wakeup pipe: %s", strerror(errno));
+
+  /* The wakeup pipe is the only event source without a watch */
+  event.events = EPOLLIN | EPOLLERR;
+  event.data.ptr = NULL;
+  if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, priv->wakeup_pipe[0],
+               &event) == -1)
+  {
+    g_error("Failed to watch wakeup pipe: %s", strerror(errno));
+  }
+
+  priv->ready_index = 0;
+  priv->ready_count = 0;
+  priv->disposed_watches = NULL;
+}
+
+static void
+inf_standalone_io_backend_finalize(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  g_assert(priv->disposed_watches == NULL);
+
+  if(close(priv->epoll_fd) == -1)
+    g_warning("Failed to close epoll instance: %s", strerror(errno));
+}
+
+static gboolean
+inf_standalone_io_backend_add_watch(InfStandaloneIo* io,
+                                    InfIoWatch* watch,
+                                    InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoNativeEvent event;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  watch->fd = *watch->socket;
+  watch->events = events;
+
+  event.events = inf_standalone_io_backend_native_events(events);
+  event.data.ptr = watch;
+
+  if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_ADD, watch->fd, &event) == -1)
+  {
+    g_warning("epoll_ctl() failed: %s", strerror(errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+inf_standalone_io_backend_update_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch,
+                                       InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoNativeEvent event;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  /* Events which have already been reported but not yet dispatched are
+   * filtered with this in inf_standalone_io_backend_next_watch(). */
+  watch->events = events;
+
+  event.events = inf_standalone_io_backend_native_events(events);
+  event.data.ptr = watch;
+
+  if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_MOD, watch->fd, &event) == -1)
+  {
+    /* If the socket has been closed already then the kernel has dropped it
+     * from the epoll set. That's OK, the watch is going to be removed. */
+    if(errno != EBADF && errno != ENOENT)
+      g_warning("epoll_ctl() failed: %s", strerror(errno));
+  }
+}
+
+static void
+inf_standalone_io_backend_remove_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch)
+{
+  InfStandaloneIoPrivate* priv;
+  guint i;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  if(epoll_ctl(priv->epoll_fd, EPOLL_CTL_DEL, watch->fd, NULL) == -1)
+  {
+    /* See inf_standalone_io_backend_update_watch() */
+    if(errno != EBADF && errno != ENOENT)
+      g_warning("epoll_ctl() failed: %s", strerror(errno));
+  }
+
+  /* Drop events that have been reported for this watch but not dispatched
+   * yet. There are at most INF_STANDALONE_IO_MAX_EVENTS of them. */
+  for(i = priv->ready_index; i < priv->ready_count; ++i)
+    if(priv->ready[i].data.ptr == watch)
+      priv->ready[i].events = 0;
+}
+
+static gboolean
+inf_standalone_io_backend_wait(InfStandaloneIo* io,
+                               InfStandaloneIoPollTimeout timeout,
+                               InfStandaloneIoPollResult* result)
+{
+  InfStandaloneIoPrivate* priv;
+  InfIoWatch* watch;
+  int i;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  /* Dispatch what is left from the previous call first */
+  if(priv->ready_index < priv->ready_count)
+  {
+    *result = priv->ready_count - priv->ready_index;
+    return TRUE;
+  }
+
+  priv->polling = TRUE;
+  g_mutex_unlock(&priv->mutex);
+
+  *result = epoll_wait(
+    priv->epoll_fd,
+    priv->ready,
+    INF_STANDALONE_IO_MAX_EVENTS,
+    timeout
+  );
+
+  g_mutex_lock(&priv->mutex);
+  priv->polling = FALSE;
+
+  if(*result > 0)
+  {
+    /* Don't report events for watches removed while we were waiting */
+    if(priv->disposed_watches != NULL)
+    {
+      for(i = 0; i < *result; ++i)
+      {
+        watch = (InfIoWatch*)priv->ready[i].data.ptr;
+        if(watch != NULL && watch->disposed == TRUE)
+          priv->ready[i].events = 0;
+      }
+    }
+
+    priv->ready_index = 0;
+    priv->ready_count = *result;
+  }
+
+  while(priv->disposed_watches != NULL)
+  {
+    watch = (InfIoWatch*)priv->disposed_watches->data;
+    priv->disposed_watches = g_slist_delete_link(
+      priv->disposed_watches,
+      priv->disposed_watches
+    );
+
+    g_mutex_unlock(&priv->mutex);
+    if(watch->notify) watch->notify(watch->user_data);
+    g_slice_free(InfIoWatch, watch);
+    g_mutex_lock(&priv->mutex);
+  }
+
+  if(*result == -1)
+  {
+    if(errno != EINTR)
+      g_warning("epoll_wait() failed: %s\n", strerror(errno));
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static InfIoWatch*
+inf_standalone_io_backend_next_watch(InfStandaloneIo* io,
+                                     InfStandaloneIoPollResult result,
+                                     InfIoEvent* events)
+{
+  InfStandaloneIoPrivate* priv;
+  InfStandaloneIoNativeEvent* event;
+  InfIoWatch* watch;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  while(priv->ready_index < priv->ready_count)
+  {
+    event = &priv->ready[priv->ready_index++];
+
+    /* Watch has been removed since the event was reported */
+    if(event->events == 0)
+      continue;
+
+    *events = 0;
+    if(event->events & EPOLLIN)
+      *events |= INF_IO_INCOMING;
+    if(event->events & EPOLLOUT)
+      *events |= INF_IO_OUTGOING;
+    /* We treat EPOLLPRI as error because it should not occur in
+     * infinote. */
+    if(event->events & (EPOLLERR | EPOLLPRI | EPOLLHUP))
+      *events |= INF_IO_ERROR;
+
+    watch = (InfIoWatch*)event->data.ptr;
+    if(watch == NULL)
+    {
+      /* wakeup call */
+      inf_standalone_io_read_wakeup(io, *events);
+    }
+    else
+    {
+      /* The watch might have been updated since the event was reported */
+      *events &= watch->events | INF_IO_ERROR;
+      if(*events != 0)
+        return watch;
+    }
+  }
+
+  return NULL;
+}
+#else
+static short
+inf_standalone_io_backend_native_events(InfIoEvent events)
+{
+  short pevents;
+
+  pevents = 0;
+  if(events & INF_IO_INCOMING)
+    pevents |= POLLIN;
+  if(events & INF_IO_OUTGOING)
+    pevents |= POLLOUT;
+  if(events & INF_IO_ERROR)
+    pevents |= (POLLERR | POLLHUP | POLLNVAL | POLLPRI);
+
+  return pevents;
+}
+
+static void
+inf_standalone_io_backend_init(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->fd_size = 0;
+  priv->fd_alloc = 4;
+
+  priv->events =
+    g_malloc(sizeof(InfStandaloneIoNativeEvent) * priv->fd_alloc);
+
+  if(pipe(priv->wakeup_pipe) == -1)
+  {
+    g_error("Failed to create wakeup pipe: %s", strerror(errno));
+  }
+  else
+  {
+    priv->events[0].fd = priv->wakeup_pipe[0];
+    priv->events[0].events = POLLIN | POLLERR;
+    priv->events[0].revents = 0;
+    ++priv->fd_size;
+  }
+
+  priv->watches = g_malloc(sizeof(InfIoWatch*) * (priv->fd_alloc - 1) );
+}
+
+static void
+inf_standalone_io_backend_finalize(InfStandaloneIo* io)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  g_free(priv->events);
+  g_free(priv->watches);
+}
+
+static gboolean
+inf_standalone_io_backend_add_watch(InfStandaloneIo* io,
+                                    InfIoWatch* watch,
+                                    InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  /* TODO: If we are currently polling we should not modify the fds array
+   * array but do this after wakeup directly after the poll call. */
+  if(priv->fd_size == priv->fd_alloc)
+  {
+    priv->fd_alloc *= 2;
+
+    priv->events = g_realloc(
+      priv->events,
+      priv->fd_alloc * sizeof(InfStandaloneIoNativeEvent)
+    );
+
+    priv->watches = g_realloc(
+      priv->watches,
+      (priv->fd_alloc - 1) * sizeof(InfIoWatch*)
+    );
+  }
+
+  priv->events[priv->fd_size].fd = *watch->socket;
+  priv->events[priv->fd_size].events =
+    inf_standalone_io_backend_native_events(events);
+  priv->events[priv->fd_size].revents = 0;
+
+  watch->index = priv->fd_size;
+  priv->watches[priv->fd_size - 1] = watch;
+  ++priv->fd_size;
+  return TRUE;
+}
+
+static void
+inf_standalone_io_backend_update_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch,
+                                       InfIoEvent events)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->events[watch->index].events =
+    inf_standalone_io_backend_native_events(events);
+}
+
+static void
+inf_standalone_io_backend_remove_watch(InfStandaloneIo* io,
+                                       InfIoWatch* watch)
+{
+  InfStandaloneIoPrivate* priv;
+  guint index;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+  index = watch->index;
+
+  /* TODO: If we are currently polling we should not modify the fds array
+   * array but do this after wakeup directly after the poll call. */
+
+  /* Remove watch by replacing it by the last pollfd/watch */
+  if(index != priv->fd_size - 1)
+  {
+    priv->events[index] = priv->events[priv->fd_size - 1];
+    priv->watches[index - 1] = priv->watches[priv->fd_size - 2];
+    priv->watches[index - 1]->index = index;
+  }
+
+  --priv->fd_size;
+}
+
+static gboolean
+inf_standalone_io_backend_wait(InfStandaloneIo* io,
+                               InfStandaloneIoPollTimeout timeout,
+                               InfStandaloneIoPollResult* result)
+{
+  InfStandaloneIoPrivate* priv;
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  priv->polling = TRUE;
+  g_mutex_unlock(&priv->mutex);
+
+  *result = poll(priv->events, (nfds_t)priv->fd_size, timeout);
+
+  g_mutex_lock(&priv->mutex);
+  priv->polling = FALSE;
+
+  if(*result == -1)
+  {
+    if(errno != EINTR)
+      g_warning("poll() failed: %s\n", strerror(errno));
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static InfIoWatch*
+inf_standalone_io_backend_next_watch(InfStandaloneIo* io,
+                                     InfStandaloneIoPollResult result,
+                                     InfIoEvent* events)
+{
+  InfStandaloneIoPrivate* priv;
+  guint i;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  for(i = 0; i < priv->fd_size; ++ i)
+  {
+    if(priv->events[i].revents != 0)
+    {
+      *events = 0;
+      if(priv->events[i].revents & POLLIN)
+        *events |= INF_IO_INCOMING;
+      if(priv->events[i].revents & POLLOUT)
+        *events |= INF_IO_OUTGOING;
+      /* We treat POLLPRI as error because it should not occur in
+       * infinote. */
+      if(priv->events[i].revents & (POLLERR | POLLPRI | POLLHUP | POLLNVAL))
+        *events |= INF_IO_ERROR;
+
+      priv->events[i].revents = 0;
+
+      if(i == 0)
+      {
+        /* wakeup call */
+        inf_standalone_io_read_wakeup(io, *events);
+      }
+      else
+      {
+        return priv->watches[i-1];
+      }
+    }
+  }
+
+  return NULL;
+}
+#endif
+
+/* Run one iteration of the main loop. Call this only with the mutex locked
+ * and a local reference added to io. */
+static void
+inf_standalone_io_iteration_impl(InfStandaloneIo* io,
+                                 InfStandaloneIoPollTimeout timeout)
+{
+  InfStandaloneIoPrivate* priv;
+  InfIoEvent events;
+  InfStandaloneIoPollResult result;
+
+  gint64 current;
+  gint64 remaining;
+  InfIoWatch* watch;
+  InfIoTimeout* cur_timeout;
+  InfIoDispatch* dispatch;
+
+  priv = INF_STANDALONE_IO_PRIVATE(io);
+
+  /* Find number of milliseconds to wait */
+  if(priv->dispatchs != NULL)
+  {
+    /* TODO: Don't even poll */
+    timeout = 0;
   }
-#else
-  if(result == -1)
+  else if(priv->n_timeouts > 0)
   {
-    if(errno != EINTR)
-      g_warning("poll() failed: %s\n", strerror(errno));
+    /* The first timeout in the heap is the next one to elapse */
+    current = g_get_monotonic_time();
+    cur_timeout = priv->timeouts[0];
 
-    return;
+    if(cur_timeout->expiration <= current)
+    {
+      /* already elapsed */
+      /* TODO: Don't even poll */
+      timeout = 0;
+    }
+    else
+    {
+      /* Round up, so that we don't wake up before the timeout elapsed */
+      remaining = (cur_timeout->expiration - current + 999) / 1000;
+      if(remaining > G_MAXINT)
+        remaining = G_MAXINT;
+
+      if(timeout == INF_STANDALONE_IO_POLL_INFINITE ||
+         (guint)remaining < (guint)timeout)
+      {
+        timeout = (InfStandaloneIoPollTimeout)remaining;
+      }
+    }
   }
-#endif
+
+  if(!inf_standalone_io_backend_wait(io, timeout, &result))
+    return;
 
   if(result == INF_STANDALONE_IO_POLL_TIMEOUT)
   {
     /* No file descriptor is active, so check whether a timeout elapsed */
-    g_get_current_time(&current);
-    for(item = priv->timeouts; item != NULL; item = g_list_next(item))
+    if(priv->n_timeouts > 0 &&
+       priv->timeouts[0]->expiration <= g_get_monotonic_time())
     {
-      cur_timeout = (InfIoTimeout*)item->data;
-      elapsed = inf_standalone_io_timeval_diff(&current, &cur_timeout->begin);
-      if(elapsed >= cur_timeout->msecs)
-      {
-        priv->timeouts = g_list_delete_link(priv->timeouts, item);
-        g_mutex_unlock(&priv->mutex);
+      cur_timeout = priv->timeouts[0];
+      inf_standalone_io_timeout_remove(priv, cur_timeout);
+      g_mutex_unlock(&priv->mutex);
 
-        cur_timeout->func(cur_timeout->user_data);
-        if(cur_timeout->notify)
-          cur_timeout->notify(cur_timeout->user_data);
-        g_slice_free(InfIoTimeout, cur_timeout);
+      cur_timeout->func(cur_timeout->user_data);
+      if(cur_timeout->notify)
+        cur_timeout->notify(cur_timeout->user_data);
+      g_slice_free(InfIoTimeout, cur_timeout);
 
-        g_mutex_lock(&priv->mutex);
-        return;
-      }
+      g_mutex_lock(&priv->mutex);
+      return;
     }
   }
-#ifdef G_OS_WIN32
-  else if(result >= WSA_WAIT_EVENT_0 &&
-          result < WSA_WAIT_EVENT_0 + priv->fd_size)
+  else
   {
-    if(result == WSA_WAIT_EVENT_0)
-    {
-      /* wakeup call */
-      WSAResetEvent(priv->events[0]);
-    }
-    else
+    watch = inf_standalone_io_backend_next_watch(io, result, &events);
+    if(watch != NULL)
     {
-      watch = priv->watches[result - WSA_WAIT_EVENT_0 - 1];
-
-      if(WSAEnumNetworkEvents(*watch->socket, *watch->event, &wsa_events) ==
-         SOCKET_ERROR)
-      {
-        error_message = g_win32_error_message(WSAGetLastError());
-        g_warning("WSAEnumNetworkEvents failed: %s\n", error_message);
-        g_free(error_message);
-
-        events = INF_IO_ERROR;
-      }
-      else
-      {
-        events = 0;
-        for(i = 0; i < G_N_ELEMENTS(inf_standalone_io_event_table); ++ i)
-        {
-          entry = &inf_standalone_io_event_table[i];
-          if(wsa_events.lNetworkEvents & entry->flag_val)
-          {
-            events |= entry->io_val;
-            if(wsa_events.iErrorCode[entry->flag_bit])
-              events |= INF_IO_ERROR;
-          }
-        }
-      }
-
       /* protect from removing the watch object via
        * inf_io_remove_watch() when running the callback. */
       watch->executing = TRUE;
@@ -341,94 +1216,6 @@ inf_standalone_io_iteration_impl(InfStandaloneIo* io,
       return;
     }
   }
-#else
-  else if(result > 0)
-  {
-    while(result--)
-    {
-      for(i = 0; i < priv->fd_size; ++ i)
-      {
-        if(priv->events[i].revents != 0)
-        {
-          events = 0;
-          if(priv->events[i].revents & POLLIN)
-            events |= INF_IO_INCOMING;
-          if(priv->events[i].revents & POLLOUT)
-            events |= INF_IO_OUTGOING;
-          /* We treat POLLPRI as error because it should not occur in
-           * infinote. */
-          if(priv->events[i].revents & (POLLERR | POLLPRI | POLLHUP | POLLNVAL))
-            events |= INF_IO_ERROR;
-
-          priv->events[i].revents = 0;
-
-          if(i == 0)
-          {
-            /* wakeup call */
-
-            /* we were not polling for outgoing */
-            g_assert(~events & INF_IO_OUTGOING);
-            if(events & INF_IO_ERROR)
-            {
-              /* TODO: Read error from FD? */
-              g_warning("Error condition on wakeup pipe");
-              /* TODO: Is there anything we could do here?
-               * Try to re-establish pipe? */
-            }
-            else
-            {
-              ret = read(priv->events[0].fd, &buf, 1);
-              if(ret == -1)
-              {
-                g_warning(
-                  "read() on wakeup pipe failed: %s",
-                  strerror(errno)
-                );
-
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else if(ret == 0)
-              {
-                g_warning("Wakeup pipe received EOF");
-                /* TODO: Is there anything we could do here?
-                 * Try to re-establish pipe? */
-              }
-              else
-              {
-                /* this is what we send as wakeup call */
-                g_assert(buf[0] == 'c');
-              }
-            }
-          }
-          else
-          {
-            watch = priv->watches[i-1];
-
-            /* protect from removing the watch object via
-             * inf_io_remove_watch() when running the callback. */
-            watch->executing = TRUE;
-            g_mutex_unlock(&priv->mutex);
-
-            watch->func(watch->socket, events, watch->user_data);
-
-            g_mutex_lock(&priv->mutex);
-            watch->executing = FALSE;
-            if(watch->disposed == TRUE)
-            {
-              g_mutex_unlock(&priv->mutex);
-              if(watch->notify) watch->notify(watch->user_data);
-              g_slice_free(InfIoWatch, watch);
-              g_mutex_lock(&priv->mutex);
-            }
-
-            return;
-          }
-        }
-      }
-    }
-  }
-#endif
 
   /* neither timeout nor IO fired, so try a dispatched message */
   if(priv->dispatchs != NULL)
@@ -450,49 +1237,19 @@ static void
 inf_standalone_io_init(InfStandaloneIo* io)
 {
   InfStandaloneIoPrivate* priv;
-
-#ifdef G_OS_WIN32
-  gchar* error_message;
-#endif
-
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_init(&priv->mutex);
 
-  priv->fd_size = 0;
-  priv->fd_alloc = 4;
-
-  priv->events =
-    g_malloc(sizeof(InfStandaloneIoNativeEvent) * priv->fd_alloc);
+  priv->watch_table = g_hash_table_new(NULL, NULL);
+  priv->watch_set = g_hash_table_new(NULL, NULL);
+  inf_standalone_io_backend_init(io);
 
-#ifdef G_OS_WIN32
-  priv->events[0] = WSACreateEvent();
-  if(priv->events[0] == WSA_INVALID_EVENT)
-  {
-    error_message = g_win32_error_message(WSAGetLastError());
-    g_error("Failed to create wakeup event: %s", error_message);
-    g_free(error_message); /* will not be called since g_error abort()s */
-  }
-  else
-  {
-    ++priv->fd_size;
-  }
-#else
-  if(pipe(priv->wakeup_pipe) == -1)
-  {
-    g_error("Failed to create wakeup pipe: %s", strerror(errno));
-  }
-  else
-  {
-    priv->events[0].fd = priv->wakeup_pipe[0];
-    priv->events[0].events = POLLIN | POLLERR;
-    priv->events[0].revents = 0;
-    ++priv->fd_size;
-  }
-#endif
+  priv->n_timeouts = 0;
+  priv->timeouts_alloc = 4;
+  priv->timeouts = g_malloc(sizeof(InfIoTimeout*) * priv->timeouts_alloc);
+  priv->timeout_set = g_hash_table_new(NULL, NULL);
 
-  priv->watches = g_malloc(sizeof(InfIoWatch*) * (priv->fd_alloc - 1) );
-  priv->timeouts = NULL;
   priv->dispatchs = NULL;
 
   priv->polling = FALSE;
@@ -504,46 +1261,38 @@ inf_standalone_io_finalize(GObject* object)
 {
   InfStandaloneIo* io;
   InfStandaloneIoPrivate* priv;
+  GHashTableIter iter;
+  gpointer value;
   guint i;
   GList* item;
   InfIoWatch* watch;
   InfIoTimeout* timeout;
   InfIoDispatch* dispatch;
-#ifdef G_OS_WIN32
-  gchar* error_message;
-#endif
 
   io = INF_STANDALONE_IO(object);
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex);
 
-  for(i = 1; i < priv->fd_size; ++i)
+  g_hash_table_iter_init(&iter, priv->watch_table);
+  while(g_hash_table_iter_next(&iter, NULL, &value))
   {
-    watch = priv->watches[i - 1];
+    watch = (InfIoWatch*)value;
 
     /* cannot dispose the IO while running a callback since the IO is
      * reffed on the stack. */
     g_assert(watch->executing == FALSE);
 
-#ifdef G_OS_WIN32
-    if(WSAEventSelect(*watch->socket, *watch->event, 0) ==
-       SOCKET_ERROR)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-      g_warning("WSAEventSelect() failed: %s", error_message);
-      g_free(error_message);
-    }
-#endif
+    inf_standalone_io_backend_remove_watch(io, watch);
 
     if(watch->notify)
       watch->notify(watch->user_data);
     g_slice_free(InfIoWatch, watch);
   }
 
-  for(item = priv->timeouts; item != NULL; item = g_list_next(item))
+  for(i = 0; i < priv->n_timeouts; ++i)
   {
-    timeout = (InfIoTimeout*)item->data;
+    timeout = priv->timeouts[i];
     if(timeout->notify)
       timeout->notify(timeout->user_data);
     g_slice_free(InfIoTimeout, timeout);
@@ -557,21 +1306,12 @@ inf_standalone_io_finalize(GObject* object)
     g_slice_free(InfIoDispatch, dispatch);
   }
 
-#ifdef G_OS_WIN32
-  for(i = 0; i < priv->fd_size; ++ i)
-  {
-    if(WSACloseEvent(priv->events[i]) == FALSE)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-      g_warning("WSACloseEvent() failed: %s", error_message);
-      g_free(error_message);
-    }
-  }
-#endif
+  inf_standalone_io_backend_finalize(io);
 
-  g_free(priv->events);
-  g_free(priv->watches);
-  g_list_free(priv->timeouts);
+  g_hash_table_destroy(priv->watch_table);
+  g_hash_table_destroy(priv->watch_set);
+  g_hash_table_destroy(priv->timeout_set);
+  g_free(priv->timeouts);
   g_list_free(priv->dispatchs);
 
 #ifndef G_OS_WIN32
@@ -598,35 +1338,17 @@ inf_standalone_io_finalize(GObject* object)
   G_OBJECT_CLASS(inf_standalone_io_parent_class)->finalize(object);
 }
 
-static InfIoWatch**
-inf_standalone_io_find_watch(InfStandaloneIo* io,
-                             InfIoWatch* watch)
-{
-  InfStandaloneIoPrivate* priv;
-  guint i;
-
-  priv = INF_STANDALONE_IO_PRIVATE(io);
-  for(i = 1; i < priv->fd_size; ++i)
-    if(priv->watches[i-1] == watch)
-      return &priv->watches[i-1];
-
-  return NULL;
-
-}
-
-static InfIoWatch**
-inf_standalone_io_find_watch_by_socket(InfStandaloneIo* io,
-                                       InfNativeSocket* socket)
+static gboolean
+inf_standalone_io_has_watch(InfStandaloneIo* io,
+                            InfIoWatch* watch)
 {
   InfStandaloneIoPrivate* priv;
-  guint i;
-
   priv = INF_STANDALONE_IO_PRIVATE(io);
-  for(i = 1; i < priv->fd_size; ++i)
-    if(priv->watches[i-1]->socket == socket)
-      return &priv->watches[i-1];
 
-  return NULL;
+  /* The watch might have been removed and freed already, or it might have
+   * been disposed while its callback is still running. In both cases it is
+   * no longer in the set. */
+  return g_hash_table_contains(priv->watch_set, watch);
 }
 
 static void
@@ -699,97 +1421,22 @@ inf_standalone_io_io_add_watch(InfIo* io,
 {
   InfStandaloneIoPrivate* priv;
   InfIoWatch* watch;
-  long pevents;
-  guint i;
-
-#ifdef G_OS_WIN32
-  gchar* error_message;
-#endif
 
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
-#ifdef G_OS_WIN32
-  pevents = 0;
-  if(events & INF_IO_INCOMING)
-    pevents |= (FD_READ | FD_ACCEPT | FD_CLOSE);
-  if(events & INF_IO_OUTGOING)
-    pevents |= (FD_WRITE | FD_CONNECT);
-#else
-  pevents = 0;
-  if(events & INF_IO_INCOMING)
-    pevents |= POLLIN;
-  if(events & INF_IO_OUTGOING)
-    pevents |= POLLOUT;
-  if(events & INF_IO_ERROR)
-    pevents |= (POLLERR | POLLHUP | POLLNVAL | POLLPRI);
-#endif
-
   g_mutex_lock(&priv->mutex);
 
   /* Watching the same socket for different events at least won't work on
    * Windows since WSAEventSelect cancels the effect of previous
    * WSAEventSelect calls for the same socket. */
-  if(inf_standalone_io_find_watch_by_socket(INF_STANDALONE_IO(io), socket))
+  if(g_hash_table_lookup(priv->watch_table, socket) != NULL)
   {
     g_mutex_unlock(&priv->mutex);
     return NULL;
   }
 
-  /* TODO: If we are currently polling we should not modify the fds array
-   * array but do this after wakeup directly after the poll call. */
-
   /* Socket is not already present, so create new watch */
-  if(priv->fd_size == priv->fd_alloc)
-  {
-    priv->fd_alloc += 4;
-
-    priv->events = g_realloc(
-      priv->events,
-      priv->fd_alloc * sizeof(InfStandaloneIoNativeEvent)
-    );
-
-    priv->watches = g_realloc(
-      priv->watches,
-      (priv->fd_alloc - 1) * sizeof(InfIoWatch*)
-    );
-
-    /* Update event pointers, the location of the events in memory might have
-     * changed after realloc. */
-    for(i = 1; i < priv->fd_size; ++i)
-      priv->watches[i-1]->event = &priv->events[i];
-  }
-
-#ifdef G_OS_WIN32
-  priv->events[priv->fd_size] = WSACreateEvent();
-  if(priv->events[priv->fd_size] == WSA_INVALID_EVENT)
-  {
-    error_message = g_win32_error_message(WSAGetLastError());
-    g_warning("WSACreateEvent() failed: %s", error_message);
-    g_free(error_message);
-
-    g_mutex_unlock(&priv->mutex);
-    return NULL;
-  }
-
-  if(WSAEventSelect(*socket, priv->events[priv->fd_size], pevents) ==
-     SOCKET_ERROR)
-  {
-    error_message = g_win32_error_message(WSAGetLastError());
-    g_warning("WSAEventSelect() failed: %s", error_message);
-    g_free(error_message);
-
-    WSACloseEvent(priv->events[priv->fd_size]);
-    g_mutex_unlock(&priv->mutex);
-    return NULL;
-  }
-#else
-  priv->events[priv->fd_size].fd = *socket;
-  priv->events[priv->fd_size].events = pevents;
-  priv->events[priv->fd_size].revents = 0;
-#endif
-
   watch = g_slice_new(InfIoWatch);
-  watch->event = &priv->events[priv->fd_size];
   watch->socket = socket;
   watch->func = func;
   watch->user_data = user_data;
@@ -797,8 +1444,16 @@ inf_standalone_io_io_add_watch(InfIo* io,
   watch->executing = FALSE;
   watch->disposed = FALSE;
 
-  priv->watches[priv->fd_size-1] = watch;
-  ++priv->fd_size;
+  if(!inf_standalone_io_backend_add_watch(INF_STANDALONE_IO(io), watch,
+                                          events))
+  {
+    g_slice_free(InfIoWatch, watch);
+    g_mutex_unlock(&priv->mutex);
+    return NULL;
+  }
+
+  g_hash_table_insert(priv->watch_table, socket, watch);
+  g_hash_table_add(priv->watch_set, watch);
 
   inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   g_mutex_unlock(&priv->mutex);
@@ -812,50 +1467,17 @@ inf_standalone_io_io_update_watch(InfIo* io,
                                   InfIoEvent events)
 {
   InfStandaloneIoPrivate* priv;
-  InfIoWatch** watch_iter;
-  long pevents;
-
-#ifdef G_OS_WIN32
-  gchar* error_message;
-#endif
-
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
-#ifdef G_OS_WIN32
-  pevents = 0;
-  if(events & INF_IO_INCOMING)
-    pevents |= (FD_READ | FD_ACCEPT | FD_CLOSE);
-  if(events & INF_IO_OUTGOING)
-    pevents |= (FD_WRITE | FD_CONNECT);
-#else
-  pevents = 0;
-  if(events & INF_IO_INCOMING)
-    pevents |= POLLIN;
-  if(events & INF_IO_OUTGOING)
-    pevents |= POLLOUT;
-  if(events & INF_IO_ERROR)
-    pevents |= (POLLERR | POLLHUP | POLLNVAL | POLLPRI);
-#endif
-
   g_mutex_lock(&priv->mutex);
 
-  watch_iter = inf_standalone_io_find_watch(INF_STANDALONE_IO(io), watch);
-  if(watch_iter != NULL)
+  if(inf_standalone_io_has_watch(INF_STANDALONE_IO(io), watch))
   {
-    /* TODO: If we are currently polling we should not modify the fds array
-     * array but do this after wakeup directly after the poll call. */
-
-    /* Update */
-#ifdef G_OS_WIN32
-    if(WSAEventSelect(*watch->socket, *watch->event, pevents) == SOCKET_ERROR)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-      g_warning("WSAEventSelect() failed: %s", error_message);
-      g_free(error_message);
-    }
-#else
-    watch->event->events = pevents;
-#endif
+    inf_standalone_io_backend_update_watch(
+      INF_STANDALONE_IO(io),
+      watch,
+      events
+    );
 
     inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   }
@@ -868,38 +1490,16 @@ inf_standalone_io_io_remove_watch(InfIo* io,
                                   InfIoWatch* watch)
 {
   InfStandaloneIoPrivate* priv;
-  InfIoWatch** watch_iter;
-  guint index;
-
-#ifdef G_OS_WIN32
-  gchar* error_message;
-#endif
-
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex);
 
-  watch_iter = inf_standalone_io_find_watch(INF_STANDALONE_IO(io), watch);
-  if(watch_iter != NULL)
+  if(inf_standalone_io_has_watch(INF_STANDALONE_IO(io), watch))
   {
-#ifdef G_OS_WIN32
-    if(WSAEventSelect(*watch->socket, *watch->event, 0) == SOCKET_ERROR)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-      g_warning("WSAEventSelect() failed: %s", error_message);
-      g_free(error_message);
-    }
-
-    if(WSACloseEvent(*watch->event) == FALSE)
-    {
-      error_message = g_win32_error_message(WSAGetLastError());
-      g_warning("WSACloseEvent() failed: %s", error_message);
-      g_free(error_message);
-    }
-#endif
+    g_hash_table_remove(priv->watch_table, watch->socket);
+    g_hash_table_remove(priv->watch_set, watch);
+    inf_standalone_io_backend_remove_watch(INF_STANDALONE_IO(io), watch);
 
-    /* TODO: If we are currently polling we should not modify the fds array
-     * array but do this after wakeup directly after the poll call. */
     if(watch->executing)
     {
       /* The callback of the watch is currently running. We don't want to
@@ -908,6 +1508,16 @@ inf_standalone_io_io_remove_watch(InfIo* io,
        * user_data and the InfIoWatch struct. */
       watch->disposed = TRUE;
     }
+#ifdef INF_STANDALONE_IO_EPOLL
+    else if(priv->polling)
+    {
+      /* epoll_wait() might be about to return an event for this watch in
+       * another thread, so keep the watch alive until it has returned. */
+      watch->disposed = TRUE;
+      priv->disposed_watches =
+        g_slist_prepend(priv->disposed_watches, watch);
+    }
+#endif
     else
     {
       /* Free user_data */
@@ -916,27 +1526,6 @@ inf_standalone_io_io_remove_watch(InfIo* io,
       g_slice_free(InfIoWatch, watch);
     }
 
-    /* Remove watch by replacing it by the last pollfd/watch */
-    index = 1 + (watch_iter - priv->watches);
-    if(index != priv->fd_size - 1)
-    {
-      memcpy(
-        &priv->events[index],
-        &priv->events[priv->fd_size - 1],
-        sizeof(InfStandaloneIoNativeEvent)
-      );
-
-      memcpy(
-        &priv->watches[index - 1],
-        &priv->watches[priv->fd_size - 2],
-        sizeof(InfIoWatch*)
-      );
-
-      priv->watches[index - 1]->event = &priv->events[index];
-    }
-
-    --priv->fd_size;
-
     inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   }
 
@@ -956,15 +1545,18 @@ inf_standalone_io_io_add_timeout(InfIo* io,
   priv = INF_STANDALONE_IO_PRIVATE(io);
   timeout = g_slice_new(InfIoTimeout);
 
-  g_get_current_time(&timeout->begin);
-  timeout->msecs = msecs;
+  timeout->expiration = g_get_monotonic_time() + (gint64)msecs * 1000;
   timeout->func = func;
   timeout->user_data = user_data;
   timeout->notify = notify;
 
   g_mutex_lock(&priv->mutex);
-  priv->timeouts = g_list_prepend(priv->timeouts, timeout);
-  inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
+  inf_standalone_io_timeout_insert(priv, timeout);
+
+  /* The main loop only needs to recompute its poll timeout if this is the
+   * timeout to elapse next. */
+  if(timeout->index == 0)
+    inf_standalone_io_wakeup(INF_STANDALONE_IO(io));
   g_mutex_unlock(&priv->mutex);
 
   return timeout;
@@ -975,16 +1567,13 @@ inf_standalone_io_io_remove_timeout(InfIo* io,
                                     InfIoTimeout* timeout)
 {
   InfStandaloneIoPrivate* priv;
-  GList* item;
-
   priv = INF_STANDALONE_IO_PRIVATE(io);
 
   g_mutex_lock(&priv->mutex);
 
-  item = g_list_find(priv->timeouts, timeout);
-  if(item != NULL)
+  if(g_hash_table_contains(priv->timeout_set, timeout))
   {
-    priv->timeouts = g_list_delete_link(priv->timeouts, item);
+    inf_standalone_io_timeout_remove(priv, timeout);
     g_mutex_unlock(&priv->mutex);
 
     if(timeout->notify)
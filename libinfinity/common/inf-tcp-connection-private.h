@@ -27,6 +27,11 @@
 
 G_BEGIN_DECLS
 
+typedef void(*InfTcpConnectionReceivedFunc)(InfTcpConnection* connection,
+                                            gconstpointer data,
+                                            guint len,
+                                            gpointer user_data);
+
 InfTcpConnection*
 _inf_tcp_connection_accepted(InfIo* io,
                              InfNativeSocket socket,
@@ -35,6 +40,11 @@ _inf_tcp_connection_accepted(InfIo* io,
                              const InfKeepalive* keepalive,
                              GError** error);
 
+void
+_inf_tcp_connection_set_received_func(InfTcpConnection* connection,
+                                      InfTcpConnectionReceivedFunc func,
+                                      gpointer user_data);
+
 G_END_DECLS
 
 #endif /* __INF_TCP_CONNECTION_PRIVATE_H__ */
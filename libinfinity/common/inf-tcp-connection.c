@@ -57,6 +57,7 @@
 #ifndef G_OS_WIN32
 # include <sys/types.h>
 # include <sys/socket.h>
+# include <sys/uio.h>
 # include <netinet/in.h>
 # include <net/if.h>
 # include <arpa/inet.h>
@@ -89,6 +90,26 @@ static const GEnumValue inf_tcp_connection_status_values[] = {
   }
 };
 
+/* Data of up to this size is appended to the previous chunk of the send
+ * queue if possible, instead of getting a chunk of its own. */
+#define INF_TCP_CONNECTION_CHUNK_SIZE 16384
+
+/* Maximum number of chunks to send with a single system call */
+#define INF_TCP_CONNECTION_MAX_IOV 64
+
+/* Initial size of the receive buffer. It grows up to the
+ * receive-buffer-size property while recv() keeps filling it completely,
+ * and shrinks back when it is mostly unused. */
+#define INF_TCP_CONNECTION_RECEIVE_BUFFER_MIN 2048
+
+typedef struct _InfTcpConnectionChunk InfTcpConnectionChunk;
+struct _InfTcpConnectionChunk {
+  /* Either a buffer passed to inf_tcp_connection_send_bytes(), or NULL if
+   * the data of the chunk has been copied into copy. */
+  GBytes* bytes;
+  GByteArray* copy;
+};
+
 typedef struct _InfTcpConnectionPrivate InfTcpConnectionPrivate;
 struct _InfTcpConnectionPrivate {
   InfIo* io;
@@ -106,10 +127,17 @@ struct _InfTcpConnectionPrivate {
   guint remote_port;
   unsigned int device_index;
 
-  guint8* queue;
-  gsize front_pos;
-  gsize back_pos;
-  gsize alloc;
+  /* Chunks of data that could not be sent yet. The first queue_offset
+   * bytes of the first chunk have already been sent. */
+  GQueue queue;
+  gsize queue_offset;
+
+  guint8* receive_buffer;
+  gsize receive_alloc;
+  guint max_receive_alloc;
+
+  InfTcpConnectionReceivedFunc received_func;
+  gpointer received_user_data;
 };
 
 enum {
@@ -127,7 +155,9 @@ enum {
   PROP_LOCAL_PORT,
 
   PROP_DEVICE_INDEX,
-  PROP_DEVICE_NAME
+  PROP_DEVICE_NAME,
+
+  PROP_RECEIVE_BUFFER_SIZE
 };
 
 enum {
@@ -274,6 +304,104 @@ inf_tcp_connection_io(InfNativeSocket* socket,
                       InfIoEvent events,
                       gpointer user_data);
 
+static gconstpointer
+inf_tcp_connection_chunk_get_data(InfTcpConnectionChunk* chunk,
+                                  gsize* len)
+{
+  if(chunk->bytes != NULL)
+    return g_bytes_get_data(chunk->bytes, len);
+
+  *len = chunk->copy->len;
+  return chunk->copy->data;
+}
+
+static void
+inf_tcp_connection_chunk_free(InfTcpConnectionChunk* chunk)
+{
+  if(chunk->bytes != NULL)
+    g_bytes_unref(chunk->bytes);
+  else
+    g_byte_array_unref(chunk->copy);
+
+  g_slice_free(InfTcpConnectionChunk, chunk);
+}
+
+static void
+inf_tcp_connection_clear_queue(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionChunk* chunk;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  while(!g_queue_is_empty(&priv->queue))
+  {
+    chunk = (InfTcpConnectionChunk*)g_queue_pop_head(&priv->queue);
+    inf_tcp_connection_chunk_free(chunk);
+  }
+
+  priv->queue_offset = 0;
+}
+
+/* Appends data to the send queue. If bytes is non-NULL, then data must
+ * point into it, and the data is not copied. */
+static void
+inf_tcp_connection_enqueue(InfTcpConnection* connection,
+                           GBytes* bytes,
+                           gconstpointer data,
+                           gsize len)
+{
+  InfTcpConnectionPrivate* priv;
+  InfTcpConnectionChunk* chunk;
+  gsize bytes_len;
+  gconstpointer bytes_data;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_assert(len > 0);
+
+  chunk = (InfTcpConnectionChunk*)g_queue_peek_tail(&priv->queue);
+
+  /* Small pieces of data are copied to avoid a chunk for every message */
+  if(bytes == NULL || len < INF_TCP_CONNECTION_CHUNK_SIZE / 16)
+  {
+    if(chunk != NULL && chunk->copy != NULL &&
+       chunk->copy->len + len <= INF_TCP_CONNECTION_CHUNK_SIZE)
+    {
+      g_byte_array_append(chunk->copy, data, len);
+      return;
+    }
+
+    chunk = g_slice_new(InfTcpConnectionChunk);
+    chunk->bytes = NULL;
+    chunk->copy = g_byte_array_sized_new(
+      MAX(len, INF_TCP_CONNECTION_CHUNK_SIZE)
+    );
+
+    g_byte_array_append(chunk->copy, data, len);
+  }
+  else
+  {
+    chunk = g_slice_new(InfTcpConnectionChunk);
+    chunk->copy = NULL;
+
+    bytes_data = g_bytes_get_data(bytes, &bytes_len);
+    if(bytes_data == data && bytes_len == len)
+    {
+      chunk->bytes = g_bytes_ref(bytes);
+    }
+    else
+    {
+      chunk->bytes = g_bytes_new_from_bytes(
+        bytes,
+        (const guint8*)data - (const guint8*)bytes_data,
+        len
+      );
+    }
+  }
+
+  g_queue_push_tail(&priv->queue, chunk);
+}
+
 
 static void
 inf_tcp_connection_connected(InfTcpConnection* connection)
@@ -282,8 +410,7 @@ inf_tcp_connection_connected(InfTcpConnection* connection)
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
 
   priv->status = INF_TCP_CONNECTION_CONNECTED;
-  priv->front_pos = 0;
-  priv->back_pos = 0;
+  inf_tcp_connection_clear_queue(connection);
 
   priv->events = INF_IO_INCOMING | INF_IO_ERROR;
 
@@ -634,21 +761,275 @@ inf_tcp_connection_send_real(InfTcpConnection* connection,
   return TRUE;
 }
 
+/* Sends as much of the send queue as the kernel accepts, passing up to
+ * INF_TCP_CONNECTION_MAX_IOV chunks to a single system call. */
+static void
+inf_tcp_connection_send_queue(InfTcpConnection* connection)
+{
+  InfTcpConnectionPrivate* priv;
+#ifdef G_OS_WIN32
+  WSABUF bufs[INF_TCP_CONNECTION_MAX_IOV];
+  DWORD sent_bytes;
+#else
+  struct iovec bufs[INF_TCP_CONNECTION_MAX_IOV];
+  struct msghdr msg;
+#endif
+  InfTcpConnectionChunk* done[INF_TCP_CONNECTION_MAX_IOV];
+  gconstpointer sent_data[INF_TCP_CONNECTION_MAX_IOV];
+  gsize sent_len[INF_TCP_CONNECTION_MAX_IOV];
+  guint n_bufs;
+  guint n_sent;
+  guint n_done;
+  guint i;
+
+  GList* item;
+  InfTcpConnectionChunk* chunk;
+  gconstpointer data;
+  gsize len;
+  gsize offset;
+  gsize requested;
+  gsize remaining;
+  ssize_t result;
+  int errcode;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  do
+  {
+    n_bufs = 0;
+    requested = 0;
+    offset = priv->queue_offset;
+    for(item = priv->queue.head;
+        item != NULL && n_bufs < INF_TCP_CONNECTION_MAX_IOV;
+        item = item->next)
+    {
+      chunk = (InfTcpConnectionChunk*)item->data;
+      data = inf_tcp_connection_chunk_get_data(chunk, &len);
+
+      sent_data[n_bufs] = (const guint8*)data + offset;
+      sent_len[n_bufs] = len - offset;
+#ifdef G_OS_WIN32
+      bufs[n_bufs].buf = (char*)sent_data[n_bufs];
+      bufs[n_bufs].len = sent_len[n_bufs];
+#else
+      bufs[n_bufs].iov_base = (void*)sent_data[n_bufs];
+      bufs[n_bufs].iov_len = sent_len[n_bufs];
+#endif
+      requested += sent_len[n_bufs];
+      ++n_bufs;
+      offset = 0;
+    }
+
+    do
+    {
+#ifdef G_OS_WIN32
+      if(WSASend(priv->socket, bufs, n_bufs, &sent_bytes, 0, NULL, NULL) == 0)
+        result = sent_bytes;
+      else
+        result = -1;
+#else
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov = bufs;
+      msg.msg_iovlen = n_bufs;
+      result = sendmsg(priv->socket, &msg, INF_NATIVE_SOCKET_SENDRECV_FLAGS);
+#endif
+      /* Preserve error code so that it is not modified by future calls */
+      errcode = INF_NATIVE_SOCKET_LAST_ERROR;
+    } while(result < 0 && errcode == INF_NATIVE_SOCKET_EINTR);
+
+    if(result < 0)
+    {
+      if(errcode != INF_NATIVE_SOCKET_EAGAIN)
+        inf_tcp_connection_system_error(connection, errcode);
+      return;
+    }
+    else if(result == 0)
+    {
+      inf_tcp_connection_close(connection);
+      return;
+    }
+
+    /* Remove what has been sent from the queue. The chunks that have been
+     * sent completely are freed only after the "sent" signal has been
+     * emitted for them. */
+    n_sent = 0;
+    n_done = 0;
+    remaining = result;
+    while(remaining > 0)
+    {
+      if(sent_len[n_sent] <= remaining)
+      {
+        remaining -= sent_len[n_sent];
+        done[n_done++] = (InfTcpConnectionChunk*)g_queue_pop_head(&priv->queue);
+        priv->queue_offset = 0;
+      }
+      else
+      {
+        sent_len[n_sent] = remaining;
+        priv->queue_offset += remaining;
+        remaining = 0;
+      }
+
+      ++n_sent;
+    }
+
+    if(g_queue_is_empty(&priv->queue))
+    {
+      /* sent everything */
+      priv->events &= ~INF_IO_OUTGOING;
+      inf_io_update_watch(priv->io, priv->watch, priv->events);
+    }
+
+    for(i = 0; i < n_sent; ++i)
+    {
+      /* A signal handler might have closed the connection, in which case
+       * the data of a partially sent chunk is gone. */
+      if(i < n_done || priv->status == INF_TCP_CONNECTION_CONNECTED)
+      {
+        g_signal_emit(
+          G_OBJECT(connection),
+          tcp_connection_signals[SENT],
+          0,
+          sent_data[i],
+          (guint)sent_len[i]
+        );
+      }
+    }
+
+    for(i = 0; i < n_done; ++i)
+      inf_tcp_connection_chunk_free(done[i]);
+
+    /* Continue if the kernel accepted everything we passed to it, and
+     * there is more data in the queue. */
+  } while((gsize)result == requested &&
+          priv->status == INF_TCP_CONNECTION_CONNECTED &&
+          !g_queue_is_empty(&priv->queue));
+}
+
+static void
+inf_tcp_connection_send_data(InfTcpConnection* connection,
+                             GBytes* bytes,
+                             gconstpointer data,
+                             guint len)
+{
+  InfTcpConnectionPrivate* priv;
+  gconstpointer sent_data;
+  guint sent_len;
+
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_object_ref(connection);
+
+  /* Check whether we have data currently queued. If we have, then we need
+   * to wait until that data has been sent before sending the new data. */
+  if(g_queue_is_empty(&priv->queue))
+  {
+    /* Must not be set, because otherwise we would need something to send,
+     * but there is nothing in the queue. */
+    g_assert(~priv->events & INF_IO_OUTGOING);
+
+    /* Nothing in queue, send data directly. */
+    sent_len = len;
+    sent_data = data;
+
+    if(inf_tcp_connection_send_real(connection, data, &sent_len) == TRUE)
+    {
+      data = (const char*)data + sent_len;
+      len -= sent_len;
+    }
+    else
+    {
+      /* Sending failed. The error signal has been emitted. */
+      /* Set len to zero so that we don't enqueue data. */
+      len = 0;
+      sent_len = 0;
+    }
+  }
+  else
+  {
+    /* Nothing sent */
+    sent_len = 0;
+  }
+
+  /* If we couldn't send all the data... */
+  if(len > 0)
+  {
+    inf_tcp_connection_enqueue(connection, bytes, data, len);
+
+    if(~priv->events & INF_IO_OUTGOING)
+    {
+      priv->events |= INF_IO_OUTGOING;
+      inf_io_update_watch(priv->io, priv->watch, priv->events);
+    }
+  }
+
+  if(sent_len > 0)
+  {
+    g_signal_emit(
+      G_OBJECT(connection),
+      tcp_connection_signals[SENT],
+      0,
+      sent_data,
+      sent_len
+    );
+  }
+
+  g_object_unref(connection);
+}
+
+static void
+inf_tcp_connection_received(InfTcpConnection* connection,
+                            gconstpointer data,
+                            guint len)
+{
+  InfTcpConnectionPrivate* priv;
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  if(priv->received_func != NULL)
+  {
+    priv->received_func(connection, data, len, priv->received_user_data);
+
+    /* Avoid the signal emission overhead if nobody else is interested */
+    if(INF_TCP_CONNECTION_GET_CLASS(connection)->received == NULL &&
+       !g_signal_has_handler_pending(connection,
+                                     tcp_connection_signals[RECEIVED],
+                                     0,
+                                     FALSE))
+    {
+      return;
+    }
+  }
+
+  g_signal_emit(
+    G_OBJECT(connection),
+    tcp_connection_signals[RECEIVED],
+    0,
+    data,
+    len
+  );
+}
+
 static void
 inf_tcp_connection_io_incoming(InfTcpConnection* connection)
 {
   InfTcpConnectionPrivate* priv;
-  gchar buf[2048];
   int errcode;
   ssize_t result;
+  gsize max_result;
 
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
 
   g_assert(priv->status == INF_TCP_CONNECTION_CONNECTED);
 
+  max_result = 0;
   do
   {
-    result = recv(priv->socket, buf, 2048, INF_NATIVE_SOCKET_SENDRECV_FLAGS);
+    result = recv(
+      priv->socket,
+      priv->receive_buffer,
+      priv->receive_alloc,
+      INF_NATIVE_SOCKET_SENDRECV_FLAGS
+    );
+
     errcode = INF_NATIVE_SOCKET_LAST_ERROR;
 
     if(result < 0 &&
@@ -663,17 +1044,51 @@ inf_tcp_connection_io_incoming(InfTcpConnection* connection)
     }
     else if(result > 0)
     {
-      g_signal_emit(
-        G_OBJECT(connection),
-        tcp_connection_signals[RECEIVED],
-        0,
-        buf,
+      inf_tcp_connection_received(
+        connection,
+        priv->receive_buffer,
         (guint)result
       );
+
+      if((gsize)result > max_result)
+        max_result = result;
+
+      /* The buffer was filled completely, so more data is probably
+       * waiting. Read it in larger pieces. */
+      if((gsize)result == priv->receive_alloc &&
+         priv->receive_alloc < priv->max_receive_alloc)
+      {
+        priv->receive_alloc = MIN(
+          priv->receive_alloc * 2,
+          priv->max_receive_alloc
+        );
+
+        priv->receive_buffer = g_realloc(
+          priv->receive_buffer,
+          priv->receive_alloc
+        );
+      }
     }
   } while( ((result > 0) ||
             (result < 0 && errcode == INF_NATIVE_SOCKET_EINTR)) &&
            (priv->status != INF_TCP_CONNECTION_CLOSED));
+
+  /* Give memory back once the burst is over, or if the maximum size has
+   * been lowered. */
+  if((max_result < priv->receive_alloc / 4 &&
+      priv->receive_alloc > INF_TCP_CONNECTION_RECEIVE_BUFFER_MIN) ||
+     priv->receive_alloc > priv->max_receive_alloc)
+  {
+    priv->receive_alloc = MAX(
+      MIN(priv->receive_alloc / 2, priv->max_receive_alloc),
+      INF_TCP_CONNECTION_RECEIVE_BUFFER_MIN
+    );
+
+    priv->receive_buffer = g_realloc(
+      priv->receive_buffer,
+      priv->receive_alloc
+    );
+  }
 }
 
 static void
@@ -684,9 +1099,6 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
   socklen_t len;
   int errcode;
 
-  gconstpointer data;
-  guint data_len;
-
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
   switch(priv->status)
   {
@@ -709,35 +1121,10 @@ inf_tcp_connection_io_outgoing(InfTcpConnection* connection)
 
     break;
   case INF_TCP_CONNECTION_CONNECTED:
-    g_assert(priv->back_pos < priv->front_pos);
+    g_assert(!g_queue_is_empty(&priv->queue));
     g_assert(priv->events & INF_IO_OUTGOING);
 
-    data = priv->queue + priv->back_pos;
-    data_len = priv->front_pos - priv->back_pos;
-    if(inf_tcp_connection_send_real(connection, data, &data_len) == TRUE)
-    {
-      priv->back_pos += data_len;
-
-      if(priv->front_pos == priv->back_pos)
-      {
-        /* sent everything */
-        priv->front_pos = 0;
-        priv->back_pos = 0;
-
-        priv->events &= ~INF_IO_OUTGOING;
-
-        inf_io_update_watch(priv->io, priv->watch, priv->events);
-      }
-
-      g_signal_emit(
-        G_OBJECT(connection),
-        tcp_connection_signals[SENT],
-        0,
-        data,
-        data_len
-      );
-    }
-
+    inf_tcp_connection_send_queue(connection);
     break;
   case INF_TCP_CONNECTION_CLOSED:
   default:
@@ -910,10 +1297,15 @@ inf_tcp_connection_init(InfTcpConnection* connection)
   priv->remote_port = 0;
   priv->device_index = 0;
 
-  priv->queue = g_malloc(1024);
-  priv->front_pos = 0;
-  priv->back_pos = 0;
-  priv->alloc = 1024;
+  g_queue_init(&priv->queue);
+  priv->queue_offset = 0;
+
+  priv->receive_alloc = INF_TCP_CONNECTION_RECEIVE_BUFFER_MIN;
+  priv->receive_buffer = g_malloc(priv->receive_alloc);
+  priv->max_receive_alloc = 65536;
+
+  priv->received_func = NULL;
+  priv->received_user_data = NULL;
 }
 
 static void
@@ -954,7 +1346,8 @@ inf_tcp_connection_finalize(GObject* object)
   if(priv->socket != INVALID_SOCKET)
     closesocket(priv->socket);
 
-  g_free(priv->queue);
+  inf_tcp_connection_clear_queue(connection);
+  g_free(priv->receive_buffer);
 
   G_OBJECT_CLASS(inf_tcp_connection_parent_class)->finalize(object);
 }
@@ -1045,6 +1438,10 @@ inf_tcp_connection_set_property(GObject* object,
     }
 #endif
     break;
+  case PROP_RECEIVE_BUFFER_SIZE:
+    /* The buffer itself is resized on the next read */
+    priv->max_receive_alloc = g_value_get_uint(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1158,6 +1555,9 @@ inf_tcp_connection_get_property(GObject* object,
     }
 #endif
     break;
+  case PROP_RECEIVE_BUFFER_SIZE:
+    g_value_set_uint(value, priv->max_receive_alloc);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -1331,6 +1731,20 @@ inf_tcp_connection_class_init(InfTcpConnectionClass* tcp_connection_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_RECEIVE_BUFFER_SIZE,
+    g_param_spec_uint(
+      "receive-buffer-size",
+      "Receive buffer size",
+      "The maximum number of bytes to read from the connection at once",
+      INF_TCP_CONNECTION_RECEIVE_BUFFER_MIN,
+      G_MAXUINT,
+      65536,
+      G_PARAM_READWRITE
+    )
+  );
+
   /**
    * InfTcpConnection::sent:
    * @connection: The #InfTcpConnection through which the data has been sent.
@@ -1588,8 +2002,7 @@ inf_tcp_connection_close(InfTcpConnection* connection)
     priv->watch = NULL;
   }
 
-  priv->front_pos = 0;
-  priv->back_pos = 0;
+  inf_tcp_connection_clear_queue(connection);
 
   priv->status = INF_TCP_CONNECTION_CLOSED;
   g_object_notify(G_OBJECT(connection), "status");
@@ -1612,8 +2025,6 @@ inf_tcp_connection_send(InfTcpConnection* connection,
                         guint len)
 {
   InfTcpConnectionPrivate* priv;
-  gconstpointer sent_data;
-  guint sent_len;
 
   g_return_if_fail(INF_IS_TCP_CONNECTION(connection));
   g_return_if_fail(len == 0 || data != NULL);
@@ -1621,91 +2032,38 @@ inf_tcp_connection_send(InfTcpConnection* connection,
   priv = INF_TCP_CONNECTION_PRIVATE(connection);
   g_return_if_fail(priv->status == INF_TCP_CONNECTION_CONNECTED);
 
-  g_object_ref(connection);
-
-  /* Check whether we have data currently queued. If we have, then we need
-   * to wait until that data has been sent before sending the new data. */
-  if(priv->front_pos == priv->back_pos)
-  {
-    /* Must not be set, because otherwise we would need something to send,
-     * but there is nothing in the queue. */
-    g_assert(~priv->events & INF_IO_OUTGOING);
-
-    /* Nothing in queue, send data directly. */
-    sent_len = len;
-    sent_data = data;
-
-    if(inf_tcp_connection_send_real(connection, data, &sent_len) == TRUE)
-    {
-      data = (const char*)data + sent_len;
-      len -= sent_len;
-    }
-    else
-    {
-      /* Sending failed. The error signal has been emitted. */
-      /* Set len to zero so that we don't enqueue data. */
-      len = 0;
-      sent_len = 0;
-    }
-  }
-  else
-  {
-    /* Nothing sent */
-    sent_len = 0;
-  }
-
-  /* If we couldn't send all the data... */
-  if(len > 0)
-  {
-    /* If we have not enough space for the new data, move queue data back
-     * onto the beginning of the queue, if not already */
-    if(priv->alloc - priv->front_pos < len && priv->back_pos > 0)
-    {
-      memmove(
-        priv->queue,
-        priv->queue + priv->back_pos,
-        priv->front_pos - priv->back_pos
-      );
-
-      priv->front_pos -= priv->back_pos;
-      priv->back_pos = 0;
-    }
-
-    /* Allocate more memory if there is still not enough space */
-    if(priv->alloc - priv->front_pos < len)
-    {
-      /* Make sure we allocate enough */
-      priv->alloc = priv->front_pos + len;
-
-      /* Always allocate a multiple of 1024 */
-      if(priv->alloc % 1024 != 0)
-        priv->alloc = priv->alloc + (1024 - priv->alloc % 1024);
+  inf_tcp_connection_send_data(connection, NULL, data, len);
+}
 
-      priv->queue = g_realloc(priv->queue, priv->alloc);
-    }
+/**
+ * inf_tcp_connection_send_bytes:
+ * @connection: A #InfTcpConnection with status %INF_TCP_CONNECTION_CONNECTED.
+ * @bytes: The data to send.
+ *
+ * Sends data through the TCP connection, like inf_tcp_connection_send().
+ * The difference is that data which cannot be sent immediately is not
+ * copied into the connection's send queue, but @bytes is referenced
+ * instead. This allows to send the same buffer through many connections
+ * without copying it for each of them.
+ **/
+void
+inf_tcp_connection_send_bytes(InfTcpConnection* connection,
+                              GBytes* bytes)
+{
+  InfTcpConnectionPrivate* priv;
+  gconstpointer data;
+  gsize len;
 
-    memcpy(priv->queue + priv->front_pos, data, len);
-    priv->front_pos += len;
+  g_return_if_fail(INF_IS_TCP_CONNECTION(connection));
+  g_return_if_fail(bytes != NULL);
 
-    if(~priv->events & INF_IO_OUTGOING)
-    {
-      priv->events |= INF_IO_OUTGOING;
-      inf_io_update_watch(priv->io, priv->watch, priv->events);
-    }
-  }
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+  g_return_if_fail(priv->status == INF_TCP_CONNECTION_CONNECTED);
 
-  if(sent_len > 0)
-  {
-    g_signal_emit(
-      G_OBJECT(connection),
-      tcp_connection_signals[SENT],
-      0,
-      sent_data,
-      sent_len
-    );
-  }
+  data = g_bytes_get_data(bytes, &len);
+  g_return_if_fail(len <= G_MAXUINT);
 
-  g_object_unref(connection);
+  inf_tcp_connection_send_data(connection, bytes, data, (guint)len);
 }
 
 /**
@@ -1835,4 +2193,23 @@ _inf_tcp_connection_accepted(InfIo* io,
   return connection;
 }
 
+/* Sets a function to be called whenever data has been received. This is
+ * called before the InfTcpConnection::received signal is emitted, and the
+ * signal emission is skipped if nobody is connected to it. It is used by
+ * InfXmppConnection and should not be considered regular API. Do not call
+ * this function. Language bindings should not wrap it. */
+void
+_inf_tcp_connection_set_received_func(InfTcpConnection* connection,
+                                      InfTcpConnectionReceivedFunc func,
+                                      gpointer user_data)
+{
+  InfTcpConnectionPrivate* priv;
+
+  g_return_if_fail(INF_IS_TCP_CONNECTION(connection));
+  priv = INF_TCP_CONNECTION_PRIVATE(connection);
+
+  priv->received_func = func;
+  priv->received_user_data = user_data;
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -131,6 +131,10 @@ inf_tcp_connection_send(InfTcpConnection* connection,
                         gconstpointer data,
                         guint len);
 
+void
+inf_tcp_connection_send_bytes(InfTcpConnection* connection,
+                              GBytes* bytes);
+
 InfIpAddress*
 inf_tcp_connection_get_remote_address(InfTcpConnection* connection);
 
@@ -0,0 +1,498 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:inf-utf8
+ * @title: UTF-8 utility functions
+ * @short_description: Fast character counting and validation of UTF-8 text
+ * @include: libinfinity/common/inf-utf8.h
+ * @stability: Unstable
+ *
+ * These functions do the same as g_utf8_strlen(), g_utf8_offset_to_pointer()
+ * and g_utf8_validate(), but they look at many bytes at once instead of
+ * walking the text character by character. They are used whenever larger
+ * amounts of text are transferred or stored, such as when synchronizing a
+ * text document.
+ *
+ * On x86 processors, SSE2 or AVX2 instructions are used if the CPU supports
+ * them. This is decided at runtime, so that the library can be built for
+ * older processors while still making use of newer ones. On all other
+ * platforms the text is processed one machine word at a time.
+ *
+ * Unlike the GLib functions, the text is never considered to be
+ * nul-terminated, and nul characters are valid UTF-8.
+ **/
+
+#include <libinfinity/common/inf-utf8.h>
+
+#include "config.h"
+
+#if defined(HAVE_SSE2_INTRINSICS) || defined(HAVE_AVX2_INTRINSICS)
+# include <immintrin.h>
+#endif
+
+#include <string.h>
+
+typedef struct _InfUtf8Kernel InfUtf8Kernel;
+struct _InfUtf8Kernel {
+  /* All of these only process the text in whole blocks of the kernel's
+   * width, and return the number of bytes processed. The remaining bytes are
+   * handled by the generic code. */
+
+  /* Adds the number of characters starting in text to *chars. */
+  gsize (*count)(const guchar* text, gsize bytes, gsize* chars);
+
+  /* Skips blocks as long as the characters starting in them are less than
+   * or equal to *chars, and subtracts the skipped characters from *chars. */
+  gsize (*skip)(const guchar* text, gsize bytes, gsize* chars);
+
+  /* Skips blocks that contain only ASCII characters. */
+  gsize (*skip_ascii)(const guchar* text, gsize bytes);
+};
+
+#define INF_UTF8_IS_CONTINUATION(c) (((c) & 0xc0) == 0x80)
+
+static guint
+inf_utf8_popcount(guint64 x)
+{
+#ifdef __GNUC__
+  return __builtin_popcountll(x);
+#else
+  x = x - ((x >> 1) & G_GUINT64_CONSTANT(0x5555555555555555));
+  x = (x & G_GUINT64_CONSTANT(0x3333333333333333)) +
+      ((x >> 2) & G_GUINT64_CONSTANT(0x3333333333333333));
+  x = (x + (x >> 4)) & G_GUINT64_CONSTANT(0x0f0f0f0f0f0f0f0f);
+  return (guint)((x * G_GUINT64_CONSTANT(0x0101010101010101)) >> 56);
+#endif
+}
+
+/*
+ * Portable kernel, processing one 64 bit word at a time
+ */
+
+#define INF_UTF8_HIGH_BITS G_GUINT64_CONSTANT(0x8080808080808080)
+
+static guint64
+inf_utf8_load_word(const guchar* text)
+{
+  guint64 word;
+  memcpy(&word, text, sizeof(word));
+  return word;
+}
+
+/* Returns the number of bytes in word which start a character, i.e. which
+ * are not of the form 10xxxxxx. The byte order does not matter here. */
+static guint
+inf_utf8_word_starts(guint64 word)
+{
+  return 8 - inf_utf8_popcount(word & ~(word << 1) & INF_UTF8_HIGH_BITS);
+}
+
+static gsize
+inf_utf8_count_word(const guchar* text,
+                    gsize bytes,
+                    gsize* chars)
+{
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 8; pos += 8)
+    *chars += inf_utf8_word_starts(inf_utf8_load_word(text + pos));
+
+  return pos;
+}
+
+static gsize
+inf_utf8_skip_word(const guchar* text,
+                   gsize bytes,
+                   gsize* chars)
+{
+  gsize pos;
+  guint n;
+
+  for(pos = 0; bytes - pos >= 8; pos += 8)
+  {
+    n = inf_utf8_word_starts(inf_utf8_load_word(text + pos));
+    if(n > *chars) break;
+    *chars -= n;
+  }
+
+  return pos;
+}
+
+static gsize
+inf_utf8_skip_ascii_word(const guchar* text,
+                         gsize bytes)
+{
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 8; pos += 8)
+    if((inf_utf8_load_word(text + pos) & INF_UTF8_HIGH_BITS) != 0)
+      break;
+
+  return pos;
+}
+
+static const InfUtf8Kernel inf_utf8_kernel_word = {
+  inf_utf8_count_word,
+  inf_utf8_skip_word,
+  inf_utf8_skip_ascii_word
+};
+
+/*
+ * SSE2 kernel, processing 16 bytes at a time. Continuation bytes are
+ * exactly the ones that are smaller than -64 when interpreted as signed
+ * values.
+ */
+
+#ifdef HAVE_SSE2_INTRINSICS
+__attribute__((target("sse2")))
+static guint
+inf_utf8_sse2_starts(const guchar* text)
+{
+  __m128i v;
+  v = _mm_loadu_si128((const __m128i*)text);
+  v = _mm_cmpgt_epi8(v, _mm_set1_epi8(-65));
+  return inf_utf8_popcount((guint)_mm_movemask_epi8(v));
+}
+
+__attribute__((target("sse2")))
+static gsize
+inf_utf8_count_sse2(const guchar* text,
+                    gsize bytes,
+                    gsize* chars)
+{
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 16; pos += 16)
+    *chars += inf_utf8_sse2_starts(text + pos);
+
+  return pos;
+}
+
+__attribute__((target("sse2")))
+static gsize
+inf_utf8_skip_sse2(const guchar* text,
+                   gsize bytes,
+                   gsize* chars)
+{
+  gsize pos;
+  guint n;
+
+  for(pos = 0; bytes - pos >= 16; pos += 16)
+  {
+    n = inf_utf8_sse2_starts(text + pos);
+    if(n > *chars) break;
+    *chars -= n;
+  }
+
+  return pos;
+}
+
+__attribute__((target("sse2")))
+static gsize
+inf_utf8_skip_ascii_sse2(const guchar* text,
+                         gsize bytes)
+{
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 16; pos += 16)
+    if(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)(text + pos))) != 0)
+      break;
+
+  return pos;
+}
+
+static const InfUtf8Kernel inf_utf8_kernel_sse2 = {
+  inf_utf8_count_sse2,
+  inf_utf8_skip_sse2,
+  inf_utf8_skip_ascii_sse2
+};
+#endif
+
+/*
+ * AVX2 kernel, processing 32 bytes at a time
+ */
+
+#ifdef HAVE_AVX2_INTRINSICS
+__attribute__((target("avx2")))
+static guint
+inf_utf8_avx2_starts(const guchar* text)
+{
+  __m256i v;
+  v = _mm256_loadu_si256((const __m256i*)text);
+  v = _mm256_cmpgt_epi8(v, _mm256_set1_epi8(-65));
+  return inf_utf8_popcount((guint)_mm256_movemask_epi8(v));
+}
+
+__attribute__((target("avx2")))
+static gsize
+inf_utf8_count_avx2(const guchar* text,
+                    gsize bytes,
+                    gsize* chars)
+{
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 32; pos += 32)
+    *chars += inf_utf8_avx2_starts(text + pos);
+
+  return pos;
+}
+
+__attribute__((target("avx2")))
+static gsize
+inf_utf8_skip_avx2(const guchar* text,
+                   gsize bytes,
+                   gsize* chars)
+{
+  gsize pos;
+  guint n;
+
+  for(pos = 0; bytes - pos >= 32; pos += 32)
+  {
+    n = inf_utf8_avx2_starts(text + pos);
+    if(n > *chars) break;
+    *chars -= n;
+  }
+
+  return pos;
+}
+
+__attribute__((target("avx2")))
+static gsize
+inf_utf8_skip_ascii_avx2(const guchar* text,
+                         gsize bytes)
+{
+  __m256i v;
+  gsize pos;
+
+  for(pos = 0; bytes - pos >= 32; pos += 32)
+  {
+    v = _mm256_loadu_si256((const __m256i*)(text + pos));
+    if(_mm256_movemask_epi8(v) != 0)
+      break;
+  }
+
+  return pos;
+}
+
+static const InfUtf8Kernel inf_utf8_kernel_avx2 = {
+  inf_utf8_count_avx2,
+  inf_utf8_skip_avx2,
+  inf_utf8_skip_ascii_avx2
+};
+#endif
+
+static const InfUtf8Kernel*
+inf_utf8_get_kernel(void)
+{
+  static gsize kernel = 0;
+  const InfUtf8Kernel* chosen;
+
+  if(g_once_init_enter(&kernel))
+  {
+    chosen = &inf_utf8_kernel_word;
+
+#ifdef HAVE_SSE2_INTRINSICS
+    if(__builtin_cpu_supports("sse2"))
+      chosen = &inf_utf8_kernel_sse2;
+#endif
+
+#ifdef HAVE_AVX2_INTRINSICS
+    if(__builtin_cpu_supports("avx2"))
+      chosen = &inf_utf8_kernel_avx2;
+#endif
+
+    g_once_init_leave(&kernel, (gsize)chosen);
+  }
+
+  return (const InfUtf8Kernel*)kernel;
+}
+
+/* Returns the length of the well-formed UTF-8 sequence starting at text, or
+ * 0 if there is none. Overlong forms, surrogates and code points beyond
+ * U+10FFFF are rejected, as by RFC 3629. */
+static gsize
+inf_utf8_sequence_length(const guchar* text,
+                         gsize bytes)
+{
+  guchar c;
+  guchar min;
+  guchar max;
+
+  c = text[0];
+  if(c < 0x80) return 1;
+
+  min = 0x80;
+  max = 0xbf;
+
+  if(c >= 0xc2 && c <= 0xdf)
+  {
+    if(bytes < 2) return 0;
+    if(text[1] < min || text[1] > max) return 0;
+    return 2;
+  }
+  else if(c >= 0xe0 && c <= 0xef)
+  {
+    if(c == 0xe0) min = 0xa0;
+    else if(c == 0xed) max = 0x9f;
+
+    if(bytes < 3) return 0;
+    if(text[1] < min || text[1] > max) return 0;
+    if(!INF_UTF8_IS_CONTINUATION(text[2])) return 0;
+    return 3;
+  }
+  else if(c >= 0xf0 && c <= 0xf4)
+  {
+    if(c == 0xf0) min = 0x90;
+    else if(c == 0xf4) max = 0x8f;
+
+    if(bytes < 4) return 0;
+    if(text[1] < min || text[1] > max) return 0;
+    if(!INF_UTF8_IS_CONTINUATION(text[2])) return 0;
+    if(!INF_UTF8_IS_CONTINUATION(text[3])) return 0;
+    return 4;
+  }
+
+  return 0;
+}
+
+/**
+ * inf_utf8_strlen:
+ * @text: (array length=bytes): Valid UTF-8 text.
+ * @bytes: The number of bytes of @text.
+ *
+ * Returns the number of characters in the first @bytes bytes of @text.
+ * @text must be valid UTF-8, which can be checked with inf_utf8_validate().
+ *
+ * Returns: The number of characters in @text.
+ */
+gsize
+inf_utf8_strlen(const gchar* text,
+                gsize bytes)
+{
+  const guchar* utext;
+  gsize chars;
+  gsize pos;
+
+  g_return_val_if_fail(text != NULL || bytes == 0, 0);
+
+  utext = (const guchar*)text;
+  chars = 0;
+
+  pos = inf_utf8_get_kernel()->count(utext, bytes, &chars);
+  for(; pos < bytes; ++pos)
+    if(!INF_UTF8_IS_CONTINUATION(utext[pos]))
+      ++chars;
+
+  return chars;
+}
+
+/**
+ * inf_utf8_offset_to_index:
+ * @text: (array length=bytes): Valid UTF-8 text.
+ * @bytes: The number of bytes of @text.
+ * @offset: A character offset into @text.
+ *
+ * Returns the byte index at which the character with offset @offset starts
+ * in @text. If @offset is equal to the number of characters in @text, then
+ * @bytes is returned. @text must be valid UTF-8.
+ *
+ * Returns: The byte index of the character at @offset.
+ */
+gsize
+inf_utf8_offset_to_index(const gchar* text,
+                         gsize bytes,
+                         gsize offset)
+{
+  const guchar* utext;
+  gsize pos;
+
+  g_return_val_if_fail(text != NULL || bytes == 0, 0);
+
+  utext = (const guchar*)text;
+  pos = inf_utf8_get_kernel()->skip(utext, bytes, &offset);
+
+  /* The kernel might have stopped in the middle of a character that started
+   * in an earlier block, and which has already been accounted for. */
+  while(pos < bytes && INF_UTF8_IS_CONTINUATION(utext[pos]))
+    ++pos;
+
+  for(; offset > 0 && pos < bytes; --offset)
+    pos += g_utf8_skip[utext[pos]];
+
+  g_return_val_if_fail(offset == 0, bytes);
+  return MIN(pos, bytes);
+}
+
+/**
+ * inf_utf8_validate:
+ * @text: (array length=bytes): The text to validate.
+ * @bytes: The number of bytes of @text.
+ * @end: (out) (allow-none): Location to store the end of the valid text,
+ * or %NULL.
+ *
+ * Checks whether the first @bytes bytes of @text are valid UTF-8, as
+ * specified by RFC 3629. In contrast to g_utf8_validate(), nul bytes are
+ * allowed in @text. If @end is non-%NULL, then it is set to the first
+ * invalid byte of @text, or to @text + @bytes if all of @text is valid.
+ *
+ * Returns: %TRUE if @text is valid UTF-8, or %FALSE otherwise.
+ */
+gboolean
+inf_utf8_validate(const gchar* text,
+                  gsize bytes,
+                  const gchar** end)
+{
+  const InfUtf8Kernel* kernel;
+  const guchar* utext;
+  gsize pos;
+  gsize len;
+
+  g_return_val_if_fail(text != NULL || bytes == 0, FALSE);
+
+  kernel = inf_utf8_get_kernel();
+  utext = (const guchar*)text;
+  pos = 0;
+
+  while(pos < bytes)
+  {
+    pos += kernel->skip_ascii(utext + pos, bytes - pos);
+
+    /* Go on character by character until the next ASCII block */
+    while(pos < bytes && utext[pos] < 0x80)
+      ++pos;
+
+    while(pos < bytes && utext[pos] >= 0x80)
+    {
+      len = inf_utf8_sequence_length(utext + pos, bytes - pos);
+      if(len == 0)
+      {
+        if(end != NULL) *end = text + pos;
+        return FALSE;
+      }
+
+      pos += len;
+    }
+  }
+
+  if(end != NULL) *end = text + bytes;
+  return TRUE;
+}
+
+/* vim:set et sw=2 ts=2: */
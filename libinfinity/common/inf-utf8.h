@@ -0,0 +1,45 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_UTF8_H__
+#define __INF_UTF8_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+gsize
+inf_utf8_strlen(const gchar* text,
+                gsize bytes);
+
+gsize
+inf_utf8_offset_to_index(const gchar* text,
+                         gsize bytes,
+                         gsize offset);
+
+gboolean
+inf_utf8_validate(const gchar* text,
+                  gsize bytes,
+                  const gchar** end);
+
+G_END_DECLS
+
+#endif /* __INF_UTF8_H__ */
+
+/* vim:set et sw=2 ts=2: */
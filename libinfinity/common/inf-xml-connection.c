@@ -294,6 +294,48 @@ void inf_xml_connection_send(InfXmlConnection* connection,
   iface->send(connection, xml);
 }
 
+/**
+ * inf_xml_connection_send_serialized:
+ * @connection: A #InfXmlConnection.
+ * @xml: (transfer full): A XML message to send. The function takes ownership
+ * of the XML node.
+ * @serialized: (transfer none): The serialized form of @xml, in the format
+ * that inf_xml_util_serialize_node() produces.
+ *
+ * Sends the given XML message to the remote host, like
+ * inf_xml_connection_send(). In addition, the caller provides the
+ * serialized form of @xml, which the connection can transmit as-is instead
+ * of serializing @xml again. This allows to serialize a message only once
+ * when it is sent to many connections. @xml is still required for the
+ * #InfXmlConnection::sent signal.
+ *
+ * Connections which do not implement
+ * #InfXmlConnectionInterface.send_serialized ignore @serialized and send
+ * @xml with #InfXmlConnectionInterface.send.
+ **/
+void inf_xml_connection_send_serialized(InfXmlConnection* connection,
+                                        xmlNodePtr xml,
+                                        GBytes* serialized)
+{
+  InfXmlConnectionInterface* iface;
+
+  g_return_if_fail(INF_IS_XML_CONNECTION(connection));
+  g_return_if_fail(xml != NULL);
+  g_return_if_fail(serialized != NULL);
+
+  iface = INF_XML_CONNECTION_GET_IFACE(connection);
+
+  if(iface->send_serialized != NULL)
+  {
+    iface->send_serialized(connection, xml, serialized);
+  }
+  else
+  {
+    g_return_if_fail(iface->send != NULL);
+    iface->send(connection, xml);
+  }
+}
+
 /**
  * inf_xml_connection_sent:
  * @connection: A #InfXmlConnection.
@@ -68,6 +68,14 @@ typedef enum _InfXmlConnectionStatus {
  * @received: Default signal handler of the #InfXmlConnection::received
  * signal.
  * @error: Default signal handler of the #InfXmlConnection::error signal.
+ * @send_serialized: Virtual function to transmit a message whose serialized
+ * form is already known, see inf_xml_connection_send_serialized(). Like
+ * @send, it takes ownership of the XML node and emits
+ * #InfXmlConnection::sent for it once it has been sent. The serialized form
+ * is owned by the caller and represents the same message as the XML node,
+ * so implementations can transmit it instead of serializing the node
+ * themselves. They need to take a reference on it if they use it after
+ * returning. If this is %NULL, @send is used instead.
  *
  * Virtual functions and default signal handlers for the #InfXmlConnection
  * interface.
@@ -92,6 +100,11 @@ struct _InfXmlConnectionInterface {
                    const xmlNodePtr xml);
   void (*error)(InfXmlConnection* connection,
                 const GError* error);
+
+  /* Virtual table, continued */
+  void (*send_serialized)(InfXmlConnection* connection,
+                          xmlNodePtr xml,
+                          GBytes* serialized);
 };
 
 GType
@@ -111,6 +124,11 @@ void
 inf_xml_connection_send(InfXmlConnection* connection,
                         xmlNodePtr xml);
 
+void
+inf_xml_connection_send_serialized(InfXmlConnection* connection,
+                                   xmlNodePtr xml,
+                                   GBytes* serialized);
+
 void
 inf_xml_connection_sent(InfXmlConnection* connection,
                         const xmlNodePtr xml);
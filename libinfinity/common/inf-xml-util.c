@@ -31,6 +31,7 @@
  **/
 
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8.h>
 #include <libinfinity/common/inf-error.h>
 #include <libinfinity/inf-i18n.h>
 
@@ -286,6 +287,56 @@ inf_xml_util_valid_xml_char(gunichar codepoint)
     || (codepoint >= 0x10000 && codepoint <= 0x10ffff);
 }
 
+static void
+inf_xml_util_set_no_such_attribute_error(xmlNodePtr xml,
+                                         const gchar* attribute,
+                                         GError** error)
+{
+  g_set_error(
+    error,
+    inf_request_error_quark(),
+    INF_REQUEST_ERROR_NO_SUCH_ATTRIBUTE,
+    _("Request '%s' does not contain required attribute '%s'"),
+    (const gchar*)xml->name,
+    attribute
+  );
+}
+
+/* Returns the value of the given attribute, matched the same way as
+ * xmlGetProp() does, that is by name regardless of the attribute's
+ * namespace. Attributes created by the XML parser or by xmlNewProp()
+ * consist of a single text node, and in that case the value is returned
+ * directly, without making a copy. The numeric attribute getters below are
+ * called for every request received, so this saves an allocation for each
+ * attribute. Otherwise, a copy is made and stored in copy, which the caller
+ * needs to free with xmlFree(). Returns NULL if there is no such
+ * attribute. */
+static const xmlChar*
+inf_xml_util_lookup_attribute(xmlNodePtr xml,
+                              const gchar* attribute,
+                              xmlChar** copy)
+{
+  xmlAttrPtr attr;
+
+  *copy = NULL;
+
+  attr = xmlHasProp(xml, (const xmlChar*)attribute);
+  if(attr == NULL)
+    return NULL;
+
+  if(attr->type == XML_ATTRIBUTE_NODE &&
+     attr->children != NULL &&
+     attr->children->next == NULL &&
+     attr->children->type == XML_TEXT_NODE &&
+     attr->children->content != NULL)
+  {
+    return attr->children->content;
+  }
+
+  *copy = xmlGetProp(xml, (const xmlChar*)attribute);
+  return *copy;
+}
+
 /* like the g_utf8_next_char macro, but without the cast to char* at the end
  */
 #define inf_utf8_next_char(p) ((p) + g_utf8_skip[*(const guchar *)(p)])
@@ -366,13 +417,15 @@ inf_xml_util_get_child_text(xmlNodePtr xml,
   GString* result = g_string_sized_new(16);
   guint num_codepoint;
   gsize char_count = 0;
+  gsize len;
   for(child = xml->children; child; child = child->next)
   {
     switch(child->type)
     {
     case XML_TEXT_NODE:
-      g_string_append(result, (const gchar*)child->content);
-      char_count += g_utf8_strlen((const gchar*)child->content, -1);
+      len = strlen((const char*)child->content);
+      g_string_append_len(result, (const gchar*)child->content, len);
+      char_count += inf_utf8_strlen((const gchar*)child->content, len);
       break;
     case XML_ELEMENT_NODE:
       if(strcmp((const char*) child->name, "uchar") != 0) {
@@ -446,16 +499,7 @@ inf_xml_util_get_attribute_required(xmlNodePtr xml,
   value = xmlGetProp(xml, (const xmlChar*)attribute);
 
   if(value == NULL)
-  {
-    g_set_error(
-      error,
-      inf_request_error_quark(),
-      INF_REQUEST_ERROR_NO_SUCH_ATTRIBUTE,
-      _("Request '%s' does not contain required attribute '%s'"),
-      (const gchar*)xml->name,
-      attribute
-    );
-  }
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
 
   return value;
 }
@@ -486,14 +530,15 @@ inf_xml_util_get_attribute_int(xmlNodePtr xml,
                                gint* result,
                                GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = xmlGetProp(xml, (const xmlChar*)attribute);
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
   if(value == NULL) return FALSE;
 
   retval = inf_xml_util_string_to_int(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -521,14 +566,19 @@ inf_xml_util_get_attribute_int_required(xmlNodePtr xml,
                                         gint* result,
                                         GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = inf_xml_util_get_attribute_required(xml, attribute, error);
-  if(value == NULL) return FALSE;
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
+  if(value == NULL)
+  {
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
+    return FALSE;
+  }
 
   retval = inf_xml_util_string_to_int(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -550,14 +600,15 @@ inf_xml_util_get_attribute_long(xmlNodePtr xml,
                                 glong* result,
                                 GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = xmlGetProp(xml, (const xmlChar*)attribute);
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
   if(value == NULL) return FALSE;
 
   retval = inf_xml_util_string_to_long(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -579,14 +630,19 @@ inf_xml_util_get_attribute_long_required(xmlNodePtr xml,
                                          glong* result,
                                          GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = inf_xml_util_get_attribute_required(xml, attribute, error);
-  if(value == NULL) return FALSE;
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
+  if(value == NULL)
+  {
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
+    return FALSE;
+  }
 
   retval = inf_xml_util_string_to_long(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -608,14 +664,15 @@ inf_xml_util_get_attribute_uint(xmlNodePtr xml,
                                 guint* result,
                                 GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = xmlGetProp(xml, (const xmlChar*)attribute);
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
   if(value == NULL) return FALSE;
 
   retval = inf_xml_util_string_to_uint(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -637,14 +694,19 @@ inf_xml_util_get_attribute_uint_required(xmlNodePtr xml,
                                          guint* result,
                                          GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = inf_xml_util_get_attribute_required(xml, attribute, error);
-  if(value == NULL) return FALSE;
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
+  if(value == NULL)
+  {
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
+    return FALSE;
+  }
 
   retval = inf_xml_util_string_to_uint(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -666,14 +728,15 @@ inf_xml_util_get_attribute_ulong(xmlNodePtr xml,
                                  gulong* result,
                                  GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = xmlGetProp(xml, (const xmlChar*)attribute);
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
   if(value == NULL) return FALSE;
 
   retval = inf_xml_util_string_to_ulong(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -695,14 +758,19 @@ inf_xml_util_get_attribute_ulong_required(xmlNodePtr xml,
                                           gulong* result,
                                           GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = inf_xml_util_get_attribute_required(xml, attribute, error);
-  if(value == NULL) return FALSE;
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
+  if(value == NULL)
+  {
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
+    return FALSE;
+  }
 
   retval = inf_xml_util_string_to_ulong(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -724,14 +792,15 @@ inf_xml_util_get_attribute_double(xmlNodePtr xml,
                                   gdouble* result,
                                   GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = xmlGetProp(xml, (const xmlChar*)attribute);
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
   if(value == NULL) return FALSE;
 
   retval = inf_xml_util_string_to_double(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -754,14 +823,19 @@ inf_xml_util_get_attribute_double_required(xmlNodePtr xml,
                                            gdouble* result,
                                            GError** error)
 {
-  xmlChar* value;
+  const xmlChar* value;
+  xmlChar* copy;
   gboolean retval;
 
-  value = inf_xml_util_get_attribute_required(xml, attribute, error);
-  if(value == NULL) return FALSE;
+  value = inf_xml_util_lookup_attribute(xml, attribute, &copy);
+  if(value == NULL)
+  {
+    inf_xml_util_set_no_such_attribute_error(xml, attribute, error);
+    return FALSE;
+  }
 
   retval = inf_xml_util_string_to_double(attribute, value, result, error);
-  xmlFree(value);
+  if(copy != NULL) xmlFree(copy);
   return retval;
 }
 
@@ -956,4 +1030,239 @@ inf_xml_util_new_error_from_node(xmlNodePtr xml)
   return result;
 }
 
+static void
+inf_xml_util_write_escaped(GString* string,
+                           const xmlChar* text,
+                           gboolean attribute)
+{
+  const xmlChar* begin;
+  const xmlChar* cur;
+  const gchar* replacement;
+
+  begin = text;
+  for(cur = text; *cur != '\0'; ++cur)
+  {
+    switch(*cur)
+    {
+    case '&': replacement = "&amp;"; break;
+    case '<': replacement = "&lt;"; break;
+    case '>': replacement = "&gt;"; break;
+    case '\r': replacement = "&#13;"; break;
+    case '"': replacement = attribute ? "&quot;" : NULL; break;
+    case '\n': replacement = attribute ? "&#10;" : NULL; break;
+    case '\t': replacement = attribute ? "&#9;" : NULL; break;
+    default: replacement = NULL; break;
+    }
+
+    if(replacement != NULL)
+    {
+      g_string_append_len(string, (const gchar*)begin, cur - begin);
+      g_string_append(string, replacement);
+      begin = cur + 1;
+    }
+  }
+
+  g_string_append_len(string, (const gchar*)begin, cur - begin);
+}
+
+/* Namespace names are stored with character references left in place by
+ * the parser, so, like libxml2, write them verbatim and only choose the
+ * quotes so that the value stays intact. */
+static void
+inf_xml_util_write_quoted(GString* string,
+                          const xmlChar* text)
+{
+  const xmlChar* cur;
+
+  if(strchr((const char*)text, '"') == NULL)
+  {
+    g_string_append_c(string, '"');
+    g_string_append(string, (const gchar*)text);
+    g_string_append_c(string, '"');
+  }
+  else if(strchr((const char*)text, '\'') == NULL)
+  {
+    g_string_append_c(string, '\'');
+    g_string_append(string, (const gchar*)text);
+    g_string_append_c(string, '\'');
+  }
+  else
+  {
+    g_string_append_c(string, '"');
+    for(cur = text; *cur != '\0'; ++cur)
+    {
+      if(*cur == '"')
+        g_string_append(string, "&quot;");
+      else
+        g_string_append_c(string, *cur);
+    }
+    g_string_append_c(string, '"');
+  }
+}
+
+static void
+inf_xml_util_write_name(GString* string,
+                        xmlNsPtr ns,
+                        const xmlChar* name)
+{
+  if(ns != NULL && ns->prefix != NULL)
+  {
+    g_string_append(string, (const gchar*)ns->prefix);
+    g_string_append_c(string, ':');
+  }
+
+  g_string_append(string, (const gchar*)name);
+}
+
+/**
+ * inf_xml_util_write_node:
+ * @string: A #GString to append to.
+ * @xml: A #xmlNodePtr.
+ *
+ * Serializes @xml and all its children, and appends the result to @string.
+ * Markup, escaping of special characters, attributes, namespaces and empty
+ * elements are written as by xmlNodeDump() without formatting. Unlike
+ * xmlNodeDump(), non-ASCII characters are written as raw UTF-8 instead of
+ * as character references, which parses back to the same tree. The output
+ * is written directly into @string, without requiring @xml to be part of a
+ * document and without going through an intermediate buffer.
+ */
+void
+inf_xml_util_write_node(GString* string,
+                        xmlNodePtr xml)
+{
+  xmlNsPtr ns;
+  xmlAttrPtr attr;
+  xmlNodePtr child;
+
+  g_return_if_fail(string != NULL);
+  g_return_if_fail(xml != NULL);
+
+  switch(xml->type)
+  {
+  case XML_ELEMENT_NODE:
+    g_string_append_c(string, '<');
+    inf_xml_util_write_name(string, xml->ns, xml->name);
+
+    for(ns = xml->nsDef; ns != NULL; ns = ns->next)
+    {
+      if(ns->href == NULL)
+        continue;
+
+      if(ns->prefix != NULL)
+      {
+        g_string_append(string, " xmlns:");
+        g_string_append(string, (const gchar*)ns->prefix);
+        g_string_append_c(string, '=');
+      }
+      else
+      {
+        g_string_append(string, " xmlns=");
+      }
+
+      inf_xml_util_write_quoted(string, ns->href);
+    }
+
+    for(attr = xml->properties; attr != NULL; attr = attr->next)
+    {
+      g_string_append_c(string, ' ');
+      inf_xml_util_write_name(string, attr->ns, attr->name);
+      g_string_append(string, "=\"");
+
+      for(child = attr->children; child != NULL; child = child->next)
+      {
+        if(child->type == XML_TEXT_NODE && child->content != NULL)
+        {
+          inf_xml_util_write_escaped(string, child->content, TRUE);
+        }
+        else if(child->type == XML_ENTITY_REF_NODE)
+        {
+          g_string_append_c(string, '&');
+          g_string_append(string, (const gchar*)child->name);
+          g_string_append_c(string, ';');
+        }
+      }
+
+      g_string_append_c(string, '"');
+    }
+
+    if(xml->children == NULL)
+    {
+      g_string_append(string, "/>");
+    }
+    else
+    {
+      g_string_append_c(string, '>');
+
+      for(child = xml->children; child != NULL; child = child->next)
+        inf_xml_util_write_node(string, child);
+
+      g_string_append(string, "</");
+      inf_xml_util_write_name(string, xml->ns, xml->name);
+      g_string_append_c(string, '>');
+    }
+
+    break;
+  case XML_TEXT_NODE:
+    if(xml->content != NULL)
+      inf_xml_util_write_escaped(string, xml->content, FALSE);
+
+    break;
+  case XML_CDATA_SECTION_NODE:
+    g_string_append(string, "<![CDATA[");
+    if(xml->content != NULL)
+      g_string_append(string, (const gchar*)xml->content);
+    g_string_append(string, "]]>");
+    break;
+  case XML_ENTITY_REF_NODE:
+    g_string_append_c(string, '&');
+    g_string_append(string, (const gchar*)xml->name);
+    g_string_append_c(string, ';');
+    break;
+  case XML_COMMENT_NODE:
+    g_string_append(string, "<!--");
+    if(xml->content != NULL)
+      g_string_append(string, (const gchar*)xml->content);
+    g_string_append(string, "-->");
+    break;
+  case XML_PI_NODE:
+    g_string_append(string, "<?");
+    g_string_append(string, (const gchar*)xml->name);
+    if(xml->content != NULL)
+    {
+      g_string_append_c(string, ' ');
+      g_string_append(string, (const gchar*)xml->content);
+    }
+    g_string_append(string, "?>");
+    break;
+  default:
+    /* Other node types do not occur within XMPP stanzas */
+    break;
+  }
+}
+
+/**
+ * inf_xml_util_serialize_node:
+ * @xml: A #xmlNodePtr.
+ *
+ * Serializes @xml and all its children into a string of bytes, in the same
+ * way as it would be transmitted over an #InfXmlConnection. The result can
+ * be passed to inf_xml_connection_send_serialized() for each connection the
+ * message is sent to, so that it needs to be serialized only once.
+ *
+ * Returns: (transfer full): A new #GBytes containing the serialized form of
+ * @xml. Free with g_bytes_unref() when no longer needed.
+ */
+GBytes*
+inf_xml_util_serialize_node(xmlNodePtr xml)
+{
+  GString* string;
+
+  g_return_val_if_fail(xml != NULL, NULL);
+
+  string = g_string_sized_new(256);
+  inf_xml_util_write_node(string, xml);
+  return g_string_free_to_bytes(string);
+}
+
 /* vim:set et sw=2 ts=2: */
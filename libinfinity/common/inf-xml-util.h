@@ -143,6 +143,13 @@ inf_xml_util_new_node_from_error(GError* error,
 GError*
 inf_xml_util_new_error_from_node(xmlNodePtr xml);
 
+void
+inf_xml_util_write_node(GString* string,
+                        xmlNodePtr xml);
+
+GBytes*
+inf_xml_util_serialize_node(xmlNodePtr xml);
+
 G_END_DECLS
 
 #endif /* __INF_XML_UTIL_H__ */
@@ -33,9 +33,18 @@
  * not need to adhere to the XMPP standard. It is in the responsibility of the
  * user of this class to send only XML message that the remote counterpart can
  * understand.
+ *
+ * Stream compression as defined by XEP-0138 is negotiated on the stream
+ * that is restarted after authentication if both sites set a non-zero
+ * #InfXmppConnection:compression-level. Each site compresses its outgoing
+ * data with its own level. A client that is going to request compression
+ * declares the compression namespace in its restarted stream header, and
+ * the server only offers compression to such clients, since it does not
+ * report the connection as open before the client has done so.
  **/
 
 #include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection-private.h>
 #include <libinfinity/common/inf-xml-connection.h>
 #include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/common/inf-ip-address.h>
@@ -53,6 +62,14 @@
 
 #include "config.h"
 
+#ifdef HAVE_ZLIB
+# include <zlib.h>
+#endif
+
+/* XEP-0138 namespace of <compress>, <compressed> and <failure> */
+static const gchar inf_xmpp_connection_compress_ns[] =
+  "http://jabber.org/protocol/compress";
+
 static const GEnumValue inf_xmpp_connection_site_values[] = {
   {
     INF_XMPP_CONNECTION_CLIENT,
@@ -118,6 +135,8 @@ typedef enum _InfXmppConnectionStatus {
   INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES,
   /* <starttls> request has been sent (client only) */
   INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED,
+  /* <compress> request has been sent (client only) */
+  INF_XMPP_CONNECTION_COMPRESSION_REQUESTED,
   /* TLS handshake is being performed */
   INF_XMPP_CONNECTION_HANDSHAKING,
   /* SASL authentication is in progress */
@@ -170,9 +189,8 @@ struct _InfXmppConnectionPrivate {
    * waiting for being sent. */
   guint position;
 
-  /* Message queue */
-  xmlDocPtr doc;
-  xmlBufferPtr buf;
+  /* Message queue. Outgoing messages are serialized into buf. */
+  GString* buf;
   InfXmppConnectionMessage* messages;
   InfXmppConnectionMessage* last_message;
 
@@ -198,6 +216,14 @@ struct _InfXmppConnectionPrivate {
   gchar* sasl_remote_mechanisms;
 
   GError* sasl_error;
+
+  /* Stream compression (XEP-0138) */
+  guint compression_level;
+#ifdef HAVE_ZLIB
+  z_stream* deflate_stream;
+  z_stream* inflate_stream;
+  GByteArray* compressed_buf;
+#endif
 };
 
 enum {
@@ -215,6 +241,8 @@ enum {
   PROP_SASL_CONTEXT,
   PROP_SASL_MECHANISMS,
 
+  PROP_COMPRESSION_LEVEL,
+
   /* From InfXmlConnection */
   PROP_STATUS,
   PROP_NETWORK,
@@ -663,6 +691,28 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
     g_object_notify(G_OBJECT(xmpp), "tls-enabled");
   }
 
+#ifdef HAVE_ZLIB
+  if(priv->deflate_stream != NULL)
+  {
+    deflateEnd(priv->deflate_stream);
+    g_slice_free(z_stream, priv->deflate_stream);
+    priv->deflate_stream = NULL;
+  }
+
+  if(priv->inflate_stream != NULL)
+  {
+    inflateEnd(priv->inflate_stream);
+    g_slice_free(z_stream, priv->inflate_stream);
+    priv->inflate_stream = NULL;
+  }
+
+  if(priv->compressed_buf != NULL)
+  {
+    g_byte_array_unref(priv->compressed_buf);
+    priv->compressed_buf = NULL;
+  }
+#endif
+
   if(priv->parser != NULL)
   {
     xmlFreeParserCtxt(priv->parser);
@@ -681,13 +731,8 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
 
   if(priv->buf != NULL)
   {
-    g_assert(priv->doc != NULL);
-
-    xmlBufferFree(priv->buf);
-    xmlFreeDoc(priv->doc);
-
+    g_string_free(priv->buf, TRUE);
     priv->buf = NULL;
-    priv->doc = NULL;
   }
 
   priv->pull_data = NULL;
@@ -696,10 +741,110 @@ inf_xmpp_connection_clear(InfXmppConnection* xmpp)
   g_object_thaw_notify(G_OBJECT(xmpp));
 }
 
+static gboolean
+inf_xmpp_connection_compression_active(InfXmppConnection* xmpp)
+{
+#ifdef HAVE_ZLIB
+  return INF_XMPP_CONNECTION_PRIVATE(xmpp)->deflate_stream != NULL;
+#else
+  return FALSE;
+#endif
+}
+
+/* Returns whether we use stream compression if the remote site supports
+ * it. Without zlib support, we neither offer nor request it. */
+static gboolean
+inf_xmpp_connection_wants_compression(InfXmppConnection* xmpp)
+{
+#ifdef HAVE_ZLIB
+  return INF_XMPP_CONNECTION_PRIVATE(xmpp)->compression_level > 0 &&
+         !inf_xmpp_connection_compression_active(xmpp);
+#else
+  return FALSE;
+#endif
+}
+
+#ifdef HAVE_ZLIB
+/* Sets up zlib streams for both directions. Everything sent and received
+ * after this call is compressed. */
+static gboolean
+inf_xmpp_connection_compression_init(InfXmppConnection* xmpp)
+{
+  InfXmppConnectionPrivate* priv;
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+  g_assert(priv->deflate_stream == NULL);
+  g_assert(priv->inflate_stream == NULL);
+
+  priv->deflate_stream = g_slice_new0(z_stream);
+  if(deflateInit(priv->deflate_stream, priv->compression_level) != Z_OK)
+  {
+    g_slice_free(z_stream, priv->deflate_stream);
+    priv->deflate_stream = NULL;
+    return FALSE;
+  }
+
+  priv->inflate_stream = g_slice_new0(z_stream);
+  if(inflateInit(priv->inflate_stream) != Z_OK)
+  {
+    deflateEnd(priv->deflate_stream);
+    g_slice_free(z_stream, priv->deflate_stream);
+    g_slice_free(z_stream, priv->inflate_stream);
+    priv->deflate_stream = NULL;
+    priv->inflate_stream = NULL;
+    return FALSE;
+  }
+
+  priv->compressed_buf = g_byte_array_sized_new(4096);
+  return TRUE;
+}
+
+/* Compresses data into priv->compressed_buf. Each call is terminated with
+ * a sync flush, so that the remote site can decompress everything we have
+ * sent so far. */
 static void
-inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
-                               gconstpointer data,
-                               guint len)
+inf_xmpp_connection_compress(InfXmppConnection* xmpp,
+                             gconstpointer data,
+                             guint len)
+{
+  InfXmppConnectionPrivate* priv;
+  z_stream* stream;
+  guint offset;
+  int ret;
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  stream = priv->deflate_stream;
+
+  stream->next_in = (Bytef*)data;
+  stream->avail_in = len;
+
+  do
+  {
+    offset = priv->compressed_buf->len;
+    g_byte_array_set_size(priv->compressed_buf, offset + len / 2 + 64);
+
+    stream->next_out = priv->compressed_buf->data + offset;
+    stream->avail_out = priv->compressed_buf->len - offset;
+
+    ret = deflate(stream, Z_SYNC_FLUSH);
+    g_assert(ret == Z_OK || ret == Z_BUF_ERROR);
+
+    g_byte_array_set_size(
+      priv->compressed_buf,
+      priv->compressed_buf->len - stream->avail_out
+    );
+  } while(stream->avail_out == 0);
+}
+#endif
+
+/* If bytes is non-NULL, then data and len refer to its content, and it is
+ * handed to the TCP connection without copying it if the connection is
+ * neither encrypted nor compressed. */
+static void
+inf_xmpp_connection_send_data(InfXmppConnection* xmpp,
+                              GBytes* bytes,
+                              gconstpointer data,
+                              guint len)
 {
   InfXmppConnectionPrivate* priv;
   ssize_t cur_bytes;
@@ -719,6 +864,16 @@ inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
    * until the gntuls_record_send() call finishes. */
   ++priv->parsing;
 
+#ifdef HAVE_ZLIB
+  if(priv->deflate_stream != NULL)
+  {
+    inf_xmpp_connection_compress(xmpp, data, len);
+    bytes = NULL;
+    data = priv->compressed_buf->data;
+    len = priv->compressed_buf->len;
+  }
+#endif
+
   if(priv->session != NULL)
   {
     do
@@ -755,9 +910,18 @@ inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
   else
   {
     priv->position += len;
-    inf_tcp_connection_send(priv->tcp, data, len);
+    if(bytes != NULL)
+      inf_tcp_connection_send_bytes(priv->tcp, bytes);
+    else
+      inf_tcp_connection_send(priv->tcp, data, len);
   }
 
+#ifdef HAVE_ZLIB
+  /* Both GnuTLS and the TCP connection have copied the data by now */
+  if(priv->compressed_buf != NULL)
+    g_byte_array_set_size(priv->compressed_buf, 0);
+#endif
+
   g_assert(priv->parsing > 0);
   if(--priv->parsing == 0)
   {
@@ -773,6 +937,14 @@ inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
   }
 }
 
+static void
+inf_xmpp_connection_send_chars(InfXmppConnection* xmpp,
+                               gconstpointer data,
+                               guint len)
+{
+  inf_xmpp_connection_send_data(xmpp, NULL, data, len);
+}
+
 static void
 inf_xmpp_connection_send_xml(InfXmppConnection* xmpp,
                              xmlNodePtr xml)
@@ -780,13 +952,9 @@ inf_xmpp_connection_send_xml(InfXmppConnection* xmpp,
   InfXmppConnectionPrivate* priv;
   priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
 
-  g_return_if_fail(priv->doc != NULL);
   g_return_if_fail(priv->buf != NULL);
 
-  xmlDocSetRootElement(priv->doc, xml);
-  xmlNodeDump(priv->buf, priv->doc, xml, 0, 0);
-  xmlUnlinkNode(xml);
-  xmlSetListDoc(xml, NULL);
+  inf_xml_util_write_node(priv->buf, xml);
 
   /* Keep the object alive during the send_chars call, so that we can check
    * the buffer variable afterwards. */
@@ -794,15 +962,15 @@ inf_xmpp_connection_send_xml(InfXmppConnection* xmpp,
 
   inf_xmpp_connection_send_chars(
     xmpp,
-    xmlBufferContent(priv->buf),
-    xmlBufferLength(priv->buf)
+    priv->buf->str,
+    priv->buf->len
   );
 
   /* The connection might be closed & cleared as a result from
    * inf_xmpp_connection_send_chars(), so make sure the buffer still
    * exists before emptying it. */
   if(priv->buf != NULL)
-    xmlBufferEmpty(priv->buf);
+    g_string_truncate(priv->buf, 0);
 
   g_object_unref(xmpp);
 }
@@ -847,6 +1015,60 @@ inf_xmpp_connection_node_new_sasl(const gchar* name)
   );
 }
 
+static xmlNodePtr
+inf_xmpp_connection_node_new_compress(const gchar* name)
+{
+  return inf_xmpp_connection_node_new(name, inf_xmpp_connection_compress_ns);
+}
+
+#ifdef HAVE_ZLIB
+/* Checks whether a <compression> feature or a <compress> request contains
+ * the given compression method. */
+static gboolean
+inf_xmpp_connection_has_compression_method(xmlNodePtr xml,
+                                           const gchar* method)
+{
+  xmlNodePtr child;
+
+  for(child = xml->children; child != NULL; child = child->next)
+  {
+    if(strcmp((const gchar*)child->name, "method") == 0 &&
+       child->children != NULL &&
+       child->children->content != NULL &&
+       strcmp((const gchar*)child->children->content, method) == 0)
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+/* Checks whether the attributes of a client's <stream:stream> declare the
+ * compression namespace. A client does so if it is going to request
+ * compression when the server offers it. */
+static gboolean
+inf_xmpp_connection_stream_announces_compression(const xmlChar** attrs)
+{
+  const xmlChar** attr;
+
+  if(attrs == NULL)
+    return FALSE;
+
+  for(attr = attrs; attr[0] != NULL; attr += 2)
+  {
+    if(strncmp((const gchar*)attr[0], "xmlns:", 6) == 0 &&
+       attr[1] != NULL &&
+       strcmp((const gchar*)attr[1], inf_xmpp_connection_compress_ns) == 0)
+    {
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+#endif
+
 /*
  * XMPP deinitialization
  */
@@ -1930,6 +2152,10 @@ inf_xmpp_connection_process_connected(InfXmppConnection* xmpp,
 
   xmlNodePtr features;
   xmlNodePtr starttls;
+#ifdef HAVE_ZLIB
+  xmlNodePtr compression;
+#endif
+  gboolean offer_compression;
   xmlNodePtr mechanisms;
   xmlNodePtr mechanism;
   gchar* mechanism_dup;
@@ -1979,6 +2205,35 @@ inf_xmpp_connection_process_connected(InfXmppConnection* xmpp,
     }
   }
 
+  /* Offer compression on the stream restarted after authentication, as
+   * recommended by XEP-0138. We then need to wait for the <compress> request
+   * before reporting the connection as open, so only offer it to clients
+   * that announced in their stream header that they are going to send
+   * one. */
+  offer_compression = FALSE;
+#ifdef HAVE_ZLIB
+  if(priv->status == INF_XMPP_CONNECTION_AUTH_INITIATED &&
+     inf_xmpp_connection_wants_compression(xmpp) &&
+     inf_xmpp_connection_stream_announces_compression(attrs))
+  {
+    offer_compression = TRUE;
+
+    compression = inf_xmpp_connection_node_new(
+      "compression",
+      "http://jabber.org/features/compress"
+    );
+
+    xmlNewChild(
+      compression,
+      NULL,
+      (const xmlChar*)"method",
+      (const xmlChar*)"zlib"
+    );
+
+    xmlAddChild(features, compression);
+  }
+#endif
+
   if(priv->status == INF_XMPP_CONNECTION_INITIATED)
   {
     /* Not yet authenticated, so give the client a list of authentication
@@ -2061,9 +2316,91 @@ inf_xmpp_connection_process_connected(InfXmppConnection* xmpp,
   inf_xmpp_connection_send_xml(xmpp, features);
   xmlFreeNode(features);
 
+  /* Authentication done, <stream:features> sent. Session is ready, unless
+   * we wait for the client to request compression. */
+  if(priv->status == INF_XMPP_CONNECTION_AUTH_INITIATED && !offer_compression)
+  {
+    priv->status = INF_XMPP_CONNECTION_READY;
+    g_object_notify(G_OBJECT(xmpp), "status");
+  }
+}
+
+/* Handles the client's reply to the <compression> feature offered after
+ * authentication */
+static void
+inf_xmpp_connection_process_compress(InfXmppConnection* xmpp,
+                                     xmlNodePtr xml)
+{
+  InfXmppConnectionPrivate* priv;
+  xmlNodePtr reply;
+#ifdef HAVE_ZLIB
+  GError* error;
+#endif
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  g_assert(priv->site == INF_XMPP_CONNECTION_SERVER);
+  g_assert(priv->status == INF_XMPP_CONNECTION_AUTH_INITIATED);
+
+  if(strcmp((const gchar*)xml->name, "compress") != 0)
+  {
+    /* The client announced a compression request but sent something else.
+     * Go on without compression, and process the message as usual. */
+    priv->status = INF_XMPP_CONNECTION_READY;
+    g_object_notify(G_OBJECT(xmpp), "status");
+
+    if(priv->status == INF_XMPP_CONNECTION_READY)
+      inf_xml_connection_received(INF_XML_CONNECTION(xmpp), xml);
+
+    return;
+  }
+
+#ifdef HAVE_ZLIB
+  if(inf_xmpp_connection_has_compression_method(xml, "zlib"))
+  {
+    /* This is the last thing we send uncompressed */
+    reply = inf_xmpp_connection_node_new_compress("compressed");
+    inf_xmpp_connection_send_xml(xmpp, reply);
+    xmlFreeNode(reply);
+
+    /* Sending might have failed */
+    if(priv->status != INF_XMPP_CONNECTION_AUTH_INITIATED)
+      return;
+
+    if(inf_xmpp_connection_compression_init(xmpp))
+    {
+      /* The client restarts the stream on top of the compressed
+       * connection. We are within an XML callback here, so the new stream
+       * is set up in received_cb(), as after authentication. */
+      priv->status = INF_XMPP_CONNECTION_AUTH_CONNECTED;
+    }
+    else
+    {
+      error = NULL;
+      g_set_error_literal(
+        &error,
+        inf_xmpp_connection_error_quark(),
+        INF_XMPP_CONNECTION_ERROR_COMPRESSION_FAILURE,
+        _("Failed to initialize stream compression")
+      );
+
+      inf_xml_connection_error(INF_XML_CONNECTION(xmpp), error);
+      g_error_free(error);
+
+      inf_xmpp_connection_terminate(xmpp);
+    }
+
+    return;
+  }
+#endif
+
+  reply = inf_xmpp_connection_node_new_compress("failure");
+  xmlNewChild(reply, NULL, (const xmlChar*)"unsupported-method", NULL);
+  inf_xmpp_connection_send_xml(xmpp, reply);
+  xmlFreeNode(reply);
+
+  /* The client goes on without compression */
   if(priv->status == INF_XMPP_CONNECTION_AUTH_INITIATED)
   {
-    /* Authentication done, <stream:features> sent. Session is ready. */
     priv->status = INF_XMPP_CONNECTION_READY;
     g_object_notify(G_OBJECT(xmpp), "status");
   }
@@ -2307,6 +2644,50 @@ inf_xmpp_connection_sasl_suggest_mechanism(InfXmppConnection* xmpp,
   return suggestion;
 }
 
+/* Sends a <compress> request if the server offers zlib compression and we
+ * want to use it. Returns TRUE if the request was sent. */
+static gboolean
+inf_xmpp_connection_request_compression(InfXmppConnection* xmpp,
+                                        xmlNodePtr features)
+{
+#ifdef HAVE_ZLIB
+  InfXmppConnectionPrivate* priv;
+  xmlNodePtr child;
+  xmlNodePtr compress;
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  g_assert(priv->site == INF_XMPP_CONNECTION_CLIENT);
+  g_assert(priv->status == INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES);
+
+  if(!inf_xmpp_connection_wants_compression(xmpp))
+    return FALSE;
+
+  for(child = features->children; child != NULL; child = child->next)
+    if(strcmp((const gchar*)child->name, "compression") == 0)
+      break;
+
+  if(child == NULL ||
+     !inf_xmpp_connection_has_compression_method(child, "zlib"))
+  {
+    return FALSE;
+  }
+
+  compress = inf_xmpp_connection_node_new_compress("compress");
+  xmlNewChild(compress, NULL, (const xmlChar*)"method", (const xmlChar*)"zlib");
+  inf_xmpp_connection_send_xml(xmpp, compress);
+  xmlFreeNode(compress);
+
+  /* Sending might have failed, in which case there is nothing to go on
+   * with. */
+  if(priv->status == INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES)
+    priv->status = INF_XMPP_CONNECTION_COMPRESSION_REQUESTED;
+
+  return TRUE;
+#else
+  return FALSE;
+#endif
+}
+
 static void
 inf_xmpp_connection_process_features(InfXmppConnection* xmpp,
                                      xmlNodePtr xml)
@@ -2434,8 +2815,13 @@ inf_xmpp_connection_process_features(InfXmppConnection* xmpp,
   }
   else if(priv->status == INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES)
   {
-    priv->status = INF_XMPP_CONNECTION_READY;
-    g_object_notify(G_OBJECT(xmpp), "status");
+    /* The session is ready once the server replied to the compression
+     * request, if we made one. */
+    if(!inf_xmpp_connection_request_compression(xmpp, xml))
+    {
+      priv->status = INF_XMPP_CONNECTION_READY;
+      g_object_notify(G_OBJECT(xmpp), "status");
+    }
   }
 }
 
@@ -2478,6 +2864,61 @@ inf_xmpp_connection_process_encryption(InfXmppConnection* xmpp,
   }
 }
 
+static void
+inf_xmpp_connection_process_compression(InfXmppConnection* xmpp,
+                                        xmlNodePtr xml)
+{
+  InfXmppConnectionPrivate* priv;
+#ifdef HAVE_ZLIB
+  GError* error;
+#endif
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+  g_assert(priv->site == INF_XMPP_CONNECTION_CLIENT);
+  g_assert(priv->status == INF_XMPP_CONNECTION_COMPRESSION_REQUESTED);
+
+  if(strcmp((const gchar*)xml->name, "compressed") == 0)
+  {
+#ifdef HAVE_ZLIB
+    if(inf_xmpp_connection_compression_init(xmpp))
+    {
+      /* We are within an XML callback here, so restart the stream in
+       * received_cb(), as after authentication. */
+      priv->status = INF_XMPP_CONNECTION_AUTH_CONNECTED;
+    }
+    else
+    {
+      error = NULL;
+      g_set_error_literal(
+        &error,
+        inf_xmpp_connection_error_quark(),
+        INF_XMPP_CONNECTION_ERROR_COMPRESSION_FAILURE,
+        _("Failed to initialize stream compression")
+      );
+
+      inf_xml_connection_error(INF_XML_CONNECTION(xmpp), error);
+      g_error_free(error);
+
+      inf_xmpp_connection_terminate(xmpp);
+    }
+#else
+    /* We never request compression without zlib support */
+    g_assert_not_reached();
+#endif
+  }
+  else if(strcmp((const gchar*)xml->name, "failure") == 0)
+  {
+    /* Compression is optional, so go on without it */
+    priv->status = INF_XMPP_CONNECTION_READY;
+    g_object_notify(G_OBJECT(xmpp), "status");
+  }
+  else
+  {
+    /* We got neither 'compressed' nor 'failure'. Ignore and wait for
+     * either of them. */
+  }
+}
+
 static void
 inf_xmpp_connection_process_authentication_error(
   InfXmppConnection* xmpp,
@@ -2698,6 +3139,11 @@ inf_xmpp_connection_process_end_element(InfXmppConnection* xmpp,
         g_assert(priv->site == INF_XMPP_CONNECTION_CLIENT);
         inf_xmpp_connection_process_encryption(xmpp, priv->root);
         break;
+      case INF_XMPP_CONNECTION_COMPRESSION_REQUESTED:
+        /* This is a client-only state */
+        g_assert(priv->site == INF_XMPP_CONNECTION_CLIENT);
+        inf_xmpp_connection_process_compression(xmpp, priv->root);
+        break;
       case INF_XMPP_CONNECTION_AUTHENTICATING:
         inf_xmpp_connection_process_authentication(xmpp, priv->root);
         break;
@@ -2712,8 +3158,12 @@ inf_xmpp_connection_process_end_element(InfXmppConnection* xmpp,
       case INF_XMPP_CONNECTION_AUTH_INITIATED:
         /* The client should be waiting for <stream:stream> from the server
          * in this state, and sax_end_element should not have called this
-         * function. Also, this is a client-only state (the server goes
-         * directly to READY after having received <stream:stream>). */
+         * function. The server only stays in this state after having
+         * received <stream:stream> if it offered compression, in which case
+         * it waits for the client's <compress> request. */
+        g_assert(priv->site == INF_XMPP_CONNECTION_SERVER);
+        inf_xmpp_connection_process_compress(xmpp, priv->root);
+        break;
       case INF_XMPP_CONNECTION_CONNECTING:
       case INF_XMPP_CONNECTION_CONNECTED:
       case INF_XMPP_CONNECTION_AUTH_CONNECTED:
@@ -2803,6 +3253,7 @@ inf_xmpp_connection_sax_start_element(void* context,
   case INF_XMPP_CONNECTION_AWAITING_FEATURES:
   case INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES:
   case INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED:
+  case INF_XMPP_CONNECTION_COMPRESSION_REQUESTED:
   case INF_XMPP_CONNECTION_AUTHENTICATING:
   case INF_XMPP_CONNECTION_READY:
     inf_xmpp_connection_process_start_element(xmpp, name, attrs);
@@ -2868,6 +3319,7 @@ inf_xmpp_connection_sax_end_element(void* context,
     case INF_XMPP_CONNECTION_AWAITING_FEATURES:
     case INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES:
     case INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED:
+    case INF_XMPP_CONNECTION_COMPRESSION_REQUESTED:
     case INF_XMPP_CONNECTION_READY:
       /* Also terminate stream in these states */
       inf_xmpp_connection_terminate(xmpp);
@@ -3046,6 +3498,14 @@ inf_xmpp_connection_initiate(InfXmppConnection* xmpp)
     "<stream:stream version=\"1.0\" xmlns=\"jabber:client\" "
     "xmlns:stream=\"http://etherx.jabber.org/streams\" to=\"%s\">";
 
+  /* Declares the compression namespace to announce that we request
+   * compression when it is offered, see
+   * inf_xmpp_connection_process_connected(). */
+  static const gchar xmpp_connection_compress_request[] =
+    "<stream:stream version=\"1.0\" xmlns=\"jabber:client\" "
+    "xmlns:stream=\"http://etherx.jabber.org/streams\" to=\"%s\" "
+    "xmlns:compress=\"%s\">";
+
   InfXmppConnectionPrivate* priv;
   gchar* request;
 
@@ -3066,17 +3526,26 @@ inf_xmpp_connection_initiate(InfXmppConnection* xmpp)
 
   /* Create XML buffer for outgoing data */
   if(priv->buf == NULL)
-  {
-    priv->buf = xmlBufferCreate();
-    priv->doc = xmlNewDoc((const xmlChar*)"1.0");
-  }
+    priv->buf = g_string_sized_new(1024);
 
   if(priv->site == INF_XMPP_CONNECTION_CLIENT)
   {
-    request = g_strdup_printf(
-      xmpp_connection_initial_request,
-      priv->remote_hostname
-    );
+    if(priv->status == INF_XMPP_CONNECTION_AUTH_CONNECTED &&
+       inf_xmpp_connection_wants_compression(xmpp))
+    {
+      request = g_strdup_printf(
+        xmpp_connection_compress_request,
+        priv->remote_hostname,
+        inf_xmpp_connection_compress_ns
+      );
+    }
+    else
+    {
+      request = g_strdup_printf(
+        xmpp_connection_initial_request,
+        priv->remote_hostname
+      );
+    }
 
     inf_xmpp_connection_send_chars(xmpp, request, strlen(request));
     g_free(request);
@@ -3171,6 +3640,82 @@ inf_xmpp_connection_sent_cb(InfTcpConnection* tcp,
   g_object_unref(G_OBJECT(xmpp));
 }
 
+/* Feeds data received from the remote site into the XML parser, after
+ * decompressing it if stream compression is enabled. */
+static void
+inf_xmpp_connection_parse(InfXmppConnection* xmpp,
+                          gconstpointer data,
+                          gsize len)
+{
+  InfXmppConnectionPrivate* priv;
+#ifdef HAVE_ZLIB
+  gchar buffer[16384];
+  z_stream* stream;
+  gsize produced;
+  GError* error;
+  int ret;
+#endif
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(xmpp);
+
+#ifdef HAVE_ZLIB
+  if(priv->inflate_stream != NULL)
+  {
+    /* The stream is kept alive while parsing, even if the connection is
+     * closed from within an XML callback. */
+    stream = priv->inflate_stream;
+    stream->next_in = (Bytef*)data;
+    stream->avail_in = len;
+
+    do
+    {
+      stream->next_out = (Bytef*)buffer;
+      stream->avail_out = sizeof(buffer);
+
+      ret = inflate(stream, Z_SYNC_FLUSH);
+      if(ret != Z_OK && ret != Z_BUF_ERROR)
+      {
+        error = NULL;
+        g_set_error_literal(
+          &error,
+          inf_xmpp_connection_error_quark(),
+          INF_XMPP_CONNECTION_ERROR_COMPRESSION_FAILURE,
+          _("Failed to decompress data received from the remote site")
+        );
+
+        inf_xml_connection_error(INF_XML_CONNECTION(xmpp), error);
+        g_error_free(error);
+
+        /* The stream cannot be recovered, so we cannot send a final
+         * </stream:stream> either. */
+        inf_tcp_connection_close(priv->tcp);
+        return;
+      }
+
+      produced = sizeof(buffer) - stream->avail_out;
+      if(produced > 0)
+      {
+        if(INF_XMPP_CONNECTION_PRINT_TRAFFIC)
+          printf("\033[00;33m%.*s\033[00;00m\n", (int)produced, buffer);
+        xmlParseChunk(priv->parser, buffer, produced, 0);
+
+        /* If the callback made us disconnect then don't try to read
+         * more data. */
+        if(priv->status == INF_XMPP_CONNECTION_CLOSING_GNUTLS ||
+           priv->status == INF_XMPP_CONNECTION_CLOSED)
+        {
+          return;
+        }
+      }
+    } while(stream->avail_in > 0 || stream->avail_out == 0);
+
+    return;
+  }
+#endif
+
+  xmlParseChunk(priv->parser, data, len, 0);
+}
+
 static void
 inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
                                 gconstpointer data,
@@ -3179,7 +3724,8 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
 {
   InfXmppConnection* xmpp;
   InfXmppConnectionPrivate* priv;
-  gchar buffer[2048];
+  /* Large enough to hold a full TLS record */
+  gchar buffer[16384];
   ssize_t res;
   GError* error;
   gboolean receiving;
@@ -3229,7 +3775,7 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
       while(receiving && (priv->pull_len > 0 ||
                           gnutls_record_check_pending(priv->session) > 0))
       {
-        res = gnutls_record_recv(priv->session, buffer, 2048);
+        res = gnutls_record_recv(priv->session, buffer, sizeof(buffer));
         if(res < 0)
         {
           /* Just try again if we were interrupted */
@@ -3257,9 +3803,13 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
         else
         {
           /* Feed decoded data into XML parser */
-          if(INF_XMPP_CONNECTION_PRINT_TRAFFIC)
+          if(INF_XMPP_CONNECTION_PRINT_TRAFFIC &&
+             !inf_xmpp_connection_compression_active(xmpp))
+          {
             printf("\033[00;32m%.*s\033[00;00m\n", (int)res, buffer);
-          xmlParseChunk(priv->parser, buffer, res, 0);
+          }
+
+          inf_xmpp_connection_parse(xmpp, buffer, res);
 
           /* If the callback changed made us disconnect then don't try
            * to read more data. */
@@ -3274,9 +3824,13 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
     else
     {
       /* Feed input directly into XML parser */
-      if(INF_XMPP_CONNECTION_PRINT_TRAFFIC)
+      if(INF_XMPP_CONNECTION_PRINT_TRAFFIC &&
+         !inf_xmpp_connection_compression_active(xmpp))
+      {
         printf("\033[00;31m%.*s\033[00;00m\n", (int)len, (const char*)data);
-      xmlParseChunk(priv->parser, data, len, 0);
+      }
+
+      inf_xmpp_connection_parse(xmpp, data, len);
     }
   }
 
@@ -3307,9 +3861,10 @@ inf_xmpp_connection_received_cb(InfTcpConnection* tcp,
     }
     else if(priv->status == INF_XMPP_CONNECTION_AUTH_CONNECTED)
     {
-      /* Reinitiate connection after successful authentication */
+      /* Reinitiate connection after successful authentication, or after
+       * stream compression has been enabled. */
       /* TODO: Only do this if status at the beginning of this call was
-       * AUTHENTICATING */
+       * AUTHENTICATING or one of the compression states */
       inf_xmpp_connection_initiate(xmpp);
     }
   }
@@ -3366,7 +3921,7 @@ inf_xmpp_connection_notify_status_cb(InfTcpConnection* tcp,
       g_assert(priv->session == NULL);
       g_assert(priv->messages == NULL);
       g_assert(priv->parser == NULL);
-      g_assert(priv->doc == NULL);
+      g_assert(priv->buf == NULL);
       g_assert(priv->position == 0);
       g_assert(priv->sasl_session == NULL);
     }
@@ -3445,11 +4000,7 @@ inf_xmpp_connection_set_tcp(InfXmppConnection* xmpp,
       xmpp
     );
 
-    inf_signal_handlers_disconnect_by_func(
-      G_OBJECT(priv->tcp),
-      G_CALLBACK(inf_xmpp_connection_received_cb),
-      xmpp
-    );
+    _inf_tcp_connection_set_received_func(priv->tcp, NULL, NULL);
 
     inf_signal_handlers_disconnect_by_func(
       G_OBJECT(priv->tcp),
@@ -3479,10 +4030,11 @@ inf_xmpp_connection_set_tcp(InfXmppConnection* xmpp,
       xmpp
     );
 
-    g_signal_connect(
-      G_OBJECT(tcp),
-      "received",
-      G_CALLBACK(inf_xmpp_connection_received_cb),
+    /* Received data is passed to us directly, without the overhead of a
+     * signal emission for every read. */
+    _inf_tcp_connection_set_received_func(
+      tcp,
+      inf_xmpp_connection_received_cb,
       xmpp
     );
 
@@ -3542,6 +4094,7 @@ inf_xmpp_connection_get_xml_status(InfXmppConnection* xmpp)
   case INF_XMPP_CONNECTION_AWAITING_FEATURES:
   case INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES:
   case INF_XMPP_CONNECTION_ENCRYPTION_REQUESTED:
+  case INF_XMPP_CONNECTION_COMPRESSION_REQUESTED:
   case INF_XMPP_CONNECTION_HANDSHAKING:
   case INF_XMPP_CONNECTION_AUTHENTICATING:
     return INF_XML_CONNECTION_OPENING;
@@ -3614,7 +4167,6 @@ inf_xmpp_connection_init(InfXmppConnection* connection)
   priv->root = NULL;
   priv->cur = NULL;
 
-  priv->doc = NULL;
   priv->buf = NULL;
 
   priv->session = NULL;
@@ -3630,6 +4182,13 @@ inf_xmpp_connection_init(InfXmppConnection* connection)
   priv->sasl_local_mechanisms = NULL;
   priv->sasl_remote_mechanisms = NULL;
   priv->sasl_error = NULL;
+
+  priv->compression_level = 0;
+#ifdef HAVE_ZLIB
+  priv->deflate_stream = NULL;
+  priv->inflate_stream = NULL;
+  priv->compressed_buf = NULL;
+#endif
 }
 
 static void
@@ -3825,6 +4384,9 @@ inf_xmpp_connection_set_property(GObject* object,
     g_free(priv->sasl_local_mechanisms);
     priv->sasl_local_mechanisms = g_value_dup_string(value);
     break;
+  case PROP_COMPRESSION_LEVEL:
+    priv->compression_level = g_value_get_uint(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -3875,6 +4437,9 @@ inf_xmpp_connection_get_property(GObject* object,
   case PROP_SASL_MECHANISMS:
     g_value_set_string(value, priv->sasl_local_mechanisms);
     break;
+  case PROP_COMPRESSION_LEVEL:
+    g_value_set_uint(value, priv->compression_level);
+    break;
   case PROP_STATUS:
     g_value_set_enum(value, inf_xmpp_connection_get_xml_status(xmpp));
     break;
@@ -4005,6 +4570,7 @@ inf_xmpp_connection_xml_connection_close(InfXmlConnection* connection)
   case INF_XMPP_CONNECTION_AUTH_INITIATED:
   case INF_XMPP_CONNECTION_AWAITING_FEATURES:
   case INF_XMPP_CONNECTION_AUTH_AWAITING_FEATURES:
+  case INF_XMPP_CONNECTION_COMPRESSION_REQUESTED:
   case INF_XMPP_CONNECTION_READY:
     inf_xmpp_connection_deinitiate(INF_XMPP_CONNECTION(connection));
     break;
@@ -4043,6 +4609,48 @@ inf_xmpp_connection_xml_connection_send(InfXmlConnection* connection,
   }
 }
 
+static void
+inf_xmpp_connection_xml_connection_send_serialized(
+  InfXmlConnection* connection,
+  xmlNodePtr xml,
+  GBytes* serialized)
+{
+  InfXmppConnectionPrivate* priv;
+  gconstpointer data;
+  gsize len;
+
+  priv = INF_XMPP_CONNECTION_PRIVATE(connection);
+
+  g_assert(priv->status == INF_XMPP_CONNECTION_READY);
+
+  /* The same serialized message is shared by all connections it is sent to,
+   * so all that is left to do here is to hand it to GnuTLS or the TCP
+   * connection. */
+  data = g_bytes_get_data(serialized, &len);
+  g_assert(len <= G_MAXUINT);
+
+  inf_xmpp_connection_send_data(
+    INF_XMPP_CONNECTION(connection),
+    serialized,
+    data,
+    len
+  );
+
+  if(priv->status == INF_XMPP_CONNECTION_READY)
+  {
+    inf_xmpp_connection_push_message(
+      INF_XMPP_CONNECTION(connection),
+      inf_xmpp_connection_xml_connection_send_sent,
+      inf_xmpp_connection_xml_connection_send_free,
+      xml
+    );
+  }
+  else
+  {
+    xmlFreeNode(xml);
+  }
+}
+
 /*
  * GObject type registration
  */
@@ -4177,6 +4785,21 @@ inf_xmpp_connection_class_init(InfXmppConnectionClass* xmpp_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_COMPRESSION_LEVEL,
+    g_param_spec_uint(
+      "compression-level",
+      "Compression level",
+      "The zlib level used to compress outgoing data, or 0 to neither offer "
+      "nor request stream compression",
+      0,
+      9,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_override_property(object_class, PROP_STATUS, "status");
   g_object_class_override_property(object_class, PROP_NETWORK, "network");
   g_object_class_override_property(object_class, PROP_LOCAL_ID, "local-id");
@@ -4202,6 +4825,8 @@ inf_xmpp_connection_xml_connection_iface_init(
   iface->open = inf_xmpp_connection_xml_connection_open;
   iface->close = inf_xmpp_connection_xml_connection_close;
   iface->send = inf_xmpp_connection_xml_connection_send;
+  iface->send_serialized =
+    inf_xmpp_connection_xml_connection_send_serialized;
 }
 
 /*
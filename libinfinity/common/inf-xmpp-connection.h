@@ -107,6 +107,8 @@ typedef enum _InfXmppConnectionSecurityPolicy {
  * provide any authentication mechanisms.
  * @INF_XMPP_CONNECTION_ERROR_NO_SUITABLE_MECHANISM: The server does not offer
  * a suitable authentication mechanism that is accepted by the client.
+ * @INF_XMPP_CONNECTION_ERROR_COMPRESSION_FAILURE: Stream compression could
+ * not be set up, or received data could not be decompressed.
  * @INF_XMPP_CONNECTION_ERROR_FAILED: General error code for otherwise
  * unknown errors.
  *
@@ -121,6 +123,7 @@ typedef enum _InfXmppConnectionError {
   INF_XMPP_CONNECTION_ERROR_CERTIFICATE_NOT_TRUSTED,
   INF_XMPP_CONNECTION_ERROR_AUTHENTICATION_UNSUPPORTED,
   INF_XMPP_CONNECTION_ERROR_NO_SUITABLE_MECHANISM,
+  INF_XMPP_CONNECTION_ERROR_COMPRESSION_FAILURE,
 
   INF_XMPP_CONNECTION_ERROR_FAILED
 } InfXmppConnectionError;
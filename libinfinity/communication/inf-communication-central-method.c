@@ -32,6 +32,7 @@
 #include <libinfinity/communication/inf-communication-central-method.h>
 #include <libinfinity/communication/inf-communication-hosted-group.h>
 #include <libinfinity/communication/inf-communication-registry.h>
+#include <libinfinity/common/inf-xml-util.h>
 #include <libinfinity/inf-signals.h>
 
 typedef struct _InfCommunicationCentralMethodPrivate
@@ -72,8 +73,10 @@ inf_communication_central_method_broadcast(InfCommunicationMethod* method,
   InfXmlConnection* connection;
   gboolean is_registered;
   InfXmlConnectionStatus status;
+  GBytes* serialized;
 
   priv = INF_COMMUNICATION_CENTRAL_METHOD_PRIVATE(method);
+  serialized = NULL;
 
   /* Each of the inf_communication_registry_send() calls can do a callback
    * which might possibly screw up our connection list completely. So be safe
@@ -108,20 +111,40 @@ inf_communication_central_method_broadcast(InfCommunicationMethod* method,
     {
       if(connections->next != NULL)
       {
+        /* The message is sent to more than one connection, so serialize it
+         * only once, and let all connections share the serialized form. */
+        if(serialized == NULL)
+          serialized = inf_xml_util_serialize_node(xml);
+
         /* Keep ownership of XML if there might be more connections we should
          * send it to. */
-        inf_communication_registry_send(
+        inf_communication_registry_send_serialized(
           registry,
           group,
           connection,
-          xmlCopyNode(xml, 1)
+          xmlCopyNode(xml, 1),
+          serialized
         );
       }
       else
       {
         /* Pass ownership of XML if this is definitely the last connection
          * in the list. */
-        inf_communication_registry_send(registry, group, connection, xml);
+        if(serialized != NULL)
+        {
+          inf_communication_registry_send_serialized(
+            registry,
+            group,
+            connection,
+            xml,
+            serialized
+          );
+        }
+        else
+        {
+          inf_communication_registry_send(registry, group, connection, xml);
+        }
+
         xml = NULL;
       }
     }
@@ -134,6 +157,8 @@ inf_communication_central_method_broadcast(InfCommunicationMethod* method,
   g_object_unref(registry);
   g_object_unref(group);
 
+  if(serialized != NULL)
+    g_bytes_unref(serialized);
   if(xml != NULL)
     xmlFreeNode(xml);
 }
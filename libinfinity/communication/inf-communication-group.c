@@ -778,6 +778,39 @@ inf_communication_group_cancel_messages(InfCommunicationGroup* group,
   inf_communication_method_cancel_messages(method, connection);
 }
 
+/**
+ * inf_communication_group_flush:
+ * @group: A #InfCommunicationGroup.
+ * @connection: (allow-none): The #InfXmlConnection for which to send
+ * messages, or %NULL.
+ *
+ * Sends messages to @connection which are held back to be coalesced with
+ * following messages immediately, see
+ * #InfCommunicationRegistry:coalesce-interval. If @connection is %NULL, then
+ * this is done for all members of @group. Call this after sending messages
+ * for which latency is important.
+ */
+void
+inf_communication_group_flush(InfCommunicationGroup* group,
+                              InfXmlConnection* connection)
+{
+  InfCommunicationGroupPrivate* priv;
+
+  g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
+  g_return_if_fail(connection == NULL || INF_IS_XML_CONNECTION(connection));
+
+  priv = INF_COMMUNICATION_GROUP_PRIVATE(group);
+
+  if(priv->communication_registry != NULL)
+  {
+    inf_communication_registry_flush(
+      priv->communication_registry,
+      group,
+      connection
+    );
+  }
+}
+
 /**
  * inf_communication_group_get_method_for_network:
  * @group: A #InfCommunicationGroup.
@@ -112,6 +112,10 @@ void
 inf_communication_group_cancel_messages(InfCommunicationGroup* group,
                                         InfXmlConnection* connection);
 
+void
+inf_communication_group_flush(InfCommunicationGroup* group,
+                              InfXmlConnection* connection);
+
 const gchar*
 inf_communication_group_get_method_for_network(InfCommunicationGroup* group,
                                                const gchar* network);
@@ -39,8 +39,11 @@
 #include <libinfinity/communication/inf-communication-registry.h>
 #include <libinfinity/communication/inf-communication-group-private.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-io.h>
 #include <libinfinity/inf-signals.h>
 
+#include <libxml/entities.h>
+
 #include <string.h>
 
 /* TODO: Store connection->InfCommunicationRegistryConnection hashtable,
@@ -62,11 +65,18 @@ struct _InfCommunicationRegistryEntry {
   InfCommunicationGroup* group;
   InfCommunicationMethod* method;
 
-  /* Queue of messages to send */
+  /* Queue of messages to send. The _private field of each queued message
+   * holds a reference on its serialized form, or is NULL if it has not been
+   * serialized in advance. */
   guint inner_count;
   xmlNodePtr queue_begin;
   xmlNodePtr queue_end;
 
+  /* Message coalescing. queue_size is the total size of the serialized
+   * messages in the queue. */
+  gsize queue_size;
+  InfIoTimeout* coalesce_timeout;
+
   /* Activation status */
   gboolean registered;
   guint activation_count; /* # messages to be sent until activation */
@@ -87,6 +97,18 @@ typedef struct _InfCommunicationRegistryPrivate
 struct _InfCommunicationRegistryPrivate {
   GHashTable* connections;
   GHashTable* entries;
+
+  InfIo* io;
+  guint coalesce_interval;
+  guint coalesce_size;
+};
+
+enum {
+  PROP_0,
+
+  PROP_IO,
+  PROP_COALESCE_INTERVAL,
+  PROP_COALESCE_SIZE
 };
 
 #define INF_COMMUNICATION_REGISTRY_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_COMMUNICATION_TYPE_REGISTRY, InfCommunicationRegistryPrivate))
@@ -97,6 +119,84 @@ G_DEFINE_TYPE_WITH_CODE(InfCommunicationRegistry, inf_communication_registry, G_
 /* Maximum number of messages enqueued at the same time */
 static const guint INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT = 5;
 
+static void
+inf_communication_registry_free_queue(xmlNodePtr xml)
+{
+  xmlNodePtr cur;
+
+  for(cur = xml; cur != NULL; cur = cur->next)
+  {
+    if(cur->_private != NULL)
+    {
+      g_bytes_unref((GBytes*)cur->_private);
+      cur->_private = NULL;
+    }
+  }
+
+  xmlFreeNodeList(xml);
+}
+
+static void
+inf_communication_registry_append_escaped(GString* string,
+                                          const gchar* value)
+{
+  xmlChar* escaped;
+
+  escaped = xmlEncodeSpecialChars(NULL, (const xmlChar*)value);
+  g_string_append(string, (const gchar*)escaped);
+  xmlFree(escaped);
+}
+
+/* Creates the serialized form of the given container from the serialized
+ * forms of its children. Returns NULL if not all children have been
+ * serialized in advance. */
+static GBytes*
+inf_communication_registry_serialize_container(
+  InfCommunicationRegistryEntry* entry,
+  xmlNodePtr container)
+{
+  GString* string;
+  xmlNodePtr child;
+  gsize len;
+
+  len = 0;
+  for(child = container->children; child != NULL; child = child->next)
+  {
+    if(child->_private == NULL)
+      return NULL;
+    len += g_bytes_get_size((GBytes*)child->_private);
+  }
+
+  string = g_string_sized_new(len + 64);
+
+  g_string_append(string, "<group");
+  if(entry->publisher_string != NULL)
+  {
+    g_string_append(string, " publisher=\"");
+    inf_communication_registry_append_escaped(
+      string,
+      entry->publisher_string
+    );
+    g_string_append_c(string, '"');
+  }
+
+  g_string_append(string, " name=\"");
+  inf_communication_registry_append_escaped(string, entry->key.group_name);
+  g_string_append(string, "\">");
+
+  for(child = container->children; child != NULL; child = child->next)
+  {
+    g_string_append_len(
+      string,
+      g_bytes_get_data((GBytes*)child->_private, NULL),
+      g_bytes_get_size((GBytes*)child->_private)
+    );
+  }
+
+  g_string_append(string, "</group>");
+  return g_string_free_to_bytes(string);
+}
+
 static void
 inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
                                      guint num_messages)
@@ -107,8 +207,25 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
   xmlNodePtr container;
   xmlNodePtr child;
   xmlNodePtr xml;
+  GBytes* serialized;
   guint i;
 
+  /* Whatever we are sending now contains the messages the coalescing
+   * timeout was waiting for. */
+  if(entry->coalesce_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      INF_COMMUNICATION_REGISTRY_PRIVATE(entry->registry)->io,
+      entry->coalesce_timeout
+    );
+
+    entry->coalesce_timeout = NULL;
+  }
+
+  /* Nothing to send if the queue has been cancelled in the meanwhile */
+  if(entry->queue_begin == NULL)
+    return;
+
   container = xmlNewNode(NULL, (const xmlChar*)"group");
   if(entry->publisher_string != NULL)
   {
@@ -127,10 +244,29 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
     if(entry->queue_begin == NULL) entry->queue_end = NULL;
     ++ entry->inner_count;
 
+    if(xml->_private != NULL)
+      entry->queue_size -= g_bytes_get_size((GBytes*)xml->_private);
+
     xmlUnlinkNode(xml);
     xmlAddChild(container, xml);
   }
 
+  /* If all messages have been serialized before, then assemble the
+   * serialized container from them, so that the connection does not need to
+   * serialize them again. The container holds a reference on it until it is
+   * sent. */
+  container->_private =
+    inf_communication_registry_serialize_container(entry, container);
+
+  for(xml = container->children; xml != NULL; xml = xml->next)
+  {
+    if(xml->_private != NULL)
+    {
+      g_bytes_unref((GBytes*)xml->_private);
+      xml->_private = NULL;
+    }
+  }
+
   /* Keep order of enqueued() calls and inf_xml_connection_send() calls
    * intact even if this function is run recursively in one of the
    * functions mentioned above. */
@@ -180,12 +316,35 @@ inf_communication_registry_send_real(InfCommunicationRegistryEntry* entry,
        * will simply append to entry->enqueued_list, and we will enqueue and
        * send the messages within the next iteration(s).
        */
-      inf_xml_connection_send(connection, xml);
+      serialized = (GBytes*)xml->_private;
+      if(serialized != NULL)
+      {
+        xml->_private = NULL;
+        inf_xml_connection_send_serialized(connection, xml, serialized);
+        g_bytes_unref(serialized);
+      }
+      else
+      {
+        inf_xml_connection_send(connection, xml);
+      }
 
-      /* Break if sending the data lead to connection closure */
+      /* Break if sending the data lead to connection closure. The entry
+       * might have been freed by then, so only release the serialized form
+       * of the containers that can no longer be sent. */
       g_object_get(G_OBJECT(connection), "status", &status, NULL);
       if(status != INF_XML_CONNECTION_OPEN)
+      {
+        for(xml = child; xml != NULL; xml = xml->next)
+        {
+          if(xml->_private != NULL)
+          {
+            g_bytes_unref((GBytes*)xml->_private);
+            xml->_private = NULL;
+          }
+        }
+
         break;
+      }
     }
 
     g_object_unref(connection);
@@ -228,6 +387,14 @@ inf_communication_registry_entry_free(gpointer data)
       inf_communication_registry_send_real(entry, G_MAXUINT);
   }
 
+  if(entry->coalesce_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      INF_COMMUNICATION_REGISTRY_PRIVATE(entry->registry)->io,
+      entry->coalesce_timeout
+    );
+  }
+
   if(entry->group)
   {
     g_object_weak_unref(
@@ -244,6 +411,56 @@ inf_communication_registry_entry_free(gpointer data)
   g_slice_free(InfCommunicationRegistryEntry, entry);
 }
 
+static void
+inf_communication_registry_coalesce_timeout_func(gpointer user_data)
+{
+  InfCommunicationRegistryEntry* entry;
+  entry = (InfCommunicationRegistryEntry*)user_data;
+
+  entry->coalesce_timeout = NULL;
+
+  /* If messages are still being sent, then the queue is sent as soon as
+   * they are, in inf_communication_registry_sent_cb(). */
+  if(entry->inner_count == 0 && entry->queue_begin != NULL)
+    inf_communication_registry_send_real(entry, G_MAXUINT);
+}
+
+/* Sends all messages which are held back for coalescing in group, or in all
+ * groups if group is NULL. */
+static void
+inf_communication_registry_flush_pending(InfCommunicationRegistry* registry,
+                                         InfCommunicationGroup* group)
+{
+  InfCommunicationRegistryPrivate* priv;
+  InfCommunicationRegistryEntry* entry;
+  GHashTableIter iter;
+  gpointer value;
+
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  /* Sending can cause entries to be removed, so start over with iteration
+   * after each entry that has been sent. */
+  do
+  {
+    entry = NULL;
+
+    g_hash_table_iter_init(&iter, priv->entries);
+    while(g_hash_table_iter_next(&iter, NULL, &value))
+    {
+      if(((InfCommunicationRegistryEntry*)value)->coalesce_timeout != NULL &&
+         (group == NULL ||
+          ((InfCommunicationRegistryEntry*)value)->group == group))
+      {
+        entry = (InfCommunicationRegistryEntry*)value;
+        break;
+      }
+    }
+
+    if(entry != NULL)
+      inf_communication_registry_send_real(entry, G_MAXUINT);
+  } while(entry != NULL);
+}
+
 static guint
 inf_communication_registry_key_hash(gconstpointer key_)
 {
@@ -709,6 +926,9 @@ inf_communication_registry_init(InfCommunicationRegistry* registry)
   priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
 
   priv->connections = g_hash_table_new(NULL, NULL);
+  priv->io = NULL;
+  priv->coalesce_interval = 0;
+  priv->coalesce_size = 0;
 
   priv->entries = g_hash_table_new_full(
     inf_communication_registry_key_hash,
@@ -767,9 +987,78 @@ inf_communication_registry_dispose(GObject* object)
   g_hash_table_unref(priv->connections);
   g_hash_table_unref(priv->entries);
 
+  if(priv->io != NULL)
+  {
+    g_object_unref(priv->io);
+    priv->io = NULL;
+  }
+
   G_OBJECT_CLASS(inf_communication_registry_parent_class)->dispose(object);
 }
 
+static void
+inf_communication_registry_set_property(GObject* object,
+                                        guint prop_id,
+                                        const GValue* value,
+                                        GParamSpec* pspec)
+{
+  InfCommunicationRegistry* registry;
+  InfCommunicationRegistryPrivate* priv;
+
+  registry = INF_COMMUNICATION_REGISTRY(object);
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  switch(prop_id)
+  {
+  case PROP_IO:
+    /* Pending timeouts have been installed on the previous IO object */
+    inf_communication_registry_flush_pending(registry, NULL);
+    if(priv->io != NULL) g_object_unref(priv->io);
+    priv->io = INF_IO(g_value_dup_object(value));
+    break;
+  case PROP_COALESCE_INTERVAL:
+    priv->coalesce_interval = g_value_get_uint(value);
+    if(priv->coalesce_interval == 0)
+      inf_communication_registry_flush_pending(registry, NULL);
+    break;
+  case PROP_COALESCE_SIZE:
+    priv->coalesce_size = g_value_get_uint(value);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
+static void
+inf_communication_registry_get_property(GObject* object,
+                                        guint prop_id,
+                                        GValue* value,
+                                        GParamSpec* pspec)
+{
+  InfCommunicationRegistry* registry;
+  InfCommunicationRegistryPrivate* priv;
+
+  registry = INF_COMMUNICATION_REGISTRY(object);
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  switch(prop_id)
+  {
+  case PROP_IO:
+    g_value_set_object(value, priv->io);
+    break;
+  case PROP_COALESCE_INTERVAL:
+    g_value_set_uint(value, priv->coalesce_interval);
+    break;
+  case PROP_COALESCE_SIZE:
+    g_value_set_uint(value, priv->coalesce_size);
+    break;
+  default:
+    G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
+    break;
+  }
+}
+
 static void
 inf_communication_registry_class_init(
   InfCommunicationRegistryClass* registry_class)
@@ -778,6 +1067,50 @@ inf_communication_registry_class_init(
   object_class = G_OBJECT_CLASS(registry_class);
 
   object_class->dispose = inf_communication_registry_dispose;
+  object_class->set_property = inf_communication_registry_set_property;
+  object_class->get_property = inf_communication_registry_get_property;
+
+  g_object_class_install_property(
+    object_class,
+    PROP_IO,
+    g_param_spec_object(
+      "io",
+      "IO",
+      "The IO object used to schedule sending coalesced messages",
+      INF_TYPE_IO,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_COALESCE_INTERVAL,
+    g_param_spec_uint(
+      "coalesce-interval",
+      "Coalesce interval",
+      "Time in milliseconds for which messages are held back to be sent "
+      "together with following messages, or 0 to send them immediately",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_COALESCE_SIZE,
+    g_param_spec_uint(
+      "coalesce-size",
+      "Coalesce size",
+      "Number of bytes of held back messages after which they are sent "
+      "without waiting for the coalesce interval to elapse, or 0 for no limit",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
 }
 
 /**
@@ -858,6 +1191,8 @@ inf_communication_registry_register(InfCommunicationRegistry* registry,
     entry->inner_count = 0;
     entry->queue_begin = NULL;
     entry->queue_end = NULL;
+    entry->queue_size = 0;
+    entry->coalesce_timeout = NULL;
 
     entry->registered = TRUE;
     entry->activation_count = 0;
@@ -975,37 +1310,17 @@ inf_communication_registry_is_registered(InfCommunicationRegistry* registry,
   return entry != NULL && entry->registered == TRUE;
 }
 
-/**
- * inf_communication_registry_send:
- * @registry: A #InfCommunicationRegistry.
- * @group: The group for which to send the message #InfCommunicationGroup.
- * @connection: A registered #InfXmlConnection.
- * @xml: (transfer full): The message to send.
- *
- * Sends an XML message to @connection. @connection must have been registered
- * with inf_communication_registry_register() before. If the message has been
- * sent, inf_communication_method_sent() is called on the method the
- * connection was registered with. inf_communication_method_enqueued() is
- * called when sending the message can no longer be cancelled via
- * inf_communication_registry_cancel_messages().
- *
- * This function takes ownership of @xml.
- */
-void
-inf_communication_registry_send(InfCommunicationRegistry* registry,
-                                InfCommunicationGroup* group,
-                                InfXmlConnection* connection,
-                                xmlNodePtr xml)
+static void
+inf_communication_registry_enqueue(InfCommunicationRegistry* registry,
+                                   InfCommunicationGroup* group,
+                                   InfXmlConnection* connection,
+                                   xmlNodePtr xml,
+                                   GBytes* serialized)
 {
   InfCommunicationRegistryPrivate* priv;
   InfCommunicationRegistryKey key;
   InfCommunicationRegistryEntry* entry;
 
-  g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
-  g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
-  g_return_if_fail(INF_IS_XML_CONNECTION(connection));
-  g_return_if_fail(xml != NULL);
-
   priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
   key.connection = connection;
   key.publisher_id =
@@ -1016,6 +1331,17 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
   g_assert(entry != NULL && entry->registered == TRUE);
 
   xmlUnlinkNode(xml);
+  if(serialized != NULL)
+    xml->_private = g_bytes_ref(serialized);
+  else if(priv->io != NULL && priv->coalesce_interval > 0)
+    xml->_private = inf_xml_util_serialize_node(xml);
+
+  /* When coalescing messages, all queued messages are serialized, so that we
+   * know how much data is waiting. The serialized form is later used by the
+   * connection, so no additional work is done. */
+  if(xml->_private != NULL)
+    entry->queue_size += g_bytes_get_size((GBytes*)xml->_private);
+
   if(entry->queue_end == NULL)
   {
     entry->queue_begin = xml;
@@ -1031,15 +1357,106 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
    * until the message has been sent, for better packing. */
   if(entry->inner_count == 0)
   {
-    inf_communication_registry_send_real(
-      entry,
-      INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT - entry->inner_count
-    );
+    if(priv->io == NULL || priv->coalesce_interval == 0)
+    {
+      inf_communication_registry_send_real(
+        entry,
+        INF_COMMUNICATION_REGISTRY_INNER_QUEUE_LIMIT - entry->inner_count
+      );
+    }
+    else if(priv->coalesce_size > 0 &&
+            entry->queue_size >= priv->coalesce_size)
+    {
+      /* Enough data has been collected to send it in one go */
+      inf_communication_registry_send_real(entry, G_MAXUINT);
+    }
+    else if(entry->coalesce_timeout == NULL)
+    {
+      /* Wait for more messages to come in, to send them all together */
+      entry->coalesce_timeout = inf_io_add_timeout(
+        priv->io,
+        priv->coalesce_interval,
+        inf_communication_registry_coalesce_timeout_func,
+        entry,
+        NULL
+      );
+    }
   }
 
   g_free(key.publisher_id);
 }
 
+/**
+ * inf_communication_registry_send:
+ * @registry: A #InfCommunicationRegistry.
+ * @group: The group for which to send the message #InfCommunicationGroup.
+ * @connection: A registered #InfXmlConnection.
+ * @xml: (transfer full): The message to send.
+ *
+ * Sends an XML message to @connection. @connection must have been registered
+ * with inf_communication_registry_register() before. If the message has been
+ * sent, inf_communication_method_sent() is called on the method the
+ * connection was registered with. inf_communication_method_enqueued() is
+ * called when sending the message can no longer be cancelled via
+ * inf_communication_registry_cancel_messages().
+ *
+ * This function takes ownership of @xml.
+ */
+void
+inf_communication_registry_send(InfCommunicationRegistry* registry,
+                                InfCommunicationGroup* group,
+                                InfXmlConnection* connection,
+                                xmlNodePtr xml)
+{
+  g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
+  g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
+  g_return_if_fail(INF_IS_XML_CONNECTION(connection));
+  g_return_if_fail(xml != NULL);
+
+  inf_communication_registry_enqueue(registry, group, connection, xml, NULL);
+}
+
+/**
+ * inf_communication_registry_send_serialized:
+ * @registry: A #InfCommunicationRegistry.
+ * @group: The group for which to send the message #InfCommunicationGroup.
+ * @connection: A registered #InfXmlConnection.
+ * @xml: (transfer full): The message to send.
+ * @serialized: The serialized form of @xml, as returned by
+ * inf_xml_util_serialize_node().
+ *
+ * Sends an XML message to @connection, like
+ * inf_communication_registry_send(). In addition, the serialized form of the
+ * message is provided, so that it does not need to be serialized again for
+ * @connection. This is useful when the same message is sent to many
+ * connections, in which case it can be serialized only once and the same
+ * @serialized can be used for all of them.
+ *
+ * This function takes ownership of @xml. It does not take ownership of
+ * @serialized, but adds a reference on it if needed.
+ */
+void
+inf_communication_registry_send_serialized(InfCommunicationRegistry* registry,
+                                           InfCommunicationGroup* group,
+                                           InfXmlConnection* connection,
+                                           xmlNodePtr xml,
+                                           GBytes* serialized)
+{
+  g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
+  g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
+  g_return_if_fail(INF_IS_XML_CONNECTION(connection));
+  g_return_if_fail(xml != NULL);
+  g_return_if_fail(serialized != NULL);
+
+  inf_communication_registry_enqueue(
+    registry,
+    group,
+    connection,
+    xml,
+    serialized
+  );
+}
+
 /**
  * inf_communication_registry_cancel_messages:
  * @registry: A #InfCommunicationRegistry.
@@ -1072,11 +1489,70 @@ inf_communication_registry_cancel_messages(InfCommunicationRegistry* registry,
   g_assert(entry != NULL && entry->registered == TRUE);
 
   /* TODO: Don't cancel messages prior activation? */
-  xmlFreeNodeList(entry->queue_begin);
+  inf_communication_registry_free_queue(entry->queue_begin);
   entry->queue_begin = NULL;
   entry->queue_end = NULL;
+  entry->queue_size = 0;
+
+  /* The messages the coalescing timeout was waiting for are gone */
+  if(entry->coalesce_timeout != NULL)
+  {
+    inf_io_remove_timeout(priv->io, entry->coalesce_timeout);
+    entry->coalesce_timeout = NULL;
+  }
 
   g_free(key.publisher_id);
 }
 
+/**
+ * inf_communication_registry_flush:
+ * @registry: A #InfCommunicationRegistry.
+ * @group: The group for which to send messages.
+ * @connection: (allow-none): A registered #InfXmlConnection, or %NULL.
+ *
+ * Sends all messages that are held back for coalescing to @connection in
+ * @group immediately, without waiting for the
+ * #InfCommunicationRegistry:coalesce-interval to elapse. If @connection is
+ * %NULL, this is done for all connections registered with @group. This
+ * should be called after sending messages for which latency matters.
+ *
+ * Messages that are held back because previous messages have not been sent
+ * yet are still sent only after these.
+ */
+void
+inf_communication_registry_flush(InfCommunicationRegistry* registry,
+                                 InfCommunicationGroup* group,
+                                 InfXmlConnection* connection)
+{
+  InfCommunicationRegistryPrivate* priv;
+  InfCommunicationRegistryKey key;
+  InfCommunicationRegistryEntry* entry;
+
+  g_return_if_fail(INF_COMMUNICATION_IS_REGISTRY(registry));
+  g_return_if_fail(INF_COMMUNICATION_IS_GROUP(group));
+  g_return_if_fail(connection == NULL || INF_IS_XML_CONNECTION(connection));
+
+  priv = INF_COMMUNICATION_REGISTRY_PRIVATE(registry);
+
+  if(connection != NULL)
+  {
+    key.connection = connection;
+    key.publisher_id =
+      inf_communication_group_get_publisher_id(group, connection);
+    key.group_name = inf_communication_group_get_name(group);
+
+    entry = g_hash_table_lookup(priv->entries, &key);
+    g_free(key.publisher_id);
+
+    g_return_if_fail(entry != NULL);
+
+    if(entry->coalesce_timeout != NULL && entry->queue_begin != NULL)
+      inf_communication_registry_send_real(entry, G_MAXUINT);
+  }
+  else
+  {
+    inf_communication_registry_flush_pending(registry, group);
+  }
+}
+
 /* vim:set et sw=2 ts=2: */
@@ -83,11 +83,23 @@ inf_communication_registry_send(InfCommunicationRegistry* registry,
                                 InfXmlConnection* connection,
                                 xmlNodePtr xml);
 
+void
+inf_communication_registry_send_serialized(InfCommunicationRegistry* registry,
+                                           InfCommunicationGroup* group,
+                                           InfXmlConnection* connection,
+                                           xmlNodePtr xml,
+                                           GBytes* serialized);
+
 void
 inf_communication_registry_cancel_messages(InfCommunicationRegistry* registry,
                                            InfCommunicationGroup* group,
                                            InfXmlConnection* connection);
 
+void
+inf_communication_registry_flush(InfCommunicationRegistry* registry,
+                                 InfCommunicationGroup* group,
+                                 InfXmlConnection* connection);
+
 G_END_DECLS
 
 #endif /* __INF_COMMUNICATION_REGISTRY_H__ */
@@ -47,6 +47,8 @@ struct _InfdXmppServerPrivate {
   InfSaslContext* sasl_context;
   InfSaslContext* sasl_own_context;
   gchar* sasl_mechanisms;
+
+  guint compression_level;
 };
 
 enum {
@@ -60,6 +62,7 @@ enum {
   PROP_SASL_MECHANISMS,
 
   PROP_SECURITY_POLICY,
+  PROP_COMPRESSION_LEVEL,
 
   /* Overridden from XML server */
   PROP_STATUS
@@ -113,6 +116,18 @@ infd_xmpp_server_new_connection_cb(InfdTcpServer* tcp_server,
 
   g_free(addr_str);
 
+  /* Only the server side's level applies here; the client decides on its
+   * own whether to request compression, and at which level it compresses
+   * its own data. */
+  if(priv->compression_level > 0)
+  {
+    g_object_set(
+      G_OBJECT(xmpp_connection),
+      "compression-level", priv->compression_level,
+      NULL
+    );
+  }
+
   /* We could, alternatively, keep the connection around until authentication
    * has completed and emit the new_connection signal after that, to guarantee
    * that the connection is open when new_connection is emitted. */
@@ -358,6 +373,8 @@ infd_xmpp_server_init(InfdXmppServer* xmpp)
   priv->sasl_context = NULL;
   priv->sasl_own_context = NULL;
   priv->sasl_mechanisms = NULL;
+
+  priv->compression_level = 0;
 }
 
 static void
@@ -462,6 +479,9 @@ infd_xmpp_server_set_property(GObject* object,
   case PROP_SECURITY_POLICY:
     infd_xmpp_server_set_security_policy(xmpp, g_value_get_enum(value));
     break;
+  case PROP_COMPRESSION_LEVEL:
+    priv->compression_level = g_value_get_uint(value);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -515,6 +535,9 @@ infd_xmpp_server_get_property(GObject* object,
   case PROP_SECURITY_POLICY:
     g_value_set_enum(value, priv->security_policy);
     break;
+  case PROP_COMPRESSION_LEVEL:
+    g_value_set_uint(value, priv->compression_level);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -628,6 +651,21 @@ infd_xmpp_server_class_init(InfdXmppServerClass* xmpp_class)
     )
   );
 
+  g_object_class_install_property(
+    object_class,
+    PROP_COMPRESSION_LEVEL,
+    g_param_spec_uint(
+      "compression-level",
+      "Compression level",
+      "The zlib level with which newly accepted connections compress their "
+      "outgoing data, or 0 to not offer stream compression",
+      0,
+      9,
+      0,
+      G_PARAM_READWRITE
+    )
+  );
+
   g_object_class_override_property(object_class, PROP_STATUS, "status");
 
   xmpp_server_signals[ERROR] = g_signal_new(
@@ -256,6 +256,248 @@ inf_text_buffer_erase_text(InfTextBuffer* buffer,
   iface->erase_text(buffer, pos, len, user);
 }
 
+/**
+ * inf_text_buffer_append:
+ * @buffer: A #InfTextBuffer.
+ * @chunk: (transfer none): A #InfTextChunk.
+ * @user: (allow-none): A #InfUser inserting @chunk, or %NULL.
+ *
+ * Inserts @chunk at the end of @buffer. This is equivalent to calling
+ * inf_text_buffer_insert_chunk() with the length of @buffer as position,
+ * but buffer implementations can handle it more efficiently. It is meant
+ * to be used when loading a whole document at once: build a single
+ * #InfTextChunk with all of the document's segments and append it to the
+ * empty buffer, so that #InfTextBuffer::text-inserted is emitted only once.
+ **/
+void
+inf_text_buffer_append(InfTextBuffer* buffer,
+                       InfTextChunk* chunk,
+                       InfUser* user)
+{
+  InfTextBufferInterface* iface;
+
+  g_return_if_fail(INF_TEXT_IS_BUFFER(buffer));
+  g_return_if_fail(chunk != NULL);
+  g_return_if_fail(user == NULL || INF_IS_USER(user));
+
+  if(inf_text_chunk_get_length(chunk) == 0)
+    return;
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+
+  if(iface->append != NULL)
+  {
+    iface->append(buffer, chunk, user);
+  }
+  else
+  {
+    g_return_if_fail(iface->insert_text != NULL);
+
+    iface->insert_text(
+      buffer,
+      inf_text_buffer_get_length(buffer),
+      chunk,
+      user
+    );
+  }
+}
+
+/**
+ * inf_text_buffer_clear:
+ * @buffer: A #InfTextBuffer.
+ * @user: (allow-none): A #InfUser that erases the text, or %NULL.
+ *
+ * Removes all text from @buffer. This is equivalent to calling
+ * inf_text_buffer_erase_text() for the whole buffer, but buffer
+ * implementations can handle it more efficiently.
+ **/
+void
+inf_text_buffer_clear(InfTextBuffer* buffer,
+                      InfUser* user)
+{
+  InfTextBufferInterface* iface;
+  guint length;
+
+  g_return_if_fail(INF_TEXT_IS_BUFFER(buffer));
+  g_return_if_fail(user == NULL || INF_IS_USER(user));
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+
+  if(iface->clear != NULL)
+  {
+    iface->clear(buffer, user);
+  }
+  else
+  {
+    g_return_if_fail(iface->erase_text != NULL);
+
+    length = inf_text_buffer_get_length(buffer);
+    if(length > 0)
+      iface->erase_text(buffer, 0, length, user);
+  }
+}
+
+/* Returns the offsets of all newline characters in buffer. This is used for
+ * buffer implementations that do not keep track of lines themselves. */
+static guint*
+inf_text_buffer_find_newlines(InfTextBuffer* buffer,
+                              guint* n_newlines)
+{
+  InfTextChunk* chunk;
+  guint* newlines;
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  newlines = inf_text_chunk_find_newlines(chunk, n_newlines);
+  inf_text_chunk_free(chunk);
+
+  return newlines;
+}
+
+/**
+ * inf_text_buffer_get_line_count:
+ * @buffer: A #InfTextBuffer.
+ *
+ * Returns the number of lines in @buffer. Lines are separated by newline
+ * ('\n') characters, so this is one more than the number of newline
+ * characters in @buffer. An empty buffer has a single line.
+ *
+ * #InfTextDefaultBuffer answers this in constant time. For buffer
+ * implementations which do not keep track of lines, the whole text is
+ * scanned.
+ *
+ * Returns: The number of lines in @buffer.
+ **/
+guint
+inf_text_buffer_get_line_count(InfTextBuffer* buffer)
+{
+  InfTextBufferInterface* iface;
+  guint* newlines;
+  guint n_newlines;
+
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), 0);
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+  if(iface->get_line_count != NULL)
+    return iface->get_line_count(buffer);
+
+  newlines = inf_text_buffer_find_newlines(buffer, &n_newlines);
+  g_free(newlines);
+
+  return n_newlines + 1;
+}
+
+/**
+ * inf_text_buffer_offset_to_line:
+ * @buffer: A #InfTextBuffer.
+ * @offset: A character offset into @buffer.
+ * @line: (out) (allow-none): Location to store the line number, or %NULL.
+ * @column: (out) (allow-none): Location to store the column, or %NULL.
+ *
+ * Finds the line which contains the character at @offset, and the
+ * position of that character within the line. Both line numbers and columns
+ * count from zero, and columns are given in characters. A newline character
+ * belongs to the line it terminates. @offset may be equal to the length of
+ * @buffer, in which case the end of the last line is returned.
+ *
+ * #InfTextDefaultBuffer answers this in logarithmic time. For buffer
+ * implementations which do not keep track of lines, the whole text is
+ * scanned.
+ **/
+void
+inf_text_buffer_offset_to_line(InfTextBuffer* buffer,
+                               guint offset,
+                               guint* line,
+                               guint* column)
+{
+  InfTextBufferInterface* iface;
+  guint* newlines;
+  guint n_newlines;
+  guint begin;
+  guint end;
+  guint mid;
+
+  g_return_if_fail(INF_TEXT_IS_BUFFER(buffer));
+  g_return_if_fail(offset <= inf_text_buffer_get_length(buffer));
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+  if(iface->offset_to_line != NULL)
+  {
+    iface->offset_to_line(buffer, offset, line, column);
+    return;
+  }
+
+  newlines = inf_text_buffer_find_newlines(buffer, &n_newlines);
+
+  /* Find the number of newline characters before offset */
+  begin = 0;
+  end = n_newlines;
+  while(begin < end)
+  {
+    mid = begin + (end - begin) / 2;
+    if(newlines[mid] < offset)
+      begin = mid + 1;
+    else
+      end = mid;
+  }
+
+  if(line != NULL) *line = begin;
+  if(column != NULL)
+    *column = (begin == 0) ? offset : offset - newlines[begin - 1] - 1;
+
+  g_free(newlines);
+}
+
+/**
+ * inf_text_buffer_line_to_offset:
+ * @buffer: A #InfTextBuffer.
+ * @line: A line number, counting from zero.
+ *
+ * Returns the character offset at which line number @line begins. @line
+ * must be smaller than the number of lines in @buffer, see
+ * inf_text_buffer_get_line_count().
+ *
+ * #InfTextDefaultBuffer answers this in logarithmic time. For buffer
+ * implementations which do not keep track of lines, the whole text is
+ * scanned.
+ *
+ * Returns: The character offset of the beginning of @line.
+ **/
+guint
+inf_text_buffer_line_to_offset(InfTextBuffer* buffer,
+                               guint line)
+{
+  InfTextBufferInterface* iface;
+  guint* newlines;
+  guint n_newlines;
+  guint offset;
+
+  g_return_val_if_fail(INF_TEXT_IS_BUFFER(buffer), 0);
+
+  iface = INF_TEXT_BUFFER_GET_IFACE(buffer);
+  if(iface->line_to_offset != NULL)
+    return iface->line_to_offset(buffer, line);
+
+  if(line == 0)
+    return 0;
+
+  newlines = inf_text_buffer_find_newlines(buffer, &n_newlines);
+  if(line > n_newlines)
+  {
+    g_free(newlines);
+    g_return_val_if_reached(inf_text_buffer_get_length(buffer));
+  }
+
+  offset = newlines[line - 1] + 1;
+  g_free(newlines);
+
+  return offset;
+}
+
 /**
  * inf_text_buffer_create_begin_iter:
  * @buffer: A #InfTextBuffer.
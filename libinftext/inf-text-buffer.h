@@ -83,6 +83,20 @@ typedef struct _InfTextBufferIter InfTextBufferIter;
  * signal.
  * @text_erased: Default signal handler of the #InfTextBuffer::text-erased
  * signal.
+ * @get_line_count: Virtual function to return the number of lines in the
+ * buffer. Can be %NULL, in which case the text is scanned for newlines.
+ * @offset_to_line: Virtual function to obtain the line and column of a
+ * character offset. Can be %NULL, in which case the text is scanned for
+ * newlines.
+ * @line_to_offset: Virtual function to obtain the character offset of the
+ * beginning of a line. Can be %NULL, in which case the text is scanned for
+ * newlines.
+ * @append: Virtual function to insert a chunk of text at the end of the
+ * buffer. This is used when loading a document and should be implemented
+ * efficiently for large chunks. Can be %NULL, in which case @insert_text is
+ * used.
+ * @clear: Virtual function to remove all text from the buffer. Can be
+ * %NULL, in which case @erase_text is used.
  *
  * This structure contains virtual functions and signal handlers of the
  * #InfTextBuffer interface.
@@ -150,6 +164,24 @@ struct _InfTextBufferInterface {
                      guint pos,
                      InfTextChunk* chunk,
                      InfUser* user);
+
+  /* Virtual table, continued */
+  guint(*get_line_count)(InfTextBuffer* buffer);
+
+  void(*offset_to_line)(InfTextBuffer* buffer,
+                        guint offset,
+                        guint* line,
+                        guint* column);
+
+  guint(*line_to_offset)(InfTextBuffer* buffer,
+                         guint line);
+
+  void(*append)(InfTextBuffer* buffer,
+                InfTextChunk* chunk,
+                InfUser* user);
+
+  void(*clear)(InfTextBuffer* buffer,
+               InfUser* user);
 };
 
 GType
@@ -186,6 +218,28 @@ inf_text_buffer_erase_text(InfTextBuffer* buffer,
                            guint len,
                            InfUser* user);
 
+void
+inf_text_buffer_append(InfTextBuffer* buffer,
+                       InfTextChunk* chunk,
+                       InfUser* user);
+
+void
+inf_text_buffer_clear(InfTextBuffer* buffer,
+                      InfUser* user);
+
+guint
+inf_text_buffer_get_line_count(InfTextBuffer* buffer);
+
+void
+inf_text_buffer_offset_to_line(InfTextBuffer* buffer,
+                               guint offset,
+                               guint* line,
+                               guint* column);
+
+guint
+inf_text_buffer_line_to_offset(InfTextBuffer* buffer,
+                               guint line);
+
 InfTextBufferIter*
 inf_text_buffer_create_begin_iter(InfTextBuffer* buffer);
 
@@ -33,7 +33,14 @@
  * An #InfTextChunk is made up of segments, where each segment represents a
  * contiguous piece of text which is written by the same user. The
  * #InfTextChunkIter functionality can be used to iterate over the segments
- * of a chunk.
+ * of a chunk. Note that the size of a segment is limited, so that text
+ * written by the same author can span several adjacent segments.
+ *
+ * Internally, the segments are kept in a balanced tree where each node
+ * caches the number of characters and bytes in its subtree. Locating a
+ * character offset, inserting and erasing text therefore take logarithmic
+ * time in the number of segments, and since segments are bounded in size,
+ * independent of how long the text written by a single author is.
  *
  * The #InfTextChunk API works with characters, not bytes, i.e. all offsets
  * are given in number of characters. This ensures that unicode strings
@@ -42,11 +49,14 @@
  * #InfTextChunk then uses iconv to convert between bytes and character
  * offsets where necessary. For a small set of selected encodings which are
  * very popular, most notably UTF-8, there exist more optimized code paths to
- * do the conversion.
+ * do the conversion. These include the fixed-width encodings UCS-2, UCS-4,
+ * UTF-32 with explicit byte order and the single-byte ISO-8859 family, as
+ * well as UTF-16 with explicit byte order.
  */
 
 #include <libinftext/inf-text-chunk.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8.h>
 
 #include <string.h>
 
@@ -56,6 +66,12 @@ G_DEFINE_BOXED_TYPE(InfTextChunk, inf_text_chunk, inf_text_chunk_copy, inf_text_
 /* Don't check integrity in stable releases */
 /*#define CHUNK_CHECK_INTEGRITY*/
 
+/* Maximum number of characters in a single segment. Longer runs of text by
+ * the same author are split into several segments, so that looking up a
+ * byte index within a segment and moving text around inside it are bounded
+ * operations. */
+#define INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH 512
+
 typedef struct _InfTextChunkPath InfTextChunkPath;
 struct _InfTextChunkPath {
   gsize (*get_byte_index)(InfTextChunk* chunk,
@@ -64,23 +80,40 @@ struct _InfTextChunkPath {
                           guint offset);
 };
 
-struct _InfTextChunk {
-  GSequence* segments;
-  guint length; /* in characters */
-  GQuark encoding;
-
-  const InfTextChunkPath* path;
-};
-
 typedef struct _InfTextChunkSegment InfTextChunkSegment;
 struct _InfTextChunkSegment {
+  InfTextChunkSegment* parent;
+  InfTextChunkSegment* left;
+  InfTextChunkSegment* right;
+  guint height;
+
   guint author;
   /* This is gchar so that we can do pointer arithmetic. It does not
    * necessarily store a full character in each byte. This depends on the
    * encoding specified in the InfTextChunk. */
   gchar* text;
-  gsize length; /* in bytes */
-  guint offset; /* absolute to chunk begin in characters, sort criteria */
+  gsize bytes;
+  guint length; /* in characters */
+
+  /* Cached sums over the subtree rooted at this segment, including the
+   * segment itself. */
+  gsize subtree_bytes;
+  guint subtree_length;
+};
+
+/* The segment tree is shared between copies of a chunk, and it is only
+ * duplicated when one of them is about to be modified. */
+typedef struct _InfTextChunkTree InfTextChunkTree;
+struct _InfTextChunkTree {
+  guint ref_count;
+  InfTextChunkSegment* root;
+};
+
+struct _InfTextChunk {
+  InfTextChunkTree* tree;
+  GQuark encoding;
+
+  const InfTextChunkPath* path;
 };
 
 /*
@@ -93,10 +126,10 @@ gsize inf_text_chunk_get_byte_index_utf8(InfTextChunk* self,
                                          guint offset)
 {
 #ifdef CHUNK_CHECK_INTEGRITY
-  g_assert(offset <= g_utf8_strlen(self, bytes));
+  g_assert(offset <= g_utf8_strlen(text, bytes));
 #endif
 
-  return g_utf8_offset_to_pointer(text, offset) - text;
+  return inf_utf8_offset_to_index(text, bytes, offset);
 }
 
 gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
@@ -144,18 +177,234 @@ gsize inf_text_chunk_get_byte_index_iconv(InfTextChunk* self,
   return bytes - inlen;
 }
 
+gsize inf_text_chunk_get_byte_index_fixed8(InfTextChunk* self,
+                                           gchar* text,
+                                           gsize bytes,
+                                           guint offset)
+{
+  g_assert(offset <= bytes);
+  return offset;
+}
+
+gsize inf_text_chunk_get_byte_index_fixed16(InfTextChunk* self,
+                                            gchar* text,
+                                            gsize bytes,
+                                            guint offset)
+{
+  g_assert((gsize)offset * 2 <= bytes);
+  return (gsize)offset * 2;
+}
+
+gsize inf_text_chunk_get_byte_index_fixed32(InfTextChunk* self,
+                                            gchar* text,
+                                            gsize bytes,
+                                            guint offset)
+{
+  g_assert((gsize)offset * 4 <= bytes);
+  return (gsize)offset * 4;
+}
+
+/* Every character is a single 16 bit code unit, except for the ones outside
+ * the BMP, which are encoded as a surrogate pair. high is the position of
+ * the more significant byte within a code unit, i.e. 1 for little endian and
+ * 0 for big endian. Runs of four code units without surrogates are skipped
+ * at once by looking at them as a single 64 bit word. */
+static gsize
+inf_text_chunk_get_byte_index_utf16_impl(const guchar* text,
+                                         gsize bytes,
+                                         guint offset,
+                                         guint high)
+{
+  const guint64 ones = G_GUINT64_CONSTANT(0x0101010101010101);
+  const guint64 high_bytes = (high == 1) ?
+    G_GUINT64_CONSTANT(0xff00ff00ff00ff00) :
+    G_GUINT64_CONSTANT(0x00ff00ff00ff00ff);
+
+  gsize pos;
+  guint64 word;
+
+  pos = 0;
+  while(offset > 0)
+  {
+    if(offset >= 4 && bytes - pos >= 8)
+    {
+      memcpy(&word, text + pos, 8);
+      /* Byte i of the text is now in bits 8*i to 8*i+7 */
+      word = GUINT64_FROM_LE(word);
+
+      /* High bytes of surrogates are 0xd8 to 0xdf, which turn into zero
+       * bytes here. Low bytes are set to 0xff so that they never do. */
+      word = ((word & (ones * 0xf8)) ^ (ones * 0xd8)) | ~high_bytes;
+      if(((word - ones) & ~word & (ones * 0x80)) == 0)
+      {
+        pos += 8;
+        offset -= 4;
+        continue;
+      }
+    }
+
+    g_assert(bytes - pos >= 2);
+    if((text[pos + high] & 0xfc) == 0xd8)
+      pos += 4;
+    else
+      pos += 2;
+
+    --offset;
+  }
+
+  g_assert(pos <= bytes);
+  return pos;
+}
+
+gsize inf_text_chunk_get_byte_index_utf16le(InfTextChunk* self,
+                                            gchar* text,
+                                            gsize bytes,
+                                            guint offset)
+{
+  return inf_text_chunk_get_byte_index_utf16_impl(
+    (const guchar*)text,
+    bytes,
+    offset,
+    1
+  );
+}
+
+gsize inf_text_chunk_get_byte_index_utf16be(InfTextChunk* self,
+                                            gchar* text,
+                                            gsize bytes,
+                                            guint offset)
+{
+  return inf_text_chunk_get_byte_index_utf16_impl(
+    (const guchar*)text,
+    bytes,
+    offset,
+    0
+  );
+}
+
 const InfTextChunkPath INF_TEXT_CHUNK_PATH_UTF8 = {
   inf_text_chunk_get_byte_index_utf8
 };
 
+const InfTextChunkPath INF_TEXT_CHUNK_PATH_FIXED8 = {
+  inf_text_chunk_get_byte_index_fixed8
+};
+
+const InfTextChunkPath INF_TEXT_CHUNK_PATH_FIXED16 = {
+  inf_text_chunk_get_byte_index_fixed16
+};
+
+const InfTextChunkPath INF_TEXT_CHUNK_PATH_FIXED32 = {
+  inf_text_chunk_get_byte_index_fixed32
+};
+
+const InfTextChunkPath INF_TEXT_CHUNK_PATH_UTF16LE = {
+  inf_text_chunk_get_byte_index_utf16le
+};
+
+const InfTextChunkPath INF_TEXT_CHUNK_PATH_UTF16BE = {
+  inf_text_chunk_get_byte_index_utf16be
+};
+
 const InfTextChunkPath INF_TEXT_CHUNK_PATH_ICONV = {
   inf_text_chunk_get_byte_index_iconv
 };
 
+typedef struct _InfTextChunkEncodingPath InfTextChunkEncodingPath;
+struct _InfTextChunkEncodingPath {
+  const gchar* encoding;
+  const InfTextChunkPath* path;
+};
+
+/* Encodings for which we do not need iconv to find byte indices. Encoding
+ * names are matched case-insensitively. UTF-16 and UTF-32 without explicit
+ * byte order are not listed, since a byte order mark at the beginning of a
+ * segment would not count as a character for iconv. */
+static const InfTextChunkEncodingPath inf_text_chunk_encoding_paths[] = {
+  { "UTF-8", &INF_TEXT_CHUNK_PATH_UTF8 },
+  { "UTF8", &INF_TEXT_CHUNK_PATH_UTF8 },
+
+  { "UTF-16LE", &INF_TEXT_CHUNK_PATH_UTF16LE },
+  { "UTF-16BE", &INF_TEXT_CHUNK_PATH_UTF16BE },
+
+  { "UCS-2", &INF_TEXT_CHUNK_PATH_FIXED16 },
+  { "UCS-2LE", &INF_TEXT_CHUNK_PATH_FIXED16 },
+  { "UCS-2BE", &INF_TEXT_CHUNK_PATH_FIXED16 },
+
+  { "UCS-4", &INF_TEXT_CHUNK_PATH_FIXED32 },
+  { "UCS-4LE", &INF_TEXT_CHUNK_PATH_FIXED32 },
+  { "UCS-4BE", &INF_TEXT_CHUNK_PATH_FIXED32 },
+  { "UTF-32LE", &INF_TEXT_CHUNK_PATH_FIXED32 },
+  { "UTF-32BE", &INF_TEXT_CHUNK_PATH_FIXED32 },
+
+  { "ASCII", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "US-ASCII", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "LATIN1", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-1", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-2", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-3", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-4", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-5", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-6", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-7", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-8", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-9", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-10", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-11", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-13", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-14", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-15", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "ISO-8859-16", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "CP1252", &INF_TEXT_CHUNK_PATH_FIXED8 },
+  { "WINDOWS-1252", &INF_TEXT_CHUNK_PATH_FIXED8 }
+};
+
+static const InfTextChunkPath*
+inf_text_chunk_lookup_path(const gchar* encoding)
+{
+  guint i;
+
+  for(i = 0; i < G_N_ELEMENTS(inf_text_chunk_encoding_paths); ++i)
+  {
+    if(g_ascii_strcasecmp(inf_text_chunk_encoding_paths[i].encoding,
+                          encoding) == 0)
+    {
+      return inf_text_chunk_encoding_paths[i].path;
+    }
+  }
+
+  return &INF_TEXT_CHUNK_PATH_ICONV;
+}
+
 /*
- * Helper functions
+ * Segment tree
  */
 
+static InfTextChunkSegment*
+inf_text_chunk_segment_new(guint author,
+                           const gchar* text,
+                           gsize bytes,
+                           guint length)
+{
+  InfTextChunkSegment* segment;
+
+  segment = g_slice_new(InfTextChunkSegment);
+  segment->parent = NULL;
+  segment->left = NULL;
+  segment->right = NULL;
+  segment->height = 1;
+
+  segment->author = author;
+  segment->text = g_memdup(text, bytes);
+  segment->bytes = bytes;
+  segment->length = length;
+
+  segment->subtree_bytes = bytes;
+  segment->subtree_length = length;
+
+  return segment;
+}
+
 static void
 inf_text_chunk_segment_free(InfTextChunkSegment* segment)
 {
@@ -163,137 +412,624 @@ inf_text_chunk_segment_free(InfTextChunkSegment* segment)
   g_slice_free(InfTextChunkSegment, segment);
 }
 
-static int
-inf_text_chunk_segment_cmp(gconstpointer first,
-                           gconstpointer second,
-                           gpointer userdata)
+static void
+inf_text_chunk_segment_free_subtree(InfTextChunkSegment* segment)
 {
-  const InfTextChunkSegment* first_segment;
-  const InfTextChunkSegment* second_segment;
- 
-  first_segment  = (const InfTextChunkSegment*)first;
-  second_segment = (const InfTextChunkSegment*)second;
+  if(segment != NULL)
+  {
+    inf_text_chunk_segment_free_subtree(segment->left);
+    inf_text_chunk_segment_free_subtree(segment->right);
+    inf_text_chunk_segment_free(segment);
+  }
+}
 
-  g_return_val_if_fail(second != NULL && first != NULL, 0);
+static guint
+inf_text_chunk_segment_height(InfTextChunkSegment* segment)
+{
+  return segment != NULL ? segment->height : 0;
+}
 
-  if (first_segment->offset < second_segment->offset)
-    return -1;
-  else if (first_segment->offset == second_segment->offset)
-    return 0;
+static guint
+inf_text_chunk_segment_subtree_length(InfTextChunkSegment* segment)
+{
+  return segment != NULL ? segment->subtree_length : 0;
+}
+
+static gsize
+inf_text_chunk_segment_subtree_bytes(InfTextChunkSegment* segment)
+{
+  return segment != NULL ? segment->subtree_bytes : 0;
+}
+
+static gsize
+inf_text_chunk_segment_count_subtree(InfTextChunkSegment* segment)
+{
+  if(segment == NULL) return 0;
+
+  return 1 + inf_text_chunk_segment_count_subtree(segment->left) +
+    inf_text_chunk_segment_count_subtree(segment->right);
+}
+
+/* Recomputes the cached values of segment from its children */
+static void
+inf_text_chunk_segment_update(InfTextChunkSegment* segment)
+{
+  segment->height = 1 + MAX(
+    inf_text_chunk_segment_height(segment->left),
+    inf_text_chunk_segment_height(segment->right)
+  );
+
+  segment->subtree_length = segment->length +
+    inf_text_chunk_segment_subtree_length(segment->left) +
+    inf_text_chunk_segment_subtree_length(segment->right);
+
+  segment->subtree_bytes = segment->bytes +
+    inf_text_chunk_segment_subtree_bytes(segment->left) +
+    inf_text_chunk_segment_subtree_bytes(segment->right);
+}
+
+/* Updates the cached values from segment up to the root, after the length
+ * of segment has changed. This does not change the tree structure. */
+static void
+inf_text_chunk_segment_update_path(InfTextChunkSegment* segment)
+{
+  for(; segment != NULL; segment = segment->parent)
+    inf_text_chunk_segment_update(segment);
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_first(InfTextChunkSegment* segment)
+{
+  if(segment != NULL)
+    while(segment->left != NULL)
+      segment = segment->left;
+  return segment;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_last(InfTextChunkSegment* segment)
+{
+  if(segment != NULL)
+    while(segment->right != NULL)
+      segment = segment->right;
+  return segment;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_next(InfTextChunkSegment* segment)
+{
+  if(segment->right != NULL)
+    return inf_text_chunk_segment_first(segment->right);
+
+  while(segment->parent != NULL && segment->parent->right == segment)
+    segment = segment->parent;
+  return segment->parent;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_segment_prev(InfTextChunkSegment* segment)
+{
+  if(segment->left != NULL)
+    return inf_text_chunk_segment_last(segment->left);
+
+  while(segment->parent != NULL && segment->parent->left == segment)
+    segment = segment->parent;
+  return segment->parent;
+}
+
+/* Makes replacement take the place of segment in the tree. Children of
+ * replacement are not touched. */
+static void
+inf_text_chunk_replace_segment(InfTextChunk* self,
+                               InfTextChunkSegment* segment,
+                               InfTextChunkSegment* replacement)
+{
+  if(segment->parent == NULL)
+    self->tree->root = replacement;
+  else if(segment->parent->left == segment)
+    segment->parent->left = replacement;
   else
-    return 1;
+    segment->parent->right = replacement;
+
+  if(replacement != NULL)
+    replacement->parent = segment->parent;
 }
 
-static guint
-inf_text_chunk_next_offset(InfTextChunk* self,
-                           GSequenceIter* iter)
+static InfTextChunkSegment*
+inf_text_chunk_rotate_left(InfTextChunk* self,
+                           InfTextChunkSegment* segment)
 {
-  GSequenceIter* next_iter;
+  InfTextChunkSegment* pivot;
+
+  pivot = segment->right;
+  inf_text_chunk_replace_segment(self, segment, pivot);
+
+  segment->right = pivot->left;
+  if(segment->right != NULL)
+    segment->right->parent = segment;
+
+  pivot->left = segment;
+  segment->parent = pivot;
 
-  g_assert(iter != g_sequence_get_end_iter(self->segments));
-  
-  next_iter = g_sequence_iter_next(iter);
-  if(next_iter == g_sequence_get_end_iter(self->segments))
-    return self->length;
+  inf_text_chunk_segment_update(segment);
+  inf_text_chunk_segment_update(pivot);
+  return pivot;
+}
+
+static InfTextChunkSegment*
+inf_text_chunk_rotate_right(InfTextChunk* self,
+                            InfTextChunkSegment* segment)
+{
+  InfTextChunkSegment* pivot;
+
+  pivot = segment->left;
+  inf_text_chunk_replace_segment(self, segment, pivot);
+
+  segment->left = pivot->right;
+  if(segment->left != NULL)
+    segment->left->parent = segment;
+
+  pivot->right = segment;
+  segment->parent = pivot;
+
+  inf_text_chunk_segment_update(segment);
+  inf_text_chunk_segment_update(pivot);
+  return pivot;
+}
+
+/* Restores the AVL balance and the cached values from segment up to the
+ * root after a segment has been linked into or unlinked from the tree. */
+static void
+inf_text_chunk_rebalance(InfTextChunk* self,
+                         InfTextChunkSegment* segment)
+{
+  guint left_height;
+  guint right_height;
+
+  while(segment != NULL)
+  {
+    inf_text_chunk_segment_update(segment);
+
+    left_height = inf_text_chunk_segment_height(segment->left);
+    right_height = inf_text_chunk_segment_height(segment->right);
+
+    if(left_height > right_height + 1)
+    {
+      if(inf_text_chunk_segment_height(segment->left->left) <
+         inf_text_chunk_segment_height(segment->left->right))
+      {
+        inf_text_chunk_rotate_left(self, segment->left);
+      }
+
+      segment = inf_text_chunk_rotate_right(self, segment);
+    }
+    else if(right_height > left_height + 1)
+    {
+      if(inf_text_chunk_segment_height(segment->right->right) <
+         inf_text_chunk_segment_height(segment->right->left))
+      {
+        inf_text_chunk_rotate_right(self, segment->right);
+      }
+
+      segment = inf_text_chunk_rotate_left(self, segment);
+    }
+
+    segment = segment->parent;
+  }
+}
+
+/* Links new_segment into the tree directly behind position, or at the very
+ * beginning if position is NULL. */
+static void
+inf_text_chunk_insert_segment_after(InfTextChunk* self,
+                                    InfTextChunkSegment* position,
+                                    InfTextChunkSegment* new_segment)
+{
+  InfTextChunkSegment* parent;
+
+  if(self->tree->root == NULL)
+  {
+    g_assert(position == NULL);
+    self->tree->root = new_segment;
+    new_segment->parent = NULL;
+    return;
+  }
+
+  if(position == NULL)
+  {
+    parent = inf_text_chunk_segment_first(self->tree->root);
+    parent->left = new_segment;
+  }
+  else if(position->right == NULL)
+  {
+    parent = position;
+    parent->right = new_segment;
+  }
   else
-    return ((InfTextChunkSegment*)g_sequence_get(next_iter))->offset;
+  {
+    parent = inf_text_chunk_segment_first(position->right);
+    parent->left = new_segment;
+  }
+
+  new_segment->parent = parent;
+  inf_text_chunk_rebalance(self, parent);
 }
 
-#ifdef CHUNK_CHECK_INTEGRITY
-static gboolean
-inf_text_chunk_check_integrity(InfTextChunk* self)
+/* Unlinks segment from the tree, but does not free it. */
+static void
+inf_text_chunk_remove_segment(InfTextChunk* self,
+                              InfTextChunkSegment* segment)
+{
+  InfTextChunkSegment* successor;
+  InfTextChunkSegment* start;
+
+  if(segment->left == NULL || segment->right == NULL)
+  {
+    start = segment->parent;
+
+    inf_text_chunk_replace_segment(
+      self,
+      segment,
+      segment->left != NULL ? segment->left : segment->right
+    );
+  }
+  else
+  {
+    successor = inf_text_chunk_segment_first(segment->right);
+
+    if(successor->parent != segment)
+    {
+      start = successor->parent;
+      inf_text_chunk_replace_segment(self, successor, successor->right);
+
+      successor->right = segment->right;
+      successor->right->parent = successor;
+    }
+    else
+    {
+      start = successor;
+    }
+
+    inf_text_chunk_replace_segment(self, segment, successor);
+    successor->left = segment->left;
+    successor->left->parent = successor;
+  }
+
+  segment->parent = NULL;
+  segment->left = NULL;
+  segment->right = NULL;
+
+  inf_text_chunk_rebalance(self, start);
+}
+
+/* Builds a balanced tree out of the n_segments given segments, in order.
+ * Returns the root of the new tree. */
+static InfTextChunkSegment*
+inf_text_chunk_build_tree(InfTextChunkSegment** segments,
+                          guint n_segments,
+                          InfTextChunkSegment* parent)
+{
+  InfTextChunkSegment* segment;
+  guint mid;
+
+  if(n_segments == 0)
+    return NULL;
+
+  mid = n_segments / 2;
+  segment = segments[mid];
+
+  segment->parent = parent;
+  segment->left = inf_text_chunk_build_tree(segments, mid, segment);
+  segment->right = inf_text_chunk_build_tree(
+    segments + mid + 1,
+    n_segments - mid - 1,
+    segment
+  );
+
+  inf_text_chunk_segment_update(segment);
+  return segment;
+}
+
+static InfTextChunkTree*
+inf_text_chunk_tree_new(InfTextChunkSegment* root)
 {
-  GSequenceIter* iter;
+  InfTextChunkTree* tree;
+
+  tree = g_slice_new(InfTextChunkTree);
+  tree->ref_count = 1;
+  tree->root = root;
+
+  return tree;
+}
+
+static void
+inf_text_chunk_tree_unref(InfTextChunkTree* tree)
+{
+  if(--tree->ref_count == 0)
+  {
+    inf_text_chunk_segment_free_subtree(tree->root);
+    g_slice_free(InfTextChunkTree, tree);
+  }
+}
+
+/* Makes sure that the segment tree of self is not shared with another
+ * chunk, so that it can be modified. This needs to be called by every
+ * function modifying the chunk's content. */
+static void
+inf_text_chunk_make_writable(InfTextChunk* self)
+{
+  InfTextChunkTree* tree;
   InfTextChunkSegment* segment;
+  GPtrArray* segments;
+
+  tree = self->tree;
+  if(tree->ref_count == 1)
+    return;
+
+  segments = g_ptr_array_new();
+
+  for(segment = inf_text_chunk_segment_first(tree->root);
+      segment != NULL;
+      segment = inf_text_chunk_segment_next(segment))
+  {
+    g_ptr_array_add(
+      segments,
+      inf_text_chunk_segment_new(
+        segment->author,
+        segment->text,
+        segment->bytes,
+        segment->length
+      )
+    );
+  }
+
+  self->tree = inf_text_chunk_tree_new(
+    inf_text_chunk_build_tree(
+      (InfTextChunkSegment**)segments->pdata,
+      segments->len,
+      NULL
+    )
+  );
+
+  g_ptr_array_free(segments, TRUE);
+  inf_text_chunk_tree_unref(tree);
+}
+
+#ifdef CHUNK_CHECK_INTEGRITY
+/* Returns the character offset of the beginning of segment */
+static guint
+inf_text_chunk_segment_get_offset(InfTextChunkSegment* segment)
+{
   guint offset;
-  guint new_offset;
 
-  offset = 0;
+  offset = inf_text_chunk_segment_subtree_length(segment->left);
+  for(; segment->parent != NULL; segment = segment->parent)
+  {
+    if(segment->parent->right == segment)
+    {
+      offset += segment->parent->length;
+      offset += inf_text_chunk_segment_subtree_length(segment->parent->left);
+    }
+  }
 
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+  return offset;
+}
+#endif
+
+static gsize
+inf_text_chunk_segment_get_byte_index(InfTextChunk* self,
+                                      InfTextChunkSegment* segment,
+                                      guint offset)
+{
+  g_assert(offset <= segment->length);
+
+  if(offset == 0)
+    return 0;
+  if(offset == segment->length)
+    return segment->bytes;
+
+  return self->path->get_byte_index(
+    self,
+    segment->text,
+    segment->bytes,
+    offset
+  );
+}
+
+#ifdef CHUNK_CHECK_INTEGRITY
+static gboolean
+inf_text_chunk_check_subtree(InfTextChunkSegment* segment)
+{
+  guint left_height;
+  guint right_height;
+
+  if(segment == NULL)
+    return TRUE;
+
+  if(segment->length == 0 ||
+     segment->length > INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH)
   {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
-    if(offset != segment->offset)
-      return FALSE;
+    return FALSE;
+  }
 
-    new_offset = inf_text_chunk_next_offset(self, iter);
-    if(new_offset <= offset)
-      return FALSE;
+  if(segment->left != NULL && segment->left->parent != segment)
+    return FALSE;
+  if(segment->right != NULL && segment->right->parent != segment)
+    return FALSE;
 
-    if(new_offset - offset > segment->length)
-      return FALSE;
+  if(!inf_text_chunk_check_subtree(segment->left) ||
+     !inf_text_chunk_check_subtree(segment->right))
+  {
+    return FALSE;
+  }
+
+  left_height = inf_text_chunk_segment_height(segment->left);
+  right_height = inf_text_chunk_segment_height(segment->right);
+
+  if(left_height > right_height + 1 || right_height > left_height + 1)
+    return FALSE;
+  if(segment->height != 1 + MAX(left_height, right_height))
+    return FALSE;
+
+  if(segment->subtree_length != segment->length +
+     inf_text_chunk_segment_subtree_length(segment->left) +
+     inf_text_chunk_segment_subtree_length(segment->right))
+  {
+    return FALSE;
+  }
 
-    offset = new_offset;
+  if(segment->subtree_bytes != segment->bytes +
+     inf_text_chunk_segment_subtree_bytes(segment->left) +
+     inf_text_chunk_segment_subtree_bytes(segment->right))
+  {
+    return FALSE;
   }
 
   return TRUE;
 }
+
+static gboolean
+inf_text_chunk_check_integrity(InfTextChunk* self)
+{
+  if(self->tree->root != NULL && self->tree->root->parent != NULL)
+    return FALSE;
+
+  return inf_text_chunk_check_subtree(self->tree->root);
+}
 #endif
 
-static GSequenceIter*
+/* Returns the segment containing the character at pos, and the offset of
+ * pos within that segment. If pos is the end of the chunk, then the last
+ * segment is returned, and offset is set to its length. The chunk must not
+ * be empty. */
+static InfTextChunkSegment*
 inf_text_chunk_get_segment(InfTextChunk* self,
                            guint pos,
-                           gsize* index)
+                           guint* offset)
 {
-  InfTextChunkSegment* found;
-  InfTextChunkSegment key;
-  GSequenceIter* iter;
+  InfTextChunkSegment* segment;
+  guint left_length;
 
-  g_assert(pos <= self->length);
+  g_assert(self->tree->root != NULL);
+  g_assert(pos <= self->tree->root->subtree_length);
 
-  /* only offset is relevant for lookup */
-  key.offset = pos;
+  segment = self->tree->root;
+  for(;;)
+  {
+    left_length = inf_text_chunk_segment_subtree_length(segment->left);
 
-  /* TODO: Verify this does binary search */
-  iter = g_sequence_search(
-    self->segments,
-    &key,
-    inf_text_chunk_segment_cmp,
-    NULL
+    if(pos < left_length)
+    {
+      segment = segment->left;
+    }
+    else if(pos < left_length + segment->length || segment->right == NULL)
+    {
+      *offset = pos - left_length;
+      return segment;
+    }
+    else
+    {
+      pos -= left_length + segment->length;
+      segment = segment->right;
+    }
+  }
+}
+
+/* Splits segment at the given character offset, which must lie strictly
+ * within it. The text behind offset is moved into a new segment which is
+ * inserted after segment and returned. */
+static InfTextChunkSegment*
+inf_text_chunk_split_segment(InfTextChunk* self,
+                             InfTextChunkSegment* segment,
+                             guint offset)
+{
+  InfTextChunkSegment* new_segment;
+  gsize index;
+
+  g_assert(offset > 0 && offset < segment->length);
+
+  index = inf_text_chunk_segment_get_byte_index(self, segment, offset);
+
+  new_segment = inf_text_chunk_segment_new(
+    segment->author,
+    segment->text + index,
+    segment->bytes - index,
+    segment->length - offset
   );
 
-  if(self->length > 0)
-  {
-    g_assert(iter != g_sequence_get_begin_iter(self->segments));
+  /* Don't realloc to make smaller */
+  segment->bytes = index;
+  segment->length = offset;
+  inf_text_chunk_segment_update_path(segment);
 
-    iter = g_sequence_iter_prev(iter);
-    found = g_sequence_get(iter);
+  inf_text_chunk_insert_segment_after(self, segment, new_segment);
+  return new_segment;
+}
 
-    g_assert(pos >= found->offset);
+/* Merges right into left if both are written by the same author and the
+ * result does not exceed the maximum segment length. right must directly
+ * follow left. */
+static void
+inf_text_chunk_try_merge_segments(InfTextChunk* self,
+                                  InfTextChunkSegment* left,
+                                  InfTextChunkSegment* right)
+{
+  if(left->author == right->author &&
+     left->length + right->length <= INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH)
+  {
+    left->text = g_realloc(left->text, left->bytes + right->bytes);
+    memcpy(left->text + left->bytes, right->text, right->bytes);
+    left->bytes += right->bytes;
+    left->length += right->length;
+    inf_text_chunk_segment_update_path(left);
+
+    inf_text_chunk_remove_segment(self, right);
+    inf_text_chunk_segment_free(right);
+  }
+}
 
-    /* This is not "<=" because it should rather find position 0 on the
-     * next segment in that case. */
-    g_assert(pos <= inf_text_chunk_next_offset(self, iter));
+/* Inserts text as new segments behind position (or at the beginning, if
+ * position is NULL), splitting it into pieces of at most
+ * INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH characters. */
+static void
+inf_text_chunk_insert_segments(InfTextChunk* self,
+                               InfTextChunkSegment* position,
+                               const gchar* text,
+                               gsize bytes,
+                               guint length,
+                               guint author)
+{
+  InfTextChunkSegment* new_segment;
+  guint piece_length;
+  gsize piece_bytes;
 
-    /* Find byte index in the segment where the specified character starts.
-     * This is rather ugly, I wish iconv or glib or someone had some nice(r)
-     * API for this. */
-    if(index != NULL)
+  while(length > 0)
+  {
+    if(length > INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH)
     {
-      if(pos == inf_text_chunk_next_offset(self, iter))
-      {
-        *index = found->length;
-      }
-      else
-      {
-        *index = self->path->get_byte_index(
-          self,
-          found->text,
-          found->length,
-          pos - found->offset
-        );
-      }
+      piece_length = INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH;
+      piece_bytes = self->path->get_byte_index(
+        self,
+        (gchar*)text,
+        bytes,
+        piece_length
+      );
     }
+    else
+    {
+      piece_length = length;
+      piece_bytes = bytes;
+    }
+
+    new_segment =
+      inf_text_chunk_segment_new(author, text, piece_bytes, piece_length);
+    inf_text_chunk_insert_segment_after(self, position, new_segment);
+    position = new_segment;
+
+    text += piece_bytes;
+    bytes -= piece_bytes;
+    length -= piece_length;
   }
-  else
-  {
-    if(index != NULL)
-      *index = 0;
-  }
-  
-  return iter;
 }
 
 /*
@@ -346,18 +1082,10 @@ InfTextChunk*
 inf_text_chunk_new(const gchar* encoding)
 {
   InfTextChunk* chunk = g_slice_new(InfTextChunk);
-  
-  chunk->segments = g_sequence_new(
-    (GDestroyNotify)inf_text_chunk_segment_free
-  );
 
-  chunk->length = 0;
+  chunk->tree = inf_text_chunk_tree_new(NULL);
   chunk->encoding = g_quark_from_string(encoding);
-
-  if(chunk->encoding == g_quark_from_static_string("UTF-8"))
-    chunk->path = &INF_TEXT_CHUNK_PATH_UTF8;
-  else
-    chunk->path = &INF_TEXT_CHUNK_PATH_ICONV;
+  chunk->path = inf_text_chunk_lookup_path(encoding);
 
   return chunk;
 }
@@ -366,7 +1094,9 @@ inf_text_chunk_new(const gchar* encoding)
  * inf_text_chunk_copy:
  * @self: A #InfTextChunk.
  *
- * Returns a copy of @self.
+ * Returns a copy of @self. The copy shares its content with @self until
+ * either of the two is modified, therefore this function is cheap
+ * regardless of the size of @self.
  *
  * Returns: (transfer full): A new #InfTextChunk.
  **/
@@ -374,32 +1104,15 @@ InfTextChunk*
 inf_text_chunk_copy(InfTextChunk* self)
 {
   InfTextChunk* new_chunk;
-  GSequenceIter* iter;
 
   g_return_val_if_fail(self != NULL, NULL);
 
   new_chunk = g_slice_new(InfTextChunk);
-  new_chunk->segments = g_sequence_new(
-    (GDestroyNotify)inf_text_chunk_segment_free
-  );
-  
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
-  {
-    InfTextChunkSegment* segment = g_sequence_get(iter);
-    InfTextChunkSegment* new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = segment->author;
-    new_segment->text = g_memdup(segment->text, segment->length);
-    new_segment->length = segment->length;
-    new_segment->offset = segment->offset;
-    g_sequence_append(new_chunk->segments, new_segment);
-  }
-
-  new_chunk->length = self->length;
+  new_chunk->tree = self->tree;
   new_chunk->encoding = self->encoding;
   new_chunk->path = self->path;
 
+  ++self->tree->ref_count;
   return new_chunk;
 }
 
@@ -414,7 +1127,7 @@ void
 inf_text_chunk_free(InfTextChunk* self)
 {
   g_return_if_fail(self != NULL);
-  g_sequence_free(self->segments);
+  inf_text_chunk_tree_unref(self->tree);
   g_slice_free(InfTextChunk, self);
 }
 
@@ -445,7 +1158,30 @@ guint
 inf_text_chunk_get_length(InfTextChunk* self)
 {
   g_return_val_if_fail(self != NULL, 0);
-  return self->length;
+  return inf_text_chunk_segment_subtree_length(self->tree->root);
+}
+
+/**
+ * inf_text_chunk_get_memory_size:
+ * @self: A #InfTextChunk.
+ *
+ * Returns the number of bytes of memory held by @self, including the text
+ * and the bookkeeping for its segments. Copies of a chunk share their
+ * segments until one of them is modified; the shared memory is accounted
+ * for in each of them, so summing the values of several chunks can
+ * overestimate the total.
+ *
+ * Returns: The memory used by @self, in bytes.
+ **/
+gsize
+inf_text_chunk_get_memory_size(InfTextChunk* self)
+{
+  g_return_val_if_fail(self != NULL, 0);
+
+  return sizeof(InfTextChunk) + sizeof(InfTextChunkTree) +
+    inf_text_chunk_segment_count_subtree(self->tree->root) *
+      sizeof(InfTextChunkSegment) +
+    inf_text_chunk_segment_subtree_bytes(self->tree->root);
 }
 
 /**
@@ -464,86 +1200,65 @@ inf_text_chunk_substring(InfTextChunk* self,
                          guint begin,
                          guint length)
 {
-  GSequenceIter* begin_iter;
-  GSequenceIter* end_iter;
-  gsize begin_index;
-  gsize end_index;
-
   InfTextChunk* result;
+  GPtrArray* segments;
   InfTextChunkSegment* segment;
-  InfTextChunkSegment* new_segment;
-  guint current_length;
+  guint offset;
+  guint segment_length;
+  gsize begin_index;
+  gsize end_index;
 
   g_return_val_if_fail(self != NULL, NULL);
-  g_return_val_if_fail(begin + length <= self->length, NULL);
-
-  if(self->length > 0 && length > 0)
-  {
-    begin_iter = inf_text_chunk_get_segment(self, begin, &begin_index);
-    end_iter = inf_text_chunk_get_segment(self, begin + length, &end_index);
+  g_return_val_if_fail(
+    begin + length <= inf_text_chunk_get_length(self),
+    NULL
+  );
 
-    if(end_index == 0)
-    {
-      g_assert(end_iter != g_sequence_get_end_iter(self->segments));
-      end_iter = g_sequence_iter_prev(end_iter);
-      end_index = ((InfTextChunkSegment*)g_sequence_get(end_iter))->length;
-    }
+  /* The whole chunk is requested, so we can share the content */
+  if(begin == 0 && length == inf_text_chunk_get_length(self))
+    return inf_text_chunk_copy(self);
 
-    result = inf_text_chunk_new(g_quark_to_string(self->encoding));
+  result = inf_text_chunk_new(g_quark_to_string(self->encoding));
 
-    current_length = 0;
-    segment = g_sequence_get(begin_iter);
+  if(length > 0)
+  {
+    segments = g_ptr_array_new();
+    segment = inf_text_chunk_get_segment(self, begin, &offset);
 
-    while(begin_iter != end_iter)
+    while(length > 0)
     {
-      new_segment = g_slice_new(InfTextChunkSegment);
-      new_segment->author = segment->author;
+      g_assert(segment != NULL);
+
+      segment_length = MIN(segment->length - offset, length);
+      begin_index = inf_text_chunk_segment_get_byte_index(self, segment, offset);
+      end_index = inf_text_chunk_segment_get_byte_index(
+        self,
+        segment,
+        offset + segment_length
+      );
 
-      new_segment->text = g_memdup(
-        segment->text + begin_index,
-        segment->length - begin_index
+      g_ptr_array_add(
+        segments,
+        inf_text_chunk_segment_new(
+          segment->author,
+          segment->text + begin_index,
+          end_index - begin_index,
+          segment_length
+        )
       );
-      
-      new_segment->length = segment->length - begin_index;
-      new_segment->offset = current_length;
-
-      begin_iter = g_sequence_iter_next(begin_iter);
-      segment = g_sequence_get(begin_iter);
-
-      /* Add (remaining) length of this segment to current length */
-      current_length = segment->offset - begin;
-
-      /* So we get the next segment from the beginning. This may only be
-       * non-zero during the first iteration. */
-      begin_index = 0;
-    /*  begin = new_segment->offset;*/
-      
-      g_sequence_append(result->segments, new_segment);
+
+      length -= segment_length;
+      offset = 0;
+      segment = inf_text_chunk_segment_next(segment);
     }
 
-    /* Don't forget last segment */
-    new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = segment->author;
-    new_segment->text = g_memdup(
-      segment->text + begin_index,
-      end_index - begin_index
+    result->tree->root = inf_text_chunk_build_tree(
+      (InfTextChunkSegment**)segments->pdata,
+      segments->len,
+      NULL
     );
-    
-    new_segment->length = end_index - begin_index;
-    new_segment->offset = current_length;
-    
-    g_sequence_append(result->segments, new_segment);
-
-    result->length = length;
-    result->encoding = self->encoding;
-    result->path = self->path;
-  }
-  else
-  {
-    g_assert(length == 0 || begin == 0);
 
-    /* New, empty chunk */
-    result = inf_text_chunk_new(g_quark_to_string(self->encoding));
+    g_ptr_array_free(segments, TRUE);
   }
 
 #ifdef CHUNK_CHECK_INTEGRITY
@@ -574,103 +1289,81 @@ inf_text_chunk_insert_text(InfTextChunk* self,
                            guint length,
                            guint author)
 {
-  GSequenceIter* iter;
-  gsize offset_index;
   InfTextChunkSegment* segment;
-  InfTextChunkSegment* new_segment;
+  guint segment_offset;
+  gsize offset_index;
 
   g_return_if_fail(self != NULL);
-  g_return_if_fail(offset <= self->length);
+  g_return_if_fail(offset <= inf_text_chunk_get_length(self));
+
+  if(length == 0)
+    return;
+
+  inf_text_chunk_make_writable(self);
 
-  if(self->length > 0)
+  if(self->tree->root != NULL)
   {
-    iter = inf_text_chunk_get_segment(self, offset, &offset_index);
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
+    segment = inf_text_chunk_get_segment(self, offset, &segment_offset);
 
-    /* Have to split segment, unless it is between two segments in which
-     * case we can perhaps append to the previous. */
-    if(segment->author != author && offset > 0 && offset_index == 0)
+    /* If inserting between two segments, then try to append to the
+     * previous one. */
+    if(segment_offset == 0 && offset > 0)
     {
-      g_assert(iter != g_sequence_get_begin_iter(self->segments));
-
-      iter = g_sequence_iter_prev(iter);
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
-      offset_index = segment->length;
+      segment = inf_text_chunk_segment_prev(segment);
+      segment_offset = segment->length;
     }
 
-    if(segment->author != author)
+    if(segment->author == author &&
+       segment->length + length <= INF_TEXT_CHUNK_MAX_SEGMENT_LENGTH)
     {
-      /* No luck, split if necessary */
-      if(offset_index > 0 && offset_index < segment->length)
+      /* Insert into existing segment */
+      offset_index = inf_text_chunk_segment_get_byte_index(
+        self,
+        segment,
+        segment_offset
+      );
+
+      segment->text = g_realloc(segment->text, segment->bytes + bytes);
+      if(offset_index < segment->bytes)
       {
-        new_segment = g_slice_new(InfTextChunkSegment);
-        new_segment->author = segment->author;
-        new_segment->text = g_memdup(
+        g_memmove(
+          segment->text + offset_index + bytes,
           segment->text + offset_index,
-          segment->length - offset_index
+          segment->bytes - offset_index
         );
-
-        new_segment->length = segment->length - offset_index;
-        new_segment->offset = offset;
-
-        iter = g_sequence_iter_next(iter);
-        iter = g_sequence_insert_before(iter, new_segment);
-
-        /* Don't realloc to make smaller */
-        segment->length = offset_index;
-        /* Note that we did not invalidate offsets so far */
-      }
-      else if(offset_index == segment->length)
-      {
-        /* Insert behind segment */
-        iter = g_sequence_iter_next(iter);
       }
 
-      new_segment = g_slice_new(InfTextChunkSegment);
-      new_segment->author = author;
-      new_segment->text = g_memdup(text, bytes);
-      new_segment->length = bytes;
-      new_segment->offset = offset;
-      g_sequence_insert_before(iter, new_segment);
+      memcpy(segment->text + offset_index, text, bytes);
+      segment->bytes += bytes;
+      segment->length += length;
+      inf_text_chunk_segment_update_path(segment);
     }
     else
     {
-      /* TODO: g_malloc + g_free + 2*memcpy? */
-      segment->text = g_realloc(segment->text, segment->length + bytes);
-      if(offset_index < segment->length)
+      /* Split if necessary, and insert new segments inbetween */
+      if(segment_offset == 0)
       {
-        g_memmove(
-          segment->text + offset_index + bytes,
-          segment->text + offset_index,
-          segment->length - offset_index
-        );
+        g_assert(offset == 0);
+        segment = NULL;
+      }
+      else if(segment_offset < segment->length)
+      {
+        inf_text_chunk_split_segment(self, segment, segment_offset);
       }
-      
-      memcpy(segment->text + offset_index, text, bytes);
-      segment->length += bytes;
-      iter = g_sequence_iter_next(iter);
-    }
 
-    /* Adjust offsets */
-    while(iter != g_sequence_get_end_iter(self->segments))
-    {
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
-      segment->offset += length;
-      iter = g_sequence_iter_next(iter);
+      inf_text_chunk_insert_segments(
+        self,
+        segment,
+        text,
+        bytes,
+        length,
+        author
+      );
     }
-
-    self->length += length;
   }
   else
   {
-    new_segment = g_slice_new(InfTextChunkSegment);
-    new_segment->author = author;
-    new_segment->text = g_memdup(text, bytes);
-    new_segment->length = bytes;
-    new_segment->offset = 0;
-
-    g_sequence_append(self->segments, new_segment);
-    self->length = length;
+    inf_text_chunk_insert_segments(self, NULL, text, bytes, length, author);
   }
 
 #ifdef CHUNK_CHECK_INTEGRITY
@@ -692,267 +1385,94 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
                             guint offset,
                             InfTextChunk* text)
 {
-  GSequenceIter* iter;
-  GSequenceIter* text_iter;
-  gsize offset_index;
-  InfTextChunkSegment* segment;
-  InfTextChunkSegment* new_segment;
+  g_return_if_fail(text != NULL);
 
-  GSequenceIter* first_iter;
-  GSequenceIter* last_iter;
-  InfTextChunkSegment* first;
-  InfTextChunkSegment* last;
+  inf_text_chunk_insert_substring(
+    self,
+    offset,
+    text,
+    0,
+    inf_text_chunk_get_length(text)
+  );
+}
 
-  InfTextChunkSegment* first_merge;
-  InfTextChunkSegment* last_merge;
-  GSequenceIter* beyond;
+/**
+ * inf_text_chunk_insert_substring:
+ * @self: A #InfTextChunk.
+ * @offset: Character offset at which to insert text.
+ * @text: (transfer none): Chunk to take the text to insert from.
+ * @begin: A character offset into @text.
+ * @length: Number of characters of @text to insert.
+ *
+ * Inserts @length characters of @text, beginning at character offset
+ * @begin, into @self at position @offset. This is equivalent to inserting
+ * the result of inf_text_chunk_substring() with inf_text_chunk_insert_chunk(),
+ * but the text is copied from @text into @self directly, without creating
+ * an intermediate chunk. @text and @self must have the same encoding.
+ **/
+void
+inf_text_chunk_insert_substring(InfTextChunk* self,
+                                guint offset,
+                                InfTextChunk* text,
+                                guint begin,
+                                guint length)
+{
+  InfTextChunkSegment* segment;
+  guint segment_offset;
+  guint segment_length;
+  gsize begin_index;
+  gsize end_index;
 
   g_return_if_fail(self != NULL);
-  g_return_if_fail(offset <= self->length);
+  g_return_if_fail(offset <= inf_text_chunk_get_length(self));
   g_return_if_fail(text != NULL);
+  g_return_if_fail(self != text);
   g_return_if_fail(self->encoding == text->encoding);
+  g_return_if_fail(begin + length <= inf_text_chunk_get_length(text));
 
-  if(self->length > 0 && text->length > 0)
-  {
-    if(g_sequence_get_length(text->segments) == 1)
-    {
-      segment = g_sequence_get(g_sequence_get_begin_iter(text->segments));
-
-      inf_text_chunk_insert_text(
-        self,
-        offset,
-        segment->text,
-        segment->length,
-        text->length,
-        segment->author
-      );
-    }
-    else
-    {
-      iter = inf_text_chunk_get_segment(self, offset, &offset_index);
-      segment = (InfTextChunkSegment*)g_sequence_get(iter);
-
-      /* First, we insert the first and last segment of text into self,
-       * possibly merging with adjacent segments. Then, the rest is
-       * copied. */
-      first_iter = g_sequence_get_begin_iter(text->segments);
-      last_iter = g_sequence_iter_prev(
-        g_sequence_get_end_iter(text->segments)
-      );
-
-      first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-      last = (InfTextChunkSegment*)g_sequence_get(last_iter);
-
-      /* 0 and 1 segment special cases have been handled above */
-      g_assert(first != last);
-
-      last_merge = segment;
-      first_merge = segment;
-
-      /* beyond points to the first segment that needs offset adjustment
-       * after insertion */
-      beyond = iter;
-
-      /* Try merge with end of previous segment if inserting inbetween two
-       * segments. */
-      if(offset_index == 0 && offset > 0)
-      {
-        g_assert(iter != g_sequence_get_begin_iter(self->segments));
-
-        iter = g_sequence_iter_prev(iter);
-        first_merge = (InfTextChunkSegment*)g_sequence_get(iter);
-        offset_index = first_merge->length;
-      }
-
-      if(offset == 0 || offset == self->length || first_merge != last_merge)
-      {
-        /* Insert between two segments, or at beginning/end */
-        if(first_merge->author == first->author && offset > 0)
-        {
-          /* Can merge first segment */
-          first_merge->length += first->length;
-
-          first_merge->text = g_realloc(
-            first_merge->text,
-            first_merge->length
-          );
-
-          memcpy(
-            first_merge->text + first_merge->length - first->length,
-            first->text,
-            first->length
-          );
-
-          /* Already inserted */
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-
-        if(last_merge->author == last->author && offset < self->length)
-        {
-          /* Can merge last segment */
-          last_merge->length += last->length;
-          last_merge->text = g_realloc(last_merge->text, last_merge->length);
-
-          g_memmove(
-            last_merge->text + last->length,
-            last_merge->text,
-            last_merge->length - last->length
-          );
-
-          memcpy(last_merge->text, last->text, last->length);
-          last_merge->offset = offset + last->offset;
-
-          /* Merged with last, so don't need to adjust last_merge->offset
-           * anymore, continue behind with offset adjustment. */
-          beyond = g_sequence_iter_next(beyond);
-        }
-        else
-        {
-          /* Could not merge last segment, so we have to insert it. Therefore,
-           * make last_iter point to the end of the sequence. */
-          last_iter = g_sequence_iter_next(last_iter);
-
-          if(offset_index > 0) /* Note: This is only false for offset == 0 */
-            beyond = g_sequence_iter_next(iter);
-        }
-
-        if(offset_index > 0) /* Note: This is only false for offset == 0 */
-        {
-          /* Pointing to the position before which to insert
-           * the rest of text. */
-          iter = g_sequence_iter_next(iter);
-        }
-      }
-      else
-      {
-        /* Insert within a segment, split segment */
-
-        new_segment = g_slice_new(InfTextChunkSegment);
-        new_segment->author = last_merge->author;
-
-        if(last_merge->author == last->author)
-        {
-          /* Merge last part into new segment */
-          new_segment->length = last_merge->length - offset_index +
-            last->length;
-
-          new_segment->text = g_malloc(new_segment->length);
-          memcpy(new_segment->text, last->text, last->length);
-
-          memcpy(
-            new_segment->text + last->length,
-            last_merge->text + offset_index,
-            last_merge->length - offset_index
-          );
-
-          new_segment->offset = offset + last->offset;
-        }
-        else
-        {
-          /* Split up last part */
-          new_segment->length = last_merge->length - offset_index;
-          new_segment->text = g_malloc(new_segment->length);
-
-          memcpy(
-            new_segment->text,
-            last_merge->text + offset_index,
-            new_segment->length
-          );
-
-          new_segment->offset = offset + text->length;
-
-          /* We still have to insert last segment since we could not merge */
-          last_iter = g_sequence_iter_next(last_iter);
-        }
-
-        iter = g_sequence_iter_next(iter);
-        iter = g_sequence_insert_before(iter, new_segment);
-
-        /* The segment just inserted is the last one being inserted, so
-         * we need to adjust beyond that */
-        beyond = g_sequence_iter_next(iter);
-
-        /* Note first_merge == last_merge */
-        if(first_merge->author == first->author)
-        {
-          /* Merge into first */
-          if(first_merge->length < offset_index + first->length)
-          {
-            first_merge->text = g_realloc(
-              first_merge->text,
-              offset_index + first->length
-            );
-          }
-
-          first_merge->length = offset_index + first->length;
-
-          memcpy(
-            first_merge->text + offset_index,
-            first->text,
-            first->length
-          );
-
-          /* Already inserted */
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-        else
-        {
-          /* Cannot merge, just cut */
-          first_merge->length = offset_index;
-        }
-      }
-
-      /* iter now points to the segment before which the rest of text has to
-       * be inserted */
-
-      for(text_iter = first_iter;
-          text_iter != last_iter;
-          text_iter = g_sequence_iter_next(text_iter))
-      {
-        segment = g_sequence_get(text_iter);
-        new_segment = g_slice_new(InfTextChunkSegment);
-
-        new_segment->author = segment->author;
-        new_segment->text = g_memdup(segment->text, segment->length);
-        new_segment->length = segment->length;
-        new_segment->offset = offset + segment->offset;
-        g_sequence_insert_before(iter, new_segment);
-      }
-
-      for(iter = beyond;
-          iter != g_sequence_get_end_iter(self->segments);
-          iter = g_sequence_iter_next(iter))
-      {
-        segment = g_sequence_get(iter);
-        segment->offset += inf_text_chunk_get_length(text);
-      }
+  if(length == 0)
+    return;
 
-      self->length += text->length;
-    }
-  }
-  else
+  /* If self is empty and all of text is inserted, then simply share the
+   * content of text */
+  if(self->tree->root == NULL && length == inf_text_chunk_get_length(text))
   {
-    for(text_iter = g_sequence_get_begin_iter(text->segments);
-        text_iter != g_sequence_get_end_iter(text->segments);
-        text_iter = g_sequence_iter_next(text_iter))
-    {
-      segment = (InfTextChunkSegment*)g_sequence_get(text_iter);
-      new_segment = g_slice_new(InfTextChunkSegment);
+    inf_text_chunk_tree_unref(self->tree);
+    self->tree = text->tree;
+    ++self->tree->ref_count;
+    return;
+  }
 
-      new_segment->author = segment->author;
-      new_segment->text = g_memdup(segment->text, segment->length);
-      new_segment->length = segment->length;
-      new_segment->offset = segment->offset;
+  /* Each piece is inserted behind the previous one, so that adjacent
+   * segments by the same author are merged where possible. */
+  segment = inf_text_chunk_get_segment(text, begin, &segment_offset);
+  while(length > 0)
+  {
+    g_assert(segment != NULL);
+
+    segment_length = MIN(segment->length - segment_offset, length);
+    begin_index =
+      inf_text_chunk_segment_get_byte_index(text, segment, segment_offset);
+    end_index = inf_text_chunk_segment_get_byte_index(
+      text,
+      segment,
+      segment_offset + segment_length
+    );
 
-      g_sequence_append(self->segments, new_segment);
-    }
+    inf_text_chunk_insert_text(
+      self,
+      offset,
+      segment->text + begin_index,
+      end_index - begin_index,
+      segment_length,
+      segment->author
+    );
 
-    self->length += text->length;
+    offset += segment_length;
+    length -= segment_length;
+    segment_offset = 0;
+    segment = inf_text_chunk_segment_next(segment);
   }
-
-#ifdef CHUNK_CHECK_INTEGRITY
-  g_assert(inf_text_chunk_check_integrity(self) == TRUE);
-#endif
 }
 
 /**
@@ -968,177 +1488,69 @@ inf_text_chunk_erase(InfTextChunk* self,
                      guint begin,
                      guint length)
 {
-  GSequenceIter* first_iter;
-  GSequenceIter* last_iter;
-  GSequenceIter* beyond;
-  gsize first_index;
-  gsize last_index;
-  InfTextChunkSegment* first;
-  InfTextChunkSegment* last;
+  InfTextChunkSegment* segment;
+  InfTextChunkSegment* prev;
+  InfTextChunkSegment* next;
+  guint segment_offset;
+  gsize index;
 
   g_return_if_fail(self != NULL);
-  g_return_if_fail(begin + length <= self->length);
+  g_return_if_fail(begin + length <= inf_text_chunk_get_length(self));
 
-  if(self->length > 0 && length > 0)
-  {
-    first_iter = inf_text_chunk_get_segment(self, begin, &first_index);
-    last_iter = inf_text_chunk_get_segment(self, begin + length, &last_index);
+  if(length == 0)
+    return;
 
-    first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-    last = (InfTextChunkSegment*)g_sequence_get(last_iter);
+  inf_text_chunk_make_writable(self);
 
-    if(begin > 0 && begin + length < self->length)
-    {
-      if(first_index == 0)
-      {
-        g_assert(first_iter != g_sequence_get_end_iter(self->segments));
-        first_iter = g_sequence_iter_prev(first_iter);
-        first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-        first_index = first->length;
-      }
+  segment = inf_text_chunk_get_segment(self, begin, &segment_offset);
+  if(segment_offset > 0)
+  {
+    prev = segment;
+    segment = inf_text_chunk_split_segment(self, segment, segment_offset);
+  }
+  else
+  {
+    prev = inf_text_chunk_segment_prev(segment);
+  }
 
-      if(first->author == last->author)
-      {
-        /* Can merge */
-        if(first == last)
-        {
-          /* Remove within a segment */
-          g_memmove(
-            first->text + first_index,
-            first->text + last_index,
-            first->length - last_index
-          );
-
-          first->length -= (last_index - first_index);
-          beyond = g_sequence_iter_next(last_iter);
-        }
-        else
-        {
-          if(first->length < first_index + last->length - last_index)
-          {
-            first->text = g_realloc(
-              first->text,
-              first_index + last->length - last_index
-            );
-          }
-
-          first->length = first_index + last->length - last_index;
-
-          memcpy(
-            first->text + first_index,
-            last->text + last_index,
-            last->length - last_index
-          );
-
-          last_iter = g_sequence_iter_next(last_iter);
-          beyond = last_iter;
-        }
-      }
-      else
-      {
-        /* This could only happen if these are the first or last segment,
-         * of the whole chunk, respectively, which they are not
-         * (as checked above). */
-        g_assert(first_index > 0);
-        g_assert(last_index < last->length);
-        
-        /* Erase from border segments */
-        first->length = first_index;
-
-        if(last_index > 0)
-        {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-        }
-
-        last->length -= last_index;
-        last->offset = begin;
-
-        /* We already adjusted offset of last, so only adjust behind */
-        beyond = g_sequence_iter_next(last_iter);
-      }
+  /* Now the erased range starts at the beginning of segment */
+  while(length > 0)
+  {
+    g_assert(segment != NULL);
 
-      /* Keep first alive, we merged stuff into it */
-      first_iter = g_sequence_iter_next(first_iter);
-    }
-    else
+    if(segment->length > length)
     {
-      if(begin == 0 && length == self->length)
-      {
-        /* Erase everything */
-        last_iter = g_sequence_iter_next(last_iter);
-        g_assert(last_iter == g_sequence_get_end_iter(self->segments));
-
-        beyond = last_iter;
-      }
-      else if(begin == 0)
-      {
-        g_assert(last_index < last->length);
-
-        /* Erase from beginning */
-        if(last_index > 0)
-        {
-          g_memmove(
-            last->text,
-            last->text + last_index,
-            last->length - last_index
-          );
-
-          last->length -= last_index;
-          last->offset = 0;
-
-          beyond = g_sequence_iter_next(last_iter);
-        }
-        else
-        {
-          /* First segments are completely removed */
-          beyond = last_iter;
-        }
-      }
-      else
-      {
-        /* Erase until end */
-
-        /* This could only be possible in the last segment, but then we
-         * would erase 0-length, which is a special case we would have
-         * catched elsewhere. */
-        g_assert(first_index < first->length);
+      /* Erase from beginning of segment */
+      index = inf_text_chunk_segment_get_byte_index(self, segment, length);
 
+      g_memmove(
+        segment->text,
+        segment->text + index,
+        segment->bytes - index
+      );
 
-        if(first_index > 0)
-        {
-          /* Cannot erase whole first chunk */
-          first->length = first_index;
-          first_iter = g_sequence_iter_next(first_iter);
-        }
-        
-        last_iter = g_sequence_iter_next(last_iter);
-        g_assert(last_iter == g_sequence_get_end_iter(self->segments));
+      segment->bytes -= index;
+      segment->length -= length;
+      inf_text_chunk_segment_update_path(segment);
 
-        beyond = last_iter;
-      }
+      length = 0;
     }
+    else
+    {
+      /* Remove segment completely */
+      next = inf_text_chunk_segment_next(segment);
+      length -= segment->length;
 
-    /* first_iter and last_iter have been adjusted so that we have to
-     * remove [first_iter, last_iter). */
-
-    /* segments are freed through the sequence's destroy function */
-    g_sequence_remove_range(first_iter, last_iter);
+      inf_text_chunk_remove_segment(self, segment);
+      inf_text_chunk_segment_free(segment);
 
-    /* adjust offsets */
-    for(first_iter = beyond;
-        first_iter != g_sequence_get_end_iter(self->segments);
-        first_iter = g_sequence_iter_next(first_iter))
-    {
-      first = (InfTextChunkSegment*)g_sequence_get(first_iter);
-      first->offset -= length;
+      segment = next;
     }
   }
 
-  self->length -= length;
+  /* Try to join the segments on both sides of the erased range */
+  if(prev != NULL && segment != NULL)
+    inf_text_chunk_try_merge_segments(self, prev, segment);
 
 #ifdef CHUNK_CHECK_INTEGRITY
   g_assert(inf_text_chunk_check_integrity(self) == TRUE);
@@ -1161,90 +1573,245 @@ gpointer
 inf_text_chunk_get_text(InfTextChunk* self,
                         gsize* length)
 {
-  GSequenceIter* iter;
   InfTextChunkSegment* segment;
   gsize bytes;
   gsize cur;
   gchar* result;
-  
-  g_return_val_if_fail(self != NULL, NULL);
-  bytes = 0;
 
-  /* First pass, determine size */
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
-  {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
-    bytes += segment->length;
-  }
+  g_return_val_if_fail(self != NULL, NULL);
 
-  /* Second pass, copy */
+  bytes = inf_text_chunk_segment_subtree_bytes(self->tree->root);
   result = g_malloc(bytes);
   cur = 0;
 
-  for(iter = g_sequence_get_begin_iter(self->segments);
-      iter != g_sequence_get_end_iter(self->segments);
-      iter = g_sequence_iter_next(iter))
+  for(segment = inf_text_chunk_segment_first(self->tree->root);
+      segment != NULL;
+      segment = inf_text_chunk_segment_next(segment))
   {
-    segment = (InfTextChunkSegment*)g_sequence_get(iter);
-    memcpy(result + cur, segment->text, segment->length);
-    cur += segment->length;
+    memcpy(result + cur, segment->text, segment->bytes);
+    cur += segment->bytes;
   }
 
   if(length != NULL) *length = bytes;
   return result;
 }
 
+/* Appends the character offsets of all '\n' characters in the given UTF-8
+ * or single-byte ASCII-compatible text to newlines. */
+static void
+inf_text_chunk_find_newlines_ascii(const gchar* text,
+                                   gsize bytes,
+                                   gboolean utf8,
+                                   guint offset,
+                                   GArray* newlines)
+{
+  const gchar* pos;
+  const gchar* newline;
+
+  pos = text;
+  while( (newline = memchr(pos, '\n', text + bytes - pos)) != NULL)
+  {
+    if(utf8)
+      offset += inf_utf8_strlen(pos, newline - pos);
+    else
+      offset += newline - pos;
+
+    g_array_append_val(newlines, offset);
+
+    ++offset;
+    pos = newline + 1;
+  }
+}
+
 /**
- * inf_text_chunk_equal:
+ * inf_text_chunk_find_newlines:
  * @self: A #InfTextChunk.
- * @other: Another #InfTextChunk.
+ * @n_newlines: (out): Location to store the number of newline characters in
+ * @self.
  *
- * Returns whether the two text chunks contain the same text and the same
- * segments were written by the same authors.
+ * Returns the character offsets of all newline ('\n') characters in @self,
+ * in increasing order. For UTF-8 and single-byte encodings the text is
+ * scanned directly, for other encodings it is converted to UTF-8 first.
  *
- * Returns: Whether the two chunks are equal.
+ * Returns: (array length=n_newlines) (transfer full) (allow-none): The
+ * offsets of the newline characters in @self, or %NULL if there are none.
+ * Free with g_free() when no longer needed.
  **/
-gboolean
-inf_text_chunk_equal(InfTextChunk* self,
-                     InfTextChunk* other)
+guint*
+inf_text_chunk_find_newlines(InfTextChunk* self,
+                             guint* n_newlines)
 {
-  GSequenceIter* iter1;
-  GSequenceIter* iter2;
-  InfTextChunkSegment* segment1;
-  InfTextChunkSegment* segment2;
+  InfTextChunkSegment* segment;
+  GArray* newlines;
+  guint offset;
+  gchar* utf8_text;
+  gsize utf8_bytes;
 
-  g_return_val_if_fail(self != NULL, FALSE);
-  g_return_val_if_fail(other != NULL, FALSE);
-  g_return_val_if_fail(self->encoding == other->encoding, FALSE);
+  g_return_val_if_fail(self != NULL, NULL);
+  g_return_val_if_fail(n_newlines != NULL, NULL);
+
+  newlines = g_array_new(FALSE, FALSE, sizeof(guint));
+  offset = 0;
 
-  iter1 = g_sequence_get_begin_iter(self->segments);
-  iter2 = g_sequence_get_begin_iter(other->segments);
+  for(segment = inf_text_chunk_segment_first(self->tree->root);
+      segment != NULL;
+      segment = inf_text_chunk_segment_next(segment))
+  {
+    if(self->path == &INF_TEXT_CHUNK_PATH_UTF8 ||
+       self->path == &INF_TEXT_CHUNK_PATH_FIXED8)
+    {
+      inf_text_chunk_find_newlines_ascii(
+        segment->text,
+        segment->bytes,
+        self->path == &INF_TEXT_CHUNK_PATH_UTF8,
+        offset,
+        newlines
+      );
+    }
+    else
+    {
+      utf8_text = g_convert(
+        segment->text,
+        segment->bytes,
+        "UTF-8",
+        g_quark_to_string(self->encoding),
+        NULL,
+        &utf8_bytes,
+        NULL
+      );
+
+      /* The chunk only contains valid text in its encoding */
+      g_assert(utf8_text != NULL);
+
+      inf_text_chunk_find_newlines_ascii(
+        utf8_text,
+        utf8_bytes,
+        TRUE,
+        offset,
+        newlines
+      );
+
+      g_free(utf8_text);
+    }
 
-  while(iter1 != g_sequence_get_end_iter(self->segments) &&
-        iter2 != g_sequence_get_end_iter(other->segments))
+    offset += segment->length;
+  }
+
+  *n_newlines = newlines->len;
+  if(newlines->len == 0)
   {
-    segment1 = (InfTextChunkSegment*)g_sequence_get(iter1);
-    segment2 = (InfTextChunkSegment*)g_sequence_get(iter2);
+    g_array_free(newlines, TRUE);
+    return NULL;
+  }
 
-    if(segment1->length != segment2->length)
-      return FALSE;
+  return (guint*)g_array_free(newlines, FALSE);
+}
 
-    if(memcmp(segment1->text, segment2->text, segment1->length) != 0)
-      return FALSE;
+/* Compares the text of the two chunks, and also their authors if
+ * compare_authors is set. */
+static gboolean
+inf_text_chunk_compare(InfTextChunk* self,
+                       InfTextChunk* other,
+                       gboolean compare_authors)
+{
+  InfTextChunkSegment* segment1;
+  InfTextChunkSegment* segment2;
+  gsize index1;
+  gsize index2;
+  gsize bytes;
 
-    iter1 = g_sequence_iter_next(iter1);
-    iter2 = g_sequence_iter_next(iter2);
+  if(inf_text_chunk_segment_subtree_length(self->tree->root) !=
+     inf_text_chunk_segment_subtree_length(other->tree->root))
+  {
+    return FALSE;
   }
 
-  if(iter1 != g_sequence_get_end_iter(self->segments) ||
-     iter2 != g_sequence_get_end_iter(other->segments))
+  if(inf_text_chunk_segment_subtree_bytes(self->tree->root) !=
+     inf_text_chunk_segment_subtree_bytes(other->tree->root))
   {
     return FALSE;
   }
 
-  return TRUE;
+  /* Segment boundaries are not necessarily the same in both chunks, so
+   * compare byte ranges from both sides as far as they overlap. Since both
+   * chunks have the same encoding, authors are compared per byte, which is
+   * equivalent to comparing them per character. */
+  segment1 = inf_text_chunk_segment_first(self->tree->root);
+  segment2 = inf_text_chunk_segment_first(other->tree->root);
+  index1 = 0;
+  index2 = 0;
+
+  while(segment1 != NULL && segment2 != NULL)
+  {
+    if(compare_authors && segment1->author != segment2->author)
+      return FALSE;
+
+    bytes = MIN(segment1->bytes - index1, segment2->bytes - index2);
+    if(memcmp(segment1->text + index1, segment2->text + index2, bytes) != 0)
+      return FALSE;
+
+    index1 += bytes;
+    index2 += bytes;
+
+    if(index1 == segment1->bytes)
+    {
+      segment1 = inf_text_chunk_segment_next(segment1);
+      index1 = 0;
+    }
+
+    if(index2 == segment2->bytes)
+    {
+      segment2 = inf_text_chunk_segment_next(segment2);
+      index2 = 0;
+    }
+  }
+
+  return segment1 == NULL && segment2 == NULL;
+}
+
+/**
+ * inf_text_chunk_equal:
+ * @self: A #InfTextChunk.
+ * @other: Another #InfTextChunk.
+ *
+ * Returns whether the two text chunks contain the same text. Who wrote the
+ * text is not taken into account, use inf_text_chunk_equal_with_authors()
+ * for that. The way the text is split into segments internally does not
+ * matter.
+ *
+ * Returns: Whether the two chunks are equal.
+ **/
+gboolean
+inf_text_chunk_equal(InfTextChunk* self,
+                     InfTextChunk* other)
+{
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(other != NULL, FALSE);
+  g_return_val_if_fail(self->encoding == other->encoding, FALSE);
+
+  return inf_text_chunk_compare(self, other, FALSE);
+}
+
+/**
+ * inf_text_chunk_equal_with_authors:
+ * @self: A #InfTextChunk.
+ * @other: Another #InfTextChunk.
+ *
+ * Returns whether the two text chunks contain the same text, and each
+ * character was written by the same author in both chunks. The way the text
+ * is split into segments internally does not matter.
+ *
+ * Returns: Whether the two chunks are equal including authorship.
+ **/
+gboolean
+inf_text_chunk_equal_with_authors(InfTextChunk* self,
+                                  InfTextChunk* other)
+{
+  g_return_val_if_fail(self != NULL, FALSE);
+  g_return_val_if_fail(other != NULL, FALSE);
+  g_return_val_if_fail(self->encoding == other->encoding, FALSE);
+
+  return inf_text_chunk_compare(self, other, TRUE);
 }
 
 /**
@@ -1265,11 +1832,11 @@ inf_text_chunk_iter_init_begin(InfTextChunk* self,
   g_return_val_if_fail(self != NULL, FALSE);
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(self->length > 0)
+  if(self->tree->root != NULL)
   {
     iter->chunk = self;
-    iter->first = g_sequence_get_begin_iter(self->segments);
-    iter->second = g_sequence_iter_next(iter->first);
+    iter->segment = inf_text_chunk_segment_first(self->tree->root);
+    iter->offset = 0;
     return TRUE;
   }
   else
@@ -1293,14 +1860,18 @@ gboolean
 inf_text_chunk_iter_init_end(InfTextChunk* self,
                              InfTextChunkIter* iter)
 {
+  InfTextChunkSegment* last;
+
   g_return_val_if_fail(self != NULL, FALSE);
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(self->length > 0)
+  if(self->tree->root != NULL)
   {
+    last = inf_text_chunk_segment_last(self->tree->root);
+
     iter->chunk = self;
-    iter->second = g_sequence_get_end_iter(self->segments);
-    iter->first = g_sequence_iter_prev(iter->second);
+    iter->segment = last;
+    iter->offset = self->tree->root->subtree_length - last->length;
     return TRUE;
   }
   else
@@ -1321,12 +1892,18 @@ inf_text_chunk_iter_init_end(InfTextChunk* self,
 gboolean
 inf_text_chunk_iter_next(InfTextChunkIter* iter)
 {
+  InfTextChunkSegment* segment;
+  InfTextChunkSegment* next;
+
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(g_sequence_iter_is_end(iter->second) == FALSE)
+  segment = (InfTextChunkSegment*)iter->segment;
+  next = inf_text_chunk_segment_next(segment);
+
+  if(next != NULL)
   {
-    iter->first = iter->second;
-    iter->second = g_sequence_iter_next(iter->first);
+    iter->segment = next;
+    iter->offset += segment->length;
     return TRUE;
   }
   else
@@ -1347,12 +1924,16 @@ inf_text_chunk_iter_next(InfTextChunkIter* iter)
 gboolean
 inf_text_chunk_iter_prev(InfTextChunkIter* iter)
 {
+  InfTextChunkSegment* prev;
+
   g_return_val_if_fail(iter != NULL, FALSE);
 
-  if(g_sequence_iter_is_begin(iter->first) == FALSE)
+  prev = inf_text_chunk_segment_prev((InfTextChunkSegment*)iter->segment);
+
+  if(prev != NULL)
   {
-    iter->second = iter->first;
-    iter->first = g_sequence_iter_prev(iter->first);
+    iter->segment = prev;
+    iter->offset -= prev->length;
     return TRUE;
   }
   else
@@ -1374,7 +1955,7 @@ gconstpointer
 inf_text_chunk_iter_get_text(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, NULL);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->text;
+  return ((InfTextChunkSegment*)iter->segment)->text;
 }
 
 /**
@@ -1389,12 +1970,16 @@ inf_text_chunk_iter_get_text(InfTextChunkIter* iter)
 guint
 inf_text_chunk_iter_get_offset(InfTextChunkIter* iter)
 {
-  InfTextChunkSegment* first;
-
   g_return_val_if_fail(iter != NULL, 0);
 
-  first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-  return first->offset;
+#ifdef CHUNK_CHECK_INTEGRITY
+  g_assert(
+    iter->offset ==
+    inf_text_chunk_segment_get_offset((InfTextChunkSegment*)iter->segment)
+  );
+#endif
+
+  return iter->offset;
 }
 
 /**
@@ -1408,22 +1993,8 @@ inf_text_chunk_iter_get_offset(InfTextChunkIter* iter)
 guint
 inf_text_chunk_iter_get_length(InfTextChunkIter* iter)
 {
-  InfTextChunkSegment* first;
-  InfTextChunkSegment* second;
-
   g_return_val_if_fail(iter != NULL, 0);
-
-  if(g_sequence_iter_is_end(iter->second) == TRUE)
-  {
-    first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-    return iter->chunk->length - first->offset;
-  }
-  else
-  {
-    first = (InfTextChunkSegment*)g_sequence_get(iter->first);
-    second = (InfTextChunkSegment*)g_sequence_get(iter->second);
-    return second->offset - first->offset;
-  }
+  return ((InfTextChunkSegment*)iter->segment)->length;
 }
 
 /**
@@ -1438,7 +2009,7 @@ gsize
 inf_text_chunk_iter_get_bytes(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, 0);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->length;
+  return ((InfTextChunkSegment*)iter->segment)->bytes;
 }
 
 /**
@@ -1453,7 +2024,7 @@ guint
 inf_text_chunk_iter_get_author(InfTextChunkIter* iter)
 {
   g_return_val_if_fail(iter != NULL, 0);
-  return ((InfTextChunkSegment*)g_sequence_get(iter->first))->author;
+  return ((InfTextChunkSegment*)iter->segment)->author;
 }
 
 /* vim:set et sw=2 ts=2: */
@@ -52,8 +52,8 @@ typedef struct _InfTextChunkIter InfTextChunkIter;
 struct _InfTextChunkIter {
   /*< private >*/
   InfTextChunk* chunk;
-  GSequenceIter* first;
-  GSequenceIter* second;
+  gpointer segment;
+  guint offset;
 };
 
 GType
@@ -83,6 +83,9 @@ inf_text_chunk_get_encoding(InfTextChunk* self);
 guint
 inf_text_chunk_get_length(InfTextChunk* self);
 
+gsize
+inf_text_chunk_get_memory_size(InfTextChunk* self);
+
 InfTextChunk*
 inf_text_chunk_substring(InfTextChunk* self,
                          guint begin,
@@ -101,6 +104,13 @@ inf_text_chunk_insert_chunk(InfTextChunk* self,
                             guint offset,
                             InfTextChunk* text);
 
+void
+inf_text_chunk_insert_substring(InfTextChunk* self,
+                                guint offset,
+                                InfTextChunk* text,
+                                guint begin,
+                                guint length);
+
 void
 inf_text_chunk_erase(InfTextChunk* self,
                      guint begin,
@@ -110,10 +120,18 @@ gpointer
 inf_text_chunk_get_text(InfTextChunk* self,
                         gsize* length);
 
+guint*
+inf_text_chunk_find_newlines(InfTextChunk* self,
+                             guint* n_newlines);
+
 gboolean
 inf_text_chunk_equal(InfTextChunk* self,
                      InfTextChunk* other);
 
+gboolean
+inf_text_chunk_equal_with_authors(InfTextChunk* self,
+                                  InfTextChunk* other);
+
 gboolean
 inf_text_chunk_iter_init_begin(InfTextChunk* self,
                                InfTextChunkIter* iter);
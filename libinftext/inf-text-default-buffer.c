@@ -26,10 +26,28 @@ struct _InfTextBufferIter {
   InfTextChunkIter chunk_iter;
 };
 
+/* The lines of the buffer are kept in a balanced tree, in document order,
+ * where each node caches the number of lines and characters in its subtree.
+ * This allows to convert between offsets and line numbers in logarithmic
+ * time. */
+typedef struct _InfTextDefaultBufferLine InfTextDefaultBufferLine;
+struct _InfTextDefaultBufferLine {
+  InfTextDefaultBufferLine* left;
+  InfTextDefaultBufferLine* right;
+  guint height;
+
+  /* in characters, including the terminating newline character */
+  guint length;
+
+  guint subtree_lines;
+  guint subtree_length;
+};
+
 typedef struct _InfTextDefaultBufferPrivate InfTextDefaultBufferPrivate;
 struct _InfTextDefaultBufferPrivate {
   gchar* encoding;
   InfTextChunk* chunk;
+  InfTextDefaultBufferLine* lines;
   gboolean modified;
 };
 
@@ -51,6 +69,501 @@ G_DEFINE_TYPE_WITH_CODE(InfTextDefaultBuffer, inf_text_default_buffer, G_TYPE_OB
   G_IMPLEMENT_INTERFACE(INF_TYPE_BUFFER, inf_text_default_buffer_buffer_iface_init)
   G_IMPLEMENT_INTERFACE(INF_TEXT_TYPE_BUFFER, inf_text_default_buffer_text_buffer_iface_init))
 
+/*
+ * Line tree
+ */
+
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_new(guint length)
+{
+  InfTextDefaultBufferLine* line;
+
+  line = g_slice_new(InfTextDefaultBufferLine);
+  line->left = NULL;
+  line->right = NULL;
+  line->height = 1;
+  line->length = length;
+  line->subtree_lines = 1;
+  line->subtree_length = length;
+
+  return line;
+}
+
+static void
+inf_text_default_buffer_line_free_subtree(InfTextDefaultBufferLine* line)
+{
+  if(line != NULL)
+  {
+    inf_text_default_buffer_line_free_subtree(line->left);
+    inf_text_default_buffer_line_free_subtree(line->right);
+    g_slice_free(InfTextDefaultBufferLine, line);
+  }
+}
+
+static guint
+inf_text_default_buffer_line_height(InfTextDefaultBufferLine* line)
+{
+  return line != NULL ? line->height : 0;
+}
+
+static guint
+inf_text_default_buffer_line_subtree_lines(InfTextDefaultBufferLine* line)
+{
+  return line != NULL ? line->subtree_lines : 0;
+}
+
+static guint
+inf_text_default_buffer_line_subtree_length(InfTextDefaultBufferLine* line)
+{
+  return line != NULL ? line->subtree_length : 0;
+}
+
+/* Recomputes the cached values of line from its children */
+static void
+inf_text_default_buffer_line_update(InfTextDefaultBufferLine* line)
+{
+  line->height = 1 + MAX(
+    inf_text_default_buffer_line_height(line->left),
+    inf_text_default_buffer_line_height(line->right)
+  );
+
+  line->subtree_lines = 1 +
+    inf_text_default_buffer_line_subtree_lines(line->left) +
+    inf_text_default_buffer_line_subtree_lines(line->right);
+
+  line->subtree_length = line->length +
+    inf_text_default_buffer_line_subtree_length(line->left) +
+    inf_text_default_buffer_line_subtree_length(line->right);
+}
+
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_rotate_left(InfTextDefaultBufferLine* line)
+{
+  InfTextDefaultBufferLine* pivot;
+
+  pivot = line->right;
+  line->right = pivot->left;
+  pivot->left = line;
+
+  inf_text_default_buffer_line_update(line);
+  inf_text_default_buffer_line_update(pivot);
+  return pivot;
+}
+
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_rotate_right(InfTextDefaultBufferLine* line)
+{
+  InfTextDefaultBufferLine* pivot;
+
+  pivot = line->left;
+  line->left = pivot->right;
+  pivot->right = line;
+
+  inf_text_default_buffer_line_update(line);
+  inf_text_default_buffer_line_update(pivot);
+  return pivot;
+}
+
+/* Restores the AVL balance at line after one of its subtrees has changed,
+ * and returns the new root of the subtree. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_balance(InfTextDefaultBufferLine* line)
+{
+  guint left_height;
+  guint right_height;
+
+  inf_text_default_buffer_line_update(line);
+
+  left_height = inf_text_default_buffer_line_height(line->left);
+  right_height = inf_text_default_buffer_line_height(line->right);
+
+  if(left_height > right_height + 1)
+  {
+    if(inf_text_default_buffer_line_height(line->left->left) <
+       inf_text_default_buffer_line_height(line->left->right))
+    {
+      line->left = inf_text_default_buffer_line_rotate_left(line->left);
+    }
+
+    return inf_text_default_buffer_line_rotate_right(line);
+  }
+  else if(right_height > left_height + 1)
+  {
+    if(inf_text_default_buffer_line_height(line->right->right) <
+       inf_text_default_buffer_line_height(line->right->left))
+    {
+      line->right = inf_text_default_buffer_line_rotate_right(line->right);
+    }
+
+    return inf_text_default_buffer_line_rotate_left(line);
+  }
+
+  return line;
+}
+
+/* Inserts new_line into the subtree rooted at line, such that it becomes
+ * the line with the given index. Returns the new root of the subtree. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_insert(InfTextDefaultBufferLine* line,
+                                    guint index,
+                                    InfTextDefaultBufferLine* new_line)
+{
+  guint left_lines;
+
+  if(line == NULL)
+    return new_line;
+
+  left_lines = inf_text_default_buffer_line_subtree_lines(line->left);
+  if(index <= left_lines)
+  {
+    line->left =
+      inf_text_default_buffer_line_insert(line->left, index, new_line);
+  }
+  else
+  {
+    line->right = inf_text_default_buffer_line_insert(
+      line->right,
+      index - left_lines - 1,
+      new_line
+    );
+  }
+
+  return inf_text_default_buffer_line_balance(line);
+}
+
+/* Unlinks the first line of the subtree rooted at line and stores it in
+ * first. Returns the new root of the subtree. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_remove_first(InfTextDefaultBufferLine* line,
+                                          InfTextDefaultBufferLine** first)
+{
+  if(line->left == NULL)
+  {
+    *first = line;
+    return line->right;
+  }
+
+  line->left =
+    inf_text_default_buffer_line_remove_first(line->left, first);
+  return inf_text_default_buffer_line_balance(line);
+}
+
+/* Removes and frees the line with the given index from the subtree rooted
+ * at line. Returns the new root of the subtree. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_remove(InfTextDefaultBufferLine* line,
+                                    guint index)
+{
+  InfTextDefaultBufferLine* replacement;
+  guint left_lines;
+
+  g_assert(line != NULL);
+
+  left_lines = inf_text_default_buffer_line_subtree_lines(line->left);
+  if(index < left_lines)
+  {
+    line->left = inf_text_default_buffer_line_remove(line->left, index);
+  }
+  else if(index > left_lines)
+  {
+    line->right = inf_text_default_buffer_line_remove(
+      line->right,
+      index - left_lines - 1
+    );
+  }
+  else
+  {
+    if(line->right == NULL)
+    {
+      replacement = line->left;
+      g_slice_free(InfTextDefaultBufferLine, line);
+      return replacement;
+    }
+
+    line->right = inf_text_default_buffer_line_remove_first(
+      line->right,
+      &replacement
+    );
+
+    replacement->left = line->left;
+    replacement->right = line->right;
+    g_slice_free(InfTextDefaultBufferLine, line);
+    line = replacement;
+  }
+
+  return inf_text_default_buffer_line_balance(line);
+}
+
+/* Sets the length of the line with the given index in the subtree rooted
+ * at line. */
+static void
+inf_text_default_buffer_line_set_length(InfTextDefaultBufferLine* line,
+                                        guint index,
+                                        guint length)
+{
+  guint left_lines;
+
+  left_lines = inf_text_default_buffer_line_subtree_lines(line->left);
+  if(index < left_lines)
+  {
+    inf_text_default_buffer_line_set_length(line->left, index, length);
+  }
+  else if(index > left_lines)
+  {
+    inf_text_default_buffer_line_set_length(
+      line->right,
+      index - left_lines - 1,
+      length
+    );
+  }
+  else
+  {
+    line->length = length;
+  }
+
+  inf_text_default_buffer_line_update(line);
+}
+
+/* Finds the line containing the character at offset, or the last line if
+ * offset is the end of the buffer. Returns the line's index, and stores the
+ * offset of its beginning in start. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_find_offset(InfTextDefaultBufferLine* line,
+                                         guint offset,
+                                         guint* index,
+                                         guint* start)
+{
+  guint left_length;
+
+  *index = 0;
+  *start = 0;
+
+  for(;;)
+  {
+    left_length = inf_text_default_buffer_line_subtree_length(line->left);
+
+    if(offset < left_length)
+    {
+      line = line->left;
+    }
+    else if(offset - left_length < line->length || line->right == NULL)
+    {
+      *index += inf_text_default_buffer_line_subtree_lines(line->left);
+      *start += left_length;
+      return line;
+    }
+    else
+    {
+      *index += inf_text_default_buffer_line_subtree_lines(line->left) + 1;
+      *start += left_length + line->length;
+      offset -= left_length + line->length;
+      line = line->right;
+    }
+  }
+}
+
+/* Returns the line with the given index, and stores the offset of its
+ * beginning in start. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_find_index(InfTextDefaultBufferLine* line,
+                                        guint index,
+                                        guint* start)
+{
+  guint left_lines;
+
+  *start = 0;
+
+  for(;;)
+  {
+    left_lines = inf_text_default_buffer_line_subtree_lines(line->left);
+
+    if(index < left_lines)
+    {
+      line = line->left;
+    }
+    else if(index == left_lines)
+    {
+      *start += inf_text_default_buffer_line_subtree_length(line->left);
+      return line;
+    }
+    else
+    {
+      *start += inf_text_default_buffer_line_subtree_length(line->left);
+      *start += line->length;
+      index -= left_lines + 1;
+      line = line->right;
+    }
+  }
+}
+
+/* Builds a balanced tree out of n_lines lines with the given lengths, in
+ * order. Returns the root of the new tree. */
+static InfTextDefaultBufferLine*
+inf_text_default_buffer_line_build(const guint* lengths,
+                                   guint n_lines)
+{
+  InfTextDefaultBufferLine* line;
+  guint mid;
+
+  if(n_lines == 0)
+    return NULL;
+
+  mid = n_lines / 2;
+  line = inf_text_default_buffer_line_new(lengths[mid]);
+
+  line->left = inf_text_default_buffer_line_build(lengths, mid);
+  line->right = inf_text_default_buffer_line_build(
+    lengths + mid + 1,
+    n_lines - mid - 1
+  );
+
+  inf_text_default_buffer_line_update(line);
+  return line;
+}
+
+/* Updates the line tree after len characters have been inserted at pos.
+ * newlines are the offsets of the newline characters within the inserted
+ * text. */
+static void
+inf_text_default_buffer_lines_inserted(InfTextDefaultBuffer* buffer,
+                                       guint pos,
+                                       guint len,
+                                       const guint* newlines,
+                                       guint n_newlines)
+{
+  InfTextDefaultBufferPrivate* priv;
+  InfTextDefaultBufferLine* line;
+  guint* lengths;
+  guint index;
+  guint start;
+  guint column;
+  guint remaining;
+  guint i;
+
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  /* When text is inserted into an empty buffer, such as when a document is
+   * loaded, build the whole tree at once instead of inserting the lines one
+   * by one. */
+  if(n_newlines > 0 && priv->lines->subtree_length == 0)
+  {
+    lengths = g_malloc(sizeof(guint) * (n_newlines + 1));
+
+    lengths[0] = newlines[0] + 1;
+    for(i = 1; i < n_newlines; ++i)
+      lengths[i] = newlines[i] - newlines[i - 1];
+    lengths[n_newlines] = len - newlines[n_newlines - 1] - 1;
+
+    inf_text_default_buffer_line_free_subtree(priv->lines);
+    priv->lines =
+      inf_text_default_buffer_line_build(lengths, n_newlines + 1);
+
+    g_free(lengths);
+    return;
+  }
+
+  line = inf_text_default_buffer_line_find_offset(
+    priv->lines,
+    pos,
+    &index,
+    &start
+  );
+
+  column = pos - start;
+
+  if(n_newlines == 0)
+  {
+    inf_text_default_buffer_line_set_length(
+      priv->lines,
+      index,
+      line->length + len
+    );
+  }
+  else
+  {
+    /* The line is split at the first newline, and the text behind it
+     * moves to the last of the new lines. */
+    remaining = line->length - column;
+
+    inf_text_default_buffer_line_set_length(
+      priv->lines,
+      index,
+      column + newlines[0] + 1
+    );
+
+    for(i = 1; i < n_newlines; ++i)
+    {
+      priv->lines = inf_text_default_buffer_line_insert(
+        priv->lines,
+        index + i,
+        inf_text_default_buffer_line_new(newlines[i] - newlines[i - 1])
+      );
+    }
+
+    priv->lines = inf_text_default_buffer_line_insert(
+      priv->lines,
+      index + n_newlines,
+      inf_text_default_buffer_line_new(
+        len - newlines[n_newlines - 1] - 1 + remaining
+      )
+    );
+  }
+}
+
+/* Updates the line tree after len characters have been erased at pos */
+static void
+inf_text_default_buffer_lines_erased(InfTextDefaultBuffer* buffer,
+                                     guint pos,
+                                     guint len)
+{
+  InfTextDefaultBufferPrivate* priv;
+  InfTextDefaultBufferLine* first;
+  InfTextDefaultBufferLine* last;
+  guint first_index;
+  guint first_start;
+  guint last_index;
+  guint last_start;
+  guint length;
+  guint i;
+
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  first = inf_text_default_buffer_line_find_offset(
+    priv->lines,
+    pos,
+    &first_index,
+    &first_start
+  );
+
+  last = inf_text_default_buffer_line_find_offset(
+    priv->lines,
+    pos + len,
+    &last_index,
+    &last_start
+  );
+
+  if(first_index == last_index)
+  {
+    length = first->length - len;
+  }
+  else
+  {
+    /* The beginning of the first line is joined with the end of the last
+     * line, and everything in between goes away. */
+    length = (pos - first_start) + last->length - (pos + len - last_start);
+
+    for(i = first_index; i < last_index; ++i)
+    {
+      priv->lines = inf_text_default_buffer_line_remove(
+        priv->lines,
+        first_index + 1
+      );
+    }
+  }
+
+  inf_text_default_buffer_line_set_length(priv->lines, first_index, length);
+}
+
 static void
 inf_text_default_buffer_init(InfTextDefaultBuffer* buffer)
 {
@@ -59,6 +572,7 @@ inf_text_default_buffer_init(InfTextDefaultBuffer* buffer)
 
   priv->encoding = NULL;
   priv->chunk = NULL;
+  priv->lines = inf_text_default_buffer_line_new(0);
   priv->modified = FALSE;
 }
 
@@ -72,6 +586,7 @@ inf_text_default_buffer_finalize(GObject* object)
   priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(default_buffer);
 
   inf_text_chunk_free(priv->chunk);
+  inf_text_default_buffer_line_free_subtree(priv->lines);
   g_free(priv->encoding);
 
   G_OBJECT_CLASS(inf_text_default_buffer_parent_class)->finalize(object);
@@ -188,10 +703,23 @@ inf_text_default_buffer_buffer_insert_text(InfTextBuffer* buffer,
                                            InfUser* user)
 {
   InfTextDefaultBufferPrivate* priv;
+  guint* newlines;
+  guint n_newlines;
+
   priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
 
   inf_text_chunk_insert_chunk(priv->chunk, pos, chunk);
 
+  newlines = inf_text_chunk_find_newlines(chunk, &n_newlines);
+  inf_text_default_buffer_lines_inserted(
+    INF_TEXT_DEFAULT_BUFFER(buffer),
+    pos,
+    inf_text_chunk_get_length(chunk),
+    newlines,
+    n_newlines
+  );
+  g_free(newlines);
+
   inf_text_buffer_text_inserted(buffer, pos, chunk, user);
 
   if(priv->modified == FALSE)
@@ -214,6 +742,11 @@ inf_text_default_buffer_buffer_erase_text(InfTextBuffer* buffer,
 
   chunk = inf_text_chunk_substring(priv->chunk, pos, len);
   inf_text_chunk_erase(priv->chunk, pos, len);
+  inf_text_default_buffer_lines_erased(
+    INF_TEXT_DEFAULT_BUFFER(buffer),
+    pos,
+    len
+  );
 
   inf_text_buffer_text_erased(buffer, pos, chunk, user);
   inf_text_chunk_free(chunk);
@@ -225,6 +758,49 @@ inf_text_default_buffer_buffer_erase_text(InfTextBuffer* buffer,
   }
 }
 
+static void
+inf_text_default_buffer_buffer_append(InfTextBuffer* buffer,
+                                      InfTextChunk* chunk,
+                                      InfUser* user)
+{
+  /* Inserting into an empty buffer shares the tree of chunk and builds the
+   * line tree in one go, so there is nothing more to do here. */
+  inf_text_default_buffer_buffer_insert_text(
+    buffer,
+    inf_text_default_buffer_get_length(buffer),
+    chunk,
+    user
+  );
+}
+
+static void
+inf_text_default_buffer_buffer_clear(InfTextBuffer* buffer,
+                                     InfUser* user)
+{
+  InfTextDefaultBufferPrivate* priv;
+  InfTextChunk* chunk;
+
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+  if(inf_text_chunk_get_length(priv->chunk) == 0)
+    return;
+
+  /* Hand the old chunk to the signal handlers instead of copying it */
+  chunk = priv->chunk;
+  priv->chunk = inf_text_chunk_new(priv->encoding);
+
+  inf_text_default_buffer_line_free_subtree(priv->lines);
+  priv->lines = inf_text_default_buffer_line_new(0);
+
+  inf_text_buffer_text_erased(buffer, 0, chunk, user);
+  inf_text_chunk_free(chunk);
+
+  if(priv->modified == FALSE)
+  {
+    priv->modified = TRUE;
+    g_object_notify(G_OBJECT(buffer), "modified");
+  }
+}
+
 static InfTextBufferIter*
 inf_text_default_buffer_buffer_create_begin_iter(InfTextBuffer* buffer)
 {
@@ -324,6 +900,51 @@ inf_text_default_buffer_buffer_iter_get_author(InfTextBuffer* buffer,
   return inf_text_chunk_iter_get_author(&iter->chunk_iter);
 }
 
+static guint
+inf_text_default_buffer_buffer_get_line_count(InfTextBuffer* buffer)
+{
+  InfTextDefaultBufferPrivate* priv;
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+  return priv->lines->subtree_lines;
+}
+
+static void
+inf_text_default_buffer_buffer_offset_to_line(InfTextBuffer* buffer,
+                                              guint offset,
+                                              guint* line,
+                                              guint* column)
+{
+  InfTextDefaultBufferPrivate* priv;
+  guint index;
+  guint start;
+
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+
+  inf_text_default_buffer_line_find_offset(
+    priv->lines,
+    offset,
+    &index,
+    &start
+  );
+
+  if(line != NULL) *line = index;
+  if(column != NULL) *column = offset - start;
+}
+
+static guint
+inf_text_default_buffer_buffer_line_to_offset(InfTextBuffer* buffer,
+                                              guint line)
+{
+  InfTextDefaultBufferPrivate* priv;
+  guint start;
+
+  priv = INF_TEXT_DEFAULT_BUFFER_PRIVATE(buffer);
+  g_return_val_if_fail(line < priv->lines->subtree_lines, 0);
+
+  inf_text_default_buffer_line_find_index(priv->lines, line, &start);
+  return start;
+}
+
 static void
 inf_text_default_buffer_class_init(
   InfTextDefaultBufferClass* default_buffer_class)
@@ -375,6 +996,11 @@ inf_text_default_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_default_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_default_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_default_buffer_buffer_iter_get_author;
+  iface->get_line_count = inf_text_default_buffer_buffer_get_line_count;
+  iface->offset_to_line = inf_text_default_buffer_buffer_offset_to_line;
+  iface->line_to_offset = inf_text_default_buffer_buffer_line_to_offset;
+  iface->append = inf_text_default_buffer_buffer_append;
+  iface->clear = inf_text_default_buffer_buffer_clear;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
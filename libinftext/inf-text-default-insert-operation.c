@@ -40,7 +40,7 @@ enum {
   PROP_CHUNK
 };
 
-#define INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(obj) (G_TYPE_INSTANCE_GET_PRIVATE((obj), INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION, InfTextDefaultInsertOperationPrivate))
+#define INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(obj) ((InfTextDefaultInsertOperationPrivate*)inf_text_default_insert_operation_get_instance_private((InfTextDefaultInsertOperation*)(obj)))
 
 static void inf_text_default_insert_operation_operation_iface_init(InfAdoptedOperationInterface* iface);
 static void inf_text_default_insert_operation_insert_operation_iface_init(InfTextInsertOperationInterface* iface);
@@ -127,6 +127,26 @@ inf_text_default_insert_operation_get_property(GObject* object,
   }
 }
 
+/* Creates a new operation by setting the private fields directly instead
+ * of going through the construct-only properties, which is much cheaper. */
+static InfTextDefaultInsertOperation*
+inf_text_default_insert_operation_new_common(guint position,
+                                             InfTextChunk* chunk)
+{
+  InfTextDefaultInsertOperation* operation;
+  InfTextDefaultInsertOperationPrivate* priv;
+
+  operation = INF_TEXT_DEFAULT_INSERT_OPERATION(
+    g_object_new(INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION, NULL)
+  );
+
+  priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
+  priv->position = position;
+  priv->chunk = inf_text_chunk_copy(chunk);
+
+  return operation;
+}
+
 static gboolean
 inf_text_default_insert_operation_need_concurrency_id(
   InfAdoptedOperation* operation,
@@ -185,12 +205,7 @@ inf_text_default_insert_operation_copy(InfAdoptedOperation* operation)
   priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
 
   return INF_ADOPTED_OPERATION(
-    g_object_new(
-      INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-      "position", priv->position,
-      "chunk", priv->chunk,
-      NULL
-    )
+    inf_text_default_insert_operation_new_common(priv->position, priv->chunk)
   );
 }
 
@@ -249,6 +264,18 @@ inf_text_default_insert_operation_revert(InfAdoptedOperation* operation)
   );
 }
 
+static gsize
+inf_text_default_insert_operation_get_memory_size(
+  InfAdoptedOperation* operation)
+{
+  InfTextDefaultInsertOperationPrivate* priv;
+  priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
+
+  return sizeof(InfTextDefaultInsertOperation) +
+    sizeof(InfTextDefaultInsertOperationPrivate) +
+    inf_text_chunk_get_memory_size(priv->chunk);
+}
+
 static guint
 inf_text_default_insert_operation_get_position(InfTextInsertOperation* op)
 {
@@ -270,18 +297,11 @@ inf_text_default_insert_operation_transform_position(
   guint position)
 {
   InfTextDefaultInsertOperationPrivate* priv;
-  GObject* result;
-
   priv = INF_TEXT_DEFAULT_INSERT_OPERATION_PRIVATE(operation);
 
-  result = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-    "position", position,
-    "chunk", priv->chunk,
-    NULL
+  return INF_TEXT_INSERT_OPERATION(
+    inf_text_default_insert_operation_new_common(position, priv->chunk)
   );
-
-  return INF_TEXT_INSERT_OPERATION(result);
 }
 
 static void
@@ -336,6 +356,8 @@ inf_text_default_insert_operation_operation_iface_init(
   iface->apply = inf_text_default_insert_operation_apply;
   iface->apply_transformed = NULL;
   iface->revert = inf_text_default_insert_operation_revert;
+  iface->get_memory_size =
+    inf_text_default_insert_operation_get_memory_size;
 }
 
 static void
@@ -362,18 +384,8 @@ InfTextDefaultInsertOperation*
 inf_text_default_insert_operation_new(guint pos,
                                       InfTextChunk* chunk)
 {
-  GObject* object;
-
   g_return_val_if_fail(chunk != NULL, NULL);
-
-  object = g_object_new(
-    INF_TEXT_TYPE_DEFAULT_INSERT_OPERATION,
-    "position", pos,
-    "chunk", chunk,
-    NULL
-  );
-
-  return INF_TEXT_DEFAULT_INSERT_OPERATION(object);
+  return inf_text_default_insert_operation_new_common(pos, chunk);
 }
 
 /**
@@ -147,11 +147,11 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
   xmlNodePtr child;
   guint author;
   gchar* content;
-  gboolean result;
   gboolean res;
   InfUser* user;
   gsize bytes;
   guint chars;
+  InfTextChunk* chunk;
 
   gboolean is_utf8;
   gchar* converted;
@@ -163,6 +163,10 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
   if(strcmp(inf_text_buffer_get_encoding(buffer), "UTF-8") != 0)
     is_utf8 = FALSE;
 
+  /* Collect the whole document in a single chunk first, so that the buffer
+   * is filled in one go instead of segment by segment. */
+  chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
+
   for(child = node->children; child != NULL; child = child->next)
   {
     if(child->type != XML_ELEMENT_NODE)
@@ -178,7 +182,10 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
       );
 
       if(res == FALSE)
+      {
+        inf_text_chunk_free(chunk);
         return FALSE;
+      }
 
       if(author != 0)
       {
@@ -194,28 +201,29 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
             author
           );
 
+          inf_text_chunk_free(chunk);
           return FALSE;
         }
       }
-      else
-      {
-        user = NULL;
-      }
 
       content = inf_xml_util_get_child_text(child, &bytes, &chars, error);
-      if(!content) return FALSE;
+      if(!content)
+      {
+        inf_text_chunk_free(chunk);
+        return FALSE;
+      }
 
       if(*content != '\0')
       {
         if(is_utf8)
         {
-          inf_text_buffer_insert_text(
-            buffer,
-            inf_text_buffer_get_length(buffer),
+          inf_text_chunk_insert_text(
+            chunk,
+            inf_text_chunk_get_length(chunk),
             content,
             bytes,
             chars,
-            user
+            author
           );
 
           g_free(content);
@@ -235,15 +243,18 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
           g_free(content);
 
           if(converted == NULL)
+          {
+            inf_text_chunk_free(chunk);
             return FALSE;
+          }
 
-          inf_text_buffer_insert_text(
-            buffer,
-            inf_text_buffer_get_length(buffer),
+          inf_text_chunk_insert_text(
+            chunk,
+            inf_text_chunk_get_length(chunk),
             converted,
             converted_bytes,
             chars,
-            user
+            author
           );
 
           g_free(converted);
@@ -252,6 +263,9 @@ inf_text_filesystem_format_read_buffer(InfTextBuffer* buffer,
     }
   }
 
+  inf_text_buffer_append(buffer, chunk, NULL);
+  inf_text_chunk_free(chunk);
+
   return TRUE;
 }
 
@@ -140,12 +140,16 @@ inf_text_remote_delete_operation_recon_free(GSList* recon_list)
   g_slist_free(recon_list);
 }
 
+/* Returns a new recon list with the length characters of chunk starting
+ * at begin added at position. */
 /* TODO: Make this work inline, adjust usages */
 /* TODO: Merge adjacent text chunks */
 static GSList*
 inf_text_remote_delete_operation_recon_feed(GSList* recon_list,
                                             guint position,
-                                            InfTextChunk* chunk)
+                                            InfTextChunk* chunk,
+                                            guint begin,
+                                            guint length)
 {
   GSList* item;
   InfTextRemoteDeleteOperationRecon* recon;
@@ -164,16 +168,16 @@ inf_text_remote_delete_operation_recon_feed(GSList* recon_list,
   for(item = recon_list; item != NULL; item = g_slist_next(item))
   {
     recon = (InfTextRemoteDeleteOperationRecon*)item->data;
-    if(position + text_pos + cur_len < recon->position &&
-       text_pos < inf_text_chunk_get_length(chunk))
+    if(position + text_pos + cur_len < recon->position && text_pos < length)
     {
       text_len = recon->position - position - text_pos - cur_len;
-      if(text_len > inf_text_chunk_get_length(chunk) - text_pos)
-        text_len = inf_text_chunk_get_length(chunk) - text_pos;
+      if(text_len > length - text_pos)
+        text_len = length - text_pos;
 
       new_recon = g_slice_new(InfTextRemoteDeleteOperationRecon);
       new_recon->position = position + text_pos + cur_len;
-      new_recon->chunk = inf_text_chunk_substring(chunk, text_pos, text_len);
+      new_recon->chunk =
+        inf_text_chunk_substring(chunk, begin + text_pos, text_len);
       new_list = g_slist_append_fast(new_list, &last, new_recon);
       text_pos += text_len;
     }
@@ -185,14 +189,14 @@ inf_text_remote_delete_operation_recon_feed(GSList* recon_list,
     new_list = g_slist_append_fast(new_list, &last, new_recon);
   }
 
-  if(text_pos < inf_text_chunk_get_length(chunk))
+  if(text_pos < length)
   {
     new_recon = g_slice_new(InfTextRemoteDeleteOperationRecon);
     new_recon->position = position + text_pos + cur_len;
     new_recon->chunk = inf_text_chunk_substring(
       chunk,
-      text_pos,
-      inf_text_chunk_get_length(chunk) - text_pos
+      begin + text_pos,
+      length - text_pos
     );
 
     new_list = g_slist_append_fast(new_list, &last, new_recon);
@@ -408,10 +412,12 @@ inf_text_remote_delete_operation_apply_transformed(InfAdoptedOperation* op,
   GSList* list;
   GSList* item;
   InfAdoptedOperation* operation;
-  GSList* recon_list;
   GSList* recon_item;
   InfTextRemoteDeleteOperationRecon* recon;
   InfTextDefaultDeleteOperation* result;
+  guint text_pos;
+  guint text_len;
+  guint cur_len;
 
   g_assert(INF_TEXT_IS_REMOTE_DELETE_OPERATION(op));
   g_assert(INF_TEXT_IS_BUFFER(buffer));
@@ -449,25 +455,44 @@ inf_text_remote_delete_operation_apply_transformed(InfAdoptedOperation* op,
         priv->position,
         priv->length
       );
-
-      recon_list = inf_text_remote_delete_operation_recon_feed(
-        priv->recon,
-        0,
-        temp_slice
-      );
-
-      inf_text_chunk_free(temp_slice);
     }
     else
     {
-      recon_list = priv->recon;
+      temp_slice = NULL;
     }
 
-    for(recon_item = recon_list;
+    /* Merge the text that is about to be erased with the recon chunks,
+     * splicing it into chunk directly instead of building a new recon
+     * list first, as inf_text_remote_delete_operation_recon_feed()
+     * would do. */
+    text_pos = 0;
+    cur_len = 0;
+
+    for(recon_item = priv->recon;
         recon_item != NULL;
         recon_item = g_slist_next(recon_item))
     {
       recon = (InfTextRemoteDeleteOperationRecon*)recon_item->data;
+      if(text_pos + cur_len < recon->position && text_pos < priv->length)
+      {
+        text_len = recon->position - text_pos - cur_len;
+        if(text_len > priv->length - text_pos)
+          text_len = priv->length - text_pos;
+
+        g_assert(priv->recon_offset + text_pos + cur_len ==
+                 inf_text_chunk_get_length(chunk));
+
+        inf_text_chunk_insert_substring(
+          chunk,
+          inf_text_chunk_get_length(chunk),
+          temp_slice,
+          text_pos,
+          text_len
+        );
+
+        text_pos += text_len;
+      }
+
       g_assert(priv->recon_offset + recon->position ==
                inf_text_chunk_get_length(chunk));
 
@@ -476,11 +501,26 @@ inf_text_remote_delete_operation_apply_transformed(InfAdoptedOperation* op,
         inf_text_chunk_get_length(chunk),
         recon->chunk
       );
+
+      cur_len += inf_text_chunk_get_length(recon->chunk);
     }
 
-    /* Free recon list if newly allocated */
-    if(priv->length > 0)
-      inf_text_remote_delete_operation_recon_free(recon_list);
+    if(text_pos < priv->length)
+    {
+      g_assert(priv->recon_offset + text_pos + cur_len ==
+               inf_text_chunk_get_length(chunk));
+
+      inf_text_chunk_insert_substring(
+        chunk,
+        inf_text_chunk_get_length(chunk),
+        temp_slice,
+        text_pos,
+        priv->length - text_pos
+      );
+    }
+
+    if(temp_slice != NULL)
+      inf_text_chunk_free(temp_slice);
 
     if(!inf_adopted_operation_apply(operation, by, buffer, error))
     {
@@ -499,6 +539,29 @@ inf_text_remote_delete_operation_apply_transformed(InfAdoptedOperation* op,
   return INF_ADOPTED_OPERATION(result);
 }
 
+static gsize
+inf_text_remote_delete_operation_get_memory_size(
+  InfAdoptedOperation* operation)
+{
+  InfTextRemoteDeleteOperationPrivate* priv;
+  InfTextRemoteDeleteOperationRecon* recon;
+  GSList* item;
+  gsize size;
+
+  priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(operation);
+  size = sizeof(InfTextRemoteDeleteOperation) +
+    sizeof(InfTextRemoteDeleteOperationPrivate);
+
+  for(item = priv->recon; item != NULL; item = item->next)
+  {
+    recon = (InfTextRemoteDeleteOperationRecon*)item->data;
+    size += sizeof(GSList) + sizeof(InfTextRemoteDeleteOperationRecon);
+    size += inf_text_chunk_get_memory_size(recon->chunk);
+  }
+
+  return size;
+}
+
 static guint
 inf_text_remote_delete_operation_get_position(
   InfTextDeleteOperation* operation)
@@ -547,7 +610,6 @@ inf_text_remote_delete_operation_transform_overlap(
   guint length)
 {
   InfTextRemoteDeleteOperationPrivate* priv;
-  InfTextChunk* chunk;
   GObject* result;
   InfTextRemoteDeleteOperationPrivate* result_priv;
 
@@ -558,14 +620,6 @@ inf_text_remote_delete_operation_transform_overlap(
 
   priv = INF_TEXT_REMOTE_DELETE_OPERATION_PRIVATE(operation);
 
-  chunk = inf_text_chunk_substring(
-    inf_text_default_delete_operation_get_chunk(
-      INF_TEXT_DEFAULT_DELETE_OPERATION(other)
-    ),
-    other_begin,
-    length
-  );
-
   result = g_object_new(
     INF_TEXT_TYPE_REMOTE_DELETE_OPERATION,
     "position", position,
@@ -578,11 +632,13 @@ inf_text_remote_delete_operation_transform_overlap(
   result_priv->recon = inf_text_remote_delete_operation_recon_feed(
     priv->recon,
     begin,
-    chunk
+    inf_text_default_delete_operation_get_chunk(
+      INF_TEXT_DEFAULT_DELETE_OPERATION(other)
+    ),
+    other_begin,
+    length
   );
 
-  inf_text_chunk_free(chunk);
-
   result_priv->recon_offset = priv->recon_offset;
   return INF_TEXT_DELETE_OPERATION(result);
 }
@@ -721,6 +777,7 @@ inf_text_remote_delete_operation_operation_iface_init(
     inf_text_remote_delete_operation_apply_transformed;
   /* RemoteDeleteOperation is not reversible */
   iface->revert = NULL;
+  iface->get_memory_size = inf_text_remote_delete_operation_get_memory_size;
 }
 
 static void
@@ -26,8 +26,10 @@
 #include <libinftext/inf-text-move-operation.h>
 #include <libinftext/inf-text-chunk.h>
 #include <libinftext/inf-text-user.h>
+#include <libinftext/inf-text-undo-grouping-private.h>
 #include <libinfinity/adopted/inf-adopted-no-operation.h>
 #include <libinfinity/common/inf-xml-util.h>
+#include <libinfinity/common/inf-utf8.h>
 #include <libinfinity/common/inf-error.h>
 #include <libinfinity/inf-i18n.h>
 #include <libinfinity/inf-signals.h>
@@ -36,9 +38,6 @@
 #include <string.h>
 #include <errno.h>
 
-/* TODO: Optionally broadcast operations delayed to merge adjacent operations
- * and send as a single request. */
-
 typedef struct _InfTextSessionLocalUser InfTextSessionLocalUser;
 struct _InfTextSessionLocalUser {
   InfTextSession* session;
@@ -50,13 +49,30 @@ struct _InfTextSessionLocalUser {
 typedef struct _InfTextSessionPrivate InfTextSessionPrivate;
 struct _InfTextSessionPrivate {
   guint caret_update_interval;
+  guint merge_interval;
   GSList* local_users;
+
+  /* Local modification that is held back to be merged with adjacent ones.
+   * There is at most one at a time, since any other modification flushes
+   * it. */
+  InfTextUser* merge_user;
+  gboolean merge_insert;
+  guint merge_position;
+  InfTextChunk* merge_chunk;
+  gboolean merge_backward;
+  gboolean merge_trailing_space;
+  InfIoTimeout* merge_timeout;
+
+  /* Text received during synchronization, which is put into the buffer in
+   * one go when synchronization is complete. */
+  InfTextChunk* sync_chunk;
 };
 
 enum {
   PROP_0,
 
-  PROP_CARET_UPDATE_INTERVAL
+  PROP_CARET_UPDATE_INTERVAL,
+  PROP_MERGE_INTERVAL
 };
 
 typedef struct _InfTextSessionInsertForeachData
@@ -101,9 +117,18 @@ inf_text_session_timeval_diff(GTimeVal* first,
          (first->tv_usec+500)/1000 - (second->tv_usec+500)/1000;
 }
 
+/* Returns whether text in the given buffer encoding can be sent and
+ * received without any conversion. */
+static gboolean
+inf_text_session_encoding_is_utf8(const gchar* encoding)
+{
+  return strcmp(encoding, "UTF-8") == 0;
+}
+
 /* Converts at most *bytes bytes with cd and writes the result, which are
  * at most 1024 bytes, into xml, setting the given author. *bytes will be
- * set to the number of bytes not yet processed. */
+ * set to the number of bytes not yet processed. If cd is NULL, then text is
+ * UTF-8 already and is written as-is, split at a character boundary. */
 static void
 inf_text_session_segment_to_xml(GIConv* cd,
                                 xmlNodePtr xml,
@@ -119,6 +144,20 @@ inf_text_session_segment_to_xml(GIConv* cd,
   gchar* inbuf;
   gchar* outbuf;
 
+  if(cd == NULL)
+  {
+    inbuf = *(gchar**)(gpointer)&text;
+    bytes_left = MIN(*bytes, 1024);
+    if(bytes_left < *bytes)
+      while(bytes_left > 0 && (inbuf[bytes_left] & 0xc0) == 0x80)
+        --bytes_left;
+
+    inf_xml_util_add_child_text(xml, inbuf, bytes_left);
+    inf_xml_util_set_attribute_uint(xml, "author", author);
+    *bytes -= bytes_left;
+    return;
+  }
+
   bytes_left = 1024;
 
   inbuf = *(gchar**)(gpointer)&text; /* cast const away without warning */
@@ -139,6 +178,27 @@ inf_text_session_segment_to_xml(GIConv* cd,
   inf_xml_util_set_attribute_uint(xml, "author", author);
 }
 
+/* Sets the same error as g_convert() would if text is not valid UTF-8. */
+static gboolean
+inf_text_session_validate_utf8(const gchar* text,
+                               gsize bytes,
+                               GError** error)
+{
+  if(!inf_utf8_validate(text, bytes, NULL))
+  {
+    g_set_error_literal(
+      error,
+      G_CONVERT_ERROR,
+      G_CONVERT_ERROR_ILLEGAL_SEQUENCE,
+      _("Invalid byte sequence in conversion input")
+    );
+
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
 static gpointer
 inf_text_session_segment_from_xml(GIConv* cd,
                                   xmlNodePtr xml,
@@ -158,6 +218,20 @@ inf_text_session_segment_from_xml(GIConv* cd,
   if(!utf8_text)
     return NULL;
 
+  /* The buffer uses UTF-8 as well, so the text only needs to be checked,
+   * which is much cheaper than running it through iconv. */
+  if(cd == NULL)
+  {
+    if(!inf_text_session_validate_utf8(utf8_text, bytes_read, error))
+    {
+      g_free(utf8_text);
+      return NULL;
+    }
+
+    *bytes = bytes_read;
+    return utf8_text;
+  }
+
   text = g_convert_with_iconv(
     utf8_text,
     bytes_read,
@@ -195,6 +269,239 @@ inf_text_session_find_local_user(InfTextSession* session,
   return NULL;
 }
 
+/* Returns whether the single character in chunk is a whitespace character */
+static gboolean
+inf_text_session_chunk_is_space(InfTextChunk* chunk)
+{
+  InfTextChunkIter iter;
+  const gchar* encoding;
+  gchar* text;
+  gunichar c;
+
+  g_assert(inf_text_chunk_get_length(chunk) == 1);
+
+  encoding = inf_text_chunk_get_encoding(chunk);
+  inf_text_chunk_iter_init_begin(chunk, &iter);
+
+  if(strcmp(encoding, "UTF-8") == 0)
+  {
+    c = g_utf8_get_char(inf_text_chunk_iter_get_text(&iter));
+  }
+  else
+  {
+    text = g_convert(
+      inf_text_chunk_iter_get_text(&iter),
+      inf_text_chunk_iter_get_bytes(&iter),
+      "UTF-8",
+      encoding,
+      NULL,
+      NULL,
+      NULL
+    );
+
+    if(text == NULL)
+      return FALSE;
+
+    c = g_utf8_get_char(text);
+    g_free(text);
+  }
+
+  return g_unichar_isspace(c);
+}
+
+/* Executes a local modification that has already been applied to the buffer
+ * and sends it to the other participants. */
+static void
+inf_text_session_broadcast_modification(InfTextSession* session,
+                                        InfTextUser* user,
+                                        InfAdoptedOperation* operation)
+{
+  InfAdoptedAlgorithm* algorithm;
+  InfAdoptedRequest* request;
+
+  algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
+
+  request = inf_adopted_algorithm_generate_request(
+    algorithm,
+    INF_ADOPTED_REQUEST_DO,
+    INF_ADOPTED_USER(user),
+    operation
+  );
+
+  /* This cannot fail since operation is not applied */
+  inf_adopted_algorithm_execute_request(algorithm, request, FALSE, NULL);
+
+  inf_adopted_session_broadcast_request(
+    INF_ADOPTED_SESSION(session),
+    request
+  );
+
+  g_object_unref(request);
+}
+
+static void
+inf_text_session_flush_merged_request(InfTextSession* session)
+{
+  InfTextSessionPrivate* priv;
+  InfTextChunk* chunk;
+  InfAdoptedOperation* operation;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+  if(priv->merge_chunk == NULL)
+    return;
+
+  if(priv->merge_timeout != NULL)
+  {
+    inf_io_remove_timeout(
+      inf_adopted_session_get_io(INF_ADOPTED_SESSION(session)),
+      priv->merge_timeout
+    );
+
+    priv->merge_timeout = NULL;
+  }
+
+  chunk = priv->merge_chunk;
+  priv->merge_chunk = NULL;
+
+  if(priv->merge_insert)
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_insert_operation_new(priv->merge_position, chunk)
+    );
+  }
+  else
+  {
+    operation = INF_ADOPTED_OPERATION(
+      inf_text_default_delete_operation_new(priv->merge_position, chunk)
+    );
+  }
+
+  /* Let InfTextUndoGrouping know that this is a run of characters typed
+   * one after the other, so that it groups it like the single ones. */
+  if(inf_text_chunk_get_length(chunk) > 1)
+    _inf_text_undo_grouping_set_run(operation, priv->merge_backward);
+
+  inf_text_session_broadcast_modification(
+    session,
+    priv->merge_user,
+    operation
+  );
+
+  g_object_unref(operation);
+  inf_text_chunk_free(chunk);
+}
+
+static void
+inf_text_session_merge_timeout_func(gpointer user_data)
+{
+  InfTextSession* session;
+  InfTextSessionPrivate* priv;
+
+  session = INF_TEXT_SESSION(user_data);
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  priv->merge_timeout = NULL;
+  inf_text_session_flush_merged_request(session);
+}
+
+/* Holds back a local single-character insertion or deletion so that it can
+ * be sent together with subsequent ones, as long as they continue at the
+ * same position. We never merge across a boundary at which
+ * InfTextUndoGrouping would start a new undo group, so that a merged request
+ * is undone the same way as the single requests would have been. */
+static void
+inf_text_session_merge_modification(InfTextSession* session,
+                                    InfTextUser* user,
+                                    gboolean insert,
+                                    guint pos,
+                                    InfTextChunk* chunk)
+{
+  InfTextSessionPrivate* priv;
+  InfAdoptedOperation* operation;
+  gboolean is_space;
+  guint merge_length;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  if(inf_text_chunk_get_length(chunk) != 1)
+  {
+    /* Larger modifications, such as pasted text, are never grouped with
+     * others for undo, so send them right away. */
+    inf_text_session_flush_merged_request(session);
+
+    if(insert)
+    {
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_insert_operation_new(pos, chunk)
+      );
+    }
+    else
+    {
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_delete_operation_new(pos, chunk)
+      );
+    }
+
+    inf_text_session_broadcast_modification(session, user, operation);
+    g_object_unref(operation);
+    return;
+  }
+
+  is_space = inf_text_session_chunk_is_space(chunk);
+
+  if(priv->merge_chunk != NULL && priv->merge_user == user &&
+     priv->merge_insert == insert &&
+     (priv->merge_trailing_space == FALSE || is_space == TRUE))
+  {
+    merge_length = inf_text_chunk_get_length(priv->merge_chunk);
+
+    if(insert && pos == priv->merge_position + merge_length)
+    {
+      inf_text_chunk_insert_chunk(priv->merge_chunk, merge_length, chunk);
+      priv->merge_trailing_space = is_space;
+      return;
+    }
+    /* A deletion run keeps the direction of its first two characters, so
+     * that it is clear in which order they have been removed. */
+    else if(!insert && pos == priv->merge_position &&
+            (merge_length == 1 || !priv->merge_backward))
+    {
+      /* Forward deletion */
+      inf_text_chunk_insert_chunk(priv->merge_chunk, merge_length, chunk);
+      priv->merge_backward = FALSE;
+      priv->merge_trailing_space = is_space;
+      return;
+    }
+    else if(!insert && pos + 1 == priv->merge_position &&
+            (merge_length == 1 || priv->merge_backward))
+    {
+      /* Backspace */
+      inf_text_chunk_insert_chunk(priv->merge_chunk, 0, chunk);
+      priv->merge_position = pos;
+      priv->merge_backward = TRUE;
+      priv->merge_trailing_space = is_space;
+      return;
+    }
+  }
+
+  inf_text_session_flush_merged_request(session);
+
+  priv->merge_user = user;
+  priv->merge_insert = insert;
+  priv->merge_position = pos;
+  priv->merge_chunk = inf_text_chunk_copy(chunk);
+  priv->merge_backward = FALSE;
+  priv->merge_trailing_space = is_space;
+
+  priv->merge_timeout = inf_io_add_timeout(
+    inf_adopted_session_get_io(INF_ADOPTED_SESSION(session)),
+    priv->merge_interval,
+    inf_text_session_merge_timeout_func,
+    session,
+    NULL
+  );
+}
+
 static void
 inf_text_session_broadcast_caret_selection(InfTextSession* session,
                                            InfTextSessionLocalUser* local)
@@ -207,6 +514,10 @@ inf_text_session_broadcast_caret_selection(InfTextSession* session,
   int sel;
   guint end;
 
+  /* The caret position refers to the buffer including any modification that
+   * is still held back */
+  inf_text_session_flush_merged_request(session);
+
   algorithm = inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(session));
   position = inf_text_user_get_caret_position(local->user);
   sel = inf_text_user_get_selection_length(local->user);
@@ -334,6 +645,24 @@ inf_text_session_selection_changed_cb(InfTextUser* user,
   }
 }
 
+static void
+inf_text_session_set_status_cb(InfUser* user,
+                               InfUserStatus status,
+                               gpointer user_data)
+{
+  InfTextSession* session;
+  InfTextSessionPrivate* priv;
+
+  session = INF_TEXT_SESSION(user_data);
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+
+  /* Send a held back modification while the user still has its old
+   * status. Afterwards the request would reactivate an inactive user, and
+   * other sites reject requests from users that have left. */
+  if(priv->merge_chunk != NULL && priv->merge_user == INF_TEXT_USER(user))
+    inf_text_session_flush_merged_request(session);
+}
+
 static void
 inf_text_session_add_local_user(InfTextSession* session,
                                 InfTextUser* user)
@@ -357,6 +686,13 @@ inf_text_session_add_local_user(InfTextSession* session,
     G_CALLBACK(inf_text_session_selection_changed_cb),
     session
   );
+
+  g_signal_connect(
+    G_OBJECT(user),
+    "set-status",
+    G_CALLBACK(inf_text_session_set_status_cb),
+    session
+  );
 }
 
 static void
@@ -375,12 +711,25 @@ inf_text_session_remove_local_user(InfTextSession* session,
     );
   }
 
+  /* A held back modification has been flushed when the user's status
+   * changed, or by InfAdoptedSession if the user is still available. This
+   * only catches the case that the user was removed from the user table
+   * otherwise, since the buffer already contains the modification. */
+  if(priv->merge_chunk != NULL && priv->merge_user == local->user)
+    inf_text_session_flush_merged_request(session);
+
   inf_signal_handlers_disconnect_by_func(
     G_OBJECT(local->user),
     G_CALLBACK(inf_text_session_selection_changed_cb),
     session
   );
 
+  inf_signal_handlers_disconnect_by_func(
+    G_OBJECT(local->user),
+    G_CALLBACK(inf_text_session_set_status_cb),
+    session
+  );
+
   g_slice_free(InfTextSessionLocalUser, local);
   priv->local_users = g_slist_remove(priv->local_users, local);
 }
@@ -537,7 +886,6 @@ inf_text_session_buffer_text_inserted_cb(InfTextBuffer* buffer,
   InfAdoptedRequest* execute_request;
 
   InfAdoptedOperation* operation;
-  InfAdoptedRequest* request;
   InfTextSessionInsertForeachData data;
 
   g_assert(INF_TEXT_IS_USER(user));
@@ -550,27 +898,30 @@ inf_text_session_buffer_text_inserted_cb(InfTextBuffer* buffer,
 
   if(execute_request == NULL)
   {
-    operation = INF_ADOPTED_OPERATION(
-      inf_text_default_insert_operation_new(pos, chunk)
-    );
-
-    request = inf_adopted_algorithm_generate_request(
-      algorithm,
-      INF_ADOPTED_REQUEST_DO,
-      INF_ADOPTED_USER(user),
-      operation
-    );
-
-    /* This cannot fail since operation is not applied */
-    inf_adopted_algorithm_execute_request(algorithm, request, FALSE, NULL);
+    if(priv->merge_interval > 0)
+    {
+      inf_text_session_merge_modification(
+        session,
+        INF_TEXT_USER(user),
+        TRUE,
+        pos,
+        chunk
+      );
+    }
+    else
+    {
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_insert_operation_new(pos, chunk)
+      );
 
-    inf_adopted_session_broadcast_request(
-      INF_ADOPTED_SESSION(session),
-      request
-    );
+      inf_text_session_broadcast_modification(
+        session,
+        INF_TEXT_USER(user),
+        operation
+      );
 
-    g_object_unref(request);
-    g_object_unref(operation);
+      g_object_unref(operation);
+    }
   }
 
   data.position = pos;
@@ -615,7 +966,6 @@ inf_text_session_buffer_text_erased_cb(InfTextBuffer* buffer,
   InfAdoptedRequest* execute_request;
 
   InfAdoptedOperation* operation;
-  InfAdoptedRequest* request;
   InfTextSessionEraseForeachData data;
 
   g_assert(INF_TEXT_IS_USER(user));
@@ -628,27 +978,30 @@ inf_text_session_buffer_text_erased_cb(InfTextBuffer* buffer,
 
   if(execute_request == NULL)
   {
-    operation = INF_ADOPTED_OPERATION(
-      inf_text_default_delete_operation_new(pos, chunk)
-    );
-
-    request = inf_adopted_algorithm_generate_request(
-      algorithm,
-      INF_ADOPTED_REQUEST_DO,
-      INF_ADOPTED_USER(user),
-      operation
-    );
-
-    /* This cannot fail since operation is not applied */
-    inf_adopted_algorithm_execute_request(algorithm, request, FALSE, NULL);
+    if(priv->merge_interval > 0)
+    {
+      inf_text_session_merge_modification(
+        session,
+        INF_TEXT_USER(user),
+        FALSE,
+        pos,
+        chunk
+      );
+    }
+    else
+    {
+      operation = INF_ADOPTED_OPERATION(
+        inf_text_default_delete_operation_new(pos, chunk)
+      );
 
-    inf_adopted_session_broadcast_request(
-      INF_ADOPTED_SESSION(session),
-      request
-    );
+      inf_text_session_broadcast_modification(
+        session,
+        INF_TEXT_USER(user),
+        operation
+      );
 
-    g_object_unref(request);
-    g_object_unref(operation);
+      g_object_unref(operation);
+    }
   }
 
   data.position = pos;
@@ -730,6 +1083,32 @@ inf_text_session_init_text_handlers(InfTextSession* session)
   );
 }
 
+/* Puts the text received during synchronization into the buffer */
+static void
+inf_text_session_flush_sync_chunk(InfTextSession* session)
+{
+  InfTextSessionPrivate* priv;
+  InfTextBuffer* buffer;
+
+  priv = INF_TEXT_SESSION_PRIVATE(session);
+  if(priv->sync_chunk != NULL)
+  {
+    buffer = INF_TEXT_BUFFER(inf_session_get_buffer(INF_SESSION(session)));
+
+    inf_text_buffer_append(buffer, priv->sync_chunk, NULL);
+    inf_text_chunk_free(priv->sync_chunk);
+    priv->sync_chunk = NULL;
+  }
+}
+
+static void
+inf_text_session_synchronization_complete_cb(InfSession* session,
+                                             InfXmlConnection* connection,
+                                             gpointer user_data)
+{
+  inf_text_session_flush_sync_chunk(INF_TEXT_SESSION(session));
+}
+
 /*
  * GObject overrides.
  */
@@ -741,6 +1120,18 @@ inf_text_session_init(InfTextSession* session)
   priv = INF_TEXT_SESSION_PRIVATE(session);
 
   priv->caret_update_interval = 500;
+  priv->merge_interval = 0;
+  priv->local_users = NULL;
+
+  priv->merge_user = NULL;
+  priv->merge_insert = FALSE;
+  priv->merge_position = 0;
+  priv->merge_chunk = NULL;
+  priv->merge_backward = FALSE;
+  priv->merge_trailing_space = FALSE;
+  priv->merge_timeout = NULL;
+
+  priv->sync_chunk = NULL;
 }
 
 static void
@@ -771,7 +1162,22 @@ inf_text_session_constructed(GObject* object)
   );
 
   if(status == INF_SESSION_RUNNING)
+  {
     inf_text_session_init_text_handlers(session);
+  }
+  else
+  {
+    /* The synchronized text needs to be in the buffer before anyone else
+     * gets to see the synchronization-complete signal. Since the signal is
+     * G_SIGNAL_RUN_LAST, the class handler would be too late, but this
+     * handler runs first since nobody else had the chance to connect yet. */
+    g_signal_connect(
+      object,
+      "synchronization-complete",
+      G_CALLBACK(inf_text_session_synchronization_complete_cb),
+      NULL
+    );
+  }
 }
 
 /*static void
@@ -839,6 +1245,18 @@ inf_text_session_dispose(GObject* object)
     session
   );
 
+  inf_signal_handlers_disconnect_by_func(
+    object,
+    G_CALLBACK(inf_text_session_synchronization_complete_cb),
+    NULL
+  );
+
+  if(priv->sync_chunk != NULL)
+  {
+    inf_text_chunk_free(priv->sync_chunk);
+    priv->sync_chunk = NULL;
+  }
+
   G_OBJECT_CLASS(inf_text_session_parent_class)->dispose(object);
 }
 
@@ -871,6 +1289,11 @@ inf_text_session_set_property(GObject* object,
   case PROP_CARET_UPDATE_INTERVAL:
     priv->caret_update_interval = g_value_get_uint(value);
     break;
+  case PROP_MERGE_INTERVAL:
+    priv->merge_interval = g_value_get_uint(value);
+    if(priv->merge_interval == 0)
+      inf_text_session_flush_merged_request(session);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -894,6 +1317,9 @@ inf_text_session_get_property(GObject* object,
   case PROP_CARET_UPDATE_INTERVAL:
     g_value_set_uint(value, priv->caret_update_interval);
     break;
+  case PROP_MERGE_INTERVAL:
+    g_value_set_uint(value, priv->merge_interval);
+    break;
   default:
     G_OBJECT_WARN_INVALID_PROPERTY_ID(object, prop_id, pspec);
     break;
@@ -987,6 +1413,7 @@ inf_text_session_to_xml_sync(InfSession* session,
   gchar* text;
   gsize total_bytes;
   gsize bytes_left;
+  gboolean utf8;
   GIConv cd;
 
   INF_SESSION_CLASS(inf_text_session_parent_class)->to_xml_sync(
@@ -995,7 +1422,12 @@ inf_text_session_to_xml_sync(InfSession* session,
   );
 
   buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
-  cd = g_iconv_open("UTF-8", inf_text_buffer_get_encoding(buffer));
+  utf8 = inf_text_session_encoding_is_utf8(
+    inf_text_buffer_get_encoding(buffer)
+  );
+
+  if(!utf8)
+    cd = g_iconv_open("UTF-8", inf_text_buffer_get_encoding(buffer));
 
   iter = inf_text_buffer_create_begin_iter(buffer);
   if(iter != NULL)
@@ -1012,7 +1444,7 @@ inf_text_session_to_xml_sync(InfSession* session,
       {
         xml = xmlNewChild(parent, NULL, (const xmlChar*)"sync-segment", NULL);
         inf_text_session_segment_to_xml(
-          &cd,
+          utf8 ? NULL : &cd,
           xml,
           text + total_bytes - bytes_left,
           &bytes_left,
@@ -1027,7 +1459,8 @@ inf_text_session_to_xml_sync(InfSession* session,
     inf_text_buffer_destroy_iter(buffer, iter);
   }
 
-  g_iconv_close(cd);
+  if(!utf8)
+    g_iconv_close(cd);
 }
 
 static gboolean
@@ -1036,6 +1469,7 @@ inf_text_session_process_xml_sync(InfSession* session,
                                   const xmlNodePtr xml,
                                   GError** error)
 {
+  InfTextSessionPrivate* priv;
   InfTextBuffer* buffer;
   GIConv cd;
 
@@ -1048,18 +1482,33 @@ inf_text_session_process_xml_sync(InfSession* session,
   if(strcmp((const char*)xml->name, "sync-segment") == 0)
   {
     buffer = INF_TEXT_BUFFER(inf_session_get_buffer(session));
-    cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
+    if(inf_text_session_encoding_is_utf8(inf_text_buffer_get_encoding(buffer)))
+    {
+      text = inf_text_session_segment_from_xml(
+        NULL,
+        xml,
+        &length,
+        &bytes,
+        &author,
+        error
+      );
+    }
+    else
+    {
+      cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
 
-    text = inf_text_session_segment_from_xml(
-      &cd,
-      xml,
-      &length,
-      &bytes,
-      &author,
-      error
-    );
+      text = inf_text_session_segment_from_xml(
+        &cd,
+        xml,
+        &length,
+        &bytes,
+        &author,
+        error
+      );
+
+      g_iconv_close(cd);
+    }
 
-    g_iconv_close(cd);
     if(text == NULL) return FALSE;
 
     if(author != 0)
@@ -1090,13 +1539,23 @@ inf_text_session_process_xml_sync(InfSession* session,
       user = NULL;
     }
 
-    inf_text_buffer_insert_text(
-      buffer,
-      inf_text_buffer_get_length(buffer),
+    /* Collect the segments, and only insert the text into the buffer when
+     * all of it has arrived. This avoids updating the buffer, and
+     * everything that is attached to it, for each segment. */
+    priv = INF_TEXT_SESSION_PRIVATE(session);
+    if(priv->sync_chunk == NULL)
+    {
+      priv->sync_chunk =
+        inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
+    }
+
+    inf_text_chunk_insert_text(
+      priv->sync_chunk,
+      inf_text_chunk_get_length(priv->sync_chunk),
       text,
       bytes,
       length,
-      user
+      author
     );
 
     g_free(text);
@@ -1104,6 +1563,10 @@ inf_text_session_process_xml_sync(InfSession* session,
   }
   else
   {
+    /* Keep the buffer up to date with what has been received so far in
+     * case something else than the text is synchronized afterwards. */
+    inf_text_session_flush_sync_chunk(INF_TEXT_SESSION(session));
+
     return INF_SESSION_CLASS(inf_text_session_parent_class)->process_xml_sync(
       session,
       connection,
@@ -1331,6 +1794,7 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
   gboolean result;
   xmlNodePtr op_xml;
 
+  gchar* chunk_text;
   gchar* utf8_text;
   gsize bytes_read;
   gsize bytes_written;
@@ -1366,12 +1830,13 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
         INF_TEXT_DEFAULT_INSERT_OPERATION(operation)
       );
 
-      result = inf_text_chunk_iter_init_begin(chunk, &iter);
-      g_assert(result == TRUE);
+      /* The whole inserted text is written by a single user, however it
+       * can still span several segments if it is long. */
+      chunk_text = inf_text_chunk_get_text(chunk, &total_bytes);
 
       utf8_text = g_convert(
-        inf_text_chunk_iter_get_text(&iter),
-        inf_text_chunk_iter_get_bytes(&iter),
+        chunk_text,
+        total_bytes,
         "UTF-8",
         inf_text_chunk_get_encoding(chunk),
         &bytes_read,
@@ -1381,14 +1846,11 @@ inf_text_session_request_to_xml(InfAdoptedSession* session,
 
       /* Conversion to UTF-8 should always succeed */
       g_assert(utf8_text != NULL);
-      g_assert(bytes_read == inf_text_chunk_iter_get_bytes(&iter));
+      g_assert(bytes_read == total_bytes);
 
       inf_xml_util_add_child_text(op_xml, utf8_text, bytes_written);
       g_free(utf8_text);
-
-      /* We only allow a single segment because the whole inserted text must
-       * be written by a single user. */
-      g_assert(inf_text_chunk_iter_next(&iter) == FALSE);
+      g_free(chunk_text);
     }
     else if(INF_TEXT_IS_DELETE_OPERATION(operation))
     {
@@ -1528,6 +1990,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
   guint length;
 
   xmlNodePtr child;
+  gboolean utf8;
   GIConv cd;
   guint author;
   gboolean cmp;
@@ -1561,18 +2024,32 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
     if(!utf8_text)
       goto fail;
 
-    text = g_convert(
-      utf8_text,
-      in_bytes,
-      inf_text_buffer_get_encoding(buffer),
-      "UTF-8",
-      NULL,
-      &bytes,
-      error
-    );
+    if(inf_text_session_encoding_is_utf8(inf_text_buffer_get_encoding(buffer)))
+    {
+      if(!inf_text_session_validate_utf8(utf8_text, in_bytes, error))
+      {
+        g_free(utf8_text);
+        goto fail;
+      }
+
+      text = utf8_text;
+      bytes = in_bytes;
+    }
+    else
+    {
+      text = g_convert(
+        utf8_text,
+        in_bytes,
+        inf_text_buffer_get_encoding(buffer),
+        "UTF-8",
+        NULL,
+        &bytes,
+        error
+      );
 
-    g_free(utf8_text);
-    if(text == NULL) goto fail;
+      g_free(utf8_text);
+      if(text == NULL) goto fail;
+    }
 
     chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
     inf_text_chunk_insert_text(chunk, 0, text, bytes, length, user_id);
@@ -1595,15 +2072,22 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
     if(for_sync == TRUE)
     {
       chunk = inf_text_chunk_new(inf_text_buffer_get_encoding(buffer));
-      cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
-      g_assert(cd != (GIConv)(-1));
+      utf8 = inf_text_session_encoding_is_utf8(
+        inf_text_buffer_get_encoding(buffer)
+      );
+
+      if(!utf8)
+      {
+        cd = g_iconv_open(inf_text_buffer_get_encoding(buffer), "UTF-8");
+        g_assert(cd != (GIConv)(-1));
+      }
 
       for(child = op_xml->children; child != NULL; child = child->next)
       {
         if(strcmp((const char*)child->name, "segment") == 0)
         {
           text = inf_text_session_segment_from_xml(
-            &cd,
+            utf8 ? NULL : &cd,
             child,
             &length,
             &bytes,
@@ -1614,7 +2098,7 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
           if(text == NULL)
           {
             inf_text_chunk_free(chunk);
-            g_iconv_close(cd);
+            if(!utf8) g_iconv_close(cd);
             goto fail;
           }
           else
@@ -1637,7 +2121,8 @@ inf_text_session_xml_to_request(InfAdoptedSession* session,
         }
       }
 
-      g_iconv_close(cd);
+      if(!utf8)
+        g_iconv_close(cd);
 
       operation = INF_ADOPTED_OPERATION(
         inf_text_default_delete_operation_new(pos, chunk)
@@ -1747,6 +2232,12 @@ fail:
   return NULL;
 }
 
+static void
+inf_text_session_flush_requests(InfAdoptedSession* session)
+{
+  inf_text_session_flush_merged_request(INF_TEXT_SESSION(session));
+}
+
 /*
  * Gype registration.
  */
@@ -1780,6 +2271,7 @@ inf_text_session_class_init(InfTextSessionClass* text_session_class)
 
   adopted_session_class->xml_to_request = inf_text_session_xml_to_request;
   adopted_session_class->request_to_xml = inf_text_session_request_to_xml;
+  adopted_session_class->flush_requests = inf_text_session_flush_requests;
 
   inf_text_session_error_quark = g_quark_from_static_string(
     "INF_TEXT_SESSION_ERROR"
@@ -1798,6 +2290,22 @@ inf_text_session_class_init(InfTextSessionClass* text_session_class)
       G_PARAM_READWRITE | G_PARAM_CONSTRUCT
     )
   );
+
+  g_object_class_install_property(
+    object_class,
+    PROP_MERGE_INTERVAL,
+    g_param_spec_uint(
+      "merge-interval",
+      "Merge interval",
+      "Maximum number of milliseconds for which local insertions and "
+      "deletions are held back to be merged with adjacent ones, or 0 to "
+      "send every modification right away",
+      0,
+      G_MAXUINT,
+      0,
+      G_PARAM_READWRITE | G_PARAM_CONSTRUCT
+    )
+  );
 }
 
 /*
@@ -1980,10 +2488,15 @@ inf_text_session_set_user_color(InfTextSession* session,
  * This function sends all pending requests for @user immediately. Requests
  * that modify the buffer are not queued normally, but cursor movement
  * requests are delayed in case are issued frequently, to save bandwidth.
+ * If #InfTextSession:merge-interval is non-zero, then insertions and
+ * deletions are held back as well, to be sent together with adjacent ones
+ * as a single request.
  *
  * The main purpose of this function is to send all pending requests before
  * changing a user's status to inactive or unavailable since inactive users
- * are automatically activated as soon as they issue a request.
+ * are automatically activated as soon as they issue a request. Held back
+ * insertions and deletions are flushed automatically when the status of
+ * @user changes, but cursor movement is not.
  *
  * TODO: We should probably detect this automatically, without requiring
  * people to call this function, i.e. flush requests for local users just
@@ -2003,6 +2516,9 @@ inf_text_session_flush_requests_for_user(InfTextSession* session,
   local = inf_text_session_find_local_user(session, user);
   g_assert(local != NULL);
 
+  if(INF_TEXT_SESSION_PRIVATE(session)->merge_user == user)
+    inf_text_session_flush_merged_request(session);
+
   if(local->caret_timeout != NULL)
   {
     inf_text_session_broadcast_caret_selection(session, local);
@@ -0,0 +1,40 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef __INF_TEXT_UNDO_GROUPING_PRIVATE_H__
+#define __INF_TEXT_UNDO_GROUPING_PRIVATE_H__
+
+#include <libinfinity/adopted/inf-adopted-operation.h>
+
+#include <glib-object.h>
+
+/* Marks a text insert or delete operation as a run of single characters
+ * that have been typed or removed one after the other and were then merged
+ * into one operation, see InfTextSession:merge-interval.
+ * InfTextUndoGrouping groups such an operation with adjacent ones in the
+ * same way as it would group its characters if they were separate
+ * requests. backward is TRUE for a deletion run made with backspace, i.e.
+ * from the end of the run towards its beginning. */
+void
+_inf_text_undo_grouping_set_run(InfAdoptedOperation* operation,
+                                gboolean backward);
+
+#endif /* __INF_TEXT_UNDO_GROUPING_PRIVATE_H__ */
+
+/* vim:set et sw=2 ts=2: */
@@ -35,6 +35,7 @@
  */
 
 #include <libinftext/inf-text-undo-grouping.h>
+#include <libinftext/inf-text-undo-grouping-private.h>
 #include <libinftext/inf-text-default-insert-operation.h>
 #include <libinftext/inf-text-default-delete-operation.h>
 #include <libinftext/inf-text-insert-operation.h>
@@ -46,6 +47,15 @@
 
 G_DEFINE_TYPE(InfTextUndoGrouping, inf_text_undo_grouping, INF_ADOPTED_TYPE_UNDO_GROUPING)
 
+/* Operations that are runs of merged characters carry this as qdata, with
+ * the value telling in which direction the characters were typed or
+ * removed. */
+typedef enum _InfTextUndoGroupingRun {
+  INF_TEXT_UNDO_GROUPING_RUN_NONE = 0,
+  INF_TEXT_UNDO_GROUPING_RUN_FORWARD,
+  INF_TEXT_UNDO_GROUPING_RUN_BACKWARD
+} InfTextUndoGroupingRun;
+
 /* Returns the gunichar of the first character of a InfTextChunk */
 static gunichar
 inf_text_undo_grouping_get_char_from_chunk(InfTextChunk* chunk)
@@ -77,6 +87,62 @@ inf_text_undo_grouping_get_char_from_chunk(InfTextChunk* chunk)
   return g_utf8_get_char(buffer);
 }
 
+/* Returns the character at offset in chunk */
+static gunichar
+inf_text_undo_grouping_get_char_at(InfTextChunk* chunk,
+                                   guint offset)
+{
+  InfTextChunk* slice;
+  gunichar result;
+
+  if(offset == 0)
+    return inf_text_undo_grouping_get_char_from_chunk(chunk);
+
+  slice = inf_text_chunk_substring(chunk, offset, 1);
+  result = inf_text_undo_grouping_get_char_from_chunk(slice);
+  inf_text_chunk_free(slice);
+
+  return result;
+}
+
+/* Returns the first or the last character that has been typed or removed
+ * by an operation, in the order the user did it. For a single character
+ * both are the same. */
+static gunichar
+inf_text_undo_grouping_get_run_char(InfTextChunk* chunk,
+                                    InfTextUndoGroupingRun run,
+                                    gboolean last)
+{
+  gboolean at_end;
+
+  at_end = last;
+  if(run == INF_TEXT_UNDO_GROUPING_RUN_BACKWARD)
+    at_end = !at_end;
+
+  if(at_end)
+  {
+    return inf_text_undo_grouping_get_char_at(
+      chunk,
+      inf_text_chunk_get_length(chunk) - 1
+    );
+  }
+  else
+  {
+    return inf_text_undo_grouping_get_char_at(chunk, 0);
+  }
+}
+
+static InfTextUndoGroupingRun
+inf_text_undo_grouping_get_run_type(InfAdoptedOperation* operation)
+{
+  return GPOINTER_TO_UINT(
+    g_object_get_qdata(
+      G_OBJECT(operation),
+      g_quark_from_static_string("inf-text-undo-grouping-run")
+    )
+  );
+}
+
 static guint
 inf_text_undo_grouping_get_translated_position(InfAdoptedAlgorithm* algorithm,
                                                InfAdoptedRequest* from,
@@ -147,6 +213,8 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
   guint second_pos;
   gunichar first_char;
   gunichar second_char;
+  InfTextUndoGroupingRun first_run;
+  InfTextUndoGroupingRun second_run;
 
   g_assert(inf_adopted_request_get_request_type(first) ==
            INF_ADOPTED_REQUEST_DO);
@@ -179,6 +247,9 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
   g_assert(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(second_op) ||
            INF_TEXT_IS_DEFAULT_DELETE_OPERATION(second_op));
 
+  first_run = inf_text_undo_grouping_get_run_type(first_op);
+  second_run = inf_text_undo_grouping_get_run_type(second_op);
+
   /* Never group insert and delete operations */
   if(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(first_op) &&
      INF_TEXT_IS_DEFAULT_DELETE_OPERATION(second_op))
@@ -199,7 +270,10 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
       INF_TEXT_INSERT_OPERATION(second_op)
     );
 
-    if(first_length > 1 || second_length > 1)
+    /* Longer insertions, such as pasted text, are not grouped, unless
+     * they are runs of merged characters. */
+    if((first_length > 1 && first_run == INF_TEXT_UNDO_GROUPING_RUN_NONE) ||
+       (second_length > 1 && second_run == INF_TEXT_UNDO_GROUPING_RUN_NONE))
     {
       return FALSE;
     }
@@ -213,7 +287,7 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
         inf_adopted_undo_grouping_get_algorithm(grouping),
         first,
         second,
-        first_pos + 1
+        first_pos + first_length
       );
 
       second_pos = inf_text_insert_operation_get_position(
@@ -224,15 +298,19 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
         return FALSE;
 
       /* start new group when going from whitespace to non-whitespace */
-      first_char = inf_text_undo_grouping_get_char_from_chunk(
+      first_char = inf_text_undo_grouping_get_run_char(
         inf_text_default_insert_operation_get_chunk(
           INF_TEXT_DEFAULT_INSERT_OPERATION(first_op)
-        )
+        ),
+        first_run,
+        TRUE
       );
-      second_char = inf_text_undo_grouping_get_char_from_chunk(
+      second_char = inf_text_undo_grouping_get_run_char(
         inf_text_default_insert_operation_get_chunk(
           INF_TEXT_DEFAULT_INSERT_OPERATION(second_op)
-        )
+        ),
+        second_run,
+        FALSE
       );
 
       if(g_unichar_isspace(first_char) && !g_unichar_isspace(second_char))
@@ -250,12 +328,15 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
       INF_TEXT_DELETE_OPERATION(second_op)
     );
 
-    if(first_length > 1 || second_length > 1)
+    if((first_length > 1 && first_run == INF_TEXT_UNDO_GROUPING_RUN_NONE) ||
+       (second_length > 1 && second_run == INF_TEXT_UNDO_GROUPING_RUN_NONE))
     {
       return FALSE;
     }
     else
     {
+      /* The last character removed by the first operation was at its
+       * position, no matter in which direction a run was removed. */
       first_pos = inf_text_delete_operation_get_position(
         INF_TEXT_DELETE_OPERATION(first_op)
       );
@@ -267,23 +348,32 @@ inf_text_undo_grouping_group_requests(InfAdoptedUndoGrouping* grouping,
         first_pos
       );
 
+      /* The first character removed by the second operation is at its end
+       * if it was removed with backspace. */
       second_pos = inf_text_delete_operation_get_position(
         INF_TEXT_DELETE_OPERATION(second_op)
       );
 
+      if(second_run == INF_TEXT_UNDO_GROUPING_RUN_BACKWARD)
+        second_pos += second_length - 1;
+
       if(first_pos != second_pos && first_pos != second_pos + 1)
         return FALSE;
 
       /* start new group when going from whitespace to non-whitespace */
-      first_char = inf_text_undo_grouping_get_char_from_chunk(
+      first_char = inf_text_undo_grouping_get_run_char(
         inf_text_default_delete_operation_get_chunk(
           INF_TEXT_DEFAULT_DELETE_OPERATION(first_op)
-        )
+        ),
+        first_run,
+        TRUE
       );
-      second_char = inf_text_undo_grouping_get_char_from_chunk(
+      second_char = inf_text_undo_grouping_get_run_char(
         inf_text_default_delete_operation_get_chunk(
           INF_TEXT_DEFAULT_DELETE_OPERATION(second_op)
-        )
+        ),
+        second_run,
+        FALSE
       );
 
       if(g_unichar_isspace(first_char) && !g_unichar_isspace(second_char))
@@ -316,6 +406,28 @@ inf_text_undo_grouping_class_init(
   undo_grouping_class->group_requests = inf_text_undo_grouping_group_requests;
 }
 
+/*
+ * Private API, see inf-text-undo-grouping-private.h
+ */
+
+void
+_inf_text_undo_grouping_set_run(InfAdoptedOperation* operation,
+                                gboolean backward)
+{
+  InfTextUndoGroupingRun run;
+
+  if(backward)
+    run = INF_TEXT_UNDO_GROUPING_RUN_BACKWARD;
+  else
+    run = INF_TEXT_UNDO_GROUPING_RUN_FORWARD;
+
+  g_object_set_qdata(
+    G_OBJECT(operation),
+    g_quark_from_static_string("inf-text-undo-grouping-run"),
+    GUINT_TO_POINTER(run)
+  );
+}
+
 /*
  * Public API.
  */
@@ -1584,6 +1584,82 @@ inf_text_gtk_buffer_buffer_get_slice(InfTextBuffer* buffer,
   return result;
 }
 
+/* Keeps the local cursor and selection bound in front of text that was
+ * inserted at their position by someone else. end_iter points to the end
+ * of the inserted text of the given length, and is moved to its beginning
+ * if one of the marks needed to be moved. */
+static void
+inf_text_gtk_buffer_fix_cursor_gravity(InfTextGtkBuffer* buffer,
+                                       GtkTextIter* end_iter,
+                                       guint length,
+                                       InfUser* user)
+{
+  InfTextGtkBufferPrivate* priv;
+  GtkTextMark* mark;
+  GtkTextIter insert_iter;
+  gboolean insert_at_cursor;
+  gboolean insert_at_selection_bound;
+
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+
+  /* TODO: We could also do this by simply resyncing the text buffer marks
+   * to the active user's caret and selection properties. But then we
+   * wouldn't have left gravtiy if no active user was present. */
+  if(user != INF_USER(priv->active_user) || user == NULL)
+  {
+    mark = gtk_text_buffer_get_insert(priv->buffer);
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+
+    if(gtk_text_iter_equal(&insert_iter, end_iter))
+      insert_at_cursor = TRUE;
+    else
+      insert_at_cursor = FALSE;
+
+    mark = gtk_text_buffer_get_selection_bound(priv->buffer);
+    gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+
+    if(gtk_text_iter_equal(&insert_iter, end_iter))
+      insert_at_selection_bound = TRUE;
+    else
+      insert_at_selection_bound = FALSE;
+
+    if(insert_at_cursor || insert_at_selection_bound)
+    {
+      inf_signal_handlers_block_by_func(
+        G_OBJECT(priv->buffer),
+        G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
+        buffer
+      );
+
+      gtk_text_iter_backward_chars(end_iter, length);
+
+      if(insert_at_cursor)
+      {
+        gtk_text_buffer_move_mark(
+          priv->buffer,
+          gtk_text_buffer_get_insert(priv->buffer),
+          end_iter
+        );
+      }
+
+      if(insert_at_selection_bound)
+      {
+        gtk_text_buffer_move_mark(
+          priv->buffer,
+          gtk_text_buffer_get_selection_bound(priv->buffer),
+          end_iter
+        );
+      }
+
+      inf_signal_handlers_unblock_by_func(
+        G_OBJECT(priv->buffer),
+        G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
+        buffer
+      );
+    }
+  }
+}
+
 static void
 inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
                                        guint pos,
@@ -1595,11 +1671,6 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
   InfTextGtkBufferTagRemove tag_remove;
   GtkTextTag* tag;
 
-  GtkTextMark* mark;
-  GtkTextIter insert_iter;
-  gboolean insert_at_cursor;
-  gboolean insert_at_selection_bound;
-
   priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
   tag_remove.buffer = priv->buffer;
 
@@ -1684,66 +1755,116 @@ inf_text_gtk_buffer_buffer_insert_text(InfTextBuffer* buffer,
     } while(inf_text_chunk_iter_next(&chunk_iter));
 
     /* Fix left gravity of own cursor on remote insert */
+    inf_text_gtk_buffer_fix_cursor_gravity(
+      INF_TEXT_GTK_BUFFER(buffer),
+      &tag_remove.end_iter,
+      inf_text_chunk_get_length(chunk),
+      user
+    );
+  }
 
-    /* TODO: We could also do this by simply resyncing the text buffer marks
-     * to the active user's caret and selection properties. But then we
-     * wouldn't have left gravtiy if no active user was present. */
-    if(user != INF_USER(priv->active_user) || user == NULL)
-    {
-      mark = gtk_text_buffer_get_insert(priv->buffer);
-      gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
+    buffer
+  );
 
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
-        insert_at_cursor = TRUE;
-      else
-        insert_at_cursor = FALSE;
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
+    buffer
+  );
 
-      mark = gtk_text_buffer_get_selection_bound(priv->buffer);
-      gtk_text_buffer_get_iter_at_mark(priv->buffer, &insert_iter, mark);
+  inf_signal_handlers_unblock_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
+    buffer
+  );
 
-      if(gtk_text_iter_equal(&insert_iter, &tag_remove.end_iter))
-        insert_at_selection_bound = TRUE;
-      else
-        insert_at_selection_bound = FALSE;
+  inf_text_buffer_text_inserted(buffer, pos, chunk, user);
+}
 
-      if(insert_at_cursor || insert_at_selection_bound)
-      {
-        inf_signal_handlers_block_by_func(
-          G_OBJECT(priv->buffer),
-          G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
-          buffer
-        );
+static void
+inf_text_gtk_buffer_buffer_append(InfTextBuffer* buffer,
+                                  InfTextChunk* chunk,
+                                  InfUser* user)
+{
+  InfTextGtkBufferPrivate* priv;
+  InfTextChunkIter chunk_iter;
+  InfTextGtkBufferUserTags* user_tags;
+  GtkTextTag* tag;
+  GtkTextIter end_iter;
+  guint pos;
 
-        gtk_text_iter_backward_chars(
-          &tag_remove.end_iter,
-          inf_text_chunk_get_length(chunk)
-        );
+  priv = INF_TEXT_GTK_BUFFER_PRIVATE(buffer);
+  g_assert(priv->record == NULL);
 
-        if(insert_at_cursor)
-        {
-          gtk_text_buffer_move_mark(
-            priv->buffer,
-            gtk_text_buffer_get_insert(priv->buffer),
-            &tag_remove.end_iter
-          );
-        }
-
-        if(insert_at_selection_bound)
-        {
-          gtk_text_buffer_move_mark(
-            priv->buffer,
-            gtk_text_buffer_get_selection_bound(priv->buffer),
-            &tag_remove.end_iter
-          );
-        }
+  pos = gtk_text_buffer_get_char_count(priv->buffer);
 
-        inf_signal_handlers_unblock_by_func(
-          G_OBJECT(priv->buffer),
-          G_CALLBACK(inf_text_gtk_buffer_mark_set_cb),
-          buffer
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_apply_tag_cb),
+    buffer
+  );
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_before),
+    buffer
+  );
+
+  inf_signal_handlers_block_by_func(
+    G_OBJECT(priv->buffer),
+    G_CALLBACK(inf_text_gtk_buffer_insert_text_cb_after),
+    buffer
+  );
+
+  if(inf_text_chunk_iter_init_begin(chunk, &chunk_iter))
+  {
+    gtk_text_buffer_get_end_iter(priv->buffer, &end_iter);
+
+    /* Unlike in insert_text, there is no need to remove other users' tags
+     * from the inserted text: Text at the end of the buffer is never inside
+     * another user's text, and GtkTextBuffer does not extend tags that end
+     * at the insertion point. This saves a walk over the whole tag table
+     * for every segment. */
+    do
+    {
+      user_tags = inf_text_gtk_buffer_get_user_tags(
+        INF_TEXT_GTK_BUFFER(buffer),
+        inf_text_chunk_iter_get_author(&chunk_iter)
+      );
+
+      if(user_tags)
+      {
+        tag = inf_text_gtk_buffer_get_user_tag(
+          INF_TEXT_GTK_BUFFER(buffer),
+          user_tags,
+          priv->show_user_colors
         );
       }
-    }
+      else
+      {
+        tag = NULL;
+      }
+
+      gtk_text_buffer_insert_with_tags(
+        priv->buffer,
+        &end_iter,
+        inf_text_chunk_iter_get_text(&chunk_iter),
+        inf_text_chunk_iter_get_bytes(&chunk_iter),
+        tag,
+        NULL
+      );
+    } while(inf_text_chunk_iter_next(&chunk_iter));
+
+    /* Fix left gravity of own cursor on remote insert */
+    inf_text_gtk_buffer_fix_cursor_gravity(
+      INF_TEXT_GTK_BUFFER(buffer),
+      &end_iter,
+      inf_text_chunk_get_length(chunk),
+      user
+    );
   }
 
   inf_signal_handlers_unblock_by_func(
@@ -2148,6 +2269,7 @@ inf_text_gtk_buffer_text_buffer_iface_init(InfTextBufferInterface* iface)
   iface->iter_get_length = inf_text_gtk_buffer_buffer_iter_get_length;
   iface->iter_get_bytes = inf_text_gtk_buffer_buffer_iter_get_bytes;
   iface->iter_get_author = inf_text_gtk_buffer_buffer_iter_get_author;
+  iface->append = inf_text_gtk_buffer_buffer_append;
   iface->text_inserted = NULL;
   iface->text_erased = NULL;
 }
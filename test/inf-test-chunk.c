@@ -19,8 +19,217 @@
 
 #include <libinftext/inf-text-chunk.h>
 
+#include <string.h>
+
+static void
+test_chunk_text(InfTextChunk* chunk,
+                const gchar* expected)
+{
+  gchar* text;
+  gsize bytes;
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  g_assert(bytes == strlen(expected));
+  g_assert(memcmp(text, expected, bytes) == 0);
+  g_assert(inf_text_chunk_get_length(chunk) == g_utf8_strlen(expected, -1));
+  g_free(text);
+}
+
+static void
+test_chunk_offsets(InfTextChunk* chunk)
+{
+  InfTextChunkIter iter;
+  guint offset;
+
+  offset = 0;
+  if(inf_text_chunk_iter_init_begin(chunk, &iter))
+  {
+    do
+    {
+      g_assert(inf_text_chunk_iter_get_offset(&iter) == offset);
+      offset += inf_text_chunk_iter_get_length(&iter);
+    } while(inf_text_chunk_iter_next(&iter));
+  }
+
+  g_assert(offset == inf_text_chunk_get_length(chunk));
+}
+
+/* Checks that inserting a range of text with inf_text_chunk_insert_substring
+ * gives the same result as inserting the corresponding substring */
+static void
+test_insert_substring(InfTextChunk* chunk,
+                      InfTextChunk* text,
+                      guint offset,
+                      guint begin,
+                      guint length)
+{
+  InfTextChunk* result;
+  InfTextChunk* expected;
+  InfTextChunk* sub;
+
+  result = inf_text_chunk_copy(chunk);
+  inf_text_chunk_insert_substring(result, offset, text, begin, length);
+
+  expected = inf_text_chunk_copy(chunk);
+  sub = inf_text_chunk_substring(text, begin, length);
+  inf_text_chunk_insert_chunk(expected, offset, sub);
+
+  g_assert(inf_text_chunk_equal_with_authors(result, expected));
+  test_chunk_offsets(result);
+
+  inf_text_chunk_free(sub);
+  inf_text_chunk_free(expected);
+  inf_text_chunk_free(result);
+}
+
+/* Exercises chunks whose text by a single author is longer than what fits
+ * into a single segment */
+static void
+test_long_segments(void)
+{
+  InfTextChunk* chunk;
+  InfTextChunk* sub;
+  GString* str;
+  GString* expected;
+  guint i;
+
+  str = g_string_new(NULL);
+  for(i = 0; i < 2000; ++i)
+    g_string_append(str, (i % 3 == 0) ? "ü" : "a");
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, str->str, str->len, 2000, 1);
+  test_chunk_text(chunk, str->str);
+  test_chunk_offsets(chunk);
+
+  /* Insert by another author in the middle, then erase across it */
+  inf_text_chunk_insert_text(chunk, 1000, "xyz", 3, 3, 2);
+  expected = g_string_new(NULL);
+  g_string_append_len(
+    expected,
+    str->str,
+    g_utf8_offset_to_pointer(str->str, 1000) - str->str
+  );
+  g_string_append(expected, "xyz");
+  g_string_append(expected, g_utf8_offset_to_pointer(str->str, 1000));
+  test_chunk_text(chunk, expected->str);
+  test_chunk_offsets(chunk);
+
+  sub = inf_text_chunk_substring(chunk, 999, 5);
+  test_chunk_text(sub, "üxyza");
+
+  test_insert_substring(sub, chunk, 0, 0, inf_text_chunk_get_length(chunk));
+  test_insert_substring(sub, chunk, 2, 990, 20);
+  test_insert_substring(sub, chunk, 5, 1001, 1);
+  test_insert_substring(sub, chunk, 3, 10, 1500);
+  test_insert_substring(chunk, sub, 1000, 1, 3);
+  inf_text_chunk_free(sub);
+
+  inf_text_chunk_erase(chunk, 999, 5);
+  g_string_erase(
+    expected,
+    g_utf8_offset_to_pointer(expected->str, 999) - expected->str,
+    g_utf8_offset_to_pointer(expected->str, 1004) -
+      g_utf8_offset_to_pointer(expected->str, 999)
+  );
+
+  test_chunk_text(chunk, expected->str);
+  test_chunk_offsets(chunk);
+
+  sub = inf_text_chunk_substring(chunk, 0, inf_text_chunk_get_length(chunk));
+  g_assert(inf_text_chunk_equal_with_authors(sub, chunk));
+  inf_text_chunk_erase(chunk, 0, inf_text_chunk_get_length(chunk));
+  g_assert(inf_text_chunk_get_length(chunk) == 0);
+  inf_text_chunk_insert_chunk(chunk, 0, sub);
+  g_assert(inf_text_chunk_equal_with_authors(sub, chunk));
+  test_chunk_offsets(chunk);
+
+  inf_text_chunk_free(sub);
+  inf_text_chunk_free(chunk);
+  g_string_free(expected, TRUE);
+  g_string_free(str, TRUE);
+}
+
+/* Checks that substrings of a chunk in a non-UTF-8 encoding match the
+ * corresponding substrings of the UTF-8 text it was created from */
+static void
+test_encoding_substring(InfTextChunk* chunk,
+                        const gchar* encoding,
+                        const gchar* utf8,
+                        guint offset,
+                        guint length)
+{
+  InfTextChunk* sub;
+  gchar* text;
+  gchar* converted;
+  const gchar* begin;
+  const gchar* end;
+  gsize bytes;
+
+  sub = inf_text_chunk_substring(chunk, offset, length);
+  text = inf_text_chunk_get_text(sub, &bytes);
+  converted = g_convert(text, bytes, "UTF-8", encoding, NULL, &bytes, NULL);
+  g_assert(converted != NULL);
+
+  begin = g_utf8_offset_to_pointer(utf8, offset);
+  end = g_utf8_offset_to_pointer(begin, length);
+  g_assert(bytes == (gsize)(end - begin));
+  g_assert(memcmp(converted, begin, bytes) == 0);
+
+  g_free(converted);
+  g_free(text);
+  inf_text_chunk_free(sub);
+}
+
+static void
+test_encoding(const gchar* encoding,
+              const gchar* const* chars)
+{
+  InfTextChunk* chunk;
+  GString* str;
+  gchar* text;
+  gsize bytes;
+  guint i;
+
+  str = g_string_new(NULL);
+  for(i = 0; i < 1500; ++i)
+    g_string_append(str, chars[i % 3]);
+
+  text = g_convert(str->str, str->len, encoding, "UTF-8", NULL, &bytes, NULL);
+  g_assert(text != NULL);
+
+  chunk = inf_text_chunk_new(encoding);
+  inf_text_chunk_insert_text(chunk, 0, text, bytes, 1500, 1);
+  g_free(text);
+
+  g_assert(inf_text_chunk_get_length(chunk) == 1500);
+  test_chunk_offsets(chunk);
+
+  test_encoding_substring(chunk, encoding, str->str, 0, 7);
+  test_encoding_substring(chunk, encoding, str->str, 700, 10);
+  test_encoding_substring(chunk, encoding, str->str, 1001, 499);
+
+  inf_text_chunk_erase(chunk, 500, 501);
+  g_assert(inf_text_chunk_get_length(chunk) == 999);
+  g_string_erase(
+    str,
+    g_utf8_offset_to_pointer(str->str, 500) - str->str,
+    g_utf8_offset_to_pointer(str->str, 1001) -
+      g_utf8_offset_to_pointer(str->str, 500)
+  );
+
+  test_encoding_substring(chunk, encoding, str->str, 495, 10);
+  test_chunk_offsets(chunk);
+
+  inf_text_chunk_free(chunk);
+  g_string_free(str, TRUE);
+}
+
 int main()
 {
+  static const gchar* const wide_chars[] = { "a", "𝄞", "ü" };
+  static const gchar* const latin1_chars[] = { "a", "b", "ü" };
+
   InfTextChunk* chunk;
   InfTextChunk* chunk2;
 
@@ -32,8 +241,25 @@ int main()
   inf_text_chunk_insert_text(chunk2, 3, "ü", 2, 1, 503);
   chunk = inf_text_chunk_substring(chunk2, 0, 3);
 
+  test_chunk_text(chunk, "cba");
+  test_chunk_text(chunk2, "cbaü");
+
+  inf_text_chunk_free(chunk);
+
+  /* Same text, but written by someone else */
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(chunk, 0, "cbaü", 5, 4, 500);
+  g_assert(inf_text_chunk_equal(chunk, chunk2));
+  g_assert(!inf_text_chunk_equal_with_authors(chunk, chunk2));
   inf_text_chunk_free(chunk);
   inf_text_chunk_free(chunk2);
 
+  test_long_segments();
+
+  test_encoding("UTF-16LE", wide_chars);
+  test_encoding("UTF-16BE", wide_chars);
+  test_encoding("UTF-32LE", wide_chars);
+  test_encoding("ISO-8859-1", latin1_chars);
+
   return 0;
 }
@@ -0,0 +1,337 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Sends messages to a member of a hosted group with message coalescing
+ * enabled in the communication registry, and checks when they show up on
+ * the connection. */
+
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/communication/inf-communication-hosted-group.h>
+#include <libinfinity/communication/inf-communication-registry.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+
+/* Long enough for the test not to depend on how fast it runs */
+#define INF_TEST_COMMUNICATION_COALESCE_INTERVAL 200
+
+/* Each message is serialized to 119 bytes, so the third one crosses this */
+#define INF_TEST_COMMUNICATION_COALESCE_SIZE 300
+
+typedef struct _InfTestCommunicationCoalesce InfTestCommunicationCoalesce;
+struct _InfTestCommunicationCoalesce {
+  InfStandaloneIo* io;
+  InfCommunicationManager* manager;
+  InfCommunicationHostedGroup* group;
+  InfSimulatedConnection* connection;
+  InfSimulatedConnection* remote;
+
+  /* Number of containers and of messages sent through connection */
+  guint containers;
+  guint messages;
+};
+
+static void
+inf_test_communication_coalesce_sent_cb(InfXmlConnection* connection,
+                                        xmlNodePtr xml,
+                                        gpointer user_data)
+{
+  InfTestCommunicationCoalesce* test;
+  xmlNodePtr child;
+
+  test = (InfTestCommunicationCoalesce*)user_data;
+
+  g_assert(strcmp((const char*)xml->name, "group") == 0);
+  ++ test->containers;
+
+  for(child = xml->children; child != NULL; child = child->next)
+    ++ test->messages;
+}
+
+static void
+inf_test_communication_coalesce_init(InfTestCommunicationCoalesce* test,
+                                     guint size)
+{
+  InfCommunicationRegistry* registry;
+
+  test->io = inf_standalone_io_new();
+  test->manager = inf_communication_manager_new();
+
+  registry = inf_communication_manager_get_registry(test->manager);
+  g_object_set(
+    G_OBJECT(registry),
+    "io", test->io,
+    "coalesce-interval", INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    "coalesce-size", size,
+    NULL
+  );
+
+  test->connection = inf_simulated_connection_new();
+  test->remote = inf_simulated_connection_new();
+  inf_simulated_connection_connect(test->connection, test->remote);
+
+  test->group = inf_communication_manager_open_group(
+    test->manager,
+    "InfTestCommunicationCoalesce",
+    NULL
+  );
+
+  inf_communication_hosted_group_add_member(
+    test->group,
+    INF_XML_CONNECTION(test->connection)
+  );
+
+  test->containers = 0;
+  test->messages = 0;
+
+  g_signal_connect(
+    G_OBJECT(test->connection),
+    "sent",
+    G_CALLBACK(inf_test_communication_coalesce_sent_cb),
+    test
+  );
+}
+
+static void
+inf_test_communication_coalesce_finalize(InfTestCommunicationCoalesce* test)
+{
+  inf_communication_hosted_group_remove_member(
+    test->group,
+    INF_XML_CONNECTION(test->connection)
+  );
+
+  g_object_unref(test->group);
+  inf_xml_connection_close(INF_XML_CONNECTION(test->connection));
+  g_object_unref(test->connection);
+  g_object_unref(test->remote);
+  g_object_unref(test->manager);
+  g_object_unref(test->io);
+}
+
+static void
+inf_test_communication_coalesce_send(InfTestCommunicationCoalesce* test)
+{
+  xmlNodePtr xml;
+  gchar content[101];
+
+  memset(content, 'x', 100);
+  content[100] = '\0';
+
+  xml = xmlNewNode(NULL, (const xmlChar*)"message");
+  xmlNodeAddContent(xml, (const xmlChar*)content);
+
+  inf_communication_group_send_message(
+    INF_COMMUNICATION_GROUP(test->group),
+    INF_XML_CONNECTION(test->connection),
+    xml
+  );
+}
+
+/* Runs the main loop for the given number of milliseconds, or until the
+ * number of sent containers reaches until_containers. */
+static void
+inf_test_communication_coalesce_run(InfTestCommunicationCoalesce* test,
+                                    guint msecs,
+                                    guint until_containers)
+{
+  gint64 end;
+  gint64 now;
+
+  end = g_get_monotonic_time() + (gint64)msecs * 1000;
+  now = g_get_monotonic_time();
+
+  while(now < end && test->containers < until_containers)
+  {
+    inf_standalone_io_iteration_timeout(test->io, (end - now + 999) / 1000);
+    now = g_get_monotonic_time();
+  }
+}
+
+/* Messages are held back until the coalesce interval has elapsed, and then
+ * sent together. */
+static void
+inf_test_communication_coalesce_interval(void)
+{
+  InfTestCommunicationCoalesce test;
+
+  inf_test_communication_coalesce_init(&test, 0);
+
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_send(&test);
+  g_assert(test.containers == 0);
+
+  inf_test_communication_coalesce_run(
+    &test,
+    10 * INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    1
+  );
+
+  g_assert(test.containers == 1);
+  g_assert(test.messages == 3);
+
+  inf_test_communication_coalesce_finalize(&test);
+}
+
+/* Messages are sent as soon as the coalesce size has been reached, without
+ * waiting for the interval to elapse. */
+static void
+inf_test_communication_coalesce_size(void)
+{
+  InfTestCommunicationCoalesce test;
+
+  inf_test_communication_coalesce_init(
+    &test,
+    INF_TEST_COMMUNICATION_COALESCE_SIZE
+  );
+
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_send(&test);
+  g_assert(test.containers == 0);
+
+  inf_test_communication_coalesce_send(&test);
+  g_assert(test.containers == 1);
+  g_assert(test.messages == 3);
+
+  /* Nothing is left to be sent when the interval elapses */
+  inf_test_communication_coalesce_run(
+    &test,
+    2 * INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    2
+  );
+
+  g_assert(test.containers == 1);
+  g_assert(test.messages == 3);
+
+  inf_test_communication_coalesce_finalize(&test);
+}
+
+/* Flushing sends held back messages immediately */
+static void
+inf_test_communication_coalesce_flush(void)
+{
+  InfTestCommunicationCoalesce test;
+
+  inf_test_communication_coalesce_init(&test, 0);
+
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_send(&test);
+  g_assert(test.containers == 0);
+
+  inf_communication_group_flush(
+    INF_COMMUNICATION_GROUP(test.group),
+    INF_XML_CONNECTION(test.connection)
+  );
+
+  g_assert(test.containers == 1);
+  g_assert(test.messages == 2);
+
+  inf_test_communication_coalesce_send(&test);
+  g_assert(test.containers == 1);
+
+  inf_communication_group_flush(INF_COMMUNICATION_GROUP(test.group), NULL);
+  g_assert(test.containers == 2);
+  g_assert(test.messages == 3);
+
+  /* Flushing an empty queue does not send anything */
+  inf_communication_group_flush(INF_COMMUNICATION_GROUP(test.group), NULL);
+
+  inf_test_communication_coalesce_run(
+    &test,
+    2 * INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    3
+  );
+
+  g_assert(test.containers == 2);
+  g_assert(test.messages == 3);
+
+  inf_test_communication_coalesce_finalize(&test);
+}
+
+/* Cancelled messages are not sent, neither when the interval elapses nor
+ * on a subsequent flush. */
+static void
+inf_test_communication_coalesce_cancel(void)
+{
+  InfTestCommunicationCoalesce test;
+
+  inf_test_communication_coalesce_init(&test, 0);
+
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_send(&test);
+
+  inf_communication_group_cancel_messages(
+    INF_COMMUNICATION_GROUP(test.group),
+    INF_XML_CONNECTION(test.connection)
+  );
+
+  inf_test_communication_coalesce_run(
+    &test,
+    2 * INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    1
+  );
+
+  g_assert(test.containers == 0);
+
+  inf_communication_group_flush(
+    INF_COMMUNICATION_GROUP(test.group),
+    INF_XML_CONNECTION(test.connection)
+  );
+
+  g_assert(test.containers == 0);
+
+  /* Messages sent afterwards are coalesced as usual */
+  inf_test_communication_coalesce_send(&test);
+  inf_test_communication_coalesce_run(
+    &test,
+    10 * INF_TEST_COMMUNICATION_COALESCE_INTERVAL,
+    1
+  );
+
+  g_assert(test.containers == 1);
+  g_assert(test.messages == 1);
+
+  inf_test_communication_coalesce_finalize(&test);
+}
+
+int
+main(int argc, char* argv[])
+{
+  GError* error;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  inf_test_communication_coalesce_interval();
+  inf_test_communication_coalesce_size();
+  inf_test_communication_coalesce_flush();
+  inf_test_communication_coalesce_cancel();
+
+  inf_deinit();
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
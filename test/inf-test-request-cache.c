@@ -0,0 +1,231 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests the request cache of InfAdoptedRequestLog, with a memory budget
+ * shared between several logs as used by InfAdoptedAlgorithm. */
+
+#include <libinfinity/adopted/inf-adopted-request-log-private.h>
+#include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/adopted/inf-adopted-no-operation.h>
+
+/* Creates a DO request with a no-op operation at the given state */
+static InfAdoptedRequest*
+test_request_cache_request_new(guint user_id,
+                               const gchar* vector_str)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+
+  vector = inf_adopted_state_vector_from_string(vector_str, NULL);
+  g_assert(vector != NULL);
+
+  operation = INF_ADOPTED_OPERATION(inf_adopted_no_operation_new());
+  request = inf_adopted_request_new_do(vector, user_id, operation, 0);
+
+  g_object_unref(operation);
+  inf_adopted_state_vector_free(vector);
+  return request;
+}
+
+/* Adds a request at the given state to the log itself */
+static void
+test_request_cache_add_request(InfAdoptedRequestLog* log,
+                               guint user_id,
+                               const gchar* vector_str)
+{
+  InfAdoptedRequest* request;
+
+  request = test_request_cache_request_new(user_id, vector_str);
+  inf_adopted_request_log_add_request(log, request);
+  g_object_unref(request);
+}
+
+/* Adds a request at the given state to the log's cache and returns the
+ * size the log's cache grew by, which is zero if the request was not
+ * cached. */
+static gsize
+test_request_cache_add_cached(InfAdoptedRequestLog* log,
+                              guint user_id,
+                              const gchar* vector_str)
+{
+  InfAdoptedRequest* request;
+  gsize before;
+  gsize after;
+
+  request = test_request_cache_request_new(user_id, vector_str);
+  inf_adopted_request_log_get_cache_statistics(log, NULL, NULL, &before);
+  inf_adopted_request_log_add_cached_request(log, request);
+  inf_adopted_request_log_get_cache_statistics(log, NULL, NULL, &after);
+
+  /* The cache must at least account for the request itself */
+  g_assert(
+    after == before ||
+    after - before >= inf_adopted_request_get_memory_size(request)
+  );
+
+  g_object_unref(request);
+  return after - before;
+}
+
+static gboolean
+test_request_cache_lookup(InfAdoptedRequestLog* log,
+                          const gchar* vector_str)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedRequest* request;
+
+  vector = inf_adopted_state_vector_from_string(vector_str, NULL);
+  g_assert(vector != NULL);
+
+  request = inf_adopted_request_log_lookup_cached_request(log, vector);
+  if(request != NULL)
+  {
+    g_assert(
+      inf_adopted_state_vector_compare(
+        inf_adopted_request_get_vector(request),
+        vector
+      ) == 0
+    );
+  }
+
+  inf_adopted_state_vector_free(vector);
+  return request != NULL;
+}
+
+static void
+test_request_cache_check_statistics(InfAdoptedRequestLog* log,
+                                    guint64 expected_hits,
+                                    guint64 expected_misses)
+{
+  guint64 hits;
+  guint64 misses;
+
+  inf_adopted_request_log_get_cache_statistics(log, &hits, &misses, NULL);
+  g_assert(hits == expected_hits);
+  g_assert(misses == expected_misses);
+}
+
+static gsize
+test_request_cache_log_size(InfAdoptedRequestLog* log)
+{
+  gsize size;
+  inf_adopted_request_log_get_cache_statistics(log, NULL, NULL, &size);
+  return size;
+}
+
+int main()
+{
+  InfAdoptedRequestCache* cache;
+  InfAdoptedRequestLog* log1;
+  InfAdoptedRequestLog* log2;
+  gsize entry_size;
+  gsize size;
+
+  log1 = inf_adopted_request_log_new(1);
+  log2 = inf_adopted_request_log_new(2);
+
+  test_request_cache_add_request(log1, 1, "1:0");
+  test_request_cache_add_request(log1, 1, "1:1");
+  test_request_cache_add_request(log2, 2, "2:0");
+
+  cache = _inf_adopted_request_cache_new(G_MAXUINT);
+  _inf_adopted_request_log_set_cache(log1, cache);
+  _inf_adopted_request_log_set_cache(log2, cache);
+
+  /* Translations of 1:0 and 2:0 to states including the other user */
+  entry_size = test_request_cache_add_cached(log1, 1, "1:0;2:1");
+  size = test_request_cache_add_cached(log2, 2, "1:1;2:0");
+  g_assert(entry_size > 0);
+  g_assert(size == entry_size);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 2 * entry_size);
+
+  /* Budget for exactly two entries, both of which still fit */
+  _inf_adopted_request_cache_set_max_size(cache, 2 * entry_size);
+  g_assert(test_request_cache_lookup(log1, "1:0;2:1"));
+  g_assert(test_request_cache_lookup(log2, "1:1;2:0"));
+  g_assert(!test_request_cache_lookup(log1, "1:0;2:5"));
+  test_request_cache_check_statistics(log1, 1, 1);
+  test_request_cache_check_statistics(log2, 1, 0);
+
+  /* Touch log1's entry, so that log2's is now the least recently used one
+   * and is evicted when log1 caches another request, even though log1
+   * itself only uses half of the budget. */
+  g_assert(test_request_cache_lookup(log1, "1:0;2:1"));
+  test_request_cache_add_cached(log1, 1, "1:0;2:2");
+
+  g_assert(test_request_cache_log_size(log1) == 2 * entry_size);
+  g_assert(test_request_cache_log_size(log2) == 0);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 2 * entry_size);
+
+  g_assert(!test_request_cache_lookup(log2, "1:1;2:0"));
+  g_assert(test_request_cache_lookup(log1, "1:0;2:1"));
+  g_assert(test_request_cache_lookup(log1, "1:0;2:2"));
+  test_request_cache_check_statistics(log1, 4, 1);
+  test_request_cache_check_statistics(log2, 1, 1);
+
+  /* Now 1:0;2:1 is the least recently used entry */
+  test_request_cache_add_cached(log2, 2, "1:2;2:0");
+  g_assert(!test_request_cache_lookup(log1, "1:0;2:1"));
+  g_assert(test_request_cache_lookup(log1, "1:0;2:2"));
+  g_assert(test_request_cache_lookup(log2, "1:2;2:0"));
+  test_request_cache_check_statistics(log1, 5, 2);
+  test_request_cache_check_statistics(log2, 2, 1);
+
+  /* Shrinking the budget evicts the least recently used entries */
+  _inf_adopted_request_cache_set_max_size(cache, entry_size);
+  g_assert(test_request_cache_log_size(log1) == 0);
+  g_assert(test_request_cache_log_size(log2) == entry_size);
+
+  /* A request that does not fit into the budget at all is not cached, and
+   * does not evict anything. */
+  _inf_adopted_request_cache_set_max_size(cache, entry_size - 1);
+  g_assert(test_request_cache_log_size(log2) == 0);
+  g_assert(test_request_cache_add_cached(log1, 1, "1:1;2:1") == 0);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 0);
+
+  /* Removing requests from the log also releases their cached translations
+   * from the shared budget. */
+  _inf_adopted_request_cache_set_max_size(cache, G_MAXUINT);
+  test_request_cache_add_cached(log1, 1, "1:0;2:1");
+  test_request_cache_add_cached(log1, 1, "1:1;2:1");
+  test_request_cache_add_cached(log2, 2, "1:1;2:0");
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 3 * entry_size);
+
+  inf_adopted_request_log_remove_requests(log1, 1);
+  g_assert(test_request_cache_log_size(log1) == entry_size);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 2 * entry_size);
+  g_assert(test_request_cache_lookup(log1, "1:1;2:1"));
+
+  /* Detaching a log drops its entries from the shared cache */
+  _inf_adopted_request_log_set_cache(log1, NULL);
+  g_assert(test_request_cache_log_size(log1) == 0);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == entry_size);
+
+  _inf_adopted_request_log_set_cache(log2, NULL);
+  g_assert(_inf_adopted_request_cache_get_size(cache) == 0);
+  _inf_adopted_request_cache_free(cache);
+
+  g_object_unref(log1);
+  g_object_unref(log2);
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,281 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Constructs requests and text operations through all of their
+ * constructors and checks that the resulting objects carry the expected
+ * state. */
+
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-default-delete-operation.h>
+#include <libinftext/inf-text-insert-operation.h>
+#include <libinftext/inf-text-delete-operation.h>
+#include <libinftext/inf-text-chunk.h>
+#include <libinfinity/adopted/inf-adopted-request.h>
+#include <libinfinity/adopted/inf-adopted-state-vector.h>
+
+#include <string.h>
+
+static InfTextChunk*
+inf_test_request_chunk(const gchar* text,
+                       guint author)
+{
+  InfTextChunk* chunk;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    chunk,
+    0,
+    text,
+    strlen(text),
+    g_utf8_strlen(text, -1),
+    author
+  );
+
+  return chunk;
+}
+
+static InfAdoptedOperation*
+inf_test_request_insert(guint pos,
+                        const gchar* text,
+                        guint author)
+{
+  InfTextChunk* chunk;
+  InfTextDefaultInsertOperation* operation;
+
+  chunk = inf_test_request_chunk(text, author);
+  operation = inf_text_default_insert_operation_new(pos, chunk);
+  inf_text_chunk_free(chunk);
+
+  return INF_ADOPTED_OPERATION(operation);
+}
+
+static void
+inf_test_request_check(InfAdoptedRequest* request,
+                       InfAdoptedRequestType type,
+                       const gchar* vector,
+                       guint user_id,
+                       gint64 received)
+{
+  gchar* str;
+
+  g_assert(INF_ADOPTED_IS_REQUEST(request));
+  g_assert(inf_adopted_request_get_request_type(request) == type);
+  g_assert(inf_adopted_request_get_user_id(request) == user_id);
+  g_assert(inf_adopted_request_get_receive_time(request) == received);
+
+  str = inf_adopted_state_vector_to_string(
+    inf_adopted_request_get_vector(request)
+  );
+
+  if(strcmp(str, vector) != 0)
+  {
+    fprintf(stderr, "Expected vector %s, got %s\n", vector, str);
+    g_assert_not_reached();
+  }
+
+  g_free(str);
+}
+
+static void
+inf_test_request_check_insert(InfAdoptedRequest* request,
+                              guint pos,
+                              guint len)
+{
+  InfAdoptedOperation* operation;
+
+  operation = inf_adopted_request_get_operation(request);
+  g_assert(INF_TEXT_IS_DEFAULT_INSERT_OPERATION(operation));
+
+  g_assert(
+    inf_text_insert_operation_get_position(
+      INF_TEXT_INSERT_OPERATION(operation)
+    ) == pos
+  );
+
+  g_assert(
+    inf_text_insert_operation_get_length(
+      INF_TEXT_INSERT_OPERATION(operation)
+    ) == len
+  );
+}
+
+static void
+inf_test_request_constructors(void)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+  InfAdoptedRequest* copy;
+
+  vector = inf_adopted_state_vector_from_string("1:2;2:3", NULL);
+  g_assert(vector != NULL);
+
+  operation = inf_test_request_insert(4, "abc", 1);
+  request = inf_adopted_request_new_do(vector, 1, operation, 17);
+  g_object_unref(operation);
+
+  inf_test_request_check(request, INF_ADOPTED_REQUEST_DO, "1:2;2:3", 1, 17);
+  g_assert(inf_adopted_request_get_index(request) == 2);
+  g_assert(inf_adopted_request_get_execute_time(request) == 0);
+  g_assert(inf_adopted_request_affects_buffer(request) == TRUE);
+  inf_test_request_check_insert(request, 4, 3);
+
+  /* The copy must keep the execution time as well */
+  inf_adopted_request_set_execute_time(request, 23);
+  copy = inf_adopted_request_copy(request);
+  inf_test_request_check(copy, INF_ADOPTED_REQUEST_DO, "1:2;2:3", 1, 17);
+  g_assert(inf_adopted_request_get_execute_time(copy) == 23);
+  g_assert(
+    inf_adopted_request_get_operation(copy) ==
+    inf_adopted_request_get_operation(request)
+  );
+  g_object_unref(copy);
+  g_object_unref(request);
+
+  request = inf_adopted_request_new_undo(vector, 2, 5);
+  inf_test_request_check(request, INF_ADOPTED_REQUEST_UNDO, "1:2;2:3", 2, 5);
+  copy = inf_adopted_request_copy(request);
+  inf_test_request_check(copy, INF_ADOPTED_REQUEST_UNDO, "1:2;2:3", 2, 5);
+  g_object_unref(copy);
+  g_object_unref(request);
+
+  request = inf_adopted_request_new_redo(vector, 2, 6);
+  inf_test_request_check(request, INF_ADOPTED_REQUEST_REDO, "1:2;2:3", 2, 6);
+  g_object_unref(request);
+
+  inf_adopted_state_vector_free(vector);
+}
+
+static void
+inf_test_request_transformations(void)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* first;
+  InfAdoptedRequest* second;
+  InfAdoptedRequest* result;
+  InfAdoptedOperation* reverted;
+
+  vector = inf_adopted_state_vector_new();
+
+  operation = inf_test_request_insert(0, "ab", 1);
+  first = inf_adopted_request_new_do(vector, 1, operation, 1);
+  g_object_unref(operation);
+
+  operation = inf_test_request_insert(5, "cde", 2);
+  second = inf_adopted_request_new_do(vector, 2, operation, 2);
+  g_object_unref(operation);
+
+  result = inf_adopted_request_transform(first, second, NULL, NULL);
+  inf_test_request_check(result, INF_ADOPTED_REQUEST_DO, "2:1", 1, 1);
+  inf_test_request_check_insert(result, 0, 2);
+  g_object_unref(result);
+
+  result = inf_adopted_request_transform(second, first, NULL, NULL);
+  inf_test_request_check(result, INF_ADOPTED_REQUEST_DO, "1:1", 2, 2);
+  inf_test_request_check_insert(result, 7, 3);
+  g_object_unref(result);
+
+  /* Mirroring an insertion yields the corresponding deletion */
+  result = inf_adopted_request_mirror(first, 3);
+  inf_test_request_check(result, INF_ADOPTED_REQUEST_DO, "1:3", 1, 1);
+  reverted = inf_adopted_request_get_operation(result);
+  g_assert(INF_TEXT_IS_DEFAULT_DELETE_OPERATION(reverted));
+  g_assert(
+    inf_text_delete_operation_get_position(
+      INF_TEXT_DELETE_OPERATION(reverted)
+    ) == 0
+  );
+  g_assert(
+    inf_text_delete_operation_get_length(
+      INF_TEXT_DELETE_OPERATION(reverted)
+    ) == 2
+  );
+  g_object_unref(result);
+
+  result = inf_adopted_request_fold(second, 1, 4);
+  inf_test_request_check(result, INF_ADOPTED_REQUEST_DO, "1:4", 2, 2);
+  inf_test_request_check_insert(result, 5, 3);
+  g_object_unref(result);
+
+  g_object_unref(second);
+  g_object_unref(first);
+  inf_adopted_state_vector_free(vector);
+}
+
+/* Construction through properties must keep working for bindings */
+static void
+inf_test_request_properties(void)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedOperation* operation;
+  InfTextChunk* chunk;
+  InfAdoptedRequest* request;
+
+  vector = inf_adopted_state_vector_from_string("3:1", NULL);
+  g_assert(vector != NULL);
+
+  chunk = inf_test_request_chunk("xyz", 3);
+  operation = INF_ADOPTED_OPERATION(
+    g_object_new(
+      INF_TEXT_TYPE_DEFAULT_DELETE_OPERATION,
+      "position", 2,
+      "chunk", chunk,
+      NULL
+    )
+  );
+  inf_text_chunk_free(chunk);
+
+  g_assert(
+    inf_text_delete_operation_get_length(
+      INF_TEXT_DELETE_OPERATION(operation)
+    ) == 3
+  );
+
+  request = INF_ADOPTED_REQUEST(
+    g_object_new(
+      INF_ADOPTED_TYPE_REQUEST,
+      "type", INF_ADOPTED_REQUEST_DO,
+      "vector", vector,
+      "user-id", 3,
+      "operation", operation,
+      "received", G_GINT64_CONSTANT(9),
+      NULL
+    )
+  );
+
+  g_object_unref(operation);
+
+  inf_test_request_check(request, INF_ADOPTED_REQUEST_DO, "3:1", 3, 9);
+  g_assert(inf_adopted_request_get_operation(request) == operation);
+  g_object_unref(request);
+
+  inf_adopted_state_vector_free(vector);
+}
+
+int main()
+{
+  inf_test_request_constructors();
+  inf_test_request_transformations();
+  inf_test_request_properties();
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
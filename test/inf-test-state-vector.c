@@ -127,6 +127,43 @@ static void l_test() {
   apply(free, (vec_));
 }
 
+static void merge_test() {
+  InfAdoptedStateVector* vec, * vec_, * res;
+
+  vec  = apply(from_string, ("1:10;2:5;5:3", NULL));
+  vec_ = apply(from_string, ("1:7;2:8;4:2",  NULL));
+
+  res = apply(max, (vec, vec_, NULL));
+  cmp("1:10;2:8;4:2;5:3", res);
+  g_assert(apply(causally_before, (vec, res)));
+  g_assert(apply(causally_before, (vec_, res)));
+  g_assert(apply(vdiff, (vec, res)) == 5);
+
+  /* Write into an existing vector */
+  g_assert(apply(min, (vec, vec_, res)) == res);
+  g_assert(apply(get, (res, 1)) == 7);
+  g_assert(apply(get, (res, 2)) == 5);
+  g_assert(apply(get, (res, 4)) == 0);
+  g_assert(apply(get, (res, 5)) == 0);
+  g_assert(apply(causally_before, (res, vec)));
+  g_assert(apply(causally_before, (res, vec_)));
+
+  /* Write into one of the operands */
+  g_assert(apply(max, (vec, vec_, vec)) == vec);
+  cmp("1:10;2:8;4:2;5:3", vec);
+
+  g_assert(apply(diff, (vec_, vec, res)) == res);
+  cmp("1:3;5:3", res);
+  g_assert(apply(vdiff, (vec_, vec)) == 6);
+
+  g_assert(apply(diff, (vec_, vec, vec_)) == vec_);
+  cmp("1:3;5:3", vec_);
+
+  apply(free, (res));
+  apply(free, (vec));
+  apply(free, (vec_));
+}
+
 int main(int argc, char* argv[])
 {
   guint users[2];
@@ -158,6 +195,7 @@ int main(int argc, char* argv[])
 
   inf_adopted_state_vector_free(vec);
   l_test();
+  merge_test();
   return 0;
 }
 
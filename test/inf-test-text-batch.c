@@ -0,0 +1,445 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Executes requests of a local and two remote users within batches of
+ * InfAdoptedAlgorithm, and checks that the undo/redo state of the local
+ * user is only updated at the end of a batch. */
+
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-default-insert-operation.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinftext/inf-text-chunk.h>
+
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/common/inf-user-table.h>
+
+#include <string.h>
+
+#define INF_TEST_TEXT_BATCH_LOCAL 1
+#define INF_TEST_TEXT_BATCH_REMOTE 2
+#define INF_TEST_TEXT_BATCH_IDLE 3
+
+typedef struct _InfTestTextBatch InfTestTextBatch;
+struct _InfTestTextBatch {
+  InfUserTable* user_table;
+  InfTextBuffer* buffer;
+  InfAdoptedAlgorithm* algorithm;
+
+  InfAdoptedUser* local;
+
+  guint can_undo_changed;
+  guint can_redo_changed;
+};
+
+static void
+inf_test_text_batch_can_undo_changed_cb(InfAdoptedAlgorithm* algorithm,
+                                        InfAdoptedUser* user,
+                                        gboolean can_undo,
+                                        gpointer user_data)
+{
+  InfTestTextBatch* test;
+  test = (InfTestTextBatch*)user_data;
+
+  g_assert(user == test->local);
+  ++ test->can_undo_changed;
+}
+
+static void
+inf_test_text_batch_can_redo_changed_cb(InfAdoptedAlgorithm* algorithm,
+                                        InfAdoptedUser* user,
+                                        gboolean can_redo,
+                                        gpointer user_data)
+{
+  InfTestTextBatch* test;
+  test = (InfTestTextBatch*)user_data;
+
+  g_assert(user == test->local);
+  ++ test->can_redo_changed;
+}
+
+static InfAdoptedUser*
+inf_test_text_batch_add_user(InfUserTable* user_table,
+                             guint id,
+                             InfUserFlags flags)
+{
+  InfTextUser* user;
+  gchar* name;
+
+  name = g_strdup_printf("User_%u", id);
+
+  user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "status", INF_USER_ACTIVE,
+      "flags", flags,
+      NULL
+    )
+  );
+
+  g_free(name);
+  inf_user_table_add_user(user_table, INF_USER(user));
+  g_object_unref(user);
+
+  return INF_ADOPTED_USER(user);
+}
+
+static InfAdoptedOperation*
+inf_test_text_batch_insert(guint pos,
+                           const gchar* text,
+                           guint author)
+{
+  InfTextChunk* chunk;
+  InfTextDefaultInsertOperation* operation;
+
+  chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    chunk,
+    0,
+    text,
+    strlen(text),
+    strlen(text),
+    author
+  );
+
+  operation = inf_text_default_insert_operation_new(pos, chunk);
+  inf_text_chunk_free(chunk);
+
+  return INF_ADOPTED_OPERATION(operation);
+}
+
+/* Creates a DO request of the remote user inserting text at pos, made in
+ * the given state. */
+static InfAdoptedRequest*
+inf_test_text_batch_remote_request(InfAdoptedStateVector* vector,
+                                   guint pos,
+                                   const gchar* text)
+{
+  InfAdoptedOperation* operation;
+  InfAdoptedRequest* request;
+
+  operation = inf_test_text_batch_insert(
+    pos,
+    text,
+    INF_TEST_TEXT_BATCH_REMOTE
+  );
+
+  request = inf_adopted_request_new_do(
+    vector,
+    INF_TEST_TEXT_BATCH_REMOTE,
+    operation,
+    g_get_real_time()
+  );
+
+  g_object_unref(operation);
+  return request;
+}
+
+static void
+inf_test_text_batch_execute(InfTestTextBatch* test,
+                            InfAdoptedRequest* request)
+{
+  GError* error;
+
+  error = NULL;
+  if(!inf_adopted_algorithm_execute_request(test->algorithm, request,
+                                            TRUE, &error))
+  {
+    fprintf(stderr, "Failed to execute request: %s\n", error->message);
+    g_error_free(error);
+    g_assert_not_reached();
+  }
+
+  g_object_unref(request);
+}
+
+static void
+inf_test_text_batch_execute_remote(InfTestTextBatch* test,
+                                   guint pos,
+                                   const gchar* text)
+{
+  inf_test_text_batch_execute(
+    test,
+    inf_test_text_batch_remote_request(
+      inf_adopted_algorithm_get_current(test->algorithm),
+      pos,
+      text
+    )
+  );
+}
+
+static void
+inf_test_text_batch_execute_local(InfTestTextBatch* test,
+                                  InfAdoptedRequestType type,
+                                  InfAdoptedOperation* operation)
+{
+  inf_test_text_batch_execute(
+    test,
+    inf_adopted_algorithm_generate_request(
+      test->algorithm,
+      type,
+      test->local,
+      operation
+    )
+  );
+}
+
+static void
+inf_test_text_batch_check_buffer(InfTestTextBatch* test,
+                                 const gchar* expected)
+{
+  InfTextChunk* chunk;
+  gchar* text;
+  gsize bytes;
+
+  chunk = inf_text_buffer_get_slice(
+    test->buffer,
+    0,
+    inf_text_buffer_get_length(test->buffer)
+  );
+
+  text = inf_text_chunk_get_text(chunk, &bytes);
+  inf_text_chunk_free(chunk);
+
+  if(bytes != strlen(expected) || memcmp(text, expected, bytes) != 0)
+  {
+    fprintf(stderr, "Expected \"%s\", got \"%.*s\"\n",
+            expected, (int)bytes, text);
+    g_assert_not_reached();
+  }
+
+  g_free(text);
+}
+
+/* The local user's vector is only updated at the end of a batch, and then
+ * has to match the current state. */
+static void
+inf_test_text_batch_check_local_vector(InfTestTextBatch* test)
+{
+  g_assert(
+    inf_adopted_state_vector_compare(
+      inf_adopted_user_get_vector(test->local),
+      inf_adopted_algorithm_get_current(test->algorithm)
+    ) == 0
+  );
+}
+
+static void
+inf_test_text_batch_init(InfTestTextBatch* test)
+{
+  test->user_table = inf_user_table_new();
+  test->buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+
+  test->local = inf_test_text_batch_add_user(
+    test->user_table,
+    INF_TEST_TEXT_BATCH_LOCAL,
+    INF_USER_LOCAL
+  );
+
+  inf_test_text_batch_add_user(
+    test->user_table,
+    INF_TEST_TEXT_BATCH_REMOTE,
+    0
+  );
+
+  inf_test_text_batch_add_user(
+    test->user_table,
+    INF_TEST_TEXT_BATCH_IDLE,
+    0
+  );
+
+  test->algorithm = inf_adopted_algorithm_new(
+    test->user_table,
+    INF_BUFFER(test->buffer)
+  );
+
+  test->can_undo_changed = 0;
+  test->can_redo_changed = 0;
+
+  g_signal_connect(
+    G_OBJECT(test->algorithm),
+    "can-undo-changed",
+    G_CALLBACK(inf_test_text_batch_can_undo_changed_cb),
+    test
+  );
+
+  g_signal_connect(
+    G_OBJECT(test->algorithm),
+    "can-redo-changed",
+    G_CALLBACK(inf_test_text_batch_can_redo_changed_cb),
+    test
+  );
+}
+
+static void
+inf_test_text_batch_finalize(InfTestTextBatch* test)
+{
+  g_object_unref(test->algorithm);
+  g_object_unref(test->buffer);
+  g_object_unref(test->user_table);
+}
+
+/* Changes of the undo/redo state are only announced at the end of the
+ * batch, once, even if a local request is executed within the batch. */
+static void
+inf_test_text_batch_deferred(InfTestTextBatch* test)
+{
+  InfAdoptedOperation* operation;
+
+  inf_adopted_algorithm_begin_batch(test->algorithm);
+
+  inf_test_text_batch_execute_remote(test, 0, "a");
+  inf_test_text_batch_execute_remote(test, 1, "b");
+
+  operation = inf_test_text_batch_insert(2, "c", INF_TEST_TEXT_BATCH_LOCAL);
+  inf_test_text_batch_execute_local(test, INF_ADOPTED_REQUEST_DO, operation);
+  g_object_unref(operation);
+
+  inf_test_text_batch_execute_remote(test, 3, "d");
+
+  g_assert(
+    inf_adopted_state_vector_compare(
+      inf_adopted_user_get_vector(test->local),
+      inf_adopted_algorithm_get_current(test->algorithm)
+    ) != 0
+  );
+
+  g_assert(test->can_undo_changed == 0);
+  g_assert(test->can_redo_changed == 0);
+
+  inf_adopted_algorithm_end_batch(test->algorithm);
+
+  g_assert(test->can_undo_changed == 1);
+  g_assert(test->can_redo_changed == 0);
+  g_assert(inf_adopted_algorithm_can_undo(test->algorithm, test->local));
+  g_assert(!inf_adopted_algorithm_can_redo(test->algorithm, test->local));
+  inf_test_text_batch_check_buffer(test, "abcd");
+  inf_test_text_batch_check_local_vector(test);
+
+  /* Undo within a nested batch changes both states, which is announced
+   * when the outer batch ends. */
+  inf_adopted_algorithm_begin_batch(test->algorithm);
+  inf_adopted_algorithm_begin_batch(test->algorithm);
+
+  inf_test_text_batch_execute_local(test, INF_ADOPTED_REQUEST_UNDO, NULL);
+  inf_test_text_batch_execute_remote(test, 0, "e");
+
+  inf_adopted_algorithm_end_batch(test->algorithm);
+
+  g_assert(test->can_undo_changed == 1);
+  g_assert(test->can_redo_changed == 0);
+
+  inf_adopted_algorithm_end_batch(test->algorithm);
+
+  g_assert(test->can_undo_changed == 2);
+  g_assert(test->can_redo_changed == 1);
+  g_assert(!inf_adopted_algorithm_can_undo(test->algorithm, test->local));
+  g_assert(inf_adopted_algorithm_can_redo(test->algorithm, test->local));
+  inf_test_text_batch_check_buffer(test, "eabd");
+  inf_test_text_batch_check_local_vector(test);
+}
+
+/* A request failing in the middle of inf_adopted_algorithm_execute_requests()
+ * keeps the requests before it, skips the ones after it, and closes the
+ * batch. */
+static void
+inf_test_text_batch_failure(InfTestTextBatch* test)
+{
+  InfAdoptedStateVector* vector;
+  InfAdoptedRequest* requests[3];
+  InfAdoptedOperation* operation;
+  GError* error;
+  guint i;
+
+  vector = inf_adopted_state_vector_copy(
+    inf_adopted_algorithm_get_current(test->algorithm)
+  );
+
+  requests[0] = inf_test_text_batch_remote_request(vector, 0, "f");
+  inf_adopted_state_vector_add(vector, INF_TEST_TEXT_BATCH_REMOTE, 1);
+
+  /* The idle user has nothing to undo */
+  requests[1] = inf_adopted_request_new_undo(
+    vector,
+    INF_TEST_TEXT_BATCH_IDLE,
+    g_get_real_time()
+  );
+
+  requests[2] = inf_test_text_batch_remote_request(vector, 0, "g");
+
+  error = NULL;
+  g_assert(
+    !inf_adopted_algorithm_execute_requests(
+      test->algorithm,
+      requests,
+      3,
+      &error
+    )
+  );
+
+  g_assert(error != NULL);
+  g_assert(error->code == INF_ADOPTED_ALGORITHM_ERROR_NO_UNDO);
+  g_error_free(error);
+
+  for(i = 0; i < 3; ++ i)
+    g_object_unref(requests[i]);
+
+  g_assert(inf_adopted_algorithm_get_execute_request(test->algorithm) == NULL);
+  g_assert(
+    inf_adopted_state_vector_compare(
+      inf_adopted_algorithm_get_current(test->algorithm),
+      vector
+    ) == 0
+  );
+
+  inf_adopted_state_vector_free(vector);
+
+  inf_test_text_batch_check_buffer(test, "feabd");
+  inf_test_text_batch_check_local_vector(test);
+
+  /* The batch is closed, so a new local request updates the undo/redo
+   * state right away. */
+  g_assert(test->can_undo_changed == 2);
+  g_assert(test->can_redo_changed == 1);
+
+  operation = inf_test_text_batch_insert(0, "h", INF_TEST_TEXT_BATCH_LOCAL);
+  inf_test_text_batch_execute_local(test, INF_ADOPTED_REQUEST_DO, operation);
+  g_object_unref(operation);
+
+  g_assert(test->can_undo_changed == 3);
+  g_assert(test->can_redo_changed == 2);
+  inf_test_text_batch_check_buffer(test, "hfeabd");
+  inf_test_text_batch_check_local_vector(test);
+}
+
+int main()
+{
+  InfTestTextBatch test;
+
+  inf_test_text_batch_init(&test);
+  inf_test_text_batch_deferred(&test);
+  inf_test_text_batch_failure(&test);
+  inf_test_text_batch_finalize(&test);
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
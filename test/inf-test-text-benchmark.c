@@ -0,0 +1,644 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Measures the performance of the adOPTed implementation with a number of
+ * simulated users editing the same document concurrently. Every user has its
+ * own site, connected to a central site via an InfSimulatedConnection, just
+ * like clients connected to infinoted. The simulation runs in ticks. In
+ * every tick, each user makes an edit with a given probability, and the
+ * messages that have been queued on a connection are delivered only every
+ * few ticks, which determines how many requests are concurrent.
+ *
+ * The results are written to stdout as key=value lines, so that they can
+ * easily be compared between different versions. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-user.h>
+#include <libinftext/inf-text-chunk.h>
+
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/communication/inf-communication-hosted-group.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifndef G_OS_WIN32
+# include <sys/resource.h>
+#endif
+
+typedef struct _InfTestTextBenchmark InfTestTextBenchmark;
+
+typedef struct _InfTestTextBenchmarkSite InfTestTextBenchmarkSite;
+struct _InfTestTextBenchmarkSite {
+  InfTestTextBenchmark* benchmark;
+
+  InfCommunicationManager* manager;
+  InfCommunicationGroup* group;
+  InfTextSession* session;
+  InfTextBuffer* buffer;
+
+  /* The local user, or NULL for the central site */
+  InfTextUser* user;
+
+  /* Connection to the central site, and the central site's end of it. Both
+   * NULL for the central site. */
+  InfSimulatedConnection* conn;
+  InfSimulatedConnection* central_conn;
+
+  gint64 execute_begin;
+};
+
+struct _InfTestTextBenchmark {
+  GRand* rand;
+  InfIo* io;
+
+  InfTestTextBenchmarkSite* sites;
+  guint n_sites;
+
+  GArray* execute_times;
+  gint64 total_execute_time;
+};
+
+static gint users = 4;
+static gint ticks = 10000;
+static gdouble edit_rate = 0.1;
+static gint latency = 10;
+static gdouble insert_ratio = 0.7;
+static gdouble jump_ratio = 0.05;
+static gint document_size = 10000;
+static gint seed = 0;
+
+static const GOptionEntry entries[] = {
+  { "users", 'u', 0, G_OPTION_ARG_INT, &users,
+    "Number of concurrently editing users", "N" },
+  { "ticks", 't', 0, G_OPTION_ARG_INT, &ticks,
+    "Number of simulation steps", "N" },
+  { "edit-rate", 'r', 0, G_OPTION_ARG_DOUBLE, &edit_rate,
+    "Probability for each user to make an edit in a tick", "P" },
+  { "latency", 'l', 0, G_OPTION_ARG_INT, &latency,
+    "Number of ticks between message deliveries on a connection", "N" },
+  { "insert-ratio", 'i', 0, G_OPTION_ARG_DOUBLE, &insert_ratio,
+    "Fraction of edits that insert text, the others delete text", "P" },
+  { "jump-ratio", 'j', 0, G_OPTION_ARG_DOUBLE, &jump_ratio,
+    "Probability for an edit to happen at a random position instead of "
+    "at the user's cursor", "P" },
+  { "document-size", 'd', 0, G_OPTION_ARG_INT, &document_size,
+    "Number of characters in the initial document", "N" },
+  { "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+    "Seed for the random number generator", "N" },
+  { NULL, 0, 0, G_OPTION_ARG_NONE, NULL, NULL, NULL }
+};
+
+static gint
+inf_test_text_benchmark_compare_time(gconstpointer first,
+                                     gconstpointer second)
+{
+  gint64 first_time;
+  gint64 second_time;
+
+  first_time = *(const gint64*)first;
+  second_time = *(const gint64*)second;
+
+  if(first_time < second_time) return -1;
+  if(first_time > second_time) return 1;
+  return 0;
+}
+
+static void
+inf_test_text_benchmark_begin_execute_request_cb(InfAdoptedAlgorithm* algo,
+                                                 InfAdoptedUser* user,
+                                                 InfAdoptedRequest* request,
+                                                 gpointer user_data)
+{
+  InfTestTextBenchmarkSite* site;
+  site = (InfTestTextBenchmarkSite*)user_data;
+
+  site->execute_begin = g_get_monotonic_time();
+}
+
+static void
+inf_test_text_benchmark_end_execute_request_cb(InfAdoptedAlgorithm* algo,
+                                               InfAdoptedUser* user,
+                                               InfAdoptedRequest* request,
+                                               InfAdoptedRequest* translated,
+                                               const GError* error,
+                                               gpointer user_data)
+{
+  InfTestTextBenchmark* benchmark;
+  InfTestTextBenchmarkSite* site;
+  gint64 time;
+
+  site = (InfTestTextBenchmarkSite*)user_data;
+  benchmark = site->benchmark;
+
+  if(error != NULL)
+  {
+    fprintf(stderr, "Failed to execute request: %s\n", error->message);
+    exit(-1);
+  }
+
+  time = g_get_monotonic_time() - site->execute_begin;
+  g_array_append_val(benchmark->execute_times, time);
+  benchmark->total_execute_time += time;
+}
+
+static InfTextUser*
+inf_test_text_benchmark_add_user(InfUserTable* user_table,
+                                 guint id,
+                                 InfUserFlags flags,
+                                 InfSimulatedConnection* connection)
+{
+  InfTextUser* user;
+  gchar* name;
+
+  name = g_strdup_printf("User_%u", id);
+
+  user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", id,
+      "name", name,
+      "status", INF_USER_ACTIVE,
+      "flags", flags,
+      "connection", connection,
+      NULL
+    )
+  );
+
+  g_free(name);
+  inf_user_table_add_user(user_table, INF_USER(user));
+  g_object_unref(user);
+
+  return user;
+}
+
+static void
+inf_test_text_benchmark_init_site(InfTestTextBenchmark* benchmark,
+                                  guint index,
+                                  InfTextChunk* initial)
+{
+  InfTestTextBenchmarkSite* site;
+  InfUserTable* user_table;
+  guint i;
+
+  site = &benchmark->sites[index];
+
+  site->buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  inf_text_buffer_insert_chunk(site->buffer, 0, initial, NULL);
+
+  site->manager = inf_communication_manager_new();
+  site->user = NULL;
+
+  /* The connections have already been created, so that the central site
+   * can refer to them. */
+  if(index == 0)
+  {
+    site->group = INF_COMMUNICATION_GROUP(
+      inf_communication_manager_open_group(
+        site->manager,
+        "InfTestTextBenchmark",
+        NULL
+      )
+    );
+
+    for(i = 1; i < benchmark->n_sites; ++i)
+    {
+      inf_communication_hosted_group_add_member(
+        INF_COMMUNICATION_HOSTED_GROUP(site->group),
+        INF_XML_CONNECTION(benchmark->sites[i].central_conn)
+      );
+    }
+  }
+  else
+  {
+    site->group = INF_COMMUNICATION_GROUP(
+      inf_communication_manager_join_group(
+        site->manager,
+        "InfTestTextBenchmark",
+        INF_XML_CONNECTION(site->conn),
+        "central"
+      )
+    );
+  }
+
+  /* Users 1 to n are at sites 1 to n, respectively. The central site only
+   * forwards requests and has no local user. */
+  user_table = inf_user_table_new();
+  for(i = 1; i < benchmark->n_sites; ++i)
+  {
+    if(index == 0)
+    {
+      inf_test_text_benchmark_add_user(
+        user_table,
+        i,
+        0,
+        benchmark->sites[i].central_conn
+      );
+    }
+    else if(index == i)
+    {
+      site->user = inf_test_text_benchmark_add_user(
+        user_table,
+        i,
+        INF_USER_LOCAL,
+        NULL
+      );
+    }
+    else
+    {
+      inf_test_text_benchmark_add_user(user_table, i, 0, site->conn);
+    }
+  }
+
+  site->session = inf_text_session_new_with_user_table(
+    site->manager,
+    site->buffer,
+    benchmark->io,
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(user_table);
+
+  /* Send caret updates right away, since the IO is never run */
+  g_object_set(G_OBJECT(site->session), "caret-update-interval", 0, NULL);
+
+  inf_communication_group_set_target(
+    site->group,
+    INF_COMMUNICATION_OBJECT(site->session)
+  );
+
+  inf_session_set_subscription_group(INF_SESSION(site->session), site->group);
+
+  g_signal_connect(
+    G_OBJECT(inf_adopted_session_get_algorithm(
+      INF_ADOPTED_SESSION(site->session))),
+    "begin-execute-request",
+    G_CALLBACK(inf_test_text_benchmark_begin_execute_request_cb),
+    site
+  );
+
+  g_signal_connect(
+    G_OBJECT(inf_adopted_session_get_algorithm(
+      INF_ADOPTED_SESSION(site->session))),
+    "end-execute-request",
+    G_CALLBACK(inf_test_text_benchmark_end_execute_request_cb),
+    site
+  );
+}
+
+static void
+inf_test_text_benchmark_edit(InfTestTextBenchmark* benchmark,
+                             InfTestTextBenchmarkSite* site)
+{
+  static const gchar CHARS[] = "abcdefghijklmnopqrstuvwxyz    \n";
+  guint length;
+  guint position;
+
+  length = inf_text_buffer_get_length(site->buffer);
+
+  if(g_rand_double(benchmark->rand) < jump_ratio)
+  {
+    inf_text_user_set_selection(
+      site->user,
+      g_rand_int_range(benchmark->rand, 0, length + 1),
+      0,
+      TRUE
+    );
+  }
+
+  /* The session keeps the caret up to date with local and remote edits */
+  position = inf_text_user_get_caret_position(site->user);
+
+  if(g_rand_double(benchmark->rand) < insert_ratio || position == 0)
+  {
+    inf_text_buffer_insert_text(
+      site->buffer,
+      position,
+      &CHARS[g_rand_int_range(benchmark->rand, 0, sizeof(CHARS) - 1)],
+      1,
+      1,
+      INF_USER(site->user)
+    );
+  }
+  else
+  {
+    inf_text_buffer_erase_text(
+      site->buffer,
+      position - 1,
+      1,
+      INF_USER(site->user)
+    );
+  }
+}
+
+static void
+inf_test_text_benchmark_deliver(InfTestTextBenchmark* benchmark,
+                                guint tick)
+{
+  InfTestTextBenchmarkSite* site;
+  guint i;
+
+  /* Spread deliveries of the different connections over the latency
+   * period, so that not all sites are synchronized at the same time. */
+  for(i = 1; i < benchmark->n_sites; ++i)
+  {
+    site = &benchmark->sites[i];
+
+    if((tick + i) % latency == 0)
+      inf_simulated_connection_flush(site->conn);
+    if((tick + i + latency / 2) % latency == 0)
+      inf_simulated_connection_flush(site->central_conn);
+  }
+}
+
+static gboolean
+inf_test_text_benchmark_check(InfTestTextBenchmark* benchmark)
+{
+  InfTextChunk* expected;
+  InfTextChunk* chunk;
+  guint i;
+  gboolean result;
+
+  /* Deliver everything that is still in flight: first from the users to
+   * the central site, then from there to the users. */
+  for(i = 1; i < benchmark->n_sites; ++i)
+    inf_simulated_connection_flush(benchmark->sites[i].conn);
+  for(i = 1; i < benchmark->n_sites; ++i)
+    inf_simulated_connection_flush(benchmark->sites[i].central_conn);
+
+  expected = inf_text_buffer_get_slice(
+    benchmark->sites[0].buffer,
+    0,
+    inf_text_buffer_get_length(benchmark->sites[0].buffer)
+  );
+
+  result = TRUE;
+  for(i = 1; i < benchmark->n_sites && result == TRUE; ++i)
+  {
+    chunk = inf_text_buffer_get_slice(
+      benchmark->sites[i].buffer,
+      0,
+      inf_text_buffer_get_length(benchmark->sites[i].buffer)
+    );
+
+    if(!inf_text_chunk_equal(chunk, expected))
+    {
+      fprintf(stderr, "Buffer of user %u does not converge\n", i);
+      result = FALSE;
+    }
+
+    inf_text_chunk_free(chunk);
+  }
+
+  inf_text_chunk_free(expected);
+  return result;
+}
+
+static void
+inf_test_text_benchmark_cache_statistics_foreach_func(InfUser* user,
+                                                      gpointer user_data)
+{
+  guint64* totals;
+  guint64 hits;
+  guint64 misses;
+
+  totals = (guint64*)user_data;
+
+  inf_adopted_request_log_get_cache_statistics(
+    inf_adopted_user_get_request_log(INF_ADOPTED_USER(user)),
+    &hits,
+    &misses,
+    NULL
+  );
+
+  totals[0] += hits;
+  totals[1] += misses;
+}
+
+static void
+inf_test_text_benchmark_report(InfTestTextBenchmark* benchmark,
+                               gdouble elapsed)
+{
+  guint64 totals[2];
+  guint n;
+  guint i;
+  gint64 p50;
+  gint64 p99;
+  glong peak_rss;
+#ifndef G_OS_WIN32
+  struct rusage usage;
+#endif
+
+  /* Every cache miss means that a request had to be transformed. */
+  totals[0] = totals[1] = 0;
+  for(i = 0; i < benchmark->n_sites; ++i)
+  {
+    inf_user_table_foreach_user(
+      inf_session_get_user_table(INF_SESSION(benchmark->sites[i].session)),
+      inf_test_text_benchmark_cache_statistics_foreach_func,
+      totals
+    );
+  }
+
+  n = benchmark->execute_times->len;
+  g_array_sort(benchmark->execute_times, inf_test_text_benchmark_compare_time);
+
+  p50 = p99 = 0;
+  if(n > 0)
+  {
+    p50 = g_array_index(benchmark->execute_times, gint64, n / 2);
+    p99 = g_array_index(benchmark->execute_times, gint64, (n * 99) / 100);
+  }
+
+  peak_rss = 0;
+#ifndef G_OS_WIN32
+  if(getrusage(RUSAGE_SELF, &usage) == 0)
+    peak_rss = usage.ru_maxrss;
+#endif
+
+  printf("users=%d\n", users);
+  printf("ticks=%d\n", ticks);
+  printf("edit_rate=%g\n", edit_rate);
+  printf("latency=%d\n", latency);
+  printf("insert_ratio=%g\n", insert_ratio);
+  printf("document_size=%d\n", document_size);
+  printf("seed=%d\n", seed);
+  printf("elapsed_sec=%.3f\n", elapsed);
+  printf("executed_requests=%u\n", n);
+  printf("execute_sec=%.3f\n", benchmark->total_execute_time / 1e6);
+  printf("transforms=%" G_GUINT64_FORMAT "\n", totals[1]);
+
+  printf(
+    "transforms_per_sec=%.0f\n",
+    benchmark->total_execute_time > 0 ?
+      totals[1] / (benchmark->total_execute_time / 1e6) : 0.0
+  );
+
+  printf(
+    "cache_hit_rate=%.4f\n",
+    totals[0] + totals[1] > 0 ?
+      (gdouble)totals[0] / (totals[0] + totals[1]) : 0.0
+  );
+
+  printf("execute_p50_usec=%" G_GINT64_FORMAT "\n", p50);
+  printf("execute_p99_usec=%" G_GINT64_FORMAT "\n", p99);
+  printf("peak_rss_kb=%ld\n", peak_rss);
+}
+
+int
+main(int argc, char* argv[])
+{
+  GOptionContext* context;
+  GError* error;
+  InfTestTextBenchmark benchmark;
+  InfTestTextBenchmarkSite* site;
+  InfTextChunk* initial;
+  GString* text;
+  GTimer* timer;
+  gdouble elapsed;
+  guint tick;
+  guint i;
+  int ret;
+
+  error = NULL;
+  context = g_option_context_new("- measure adOPTed performance");
+  g_option_context_add_main_entries(context, entries, NULL);
+
+  if(!g_option_context_parse(context, &argc, &argv, &error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    g_option_context_free(context);
+    return -1;
+  }
+
+  g_option_context_free(context);
+
+  if(users < 1 || ticks < 0 || latency < 1 || document_size < 0)
+  {
+    fprintf(stderr, "Invalid parameters\n");
+    return -1;
+  }
+
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  benchmark.rand = g_rand_new_with_seed(seed);
+  benchmark.io = INF_IO(inf_standalone_io_new());
+  benchmark.n_sites = users + 1;
+  benchmark.sites = g_new(InfTestTextBenchmarkSite, benchmark.n_sites);
+  benchmark.execute_times = g_array_new(FALSE, FALSE, sizeof(gint64));
+  benchmark.total_execute_time = 0;
+
+  text = g_string_sized_new(document_size);
+  for(i = 0; i < (guint)document_size; ++i)
+    g_string_append_c(text, (i % 64 == 63) ? '\n' : 'a' + (i % 26));
+
+  initial = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(initial, 0, text->str, text->len, text->len, 0);
+  g_string_free(text, TRUE);
+
+  for(i = 0; i < benchmark.n_sites; ++i)
+  {
+    site = &benchmark.sites[i];
+    site->benchmark = &benchmark;
+    site->execute_begin = 0;
+    site->conn = NULL;
+    site->central_conn = NULL;
+
+    if(i > 0)
+    {
+      site->conn = inf_simulated_connection_new();
+      site->central_conn = inf_simulated_connection_new();
+      inf_simulated_connection_connect(site->conn, site->central_conn);
+
+      inf_simulated_connection_set_mode(
+        site->conn,
+        INF_SIMULATED_CONNECTION_DELAYED
+      );
+
+      inf_simulated_connection_set_mode(
+        site->central_conn,
+        INF_SIMULATED_CONNECTION_DELAYED
+      );
+    }
+  }
+
+  for(i = 0; i < benchmark.n_sites; ++i)
+    inf_test_text_benchmark_init_site(&benchmark, i, initial);
+  inf_text_chunk_free(initial);
+
+  /* Only measure the simulation itself */
+  g_array_set_size(benchmark.execute_times, 0);
+  benchmark.total_execute_time = 0;
+
+  timer = g_timer_new();
+
+  for(tick = 0; tick < (guint)ticks; ++tick)
+  {
+    for(i = 1; i < benchmark.n_sites; ++i)
+      if(g_rand_double(benchmark.rand) < edit_rate)
+        inf_test_text_benchmark_edit(&benchmark, &benchmark.sites[i]);
+
+    inf_test_text_benchmark_deliver(&benchmark, tick);
+  }
+
+  ret = inf_test_text_benchmark_check(&benchmark) ? 0 : -1;
+
+  elapsed = g_timer_elapsed(timer, NULL);
+  g_timer_destroy(timer);
+
+  inf_test_text_benchmark_report(&benchmark, elapsed);
+
+  for(i = 0; i < benchmark.n_sites; ++i)
+  {
+    g_object_unref(benchmark.sites[i].session);
+    g_object_unref(benchmark.sites[i].buffer);
+    g_object_unref(benchmark.sites[i].group);
+    g_object_unref(benchmark.sites[i].manager);
+
+    if(benchmark.sites[i].conn != NULL)
+    {
+      g_object_unref(benchmark.sites[i].conn);
+      g_object_unref(benchmark.sites[i].central_conn);
+    }
+  }
+
+  g_free(benchmark.sites);
+  g_array_free(benchmark.execute_times, TRUE);
+  g_object_unref(benchmark.io);
+  g_rand_free(benchmark.rand);
+
+  return ret;
+}
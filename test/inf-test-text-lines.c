@@ -0,0 +1,153 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <libinftext/inf-text-default-buffer.h>
+
+/* Checks the line information of buffer against the text it should
+ * contain, which is stored as an array of gunichar. */
+static void
+test_lines_check(InfTextBuffer* buffer,
+                 GArray* text)
+{
+  guint offset;
+  guint line;
+  guint column;
+  guint expected_line;
+  guint expected_column;
+
+  expected_line = 0;
+  expected_column = 0;
+
+  for(offset = 0; offset <= text->len; ++offset)
+  {
+    inf_text_buffer_offset_to_line(buffer, offset, &line, &column);
+    g_assert(line == expected_line);
+    g_assert(column == expected_column);
+
+    if(expected_column == 0)
+    {
+      g_assert(
+        inf_text_buffer_line_to_offset(buffer, expected_line) == offset
+      );
+    }
+
+    if(offset < text->len && g_array_index(text, gunichar, offset) == '\n')
+    {
+      ++expected_line;
+      expected_column = 0;
+    }
+    else
+    {
+      ++expected_column;
+    }
+  }
+
+  g_assert(inf_text_buffer_get_line_count(buffer) == expected_line + 1);
+}
+
+int main()
+{
+  static const gchar* const CHARS[] = { "a", "\n", "ü", "𝄞", "\n" };
+
+  InfTextBuffer* buffer;
+  InfTextChunk* chunk;
+  InfTextChunk* slice;
+  GArray* text;
+  GString* insert;
+  gunichar* ucs4;
+  GRand* rand;
+  guint pos;
+  guint len;
+  guint i;
+  guint j;
+
+  buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  text = g_array_new(FALSE, FALSE, sizeof(gunichar));
+  insert = g_string_new(NULL);
+  rand = g_rand_new_with_seed(42);
+
+  test_lines_check(buffer, text);
+
+  for(i = 0; i < 2000; ++i)
+  {
+    if(text->len == 0 || g_rand_int_range(rand, 0, 3) != 0)
+    {
+      pos = g_rand_int_range(rand, 0, text->len + 1);
+      len = g_rand_int_range(rand, 1, 20);
+
+      g_string_truncate(insert, 0);
+      for(j = 0; j < len; ++j)
+      {
+        g_string_append(
+          insert,
+          CHARS[g_rand_int_range(rand, 0, G_N_ELEMENTS(CHARS))]
+        );
+      }
+
+      inf_text_buffer_insert_text(
+        buffer,
+        pos,
+        insert->str,
+        insert->len,
+        len,
+        NULL
+      );
+
+      ucs4 = g_utf8_to_ucs4_fast(insert->str, insert->len, NULL);
+      g_array_insert_vals(text, pos, ucs4, len);
+      g_free(ucs4);
+    }
+    else
+    {
+      pos = g_rand_int_range(rand, 0, text->len);
+      len = g_rand_int_range(rand, 1, MIN(text->len - pos, 30) + 1);
+
+      inf_text_buffer_erase_text(buffer, pos, len, NULL);
+      g_array_remove_range(text, pos, len);
+    }
+
+    if(i % 20 == 0)
+      test_lines_check(buffer, text);
+  }
+
+  test_lines_check(buffer, text);
+
+  /* Reload the buffer contents in one go */
+  chunk = inf_text_buffer_get_slice(buffer, 0, text->len);
+  inf_text_buffer_clear(buffer, NULL);
+  g_assert(inf_text_buffer_get_length(buffer) == 0);
+  g_assert(inf_text_buffer_get_line_count(buffer) == 1);
+
+  inf_text_buffer_append(buffer, chunk, NULL);
+  slice = inf_text_buffer_get_slice(buffer, 0, text->len);
+  g_assert(inf_text_chunk_equal(chunk, slice));
+  inf_text_chunk_free(slice);
+  inf_text_chunk_free(chunk);
+
+  test_lines_check(buffer, text);
+
+  g_array_free(text, TRUE);
+  g_string_free(insert, TRUE);
+  g_rand_free(rand);
+  g_object_unref(buffer);
+
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
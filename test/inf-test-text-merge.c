@@ -0,0 +1,439 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Tests merging of local modifications with InfTextSession:merge-interval.
+ * The same edits are made in a session that sends every character on its
+ * own and in one that merges them, and both need to end up with the same
+ * text and to be undone in the same steps. Also checks that a held back
+ * modification reaches other sites when its user leaves the session. */
+
+#include <libinftext/inf-text-session.h>
+#include <libinftext/inf-text-default-buffer.h>
+#include <libinftext/inf-text-buffer.h>
+#include <libinftext/inf-text-undo-grouping.h>
+#include <libinftext/inf-text-user.h>
+#include <libinftext/inf-text-chunk.h>
+
+#include <libinfinity/adopted/inf-adopted-algorithm.h>
+#include <libinfinity/adopted/inf-adopted-request-log.h>
+#include <libinfinity/communication/inf-communication-manager.h>
+#include <libinfinity/communication/inf-communication-hosted-group.h>
+#include <libinfinity/common/inf-simulated-connection.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-user-table.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <string.h>
+#include <stdio.h>
+
+typedef struct _InfTestTextMergeSite InfTestTextMergeSite;
+struct _InfTestTextMergeSite {
+  InfCommunicationManager* manager;
+  InfCommunicationGroup* group;
+  InfTextSession* session;
+  InfTextBuffer* buffer;
+  InfTextUser* user;
+  InfAdoptedUndoGrouping* grouping;
+};
+
+/* Creates a site with user 1, which is local if connection is NULL. With a
+ * connection the site joins the group hosted at the other end of it, and
+ * without one it hosts the group itself, with host_conn as the only member
+ * if given. */
+static void
+inf_test_text_merge_init_site(InfTestTextMergeSite* site,
+                              InfIo* io,
+                              guint merge_interval,
+                              InfSimulatedConnection* host_conn,
+                              InfSimulatedConnection* connection)
+{
+  InfUserTable* user_table;
+
+  site->buffer = INF_TEXT_BUFFER(inf_text_default_buffer_new("UTF-8"));
+  site->manager = inf_communication_manager_new();
+
+  if(connection == NULL)
+  {
+    site->group = INF_COMMUNICATION_GROUP(
+      inf_communication_manager_open_group(
+        site->manager,
+        "InfTestTextMerge",
+        NULL
+      )
+    );
+
+    if(host_conn != NULL)
+    {
+      inf_communication_hosted_group_add_member(
+        INF_COMMUNICATION_HOSTED_GROUP(site->group),
+        INF_XML_CONNECTION(host_conn)
+      );
+    }
+  }
+  else
+  {
+    site->group = INF_COMMUNICATION_GROUP(
+      inf_communication_manager_join_group(
+        site->manager,
+        "InfTestTextMerge",
+        INF_XML_CONNECTION(connection),
+        "central"
+      )
+    );
+  }
+
+  user_table = inf_user_table_new();
+
+  site->user = INF_TEXT_USER(
+    g_object_new(
+      INF_TEXT_TYPE_USER,
+      "id", 1,
+      "name", "User_1",
+      "status", INF_USER_ACTIVE,
+      "flags", connection == NULL ? INF_USER_LOCAL : 0,
+      "connection", connection,
+      NULL
+    )
+  );
+
+  inf_user_table_add_user(user_table, INF_USER(site->user));
+  g_object_unref(site->user);
+
+  site->session = inf_text_session_new_with_user_table(
+    site->manager,
+    site->buffer,
+    io,
+    user_table,
+    INF_SESSION_RUNNING,
+    NULL,
+    NULL
+  );
+
+  g_object_unref(user_table);
+
+  /* The IO is never run, so a merged modification is only sent when it is
+   * flushed explicitly or cannot be merged with the next one. */
+  g_object_set(
+    G_OBJECT(site->session),
+    "caret-update-interval", 0,
+    "merge-interval", merge_interval,
+    NULL
+  );
+
+  inf_communication_group_set_target(
+    site->group,
+    INF_COMMUNICATION_OBJECT(site->session)
+  );
+
+  inf_session_set_subscription_group(INF_SESSION(site->session), site->group);
+
+  site->grouping = INF_ADOPTED_UNDO_GROUPING(inf_text_undo_grouping_new());
+  inf_adopted_undo_grouping_set_algorithm(
+    site->grouping,
+    inf_adopted_session_get_algorithm(INF_ADOPTED_SESSION(site->session)),
+    INF_ADOPTED_USER(site->user)
+  );
+}
+
+static void
+inf_test_text_merge_finalize_site(InfTestTextMergeSite* site)
+{
+  g_object_unref(site->grouping);
+  g_object_unref(site->session);
+  g_object_unref(site->buffer);
+  g_object_unref(site->group);
+  g_object_unref(site->manager);
+}
+
+static void
+inf_test_text_merge_type(InfTestTextMergeSite* site,
+                         guint pos,
+                         const gchar* text)
+{
+  for(; *text != '\0'; ++text, ++pos)
+  {
+    inf_text_buffer_insert_text(
+      site->buffer,
+      pos,
+      text,
+      1,
+      1,
+      INF_USER(site->user)
+    );
+  }
+}
+
+static void
+inf_test_text_merge_erase(InfTestTextMergeSite* site,
+                          guint pos)
+{
+  inf_text_buffer_erase_text(site->buffer, pos, 1, INF_USER(site->user));
+}
+
+static void
+inf_test_text_merge_flush(InfTestTextMergeSite* site)
+{
+  inf_text_session_flush_requests_for_user(site->session, site->user);
+}
+
+static guint
+inf_test_text_merge_get_log_size(InfTestTextMergeSite* site)
+{
+  return inf_adopted_request_log_get_end(
+    inf_adopted_user_get_request_log(INF_ADOPTED_USER(site->user))
+  );
+}
+
+static gboolean
+inf_test_text_merge_check_text(InfTextBuffer* buffer,
+                               const gchar* expected)
+{
+  InfTextChunk* expected_chunk;
+  InfTextChunk* chunk;
+  gboolean result;
+
+  expected_chunk = inf_text_chunk_new("UTF-8");
+  inf_text_chunk_insert_text(
+    expected_chunk,
+    0,
+    expected,
+    strlen(expected),
+    g_utf8_strlen(expected, -1),
+    0
+  );
+
+  chunk = inf_text_buffer_get_slice(
+    buffer,
+    0,
+    inf_text_buffer_get_length(buffer)
+  );
+
+  result = inf_text_chunk_equal(chunk, expected_chunk);
+
+  inf_text_chunk_free(chunk);
+  inf_text_chunk_free(expected_chunk);
+  return result;
+}
+
+static gboolean
+inf_test_text_merge_check_equal(InfTestTextMergeSite* first,
+                                InfTestTextMergeSite* second)
+{
+  InfTextChunk* first_chunk;
+  InfTextChunk* second_chunk;
+  gboolean result;
+
+  first_chunk = inf_text_buffer_get_slice(
+    first->buffer,
+    0,
+    inf_text_buffer_get_length(first->buffer)
+  );
+
+  second_chunk = inf_text_buffer_get_slice(
+    second->buffer,
+    0,
+    inf_text_buffer_get_length(second->buffer)
+  );
+
+  result = inf_text_chunk_equal(first_chunk, second_chunk);
+
+  inf_text_chunk_free(first_chunk);
+  inf_text_chunk_free(second_chunk);
+  return result;
+}
+
+/* Makes edits that are merged into runs if site has a merge interval */
+static void
+inf_test_text_merge_edit(InfTestTextMergeSite* site)
+{
+  /* A new run starts after the whitespace */
+  inf_test_text_merge_type(site, 0, "hello world");
+
+  /* Two insertion runs that belong to the same undo group */
+  inf_test_text_merge_type(site, 11, "foo");
+  inf_test_text_merge_flush(site);
+  inf_test_text_merge_type(site, 14, "bar");
+
+  /* A backspace run, followed by a single backspace */
+  inf_test_text_merge_erase(site, 16);
+  inf_test_text_merge_erase(site, 15);
+  inf_test_text_merge_flush(site);
+  inf_test_text_merge_erase(site, 14);
+
+  /* A forward deletion run somewhere else */
+  inf_test_text_merge_erase(site, 0);
+  inf_test_text_merge_erase(site, 0);
+
+  /* A backspace run, which is not merged with the forward deletion
+   * following it, but grouped with it for undo. */
+  inf_test_text_merge_erase(site, 5);
+  inf_test_text_merge_erase(site, 4);
+  inf_test_text_merge_erase(site, 4);
+
+  inf_test_text_merge_flush(site);
+}
+
+static int
+inf_test_text_merge_undo(InfIo* io)
+{
+  InfTestTextMergeSite single;
+  InfTestTextMergeSite merged;
+  guint single_size;
+  guint merged_size;
+  guint steps;
+
+  inf_test_text_merge_init_site(&single, io, 0, NULL, NULL);
+  inf_test_text_merge_init_site(&merged, io, 1000, NULL, NULL);
+
+  inf_test_text_merge_edit(&single);
+  inf_test_text_merge_edit(&merged);
+
+  if(!inf_test_text_merge_check_text(single.buffer, "llo ldfoo") ||
+     !inf_test_text_merge_check_equal(&single, &merged))
+  {
+    fprintf(stderr, "Merged modifications lead to different text\n");
+    return -1;
+  }
+
+  if(inf_test_text_merge_get_log_size(&merged) >=
+     inf_test_text_merge_get_log_size(&single))
+  {
+    fprintf(stderr, "Modifications have not been merged\n");
+    return -1;
+  }
+
+  /* Both sites need to undo the same text in every step */
+  steps = 0;
+  for(;;)
+  {
+    single_size = inf_adopted_undo_grouping_get_undo_size(single.grouping);
+    merged_size = inf_adopted_undo_grouping_get_undo_size(merged.grouping);
+    if(single_size == 0 || merged_size == 0)
+      break;
+
+    inf_adopted_session_undo(
+      INF_ADOPTED_SESSION(single.session),
+      INF_ADOPTED_USER(single.user),
+      single_size
+    );
+
+    inf_adopted_session_undo(
+      INF_ADOPTED_SESSION(merged.session),
+      INF_ADOPTED_USER(merged.user),
+      merged_size
+    );
+
+    ++steps;
+    if(!inf_test_text_merge_check_equal(&single, &merged))
+    {
+      fprintf(stderr, "Undo step %u differs for merged requests\n", steps);
+      return -1;
+    }
+  }
+
+  if(single_size != merged_size ||
+     !inf_test_text_merge_check_text(merged.buffer, ""))
+  {
+    fprintf(stderr, "Merged requests are undone in a different number of "
+                    "steps\n");
+    return -1;
+  }
+
+  inf_test_text_merge_finalize_site(&single);
+  inf_test_text_merge_finalize_site(&merged);
+  return 0;
+}
+
+static int
+inf_test_text_merge_leave(InfIo* io)
+{
+  InfSimulatedConnection* conn;
+  InfSimulatedConnection* host_conn;
+  InfTestTextMergeSite local;
+  InfTestTextMergeSite remote;
+  int result;
+
+  conn = inf_simulated_connection_new();
+  host_conn = inf_simulated_connection_new();
+  inf_simulated_connection_connect(conn, host_conn);
+  inf_simulated_connection_set_mode(conn, INF_SIMULATED_CONNECTION_DELAYED);
+  inf_simulated_connection_set_mode(
+    host_conn,
+    INF_SIMULATED_CONNECTION_DELAYED
+  );
+
+  inf_test_text_merge_init_site(&local, io, 1000, host_conn, NULL);
+  inf_test_text_merge_init_site(&remote, io, 0, NULL, conn);
+
+  /* The user leaves while its typing is still held back. The request
+   * must be sent before the status change, since the other sites do not
+   * accept requests from users that are not available. */
+  inf_test_text_merge_type(&local, 0, "ab");
+  g_assert(inf_test_text_merge_get_log_size(&local) == 0);
+
+  inf_session_set_user_status(
+    INF_SESSION(local.session),
+    INF_USER(local.user),
+    INF_USER_UNAVAILABLE
+  );
+
+  inf_simulated_connection_flush(host_conn);
+
+  result = 0;
+  if(inf_test_text_merge_get_log_size(&local) != 1 ||
+     inf_test_text_merge_get_log_size(&remote) != 1 ||
+     !inf_test_text_merge_check_text(remote.buffer, "ab") ||
+     inf_user_get_status(INF_USER(remote.user)) != INF_USER_UNAVAILABLE)
+  {
+    fprintf(stderr, "Held back request is lost when the user leaves\n");
+    result = -1;
+  }
+
+  inf_test_text_merge_finalize_site(&local);
+  inf_test_text_merge_finalize_site(&remote);
+  g_object_unref(conn);
+  g_object_unref(host_conn);
+  return result;
+}
+
+int main()
+{
+  GError* error;
+  InfIo* io;
+  int result;
+
+  error = NULL;
+  if(!inf_init(&error))
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return -1;
+  }
+
+  io = INF_IO(inf_standalone_io_new());
+
+  result = inf_test_text_merge_undo(io);
+  if(result == 0)
+    result = inf_test_text_merge_leave(io);
+
+  g_object_unref(io);
+  return result;
+}
+
+/* vim:set et sw=2 ts=2: */
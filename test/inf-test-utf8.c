@@ -0,0 +1,122 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <libinfinity/common/inf-utf8.h>
+
+#include <string.h>
+
+/* Compares the results of the libinfinity functions with their GLib
+ * counterparts for all prefixes of text, so that every tail length after
+ * the last full block is covered. */
+static void
+test_utf8_text(const gchar* text)
+{
+  gsize bytes;
+  gsize len;
+  gsize chars;
+  gsize i;
+
+  for(bytes = 0; bytes <= strlen(text); ++bytes)
+  {
+    /* Only check prefixes ending at character boundaries */
+    if(!g_utf8_validate(text, bytes, NULL))
+      continue;
+
+    g_assert(inf_utf8_validate(text, bytes, NULL));
+
+    chars = g_utf8_strlen(text, bytes);
+    g_assert(inf_utf8_strlen(text, bytes) == chars);
+
+    g_assert(inf_utf8_offset_to_index(text, bytes, chars) == bytes);
+    len = g_utf8_offset_to_pointer(text, chars / 2) - text;
+    g_assert(inf_utf8_offset_to_index(text, bytes, chars / 2) == len);
+  }
+
+  bytes = strlen(text);
+  for(i = 0; i <= g_utf8_strlen(text, bytes); ++i)
+  {
+    len = g_utf8_offset_to_pointer(text, i) - text;
+    g_assert(inf_utf8_offset_to_index(text, bytes, i) == len);
+  }
+}
+
+static void
+test_utf8_invalid(const gchar* prefix,
+                  const gchar* invalid)
+{
+  gchar* text;
+  const gchar* end;
+
+  text = g_strconcat(prefix, invalid, "abc", NULL);
+
+  g_assert(!inf_utf8_validate(text, strlen(text), &end));
+  g_assert(end == text + strlen(prefix));
+
+  g_free(text);
+}
+
+int main()
+{
+  static const gchar* const invalid[] = {
+    "\x80",             /* lone continuation byte */
+    "\xc0\xaf",         /* overlong '/' */
+    "\xe0\x80\xaf",     /* overlong '/' */
+    "\xed\xa0\x80",     /* surrogate */
+    "\xf4\x90\x80\x80", /* beyond U+10FFFF */
+    "\xf8\x88\x80\x80", /* five byte sequence */
+    "\xe2\x82",         /* truncated */
+    "\xff",
+    NULL
+  };
+
+  GString* str;
+  const gchar* const* inv;
+  guint i;
+
+  test_utf8_text("");
+  test_utf8_text("a");
+  test_utf8_text("Hello World, this is a plain ASCII text with some length");
+  test_utf8_text("ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€ü𝄞€");
+
+  str = g_string_new(NULL);
+  for(i = 0; i < 40; ++i)
+  {
+    g_string_append(str, "abcdefghijklmnopqrstuvwxyz0123456789");
+    g_string_append(str, i % 3 == 0 ? "ä" : (i % 3 == 1 ? "€" : "𝄞"));
+  }
+
+  test_utf8_text(str->str);
+
+  /* Nul characters are valid */
+  g_assert(inf_utf8_validate("a\0b", 3, NULL));
+  g_assert(inf_utf8_strlen("a\0b", 3) == 3);
+  g_assert(inf_utf8_offset_to_index("a\0b", 3, 2) == 2);
+
+  for(inv = invalid; *inv != NULL; ++inv)
+  {
+    test_utf8_invalid("", *inv);
+    test_utf8_invalid("abc", *inv);
+    test_utf8_invalid(str->str, *inv);
+  }
+
+  g_string_free(str, TRUE);
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
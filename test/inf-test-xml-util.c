@@ -0,0 +1,239 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <libinfinity/common/inf-xml-util.h>
+
+#include <libxml/parser.h>
+#include <libxml/tree.h>
+
+#include <string.h>
+
+static xmlDocPtr
+test_xml_util_parse(const gchar* text)
+{
+  xmlDocPtr doc;
+
+  doc = xmlReadMemory(text, strlen(text), NULL, NULL, 0);
+  g_assert(doc != NULL);
+
+  return doc;
+}
+
+static gchar*
+test_xml_util_dump(xmlDocPtr doc,
+                   xmlNodePtr xml)
+{
+  xmlBufferPtr buffer;
+  gchar* result;
+
+  buffer = xmlBufferCreate();
+  g_assert(xmlNodeDump(buffer, doc, xml, 0, 0) >= 0);
+  result = g_strdup((const gchar*)xmlBufferContent(buffer));
+  xmlBufferFree(buffer);
+
+  return result;
+}
+
+static gchar*
+test_xml_util_write(xmlNodePtr xml)
+{
+  GString* string;
+
+  string = g_string_new(NULL);
+  inf_xml_util_write_node(string, xml);
+  return g_string_free(string, FALSE);
+}
+
+/* Checks that inf_xml_util_write_node() produces the same output as
+ * xmlNodeDump() for text that contains only ASCII characters. */
+static void
+test_xml_util_same(const gchar* text)
+{
+  xmlDocPtr doc;
+  gchar* expected;
+  gchar* written;
+
+  doc = test_xml_util_parse(text);
+  expected = test_xml_util_dump(doc, xmlDocGetRootElement(doc));
+  written = test_xml_util_write(xmlDocGetRootElement(doc));
+
+  if(strcmp(expected, written) != 0)
+  {
+    fprintf(stderr, "Input: %s\n", text);
+    fprintf(stderr, "xmlNodeDump: %s\n", expected);
+    fprintf(stderr, "inf_xml_util_write_node: %s\n", written);
+    g_assert_not_reached();
+  }
+
+  g_free(expected);
+  g_free(written);
+  xmlFreeDoc(doc);
+}
+
+/* Non-ASCII characters are written as raw UTF-8 by
+ * inf_xml_util_write_node(), whereas xmlNodeDump() turns them into
+ * character references when the document has no encoding set. Both must
+ * parse back into the same tree, though. */
+static void
+test_xml_util_equivalent(const gchar* text,
+                         const gchar* raw)
+{
+  xmlDocPtr doc;
+  xmlDocPtr reparsed;
+  gchar* expected;
+  gchar* written;
+  gchar* redumped;
+
+  doc = test_xml_util_parse(text);
+  expected = test_xml_util_dump(doc, xmlDocGetRootElement(doc));
+  written = test_xml_util_write(xmlDocGetRootElement(doc));
+
+  g_assert(strstr(written, raw) != NULL);
+
+  reparsed = test_xml_util_parse(written);
+  redumped = test_xml_util_dump(reparsed, xmlDocGetRootElement(reparsed));
+  g_assert(strcmp(expected, redumped) == 0);
+
+  g_free(redumped);
+  xmlFreeDoc(reparsed);
+  g_free(expected);
+  g_free(written);
+  xmlFreeDoc(doc);
+}
+
+/* Nodes built in memory are not necessarily part of a document */
+static void
+test_xml_util_detached(void)
+{
+  xmlDocPtr doc;
+  xmlNodePtr xml;
+  xmlNodePtr child;
+  gchar* written;
+  gchar* expected;
+
+  xml = xmlNewNode(NULL, (const xmlChar*)"request");
+  xmlNewProp(xml, (const xmlChar*)"user", (const xmlChar*)"1 & \"2\"");
+  child = xmlNewChild(xml, NULL, (const xmlChar*)"insert", NULL);
+  xmlNodeAddContent(child, (const xmlChar*)"<a>\r\n\tb");
+  xmlNewChild(xml, NULL, (const xmlChar*)"no-op", NULL);
+
+  written = test_xml_util_write(xml);
+
+  doc = xmlNewDoc((const xmlChar*)"1.0");
+  xmlDocSetRootElement(doc, xml);
+  expected = test_xml_util_dump(doc, xml);
+
+  g_assert(strcmp(expected, written) == 0);
+
+  g_free(expected);
+  g_free(written);
+  xmlFreeDoc(doc);
+}
+
+/* The numeric getters must find the same attributes as xmlGetProp() */
+static void
+test_xml_util_attributes(void)
+{
+  xmlDocPtr doc;
+  xmlNodePtr xml;
+  xmlAttrPtr attr;
+  xmlNodePtr text;
+  xmlChar* value;
+  guint uint_value;
+  gint int_value;
+  GError* error;
+
+  doc = test_xml_util_parse(
+    "<a xmlns:p=\"urn:p\" p:pos=\"3\" len=\"4\" neg=\"-&#50;\"/>"
+  );
+
+  xml = xmlDocGetRootElement(doc);
+  error = NULL;
+
+  value = xmlGetProp(xml, (const xmlChar*)"pos");
+  g_assert(value != NULL && strcmp((const char*)value, "3") == 0);
+  xmlFree(value);
+
+  g_assert(inf_xml_util_get_attribute_uint_required(
+    xml, "pos", &uint_value, &error));
+  g_assert(uint_value == 3);
+
+  g_assert(inf_xml_util_get_attribute_uint_required(
+    xml, "len", &uint_value, &error));
+  g_assert(uint_value == 4);
+
+  g_assert(inf_xml_util_get_attribute_int_required(
+    xml, "neg", &int_value, &error));
+  g_assert(int_value == -2);
+
+  g_assert(!inf_xml_util_get_attribute_uint(xml, "caret", &uint_value, NULL));
+  g_assert(error == NULL);
+
+  /* An attribute value consisting of more than one text node. Link the
+   * node manually, since xmlAddChild() would merge the two. */
+  attr = xmlHasProp(xml, (const xmlChar*)"len");
+  text = xmlNewText((const xmlChar*)"2");
+  text->parent = (xmlNodePtr)attr;
+  text->prev = attr->children;
+  attr->children->next = text;
+  attr->last = text;
+
+  g_assert(inf_xml_util_get_attribute_uint_required(
+    xml, "len", &uint_value, &error));
+  g_assert(uint_value == 42);
+
+  xmlFreeDoc(doc);
+}
+
+int main()
+{
+  /* Escaping in attributes and text */
+  test_xml_util_same(
+    "<a x=\"1 &amp; 2\" y=\"&lt;&gt;&quot;'\" z=\"&#10;&#9;&#13;\"/>"
+  );
+  test_xml_util_same("<a>&lt;b&gt; &amp; \"q\" 'q' &#13;&#10;&#9;</a>");
+  test_xml_util_same("<a><![CDATA[<raw> & ]]></a>");
+
+  /* Namespace definitions and prefixed names */
+  test_xml_util_same(
+    "<p:a xmlns:p=\"urn:p\" xmlns=\"urn:d?a&amp;b\" p:x=\"1\" y=\"2\">"
+    "<b/><p:c p:z=\"3\">t</p:c></p:a>"
+  );
+  test_xml_util_same(
+    "<a><b xmlns=\"urn:b\"><c/></b><q:d xmlns:q=\"urn:q\" q:e=\"f\"/></a>"
+  );
+
+  /* Empty elements */
+  test_xml_util_same("<a/>");
+  test_xml_util_same("<a></a>");
+  test_xml_util_same("<a><b/><c></c><d x=\"\"/></a>");
+
+  /* Non-ASCII text and attribute values */
+  test_xml_util_equivalent("<a x=\"\xc3\xbc\xe2\x82\xac\"/>", "\xc3\xbc");
+  test_xml_util_equivalent(
+    "<a>\xc3\xbc\xf0\x9d\x84\x9e &amp; \xe2\x82\xac</a>",
+    "\xc3\xbc\xf0\x9d\x84\x9e &amp; \xe2\x82\xac"
+  );
+
+  test_xml_util_detached();
+  test_xml_util_attributes();
+  return 0;
+}
+
+/* vim:set et sw=2 ts=2: */
@@ -0,0 +1,577 @@
+/* libinfinity - a GObject-based infinote implementation
+ * Copyright (C) 2007-2014 Armin Burgmeier <armin@arbur.net>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free
+ * Software Foundation, Inc., 51 Franklin St, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/* Connects a client to a server over the loopback interface with various
+ * compression settings, and checks that stanzas sent by the client are
+ * echoed back by the server unmodified. If both sites enable compression,
+ * the client's data on the wire must be considerably smaller than the
+ * stanzas themselves, and otherwise larger. */
+
+#include <libinfinity/server/infd-xmpp-server.h>
+#include <libinfinity/server/infd-xml-server.h>
+#include <libinfinity/common/inf-cert-util.h>
+#include <libinfinity/common/inf-standalone-io.h>
+#include <libinfinity/common/inf-error.h>
+#include <libinfinity/common/inf-xml-connection.h>
+#include <libinfinity/common/inf-xmpp-connection.h>
+#include <libinfinity/common/inf-tcp-connection.h>
+#include <libinfinity/common/inf-ip-address.h>
+#include <libinfinity/common/inf-init.h>
+
+#include <gnutls/x509.h>
+#include <gnutls/gnutls.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+
+typedef struct _InfTestXmppCompressionDesc InfTestXmppCompressionDesc;
+struct _InfTestXmppCompressionDesc {
+  /* Name of the test */
+  const gchar* name;
+
+  /* Security policy of both sites */
+  InfXmppConnectionSecurityPolicy policy;
+
+  /* Compression levels */
+  guint server_level;
+  guint client_level;
+
+  /* Whether the client's data is expected to be sent compressed */
+  gboolean expect_compressed;
+};
+
+typedef struct _InfTestXmppCompressionData InfTestXmppCompressionData;
+struct _InfTestXmppCompressionData {
+  InfStandaloneIo* io;
+  GPtrArray* messages;
+
+  gboolean open;
+  guint received;
+  gsize sent_bytes;
+
+  gboolean timed_out;
+  GError* error;
+};
+
+static const InfTestXmppCompressionDesc TESTS[] = {
+  {
+    "tls-compressed",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_TLS,
+    6,
+    6,
+    TRUE
+  }, {
+    "tls-client-only",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_TLS,
+    0,
+    6,
+    FALSE
+  }, {
+    "tls-server-only",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_TLS,
+    6,
+    0,
+    FALSE
+  }, {
+    "unsecured-compressed",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    6,
+    6,
+    TRUE
+  }, {
+    "unsecured-client-only",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    0,
+    6,
+    FALSE
+  }, {
+    "unsecured-server-only",
+    INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED,
+    6,
+    0,
+    FALSE
+  }, {
+    NULL
+  }
+};
+
+static GQuark
+inf_test_xmpp_compression_error()
+{
+  return g_quark_from_static_string("INF_TEST_XMPP_COMPRESSION_ERROR");
+}
+
+static void
+inf_test_xmpp_compression_server_received_cb(InfXmlConnection* connection,
+                                             xmlNodePtr xml,
+                                             gpointer user_data)
+{
+  /* Echo everything back to the client */
+  inf_xml_connection_send(connection, xmlCopyNode(xml, 1));
+}
+
+static void
+inf_test_xmpp_compression_new_connection_cb(InfdXmlServer* server,
+                                            InfXmlConnection* conn,
+                                            gpointer user_data)
+{
+  g_object_ref(conn);
+
+  g_object_set_data_full(
+    G_OBJECT(server),
+    "client-connection",
+    conn,
+    g_object_unref
+  );
+
+  g_signal_connect(
+    G_OBJECT(conn),
+    "received",
+    G_CALLBACK(inf_test_xmpp_compression_server_received_cb),
+    NULL
+  );
+}
+
+static InfCertificateCredentials*
+inf_test_xmpp_compression_read_credentials(GError** error)
+{
+  gnutls_x509_privkey_t key;
+  GPtrArray* certs;
+  InfCertificateCredentials* creds;
+  guint i;
+  int res;
+
+  key = inf_cert_util_read_private_key("test-good-key.pem", error);
+  if(!key) return NULL;
+
+  certs = inf_cert_util_read_certificate("test-good-crt.pem", NULL, error);
+  if(!certs)
+  {
+    gnutls_x509_privkey_deinit(key);
+    return NULL;
+  }
+
+  creds = inf_certificate_credentials_new();
+  res = gnutls_certificate_set_x509_key(
+    inf_certificate_credentials_get(creds),
+    (gnutls_x509_crt_t*)certs->pdata,
+    certs->len,
+    key
+  );
+
+  gnutls_x509_privkey_deinit(key);
+  for(i = 0; i < certs->len; ++i)
+    gnutls_x509_crt_deinit(certs->pdata[i]);
+  g_ptr_array_free(certs, TRUE);
+
+  if(res != 0)
+  {
+    inf_certificate_credentials_unref(creds);
+    inf_gnutls_set_error(error, res);
+    return NULL;
+  }
+
+  return creds;
+}
+
+static InfdXmppServer*
+inf_test_xmpp_compression_setup_server(InfIo* io,
+                                       const InfTestXmppCompressionDesc* desc,
+                                       GError** error)
+{
+  InfdTcpServer* tcp;
+  InfdXmppServer* xmpp;
+  InfCertificateCredentials* creds;
+
+  creds = NULL;
+  if(desc->policy != INF_XMPP_CONNECTION_SECURITY_ONLY_UNSECURED)
+  {
+    creds = inf_test_xmpp_compression_read_credentials(error);
+    if(creds == NULL)
+      return NULL;
+  }
+
+  tcp = g_object_new(
+    INFD_TYPE_TCP_SERVER,
+    "io", io,
+    "local-port", 6525,
+    NULL
+  );
+
+  if(infd_tcp_server_open(tcp, error) == FALSE)
+  {
+    if(creds != NULL)
+      inf_certificate_credentials_unref(creds);
+    g_object_unref(tcp);
+    return NULL;
+  }
+
+  xmpp = infd_xmpp_server_new(tcp, desc->policy, creds, NULL, NULL);
+  g_object_set(G_OBJECT(xmpp), "compression-level", desc->server_level, NULL);
+
+  g_signal_connect(
+    G_OBJECT(xmpp),
+    "new-connection",
+    G_CALLBACK(inf_test_xmpp_compression_new_connection_cb),
+    NULL
+  );
+
+  if(creds != NULL)
+    inf_certificate_credentials_unref(creds);
+  g_object_unref(tcp);
+  return xmpp;
+}
+
+static void
+inf_test_xmpp_compression_notify_status_cb(GObject* object,
+                                           GParamSpec* pspec,
+                                           gpointer user_data)
+{
+  InfTestXmppCompressionData* data;
+  InfXmlConnectionStatus status;
+  xmlNodePtr xml;
+  guint i;
+
+  data = (InfTestXmppCompressionData*)user_data;
+  g_object_get(object, "status", &status, NULL);
+
+  if(status == INF_XML_CONNECTION_OPEN)
+  {
+    /* Only count what is sent from now on */
+    data->open = TRUE;
+    data->sent_bytes = 0;
+
+    for(i = 0; i < data->messages->len; ++i)
+    {
+      xml = xmlNewNode(NULL, (const xmlChar*)"message");
+      xmlNodeAddContent(xml, (const xmlChar*)data->messages->pdata[i]);
+      inf_xml_connection_send(INF_XML_CONNECTION(object), xml);
+    }
+  }
+  else if(status == INF_XML_CONNECTION_CLOSING ||
+          status == INF_XML_CONNECTION_CLOSED)
+  {
+    if(inf_standalone_io_loop_running(data->io))
+      inf_standalone_io_loop_quit(data->io);
+  }
+}
+
+static void
+inf_test_xmpp_compression_received_cb(InfXmlConnection* connection,
+                                      xmlNodePtr xml,
+                                      gpointer user_data)
+{
+  InfTestXmppCompressionData* data;
+  xmlChar* content;
+
+  data = (InfTestXmppCompressionData*)user_data;
+  if(data->error != NULL) return;
+
+  content = xmlNodeGetContent(xml);
+
+  if(data->received >= data->messages->len ||
+     strcmp((const gchar*)xml->name, "message") != 0 ||
+     content == NULL ||
+     strcmp((const gchar*)content,
+            (const gchar*)data->messages->pdata[data->received]) != 0)
+  {
+    g_set_error(
+      &data->error,
+      inf_test_xmpp_compression_error(),
+      0,
+      "Message %u was not echoed correctly",
+      data->received
+    );
+  }
+
+  if(content != NULL)
+    xmlFree(content);
+
+  ++data->received;
+  if(data->error != NULL || data->received == data->messages->len)
+    inf_standalone_io_loop_quit(data->io);
+}
+
+static void
+inf_test_xmpp_compression_sent_cb(InfTcpConnection* connection,
+                                  gconstpointer buf,
+                                  guint len,
+                                  gpointer user_data)
+{
+  InfTestXmppCompressionData* data;
+  data = (InfTestXmppCompressionData*)user_data;
+
+  if(data->open)
+    data->sent_bytes += len;
+}
+
+static void
+inf_test_xmpp_compression_error_cb(InfXmlConnection* conn,
+                                   const GError* error,
+                                   gpointer user_data)
+{
+  InfTestXmppCompressionData* data;
+  data = (InfTestXmppCompressionData*)user_data;
+
+  if(data->error == NULL)
+    data->error = g_error_copy(error);
+}
+
+static void
+inf_test_xmpp_compression_timeout_func(gpointer user_data)
+{
+  InfTestXmppCompressionData* data;
+  data = (InfTestXmppCompressionData*)user_data;
+
+  data->timed_out = TRUE;
+  inf_standalone_io_loop_quit(data->io);
+}
+
+static gboolean
+inf_test_xmpp_compression_run(const InfTestXmppCompressionDesc* desc,
+                              GPtrArray* messages,
+                              GError** error)
+{
+  InfTestXmppCompressionData data;
+  InfdXmppServer* server;
+  InfIpAddress* addr;
+  InfTcpConnection* tcp;
+  InfXmppConnection* client;
+  InfIoTimeout* timeout;
+  gsize payload;
+  gboolean result;
+  guint i;
+
+  data.io = inf_standalone_io_new();
+  data.messages = messages;
+  data.open = FALSE;
+  data.received = 0;
+  data.sent_bytes = 0;
+  data.timed_out = FALSE;
+  data.error = NULL;
+
+  server = inf_test_xmpp_compression_setup_server(INF_IO(data.io), desc, error);
+  if(server == NULL)
+  {
+    g_object_unref(data.io);
+    return FALSE;
+  }
+
+  addr = inf_ip_address_new_loopback4();
+  tcp = inf_tcp_connection_new(INF_IO(data.io), addr, 6525);
+  inf_ip_address_free(addr);
+
+  client = inf_xmpp_connection_new(
+    tcp,
+    INF_XMPP_CONNECTION_CLIENT,
+    g_get_host_name(),
+    "test-good.gobby.0x539.de",
+    desc->policy,
+    NULL,
+    NULL,
+    NULL
+  );
+
+  g_object_set(G_OBJECT(client), "compression-level", desc->client_level, NULL);
+
+  g_signal_connect(
+    G_OBJECT(tcp),
+    "sent",
+    G_CALLBACK(inf_test_xmpp_compression_sent_cb),
+    &data
+  );
+
+  g_signal_connect(
+    G_OBJECT(client),
+    "notify::status",
+    G_CALLBACK(inf_test_xmpp_compression_notify_status_cb),
+    &data
+  );
+
+  g_signal_connect(
+    G_OBJECT(client),
+    "received",
+    G_CALLBACK(inf_test_xmpp_compression_received_cb),
+    &data
+  );
+
+  g_signal_connect(
+    G_OBJECT(client),
+    "error",
+    G_CALLBACK(inf_test_xmpp_compression_error_cb),
+    &data
+  );
+
+  if(inf_tcp_connection_open(tcp, error) == FALSE)
+  {
+    g_object_unref(tcp);
+    g_object_unref(client);
+    g_object_unref(server);
+    g_object_unref(data.io);
+    return FALSE;
+  }
+
+  timeout = inf_io_add_timeout(
+    INF_IO(data.io),
+    10000,
+    inf_test_xmpp_compression_timeout_func,
+    &data,
+    NULL
+  );
+
+  inf_standalone_io_loop(data.io);
+
+  if(!data.timed_out)
+    inf_io_remove_timeout(INF_IO(data.io), timeout);
+
+  payload = 0;
+  for(i = 0; i < messages->len; ++i)
+    payload += strlen(messages->pdata[i]);
+
+  result = FALSE;
+  if(data.error != NULL)
+  {
+    g_propagate_error(error, data.error);
+    data.error = NULL;
+  }
+  else if(data.timed_out)
+  {
+    g_set_error(
+      error,
+      inf_test_xmpp_compression_error(),
+      1,
+      "Timed out after %u of %u messages",
+      data.received,
+      messages->len
+    );
+  }
+  else if(data.received != messages->len)
+  {
+    g_set_error(
+      error,
+      inf_test_xmpp_compression_error(),
+      2,
+      "Connection closed after %u of %u messages",
+      data.received,
+      messages->len
+    );
+  }
+#ifdef HAVE_ZLIB
+  else if(desc->expect_compressed && data.sent_bytes * 4 > payload)
+  {
+    g_set_error(
+      error,
+      inf_test_xmpp_compression_error(),
+      3,
+      "Sent %lu bytes for a payload of %lu bytes, expected compression",
+      (unsigned long)data.sent_bytes,
+      (unsigned long)payload
+    );
+  }
+#endif
+  else if(!desc->expect_compressed && data.sent_bytes < payload)
+  {
+    g_set_error(
+      error,
+      inf_test_xmpp_compression_error(),
+      4,
+      "Sent %lu bytes for a payload of %lu bytes, expected no compression",
+      (unsigned long)data.sent_bytes,
+      (unsigned long)payload
+    );
+  }
+  else
+  {
+    result = TRUE;
+  }
+
+  infd_xml_server_close(INFD_XML_SERVER(server));
+  g_object_unref(client);
+  g_object_unref(tcp);
+  g_object_unref(server);
+  g_object_unref(data.io);
+
+  return result;
+}
+
+int
+main(int argc,
+     char** argv)
+{
+  const InfTestXmppCompressionDesc* test;
+  GPtrArray* messages;
+  GString* large;
+  GError* error;
+  int res;
+  guint i;
+
+  error = NULL;
+  if(inf_init(&error) == FALSE)
+  {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return EXIT_FAILURE;
+  }
+
+  /* So that the certificate files are found */
+  if(chdir("certs") != 0)
+  {
+    fprintf(stderr, "Failed to change into the certs directory\n");
+    return EXIT_FAILURE;
+  }
+
+  large = g_string_new(NULL);
+  for(i = 0; i < 2048; ++i)
+    g_string_append(large, "insert pos=\"17\" & <text> with some content\n");
+
+  messages = g_ptr_array_new();
+  g_ptr_array_add(messages, "a");
+  g_ptr_array_add(messages, large->str);
+  g_ptr_array_add(messages, "\xc3\xbc\xe2\x82\xac\xf0\x9d\x84\x9e <&> \"'");
+  g_ptr_array_add(messages, large->str);
+
+  res = EXIT_SUCCESS;
+  for(test = TESTS; test->name != NULL; ++test)
+  {
+    printf("%s...", test->name);
+    fflush(stdout);
+
+    error = NULL;
+    if(inf_test_xmpp_compression_run(test, messages, &error) == FALSE)
+    {
+      printf(" %s\n", error->message);
+      g_error_free(error);
+      res = EXIT_FAILURE;
+    }
+    else
+    {
+      printf(" OK\n");
+    }
+  }
+
+  g_ptr_array_free(messages, TRUE);
+  g_string_free(large, TRUE);
+  return res;
+}
+
+/* vim:set et sw=2 ts=2: */